@@ -0,0 +1,319 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include "chargingsessionhistory.h"
+#include "engineclock.h"
+
+#include <QLoggingCategory>
+
+#include <limits>
+#include <string.h>
+
+Q_DECLARE_LOGGING_CATEGORY(dcConsolinnoEnergy)
+
+static const quint32 historyMagic = 0x43534831; // "CSH1"
+static const quint32 historyVersion = 1;
+
+struct ChargingSessionHistory::Header {
+    quint32 magic;
+    quint32 version;
+    quint32 capacity;
+    quint32 first; // Slot of the oldest record
+    quint32 count;
+    quint32 reserved[3];
+};
+
+struct ChargingSessionHistory::Record {
+    qint64 recordedAt; // Seconds since epoch, never decreasing in ring order
+    uchar evChargerThingId[16];
+    uchar carThingId[16];
+    uchar sessionId[16];
+    char startedAt[32];
+    char finishedAt[32];
+    float initialBatteryEnergy;
+    float energyCharged;
+    float energyBattery;
+    qint32 duration;
+    qint32 batteryLevel;
+    qint32 state;
+    qint32 timestamp;
+    uchar reserved[12];
+};
+
+static void writeUuid(uchar* destination, const QUuid& uuid)
+{
+    QByteArray data = uuid.toRfc4122();
+    memcpy(destination, data.constData(), 16);
+}
+
+static QUuid readUuid(const uchar* source)
+{
+    return QUuid::fromRfc4122(QByteArray::fromRawData(reinterpret_cast<const char*>(source), 16));
+}
+
+static void writeString(char* destination, int size, const QString& string)
+{
+    QByteArray data = string.toUtf8().left(size - 1);
+    memset(destination, 0, size);
+    memcpy(destination, data.constData(), data.size());
+}
+
+ChargingSessionHistory::ChargingSessionHistory(
+    const QString& fileName, quint32 capacity, QObject* parent)
+    : QObject(parent)
+    , m_file(fileName)
+{
+    if (!open(qMax<quint32>(1, capacity))) {
+        qCWarning(dcConsolinnoEnergy())
+            << "ChargingSessionHistory: History not available" << m_file.fileName();
+    }
+}
+
+ChargingSessionHistory::~ChargingSessionHistory()
+{
+    if (m_data) {
+        m_file.unmap(m_data);
+    }
+    m_file.close();
+}
+
+bool ChargingSessionHistory::isOpen() const { return m_data != nullptr; }
+
+quint32 ChargingSessionHistory::capacity() const { return m_data ? header()->capacity : 0; }
+
+quint32 ChargingSessionHistory::count() const { return m_data ? header()->count : 0; }
+
+int ChargingSessionHistory::retentionDays() const { return m_retentionDays; }
+
+void ChargingSessionHistory::setRetentionDays(int retentionDays)
+{
+    m_retentionDays = qMax(0, retentionDays);
+}
+
+void ChargingSessionHistory::record(const ChargingSessionConfiguration& chargingSession)
+{
+    if (!m_data || chargingSession.sessionId().isNull())
+        return;
+
+    Header* h = header();
+    qint64 now = EngineClock::currentMSecsSinceEpoch() / 1000;
+    dropExpired(now);
+
+    // Update the session in place if it is the last one recorded for this charger
+    Record* record = nullptr;
+    auto lastSlot = m_lastSlots.constFind(chargingSession.evChargerThingId());
+    if (lastSlot != m_lastSlots.constEnd()) {
+        Record* last = reinterpret_cast<Record*>(m_data + sizeof(Header)) + lastSlot.value();
+        if (readUuid(last->sessionId) == chargingSession.sessionId()
+            && readUuid(last->evChargerThingId) == chargingSession.evChargerThingId()) {
+            record = last;
+        }
+    }
+
+    if (!record) {
+        qint64 recordedAt = now;
+        if (h->count > 0) {
+            // Keep the ring sorted even if the clock went backwards
+            recordedAt = qMax(recordedAt, recordAt(h->count - 1)->recordedAt);
+        }
+
+        quint32 slot = slotOf(h->count);
+        if (h->count == h->capacity) {
+            // Ring is full, the oldest record gets overwritten
+            Record* oldest = recordAt(0);
+            ThingId oldestCharger = readUuid(oldest->evChargerThingId);
+            if (m_lastSlots.value(oldestCharger, slot + 1) == slot) {
+                m_lastSlots.remove(oldestCharger);
+            }
+            h->first = (h->first + 1) % h->capacity;
+        } else {
+            h->count++;
+        }
+
+        record = reinterpret_cast<Record*>(m_data + sizeof(Header)) + slot;
+        memset(record, 0, sizeof(Record));
+        record->recordedAt = recordedAt;
+        writeUuid(record->evChargerThingId, chargingSession.evChargerThingId());
+        writeUuid(record->sessionId, chargingSession.sessionId());
+        m_lastSlots.insert(chargingSession.evChargerThingId(), slot);
+    }
+
+    writeUuid(record->carThingId, chargingSession.carThingId());
+    writeString(record->startedAt, sizeof(record->startedAt), chargingSession.startedAt());
+    writeString(record->finishedAt, sizeof(record->finishedAt), chargingSession.finishedAt());
+    record->initialBatteryEnergy = chargingSession.initialBatteryEnergy();
+    record->energyCharged = chargingSession.energyCharged();
+    record->energyBattery = chargingSession.energyBattery();
+    record->duration = chargingSession.duration();
+    record->batteryLevel = chargingSession.batteryLevel();
+    record->state = chargingSession.state();
+    record->timestamp = chargingSession.timestamp();
+}
+
+QList<ChargingSessionConfiguration> ChargingSessionHistory::sessions(
+    const ThingId& evChargerThingId, qint64 from, qint64 to, int limit) const
+{
+    QList<ChargingSessionConfiguration> sessions;
+    if (!m_data || from > to)
+        return sessions;
+
+    qint64 oldest = 0;
+    if (m_retentionDays > 0) {
+        oldest = EngineClock::currentMSecsSinceEpoch() / 1000 - m_retentionDays * 86400LL;
+    }
+
+    // Walk back from the newest record in range, a limit keeps the newest sessions
+    quint32 begin = lowerBound(qMax(from, oldest));
+    quint32 end = to == std::numeric_limits<qint64>::max() ? header()->count : lowerBound(to + 1);
+    QByteArray charger = evChargerThingId.toRfc4122();
+    for (quint32 index = end; index > begin; index--) {
+        const Record* record = recordAt(index - 1);
+        if (!evChargerThingId.isNull()
+            && memcmp(record->evChargerThingId, charger.constData(), 16) != 0)
+            continue;
+
+        sessions.prepend(session(record));
+        if (limit > 0 && sessions.count() >= limit)
+            break;
+    }
+
+    return sessions;
+}
+
+ChargingSessionConfiguration ChargingSessionHistory::session(const Record* record)
+{
+    ChargingSessionConfiguration session;
+    session.setEvChargerThingId(readUuid(record->evChargerThingId));
+    session.setCarThingId(readUuid(record->carThingId));
+    session.setSessionId(readUuid(record->sessionId));
+    session.setStartedAt(QString::fromUtf8(record->startedAt,
+        static_cast<int>(strnlen(record->startedAt, sizeof(record->startedAt)))));
+    session.setFinishedAt(QString::fromUtf8(record->finishedAt,
+        static_cast<int>(strnlen(record->finishedAt, sizeof(record->finishedAt)))));
+    session.setInitialBatteryEnergy(record->initialBatteryEnergy);
+    session.setEnergyCharged(record->energyCharged);
+    session.setEnergyBattery(record->energyBattery);
+    session.setDuration(record->duration);
+    session.setBatteryLevel(record->batteryLevel);
+    session.setState(record->state);
+    session.setTimestamp(record->timestamp);
+    return session;
+}
+
+bool ChargingSessionHistory::open(quint32 capacity)
+{
+    static_assert(sizeof(Header) == 32, "Unexpected history header size");
+    static_assert(sizeof(Record) == 160, "Unexpected history record size");
+
+    if (!m_file.open(QIODevice::ReadWrite)) {
+        qCWarning(dcConsolinnoEnergy()) << "ChargingSessionHistory: Could not open"
+                                        << m_file.fileName() << m_file.errorString();
+        return false;
+    }
+
+    // Use the capacity of an existing history, create a new one otherwise
+    Header existing;
+    memset(&existing, 0, sizeof(Header));
+    bool valid = m_file.size() >= static_cast<qint64>(sizeof(Header))
+        && m_file.read(reinterpret_cast<char*>(&existing), sizeof(Header))
+            == static_cast<qint64>(sizeof(Header))
+        && existing.magic == historyMagic && existing.version == historyVersion
+        && existing.capacity > 0 && existing.first < existing.capacity
+        && existing.count <= existing.capacity
+        && m_file.size()
+            == static_cast<qint64>(sizeof(Header) + existing.capacity * sizeof(Record));
+
+    if (!valid) {
+        if (m_file.size() > 0) {
+            qCWarning(dcConsolinnoEnergy())
+                << "ChargingSessionHistory: Recreating invalid history" << m_file.fileName();
+        }
+
+        Header created;
+        memset(&created, 0, sizeof(Header));
+        created.magic = historyMagic;
+        created.version = historyVersion;
+        created.capacity = capacity;
+        if (!m_file.resize(0) || !m_file.resize(sizeof(Header) + capacity * sizeof(Record))
+            || !m_file.seek(0)
+            || m_file.write(reinterpret_cast<const char*>(&created), sizeof(Header))
+                != static_cast<qint64>(sizeof(Header))
+            || !m_file.flush()) {
+            qCWarning(dcConsolinnoEnergy()) << "ChargingSessionHistory: Could not create"
+                                            << m_file.fileName() << m_file.errorString();
+            m_file.close();
+            return false;
+        }
+    }
+
+    m_data = m_file.map(0, m_file.size());
+    if (!m_data) {
+        qCWarning(dcConsolinnoEnergy()) << "ChargingSessionHistory: Could not map"
+                                        << m_file.fileName() << m_file.errorString();
+        m_file.close();
+        return false;
+    }
+
+    // Remember the last record of each charger, newer records replace older ones
+    for (quint32 index = 0; index < header()->count; index++) {
+        m_lastSlots.insert(readUuid(recordAt(index)->evChargerThingId), slotOf(index));
+    }
+
+    qCDebug(dcConsolinnoEnergy()) << "ChargingSessionHistory: Opened" << m_file.fileName() << "with"
+                                  << header()->count << "of" << header()->capacity << "sessions";
+    return true;
+}
+
+ChargingSessionHistory::Header* ChargingSessionHistory::header() const
+{
+    return reinterpret_cast<Header*>(m_data);
+}
+
+ChargingSessionHistory::Record* ChargingSessionHistory::recordAt(quint32 index) const
+{
+    return reinterpret_cast<Record*>(m_data + sizeof(Header)) + slotOf(index);
+}
+
+quint32 ChargingSessionHistory::slotOf(quint32 index) const
+{
+    return (header()->first + index) % header()->capacity;
+}
+
+quint32 ChargingSessionHistory::lowerBound(qint64 recordedAt) const
+{
+    // First record with recordedAt >= the given time
+    quint32 low = 0;
+    quint32 high = header()->count;
+    while (low < high) {
+        quint32 middle = low + (high - low) / 2;
+        if (recordAt(middle)->recordedAt < recordedAt) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+void ChargingSessionHistory::dropExpired(qint64 now)
+{
+    if (m_retentionDays <= 0)
+        return;
+
+    quint32 expired = lowerBound(now - m_retentionDays * 86400LL);
+    if (expired == 0)
+        return;
+
+    Header* h = header();
+    for (quint32 index = 0; index < expired; index++) {
+        ThingId charger = readUuid(recordAt(index)->evChargerThingId);
+        if (m_lastSlots.value(charger, h->capacity) == slotOf(index)) {
+            m_lastSlots.remove(charger);
+        }
+    }
+
+    h->first = slotOf(expired);
+    h->count -= expired;
+}
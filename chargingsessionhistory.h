@@ -0,0 +1,72 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#ifndef CHARGINGSESSIONHISTORY_H
+#define CHARGINGSESSIONHISTORY_H
+
+#include <QFile>
+#include <QHash>
+#include <QObject>
+
+#include "configurations/chargingsessionconfiguration.h"
+
+/*!
+ * \brief The ChargingSessionHistory class keeps past charging sessions in a ring file.
+ * \details The file holds a fixed number of fixed-size records and is memory-mapped, so queries
+ * only touch the pages they read. Records are kept in the order they were recorded and their
+ * record time never decreases, which makes the ring itself the time index: range queries binary
+ * search the first record and walk forward from there. When the ring is full the oldest record
+ * gets overwritten, records older than the retention period are dropped on the next append.
+ * Queries select by the record time, not by the finishedAt of the session, which is empty for a
+ * session that got replaced before it finished.
+ *
+ * The capacity is fixed when the file gets created, an existing file keeps its capacity. Record
+ * times come from the EngineClock, a replay records on its virtual time.
+ */
+class ChargingSessionHistory : public QObject {
+    Q_OBJECT
+public:
+    explicit ChargingSessionHistory(
+        const QString& fileName, quint32 capacity = 8192, QObject* parent = nullptr);
+    ~ChargingSessionHistory() override;
+
+    bool isOpen() const;
+    quint32 capacity() const;
+    quint32 count() const;
+
+    // Records older than this are dropped, 0 keeps records until the ring is full
+    int retentionDays() const;
+    void setRetentionDays(int retentionDays);
+
+    // Adds the session, or updates it if it is the last recorded session of its ev charger
+    void record(const ChargingSessionConfiguration& chargingSession);
+
+    // Sessions of the given ev charger recorded within [from, to] (seconds since epoch), oldest
+    // first. A null evChargerThingId matches all chargers. A limit keeps the newest sessions of
+    // the range, 0 returns all matches.
+    QList<ChargingSessionConfiguration> sessions(
+        const ThingId& evChargerThingId, qint64 from, qint64 to, int limit = 0) const;
+
+private:
+    struct Header;
+    struct Record;
+
+    QFile m_file;
+    uchar* m_data = nullptr;
+    int m_retentionDays = 365;
+
+    // Slot of the last record per ev charger, used to update running sessions in place
+    QHash<ThingId, quint32> m_lastSlots;
+
+    bool open(quint32 capacity);
+    Header* header() const;
+    Record* recordAt(quint32 index) const;
+    quint32 slotOf(quint32 index) const;
+    quint32 lowerBound(qint64 recordedAt) const;
+    static ChargingSessionConfiguration session(const Record* record);
+    void dropExpired(qint64 now);
+};
+
+#endif // CHARGINGSESSIONHISTORY_H
@@ -0,0 +1,99 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include "clspowerallocator.h"
+
+#include <QVarLengthArray>
+
+#include <array>
+
+static int priorityBucket(int priority)
+{
+    return qBound(0, priority, ClsPowerAllocator::priorityCount - 1);
+}
+
+// A stepless load that did not get its minimum cannot run at all
+static bool isRunnable(const ClsLoad& load)
+{
+    return load.minPower <= 0 || load.grantedPower >= load.minPower;
+}
+
+double ClsPowerAllocator::allocate(double budget, QVector<ClsLoad>& loads)
+{
+    double remaining = qMax(0.0, budget);
+
+    // Counting sort by priority, the order within one priority is kept
+    std::array<int, priorityCount + 1> offsets = {};
+    for (int i = 0; i < loads.size(); i++) {
+        ClsLoad& load = loads[i];
+        load.grantedPower = 0;
+        load.minPower = qMax(0.0, load.minPower);
+        load.maxPower = qMax(load.minPower, load.maxPower);
+        offsets[priorityBucket(load.priority) + 1]++;
+
+        // Drawn anyway, even beyond the budget
+        if (load.fixed) {
+            load.grantedPower = load.maxPower;
+            remaining = qMax(0.0, remaining - load.maxPower);
+        }
+    }
+    for (int priority = 0; priority < priorityCount; priority++) {
+        offsets[priority + 1] += offsets[priority];
+    }
+
+    QVarLengthArray<int, 64> order(loads.size());
+    std::array<int, priorityCount + 1> next = offsets;
+    for (int i = 0; i < loads.size(); i++) {
+        order[next[priorityBucket(loads.at(i).priority)]++] = i;
+    }
+
+    // First pass: reserve the minimum power in priority order
+    for (int i = 0; i < order.size(); i++) {
+        ClsLoad& load = loads[order.at(i)];
+        if (load.fixed)
+            continue;
+
+        double reserve = load.stepless ? load.minPower : (load.minPower > 0 ? load.maxPower : 0);
+        if (reserve > 0 && reserve <= remaining) {
+            load.grantedPower = reserve;
+            remaining -= reserve;
+        }
+    }
+
+    // Second pass: switch on what fits and share the rest within each priority
+    for (int priority = 0; priority < priorityCount; priority++) {
+        double headroom = 0;
+        for (int i = offsets[priority]; i < offsets[priority + 1]; i++) {
+            ClsLoad& load = loads[order.at(i)];
+            if (load.fixed)
+                continue;
+
+            if (!load.stepless) {
+                if (load.grantedPower <= 0 && load.maxPower > 0 && load.maxPower <= remaining) {
+                    load.grantedPower = load.maxPower;
+                    remaining -= load.maxPower;
+                }
+            } else if (isRunnable(load)) {
+                headroom += load.maxPower - load.grantedPower;
+            }
+        }
+
+        if (headroom <= 0 || remaining <= 0)
+            continue;
+
+        double share = qMin(1.0, remaining / headroom);
+        for (int i = offsets[priority]; i < offsets[priority + 1]; i++) {
+            ClsLoad& load = loads[order.at(i)];
+            if (load.fixed || !load.stepless || !isRunnable(load))
+                continue;
+
+            double power = (load.maxPower - load.grantedPower) * share;
+            load.grantedPower += power;
+            remaining -= power;
+        }
+    }
+
+    return qMax(0.0, remaining);
+}
@@ -0,0 +1,53 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#ifndef CLSPOWERALLOCATOR_H
+#define CLSPOWERALLOCATOR_H
+
+#include <QVector>
+
+/*!
+ * \brief The ClsLoad struct is one controllable local system competing for the §14a power.
+ */
+struct ClsLoad {
+    // 0 is served first, see ClsPowerAllocator::priorityCount
+    int priority = 0;
+    // Power in W reserved in the first pass before any headroom gets distributed
+    double minPower = 0;
+    // Power in W the load can consume at most
+    double maxPower = 0;
+    // Stepless loads (wallboxes) can take any power between min and max, the others are either
+    // switched on with maxPower or off
+    bool stepless = false;
+    // Fixed loads draw maxPower whatever the budget is, e.g. a heat pump that may not be switched
+    // yet. Their power is taken off the budget before anything else gets allocated.
+    bool fixed = false;
+
+    // Result: power in W the load may consume
+    double grantedPower = 0;
+};
+
+/*!
+ * \brief The ClsPowerAllocator class distributes the power allowed by a §14a limit across the
+ * controllable local systems.
+ * \details Fixed loads are granted their maxPower up front, whatever their priority. The budget
+ * left over gets distributed in two passes. The first pass reserves the minimum power of every
+ * other load in priority order: stepless loads get their minPower, switched loads with a minPower
+ * get their maxPower. The second pass goes through the priorities again. Switched loads get
+ * switched on if their maxPower still fits, then the remaining power is split among the stepless
+ * loads of that priority in proportion to their headroom (maxPower - minPower). Lower priorities
+ * only get what higher ones left over.
+ *
+ * Priorities are bucketed instead of sorted, so both passes run in linear time.
+ */
+class ClsPowerAllocator {
+public:
+    static const int priorityCount = 10;
+
+    // Returns the power in W that has not been allocated
+    static double allocate(double budget, QVector<ClsLoad>& loads);
+};
+
+#endif // CLSPOWERALLOCATOR_H
@@ -0,0 +1,94 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include "configurationchangelog.h"
+
+ConfigurationChange::ConfigurationChange() { }
+
+ConfigurationChange::ConfigurationChange(
+    quint64 revision, const QString& type, const QUuid& thingId, Kind kind)
+    : m_revision(revision)
+    , m_type(type)
+    , m_thingId(thingId)
+    , m_kind(kind)
+{
+}
+
+qulonglong ConfigurationChange::revision() const { return m_revision; }
+
+QString ConfigurationChange::type() const { return m_type; }
+
+QUuid ConfigurationChange::thingId() const { return m_thingId; }
+
+QString ConfigurationChange::kind() const
+{
+    switch (m_kind) {
+    case KindAdded:
+        return QStringLiteral("added");
+    case KindChanged:
+        return QStringLiteral("changed");
+    case KindRemoved:
+        return QStringLiteral("removed");
+    }
+    return QString();
+}
+
+QDebug operator<<(QDebug debug, const ConfigurationChange& configurationChange)
+{
+    debug.nospace() << "ConfigurationChange(" << configurationChange.revision();
+    debug.nospace() << ", " << configurationChange.type();
+    debug.nospace() << ", " << configurationChange.kind();
+    if (!configurationChange.thingId().isNull()) {
+        debug.nospace() << ", " << configurationChange.thingId().toString();
+    }
+    debug.nospace() << ")";
+    return debug.maybeSpace();
+}
+
+ConfigurationChangeLog::ConfigurationChangeLog(int capacity)
+    : m_capacity(qMax(1, capacity))
+{
+}
+
+void ConfigurationChangeLog::reset(quint64 initialRevision)
+{
+    m_changes.clear();
+    m_first = 0;
+    m_revision = initialRevision;
+}
+
+quint64 ConfigurationChangeLog::revision() const { return m_revision; }
+
+quint64 ConfigurationChangeLog::append(
+    const QString& type, const QUuid& thingId, ConfigurationChange::Kind kind)
+{
+    ConfigurationChange change(++m_revision, type, thingId, kind);
+
+    // Ring buffer, once full the oldest change gets overwritten
+    if (m_changes.count() < m_capacity) {
+        m_changes.append(change);
+    } else {
+        m_changes[m_first] = change;
+        m_first = (m_first + 1) % m_capacity;
+    }
+
+    return m_revision;
+}
+
+bool ConfigurationChangeLog::changesSince(
+    quint64 revision, QList<ConfigurationChange>* changes) const
+{
+    // The revisions in the log are gapless and end at m_revision
+    quint64 oldest = m_revision - m_changes.count();
+    if (revision < oldest || revision > m_revision)
+        return false;
+
+    int count = static_cast<int>(m_revision - revision);
+    int start = m_changes.count() - count;
+    for (int i = start; i < m_changes.count(); i++) {
+        changes->append(m_changes.at((m_first + i) % m_changes.count()));
+    }
+    return true;
+}
@@ -0,0 +1,79 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#ifndef CONFIGURATIONCHANGELOG_H
+#define CONFIGURATIONCHANGELOG_H
+
+#include <QDebug>
+#include <QObject>
+#include <QUuid>
+#include <QVector>
+
+/*!
+ * \brief The ConfigurationChange class records one change of the state the app synchronizes.
+ */
+class ConfigurationChange {
+    Q_GADGET
+    Q_PROPERTY(qulonglong revision READ revision)
+    Q_PROPERTY(QString type READ type)
+    Q_PROPERTY(QUuid thingId READ thingId)
+    Q_PROPERTY(QString kind READ kind)
+
+public:
+    enum Kind : quint8 { KindAdded, KindChanged, KindRemoved };
+
+    ConfigurationChange();
+    ConfigurationChange(quint64 revision, const QString& type, const QUuid& thingId, Kind kind);
+
+    qulonglong revision() const;
+    // The notification name without the kind, e.g. "chargingConfiguration" or "availableUseCases"
+    QString type() const;
+    // The thing or configuration ID, null for changes that are not bound to a thing
+    QUuid thingId() const;
+    // "added", "changed" or "removed"
+    QString kind() const;
+
+private:
+    quint64 m_revision = 0;
+    QString m_type;
+    QUuid m_thingId;
+    Kind m_kind = KindChanged;
+};
+
+QDebug operator<<(QDebug debug, const ConfigurationChange& configurationChange);
+
+/*!
+ * \brief The ConfigurationChangeLog class keeps the latest changes for incremental syncs.
+ * \details Every change gets the next revision, so the log holds a gapless range of revisions in
+ * a ring buffer. A client that reconnects asks for the changes after the revision it has seen. If
+ * that revision has already been dropped from the log the changes cannot be reconstructed and the
+ * client has to fetch a full snapshot instead. Revisions restart with every run of nymead, the
+ * owner has to tell the runs apart.
+ */
+class ConfigurationChangeLog {
+public:
+    explicit ConfigurationChangeLog(int capacity = 1024);
+
+    // The revision the log starts after, the first change gets initialRevision + 1
+    void reset(quint64 initialRevision);
+
+    quint64 revision() const;
+
+    // Returns the revision of the change
+    quint64 append(const QString& type, const QUuid& thingId, ConfigurationChange::Kind kind);
+
+    // Fills the changes after the given revision, oldest first. Returns false if they are not
+    // all in the log anymore.
+    bool changesSince(quint64 revision, QList<ConfigurationChange>* changes) const;
+
+private:
+    QVector<ConfigurationChange> m_changes;
+    int m_capacity = 1024;
+    // Index of the oldest change
+    int m_first = 0;
+    quint64 m_revision = 0;
+};
+
+#endif // CONFIGURATIONCHANGELOG_H
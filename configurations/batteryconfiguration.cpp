@@ -40,11 +40,33 @@ void BatteryConfiguration::setControllableLocalSystem(bool controllableLocalSyst
     m_controllableLocalSystem = controllableLocalSystem;
 }
 
+int BatteryConfiguration::clsPriority() const
+{
+    return m_clsPriority;
+}
+
+void BatteryConfiguration::setClsPriority(int clsPriority)
+{
+    m_clsPriority = clsPriority;
+}
+
+double BatteryConfiguration::clsMinPower() const
+{
+    return m_clsMinPower;
+}
+
+void BatteryConfiguration::setClsMinPower(double clsMinPower)
+{
+    m_clsMinPower = clsMinPower;
+}
+
 bool BatteryConfiguration::operator==(const BatteryConfiguration &other) const
 {
     return m_batteryThingId == other.batteryThingId() 
     && m_optimizationEnabled == other.optimizationEnabled()
-    && m_controllableLocalSystem == other.optimizationEnabled();
+    && m_controllableLocalSystem == other.optimizationEnabled()
+    && m_clsPriority == other.clsPriority()
+    && m_clsMinPower == other.clsMinPower();
 }
 
 bool BatteryConfiguration::operator!=(const BatteryConfiguration &other) const
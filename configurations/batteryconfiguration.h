@@ -16,6 +16,8 @@ class BatteryConfiguration
     Q_PROPERTY(QUuid batteryThingId READ batteryThingId WRITE setBatteryThingId)
     Q_PROPERTY(bool optimizationEnabled READ optimizationEnabled WRITE setOptimizationEnabled USER true)
     Q_PROPERTY(bool controllableLocalSystem READ controllableLocalSystem WRITE setControllableLocalSystem USER true)
+    Q_PROPERTY(int clsPriority READ clsPriority WRITE setClsPriority USER true)
+    Q_PROPERTY(double clsMinPower READ clsMinPower WRITE setClsMinPower USER true)
 
 public:
     BatteryConfiguration();
@@ -29,6 +31,14 @@ public:
     bool controllableLocalSystem() const;
     void setControllableLocalSystem(bool controllableLocalSystem);
 
+    // §14a allocation priority, 0 is served first
+    int clsPriority() const;
+    void setClsPriority(int clsPriority);
+
+    // Power in W reserved for this unit while a §14a limit is active
+    double clsMinPower() const;
+    void setClsMinPower(double clsMinPower);
+
     bool operator==(const BatteryConfiguration &other) const;
     bool operator!=(const BatteryConfiguration &other) const;
 
@@ -36,6 +46,8 @@ private:
     ThingId m_batteryThingId;
     bool m_optimizationEnabled = true;
     bool m_controllableLocalSystem = false;
+    int m_clsPriority = 2;
+    double m_clsMinPower = 0;
 };
 
 QDebug operator<<(QDebug debug, const BatteryConfiguration &batteryConfig);
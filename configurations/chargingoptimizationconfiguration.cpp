@@ -80,6 +80,26 @@ void ChargingOptimizationConfiguration::setControllableLocalSystem(bool controll
     m_controllableLocalSystem = controllableLocalSystem;
 }
 
+int ChargingOptimizationConfiguration::clsPriority() const
+{
+    return m_clsPriority;
+}
+
+void ChargingOptimizationConfiguration::setClsPriority(int clsPriority)
+{
+    m_clsPriority = clsPriority;
+}
+
+double ChargingOptimizationConfiguration::clsMinPower() const
+{
+    return m_clsMinPower;
+}
+
+void ChargingOptimizationConfiguration::setClsMinPower(double clsMinPower)
+{
+    m_clsMinPower = clsMinPower;
+}
+
 
 bool ChargingOptimizationConfiguration::operator==(const ChargingOptimizationConfiguration &other) const
 {
@@ -89,7 +109,9 @@ bool ChargingOptimizationConfiguration::operator==(const ChargingOptimizationCon
             m_d_value == other.d_value() &&
             m_setpoint == other.setpoint() &&
             m_controllableLocalSystem == other.controllableLocalSystem() &&
-            m_reenableChargepoint == other.reenableChargepoint();
+            m_reenableChargepoint == other.reenableChargepoint() &&
+            m_clsPriority == other.clsPriority() &&
+            m_clsMinPower == other.clsMinPower();
 
 }
 
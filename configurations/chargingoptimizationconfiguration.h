@@ -21,6 +21,8 @@ class ChargingOptimizationConfiguration
     Q_PROPERTY(float d_value READ d_value WRITE setD_value USER true)
     Q_PROPERTY(float setpoint READ setpoint WRITE setSetpoint USER true)
     Q_PROPERTY(bool controllableLocalSystem READ controllableLocalSystem WRITE setControllableLocalSystem USER true)
+    Q_PROPERTY(int clsPriority READ clsPriority WRITE setClsPriority USER true)
+    Q_PROPERTY(double clsMinPower READ clsMinPower WRITE setClsMinPower USER true)
 
 
 public:
@@ -47,6 +49,14 @@ public:
     bool controllableLocalSystem() const;
     void setControllableLocalSystem(bool controllableLocalSystem);
 
+    // §14a allocation priority, 0 is served first
+    int clsPriority() const;
+    void setClsPriority(int clsPriority);
+
+    // Power in W reserved for this unit while a §14a limit is active
+    double clsMinPower() const;
+    void setClsMinPower(double clsMinPower);
+
     bool operator==(const ChargingOptimizationConfiguration &other) const;
     bool operator!=(const ChargingOptimizationConfiguration &other) const;
 
@@ -58,6 +68,8 @@ private:
     float m_d_value = 0;
     float m_setpoint = 0;
     bool m_controllableLocalSystem = false;
+    int m_clsPriority = 1;
+    double m_clsMinPower = 0;
 };
 
 QDebug operator<<(QDebug debug, const ChargingOptimizationConfiguration &chargingConfig);
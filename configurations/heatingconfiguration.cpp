@@ -95,6 +95,26 @@ void HeatingConfiguration::setControllableLocalSystem(bool controllableLocalSyst
     m_controllableLocalSystem = controllableLocalSystem;
 }
 
+int HeatingConfiguration::clsPriority() const
+{
+    return m_clsPriority;
+}
+
+void HeatingConfiguration::setClsPriority(int clsPriority)
+{
+    m_clsPriority = clsPriority;
+}
+
+double HeatingConfiguration::clsMinPower() const
+{
+    return m_clsMinPower;
+}
+
+void HeatingConfiguration::setClsMinPower(double clsMinPower)
+{
+    m_clsMinPower = clsMinPower;
+}
+
 bool HeatingConfiguration::operator==(const HeatingConfiguration &other) const
 {
     return m_heatMeterThingId == other.heatPumpThingId() &&
@@ -104,7 +124,9 @@ bool HeatingConfiguration::operator==(const HeatingConfiguration &other) const
             m_houseType == other.houseType() &&
             m_floorHeatingArea == other.floorHeatingArea() &&
             m_heatMeterThingId == other.heatMeterThingId() &&
-            m_controllableLocalSystem == other.optimizationEnabled();
+            m_controllableLocalSystem == other.optimizationEnabled() &&
+            m_clsPriority == other.clsPriority() &&
+            m_clsMinPower == other.clsMinPower();
 }
 
 bool HeatingConfiguration::operator!=(const HeatingConfiguration &other) const
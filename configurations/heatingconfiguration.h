@@ -26,6 +26,8 @@ class HeatingConfiguration
     Q_PROPERTY(double floorHeatingArea READ floorHeatingArea WRITE setFloorHeatingArea USER true)
     Q_PROPERTY(QUuid heatMeterThingId READ heatMeterThingId WRITE setHeatMeterThingId USER true)
     Q_PROPERTY(bool controllableLocalSystem READ controllableLocalSystem WRITE setControllableLocalSystem USER true)
+    Q_PROPERTY(int clsPriority READ clsPriority WRITE setClsPriority USER true)
+    Q_PROPERTY(double clsMinPower READ clsMinPower WRITE setClsMinPower USER true)
 
 public:
     HeatingConfiguration();
@@ -73,6 +75,14 @@ public:
     bool controllableLocalSystem() const;
     void setControllableLocalSystem(bool controllableLocalSystem);
 
+    // §14a allocation priority, 0 is served first
+    int clsPriority() const;
+    void setClsPriority(int clsPriority);
+
+    // Power in W reserved for this unit while a §14a limit is active
+    double clsMinPower() const;
+    void setClsMinPower(double clsMinPower);
+
     bool operator==(const HeatingConfiguration &other) const;
     bool operator!=(const HeatingConfiguration &other) const;
 
@@ -85,6 +95,8 @@ private:
     double m_floorHeatingArea = 100;
     ThingId m_heatMeterThingId;
     bool m_controllableLocalSystem = false;
+    int m_clsPriority = 0;
+    double m_clsMinPower = 0;
 };
 
 QDebug operator<<(QDebug debug, const HeatingConfiguration &heatingConfig);
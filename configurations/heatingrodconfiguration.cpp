@@ -55,12 +55,34 @@ void HeatingRodConfiguration::setControllableLocalSystem(bool controllableLocalS
     m_controllableLocalSystem = controllableLocalSystem;
 }
 
+int HeatingRodConfiguration::clsPriority() const
+{
+    return m_clsPriority;
+}
+
+void HeatingRodConfiguration::setClsPriority(int clsPriority)
+{
+    m_clsPriority = clsPriority;
+}
+
+double HeatingRodConfiguration::clsMinPower() const
+{
+    return m_clsMinPower;
+}
+
+void HeatingRodConfiguration::setClsMinPower(double clsMinPower)
+{
+    m_clsMinPower = clsMinPower;
+}
+
 bool HeatingRodConfiguration::operator==(const HeatingRodConfiguration &other) const
 {
     return m_heatMeterThingId == other.heatingRodThingId() &&
             m_optimizationEnabled == other.optimizationEnabled() &&
             m_maxElectricalPower == other.maxElectricalPower() &&
-            m_controllableLocalSystem == other.optimizationEnabled();
+            m_controllableLocalSystem == other.optimizationEnabled() &&
+            m_clsPriority == other.clsPriority() &&
+            m_clsMinPower == other.clsMinPower();
 }
 
 bool HeatingRodConfiguration::operator!=(const HeatingRodConfiguration &other) const
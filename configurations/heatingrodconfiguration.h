@@ -22,6 +22,8 @@ class HeatingRodConfiguration
     Q_PROPERTY(bool optimizationEnabled READ optimizationEnabled WRITE setOptimizationEnabled USER true)
     Q_PROPERTY(double maxElectricalPower READ maxElectricalPower WRITE setMaxElectricalPower USER true)
     Q_PROPERTY(bool controllableLocalSystem READ controllableLocalSystem WRITE setControllableLocalSystem USER true)
+    Q_PROPERTY(int clsPriority READ clsPriority WRITE setClsPriority USER true)
+    Q_PROPERTY(double clsMinPower READ clsMinPower WRITE setClsMinPower USER true)
 public:
     HeatingRodConfiguration();
 
@@ -41,6 +43,14 @@ public:
     bool controllableLocalSystem() const;
     void setControllableLocalSystem(bool controllableLocalSystem);
 
+    // §14a allocation priority, 0 is served first
+    int clsPriority() const;
+    void setClsPriority(int clsPriority);
+
+    // Power in W reserved for this unit while a §14a limit is active
+    double clsMinPower() const;
+    void setClsMinPower(double clsMinPower);
+
     bool operator==(const HeatingRodConfiguration &other) const;
     bool operator!=(const HeatingRodConfiguration &other) const;
 
@@ -50,6 +60,8 @@ private:
     double m_maxElectricalPower = 3;
     ThingId m_heatMeterThingId;
     bool m_controllableLocalSystem = false;
+    int m_clsPriority = 3;
+    double m_clsMinPower = 0;
 };
 
 QDebug operator<<(QDebug debug, const HeatingRodConfiguration &heatingConfig);
@@ -0,0 +1,112 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#ifndef CONFIGURATIONSTORE_H
+#define CONFIGURATIONSTORE_H
+
+#include <QLoggingCategory>
+#include <QMetaProperty>
+#include <QUuid>
+#include <QVector>
+
+#include "settingsstore.h"
+
+Q_DECLARE_LOGGING_CATEGORY(dcConsolinnoEnergy)
+
+/*!
+ * \brief The ConfigurationStore class persists Q_GADGET configurations in the SettingsStore.
+ * \details Every configuration lives in "<group>/<id>/<property>". The properties are resolved
+ * once from the static meta object of T: the id property names the settings group, every other
+ * writable property gets persisted under its own name. Adding a Q_PROPERTY to a configuration is
+ * all that is needed to persist a new field.
+ */
+template <typename T> class ConfigurationStore {
+public:
+    ConfigurationStore(SettingsStore* settings, const QString& group, const char* idProperty)
+        : m_settings(settings)
+        , m_group(group)
+    {
+        const QMetaObject& metaObject = T::staticMetaObject;
+        m_idProperty = metaObject.property(metaObject.indexOfProperty(idProperty));
+        Q_ASSERT_X(m_idProperty.isValid(), "ConfigurationStore", "Unknown id property");
+
+        for (int i = metaObject.propertyOffset(); i < metaObject.propertyCount(); i++) {
+            QMetaProperty property = metaObject.property(i);
+            if (i == m_idProperty.propertyIndex() || !property.isWritable())
+                continue;
+
+            m_properties.append(property);
+            m_keys.append(QString::fromLatin1(property.name()));
+        }
+    }
+
+    QString group() const { return m_group; }
+
+    QUuid id(const T& configuration) const
+    {
+        return m_idProperty.readOnGadget(&configuration).toUuid();
+    }
+
+    bool contains(const QUuid& id) const { return m_settings->containsGroup(groupKey(id)); }
+
+    // Returns the stored configuration, fields missing in the settings keep their default value
+    T value(const QUuid& id) const
+    {
+        T configuration;
+        if (m_idProperty.isWritable()) {
+            m_idProperty.writeOnGadget(&configuration, id);
+        }
+
+        QString prefix = groupKey(id) + '/';
+        for (int i = 0; i < m_properties.count(); i++) {
+            QVariant value = m_settings->value(prefix + m_keys.at(i));
+            if (!value.isValid())
+                continue;
+
+            if (!m_properties.at(i).writeOnGadget(&configuration, value)) {
+                qCWarning(dcConsolinnoEnergy()) << "ConfigurationStore: Could not restore"
+                                                << prefix + m_keys.at(i) << value;
+            }
+        }
+
+        return configuration;
+    }
+
+    // Writes all fields, returns true if anything changed. Deferred values do not start the flush
+    // timer of the settings store (see SettingsStore::setValueDeferred()).
+    bool setValue(const T& configuration, bool deferred = false)
+    {
+        QString prefix = groupKey(id(configuration)) + '/';
+        bool changed = false;
+        for (int i = 0; i < m_properties.count(); i++) {
+            QVariant value = m_properties.at(i).readOnGadget(&configuration);
+            // Enums are stored by value, like the hand written settings code did
+            if (m_properties.at(i).isEnumType()) {
+                value = value.toInt();
+            }
+
+            if (deferred) {
+                changed |= m_settings->setValueDeferred(prefix + m_keys.at(i), value);
+            } else {
+                changed |= m_settings->setValue(prefix + m_keys.at(i), value);
+            }
+        }
+
+        return changed;
+    }
+
+    void remove(const QUuid& id) { m_settings->remove(groupKey(id)); }
+
+private:
+    SettingsStore* m_settings = nullptr;
+    QString m_group;
+    QMetaProperty m_idProperty;
+    QVector<QMetaProperty> m_properties;
+    QVector<QString> m_keys;
+
+    QString groupKey(const QUuid& id) const { return m_group + '/' + id.toString(); }
+};
+
+#endif // CONFIGURATIONSTORE_H
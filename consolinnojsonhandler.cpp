@@ -10,6 +10,8 @@
 #include <QJsonDocument>
 #include <QJsonParseError>
 
+#include <limits>
+
 Q_DECLARE_LOGGING_CATEGORY(dcConsolinnoEnergy)
 
 ConsolinnoJsonHandler::ConsolinnoJsonHandler(
@@ -38,6 +40,13 @@ ConsolinnoJsonHandler::ConsolinnoJsonHandler(
     registerObject<UserConfiguration>();
     registerObject<BatteryConfiguration>();
     registerObject<ConEMSState>();
+    registerObject<ControlDecision>();
+    registerObject<HeatPumpTransition>();
+    registerObject<ControlLatencyStats>();
+    registerObject<LimitSourceStatus>();
+    registerObject<ConfigurationChange>();
+
+    initReplyCache();
 
     QVariantMap params, returns;
     QString description;
@@ -49,6 +58,76 @@ ConsolinnoJsonHandler::ConsolinnoJsonHandler(
     description = "Get the version of the HEMS system";
     registerMethod("GetHEMSVersion", description, params, returns);
 
+    params.clear();
+    returns.clear();
+    description = "Get everything the app needs after connecting in one call: the available use "
+                  "cases, the houshold phase limit, all configurations, the ConEMS state and the "
+                  "grid support thing ID, together with a revision that changes whenever any of "
+                  "them changes. Revisions count from 0 on every start of nymead, the runId tells "
+                  "the runs apart. If ifNoneMatch and runId equal the current revision and runId, "
+                  "only notModified, the revision and the runId are returned.";
+    params.insert("o:ifNoneMatch", enumValueName(Uint));
+    params.insert("o:runId", enumValueName(Uuid));
+    returns.insert("revision", enumValueName(Uint));
+    returns.insert("runId", enumValueName(Uuid));
+    returns.insert("notModified", enumValueName(Bool));
+    returns.insert("o:availableUseCases", flagRef<EnergyEngine::HemsUseCases>());
+    returns.insert("o:housholdPhaseLimit", enumValueName(Uint));
+    returns.insert("o:userConfigurations", QVariantList() << objectRef<UserConfiguration>());
+    returns.insert("o:heatingConfigurations", QVariantList() << objectRef<HeatingConfiguration>());
+    returns.insert(
+        "o:heatingRodConfigurations", QVariantList() << objectRef<HeatingRodConfiguration>());
+    returns.insert("o:dynamicElectricPricingConfigurations",
+        QVariantList() << objectRef<DynamicElectricPricingConfiguration>());
+    returns.insert("o:washingMachineConfigurations",
+        QVariantList() << objectRef<WashingMachineConfiguration>());
+    returns.insert(
+        "o:chargingConfigurations", QVariantList() << objectRef<ChargingConfiguration>());
+    returns.insert("o:chargingOptimizationConfigurations",
+        QVariantList() << objectRef<ChargingOptimizationConfiguration>());
+    returns.insert("o:batteryConfigurations", QVariantList() << objectRef<BatteryConfiguration>());
+    returns.insert("o:pvConfigurations", QVariantList() << objectRef<PvConfiguration>());
+    returns.insert("o:chargingSessionConfigurations",
+        QVariantList() << objectRef<ChargingSessionConfiguration>());
+    returns.insert("o:conEMSState", QVariantList() << objectRef<ConEMSState>());
+    returns.insert("o:gridSupportThingId", enumValueName(String));
+    registerMethod("GetSnapshot", description, params, returns);
+
+    params.clear();
+    returns.clear();
+    description = "Get the changes after the given revision of GetSnapshot or GetChangesSince, "
+                  "oldest first. Only the type, the thing ID and the kind of each change are "
+                  "returned, the app fetches the changed configurations it needs. If the changes "
+                  "are not in the log anymore, or the runId is not the one of the current run, "
+                  "truncated is true and a full snapshot is returned instead of the changes.";
+    params.insert("revision", enumValueName(Uint));
+    params.insert("runId", enumValueName(Uuid));
+    returns.insert("revision", enumValueName(Uint));
+    returns.insert("runId", enumValueName(Uuid));
+    returns.insert("truncated", enumValueName(Bool));
+    returns.insert("o:changes", QVariantList() << objectRef<ConfigurationChange>());
+    returns.insert("o:availableUseCases", flagRef<EnergyEngine::HemsUseCases>());
+    returns.insert("o:housholdPhaseLimit", enumValueName(Uint));
+    returns.insert("o:userConfigurations", QVariantList() << objectRef<UserConfiguration>());
+    returns.insert("o:heatingConfigurations", QVariantList() << objectRef<HeatingConfiguration>());
+    returns.insert(
+        "o:heatingRodConfigurations", QVariantList() << objectRef<HeatingRodConfiguration>());
+    returns.insert("o:dynamicElectricPricingConfigurations",
+        QVariantList() << objectRef<DynamicElectricPricingConfiguration>());
+    returns.insert("o:washingMachineConfigurations",
+        QVariantList() << objectRef<WashingMachineConfiguration>());
+    returns.insert(
+        "o:chargingConfigurations", QVariantList() << objectRef<ChargingConfiguration>());
+    returns.insert("o:chargingOptimizationConfigurations",
+        QVariantList() << objectRef<ChargingOptimizationConfiguration>());
+    returns.insert("o:batteryConfigurations", QVariantList() << objectRef<BatteryConfiguration>());
+    returns.insert("o:pvConfigurations", QVariantList() << objectRef<PvConfiguration>());
+    returns.insert("o:chargingSessionConfigurations",
+        QVariantList() << objectRef<ChargingSessionConfiguration>());
+    returns.insert("o:conEMSState", QVariantList() << objectRef<ConEMSState>());
+    returns.insert("o:gridSupportThingId", enumValueName(String));
+    registerMethod("GetChangesSince", description, params, returns);
+
     params.clear();
     returns.clear();
     description = "Get the current available optimization UseCases based on the thing setup "
@@ -173,6 +252,48 @@ ConsolinnoJsonHandler::ConsolinnoJsonHandler(
     description = "Get the current states of the Grid Support device.";
     registerMethod("GetGridSupportThing", description, params, returns);
 
+    // Decision trace
+    params.clear();
+    returns.clear();
+    description = "Get the latest decisions of the control loop, oldest first. Every evaluation "
+                  "records the phase powers, the consumption limit, the resulting margin or "
+                  "overshoot and the number of actions it executed. The first actions are listed "
+                  "with thingId, action (chargingCurrent, heatPump or heatingRod) and value: the "
+                  "charging current in A, the SG-ready mode or false. The optional limit returns "
+                  "only the given number of latest decisions.";
+    params.insert("o:limit", enumValueName(Uint));
+    returns.insert("decisions", QVariantList() << objectRef<ControlDecision>());
+    registerMethod("GetDecisionTrace", description, params, returns);
+
+    // Heat pump transitions
+    params.clear();
+    returns.clear();
+    description = "Get the latest SG-ready transitions of the CLS heat pumps, oldest first. Every "
+                  "transition records the state entered, the reason and the seconds spent in the "
+                  "previous state. The optional limit returns only the given number of latest "
+                  "transitions.";
+    params.insert("o:limit", enumValueName(Uint));
+    returns.insert("transitions", QVariantList() << objectRef<HeatPumpTransition>());
+    registerMethod("GetHeatPumpTransitions", description, params, returns);
+
+    // Control latency
+    params.clear();
+    returns.clear();
+    description = "Get the latency statistics per consumption limit source in milliseconds. The "
+                  "action latency is the time from receiving a limit to executing the resulting "
+                  "actions, the meter latency the time until the root meter showed the power drop.";
+    returns.insert("latencyStats", QVariantList() << objectRef<ControlLatencyStats>());
+    registerMethod("GetControlLatencyStats", description, params, returns);
+
+    // Limit sources
+    params.clear();
+    returns.clear();
+    description = "Get the connection state of the consumption limit sources. A source is "
+                  "disconnected while its D-Bus service is missing, connecting while its current "
+                  "limit is being read and connected once the limit has been read or signalled.";
+    returns.insert("limitSources", QVariantList() << objectRef<LimitSourceStatus>());
+    registerMethod("GetLimitSources", description, params, returns);
+
     // PV
     params.clear();
     returns.clear();
@@ -205,6 +326,20 @@ ConsolinnoJsonHandler::ConsolinnoJsonHandler(
     returns.insert("hemsError", enumRef<EnergyEngine::HemsError>());
     registerMethod("SetChargingSessionConfiguration", description, params, returns);
 
+    params.clear();
+    returns.clear();
+    description = "Get the charging sessions of the given ev charger from the session history, "
+                  "oldest first. A session is recorded when it finishes or when a new session "
+                  "replaces it before it finished. The optional from and to parameters limit the "
+                  "time range in seconds since epoch in which the sessions were recorded, limit "
+                  "returns only the newest sessions of that range, still oldest first.";
+    params.insert("evChargerThingId", enumValueName(Uuid));
+    params.insert("o:from", enumValueName(Int));
+    params.insert("o:to", enumValueName(Int));
+    params.insert("o:limit", enumValueName(Uint));
+    returns.insert("chargingSessions", QVariantList() << objectRef<ChargingSessionConfiguration>());
+    registerMethod("GetChargingSessions", description, params, returns);
+
     // charging
     params.clear();
     returns.clear();
@@ -238,6 +373,18 @@ ConsolinnoJsonHandler::ConsolinnoJsonHandler(
     returns.insert("hemsError", enumRef<EnergyEngine::HemsError>());
     registerMethod("SetChargingOptimizationConfiguration", description, params, returns);
 
+    params.clear();
+    returns.clear();
+    description = "Start the automatic PID tuning of an ev charger regulating the grid point "
+                  "power. The charging current is held to measure the grid power, then stepped by "
+                  "stepCurrent (default 2 A) for a few minutes. The gains derived from the "
+                  "response are written to the charging optimization configuration. A car has to "
+                  "be charging, a consumption limit aborts the tuning.";
+    params.insert("evChargerThingId", enumValueName(Uuid));
+    params.insert("o:stepCurrent", enumValueName(Double));
+    returns.insert("hemsError", enumRef<EnergyEngine::HemsError>());
+    registerMethod("StartChargingAutoTune", description, params, returns);
+
     // battery
     params.clear();
     returns.clear();
@@ -486,6 +633,7 @@ ConsolinnoJsonHandler::ConsolinnoJsonHandler(
     */
     connect(m_energyEngine, &EnergyEngine::availableUseCasesChanged, this,
         [=](EnergyEngine::HemsUseCases availableUseCases) {
+            m_changeLog.append("availableUseCases", QUuid(), ConfigurationChange::KindChanged);
             QVariantMap params;
             params.insert("availableUseCases", flagValueNames(availableUseCases));
             emit AvailableUseCasesChanged(params);
@@ -493,6 +641,7 @@ ConsolinnoJsonHandler::ConsolinnoJsonHandler(
 
     connect(m_energyEngine, &EnergyEngine::housholdPhaseLimitChanged, this,
         [=](uint housholdPhaseLimit) {
+            m_changeLog.append("housholdPhaseLimit", QUuid(), ConfigurationChange::KindChanged);
             QVariantMap params;
             params.insert("housholdPhaseLimit", housholdPhaseLimit);
             emit HousholdPhaseLimitChanged(params);
@@ -501,6 +650,8 @@ ConsolinnoJsonHandler::ConsolinnoJsonHandler(
     // UserConfig
     connect(m_energyEngine, &EnergyEngine::userConfigurationAdded, this,
         [=](const UserConfiguration& userConfiguration) {
+            configurationChanged(ConfigurationUser,
+                userConfiguration.userConfigID(), ConfigurationChange::KindAdded);
             QVariantMap params;
             params.insert("userConfiguration", pack(userConfiguration));
             emit UserConfigurationAdded(params);
@@ -508,6 +659,7 @@ ConsolinnoJsonHandler::ConsolinnoJsonHandler(
 
     connect(m_energyEngine, &EnergyEngine::userConfigurationRemoved, this,
         [=](const QUuid& userConfigID) {
+            configurationChanged(ConfigurationUser, userConfigID, ConfigurationChange::KindRemoved);
             QVariantMap params;
             params.insert("userConfigID", userConfigID);
             emit UserConfigurationRemoved(params);
@@ -515,6 +667,8 @@ ConsolinnoJsonHandler::ConsolinnoJsonHandler(
 
     connect(m_energyEngine, &EnergyEngine::userConfigurationChanged, this,
         [=](const UserConfiguration& userConfiguration) {
+            configurationChanged(ConfigurationUser,
+                userConfiguration.userConfigID(), ConfigurationChange::KindChanged);
             QVariantMap params;
             params.insert("userConfiguration", pack(userConfiguration));
             emit UserConfigurationChanged(params);
@@ -523,6 +677,8 @@ ConsolinnoJsonHandler::ConsolinnoJsonHandler(
     // Heating
     connect(m_energyEngine, &EnergyEngine::heatingConfigurationAdded, this,
         [=](const HeatingConfiguration& heatingConfiguration) {
+            configurationChanged(ConfigurationHeating,
+                heatingConfiguration.heatPumpThingId(), ConfigurationChange::KindAdded);
             QVariantMap params;
             params.insert("heatingConfiguration", pack(heatingConfiguration));
             emit HeatingConfigurationAdded(params);
@@ -530,6 +686,8 @@ ConsolinnoJsonHandler::ConsolinnoJsonHandler(
 
     connect(m_energyEngine, &EnergyEngine::heatingConfigurationRemoved, this,
         [=](const ThingId& heatPumpThingId) {
+            configurationChanged(ConfigurationHeating,
+                heatPumpThingId, ConfigurationChange::KindRemoved);
             QVariantMap params;
             params.insert("heatPumpThingId", heatPumpThingId);
             emit HeatingConfigurationRemoved(params);
@@ -537,6 +695,8 @@ ConsolinnoJsonHandler::ConsolinnoJsonHandler(
 
     connect(m_energyEngine, &EnergyEngine::heatingConfigurationChanged, this,
         [=](const HeatingConfiguration& heatingConfiguration) {
+            configurationChanged(ConfigurationHeating,
+                heatingConfiguration.heatPumpThingId(), ConfigurationChange::KindChanged);
             QVariantMap params;
             params.insert("heatingConfiguration", pack(heatingConfiguration));
             emit HeatingConfigurationChanged(params);
@@ -545,6 +705,8 @@ ConsolinnoJsonHandler::ConsolinnoJsonHandler(
     // Heating rod
     connect(m_energyEngine, &EnergyEngine::heatingRodConfigurationAdded, this,
         [=](const HeatingRodConfiguration& heatingRodConfiguration) {
+            configurationChanged(ConfigurationHeatingRod,
+                heatingRodConfiguration.heatingRodThingId(), ConfigurationChange::KindAdded);
             QVariantMap params;
             params.insert("heatingRodConfiguration", pack(heatingRodConfiguration));
             emit HeatingRodConfigurationAdded(params);
@@ -552,6 +714,8 @@ ConsolinnoJsonHandler::ConsolinnoJsonHandler(
 
     connect(m_energyEngine, &EnergyEngine::heatingRodConfigurationRemoved, this,
         [=](const ThingId& heatingRodThingId) {
+            configurationChanged(ConfigurationHeatingRod,
+                heatingRodThingId, ConfigurationChange::KindRemoved);
             QVariantMap params;
             params.insert("heatingRodThingId", heatingRodThingId);
             emit HeatingRodConfigurationRemoved(params);
@@ -559,6 +723,8 @@ ConsolinnoJsonHandler::ConsolinnoJsonHandler(
 
     connect(m_energyEngine, &EnergyEngine::heatingRodConfigurationChanged, this,
         [=](const HeatingRodConfiguration& heatingRodConfiguration) {
+            configurationChanged(ConfigurationHeatingRod,
+                heatingRodConfiguration.heatingRodThingId(), ConfigurationChange::KindChanged);
             QVariantMap params;
             params.insert("heatingRodConfiguration", pack(heatingRodConfiguration));
             emit HeatingRodConfigurationChanged(params);
@@ -567,6 +733,9 @@ ConsolinnoJsonHandler::ConsolinnoJsonHandler(
     // Dynamic Electric Pricing
     connect(m_energyEngine, &EnergyEngine::dynamicElectricPricingConfigurationAdded, this,
         [=](const DynamicElectricPricingConfiguration& dynamicElectricPricingConfiguration) {
+            configurationChanged(ConfigurationDynamicElectricPricing,
+                dynamicElectricPricingConfiguration.dynamicElectricPricingThingId(),
+                ConfigurationChange::KindAdded);
             QVariantMap params;
             params.insert(
                 "dynamicElectricPricingConfiguration", pack(dynamicElectricPricingConfiguration));
@@ -575,6 +744,8 @@ ConsolinnoJsonHandler::ConsolinnoJsonHandler(
 
     connect(m_energyEngine, &EnergyEngine::dynamicElectricPricingConfigurationRemoved, this,
         [=](const ThingId& dynamicElectricPricingThingId) {
+            configurationChanged(ConfigurationDynamicElectricPricing,
+                dynamicElectricPricingThingId, ConfigurationChange::KindRemoved);
             QVariantMap params;
             params.insert("dynamicElectricPricingThingId", dynamicElectricPricingThingId);
             emit DynamicElectricPricingConfigurationRemoved(params);
@@ -582,6 +753,9 @@ ConsolinnoJsonHandler::ConsolinnoJsonHandler(
 
     connect(m_energyEngine, &EnergyEngine::dynamicElectricPricingConfigurationChanged, this,
         [=](const DynamicElectricPricingConfiguration& dynamicElectricPricingConfiguration) {
+            configurationChanged(ConfigurationDynamicElectricPricing,
+                dynamicElectricPricingConfiguration.dynamicElectricPricingThingId(),
+                ConfigurationChange::KindChanged);
             QVariantMap params;
             params.insert(
                 "dynamicElectricPricingConfiguration", pack(dynamicElectricPricingConfiguration));
@@ -591,6 +765,9 @@ ConsolinnoJsonHandler::ConsolinnoJsonHandler(
     // Washing machine
     connect(m_energyEngine, &EnergyEngine::washingMachineConfigurationAdded, this,
         [=](const WashingMachineConfiguration& washingMachineConfiguration) {
+            configurationChanged(ConfigurationWashingMachine,
+                washingMachineConfiguration.washingMachineThingId(),
+                ConfigurationChange::KindAdded);
             QVariantMap params;
             params.insert("washingMachineConfiguration", pack(washingMachineConfiguration));
             emit WashingMachineConfigurationAdded(params);
@@ -598,6 +775,8 @@ ConsolinnoJsonHandler::ConsolinnoJsonHandler(
 
     connect(m_energyEngine, &EnergyEngine::washingMachineConfigurationRemoved, this,
         [=](const ThingId& washingMachineThingId) {
+            configurationChanged(ConfigurationWashingMachine,
+                washingMachineThingId, ConfigurationChange::KindRemoved);
             QVariantMap params;
             params.insert("washingMachineThingId", washingMachineThingId);
             emit WashingMachineConfigurationRemoved(params);
@@ -605,14 +784,19 @@ ConsolinnoJsonHandler::ConsolinnoJsonHandler(
 
     connect(m_energyEngine, &EnergyEngine::washingMachineConfigurationChanged, this,
         [=](const WashingMachineConfiguration& washingMachineConfiguration) {
+            configurationChanged(ConfigurationWashingMachine,
+                washingMachineConfiguration.washingMachineThingId(),
+                ConfigurationChange::KindChanged);
             QVariantMap params;
             params.insert("washingMachineConfiguration", pack(washingMachineConfiguration));
             emit WashingMachineConfigurationChanged(params);
         });
 
-    // ConEMS
+    // ConEMS, there is only one state and it has no ID. The change log records all of its
+    // changes with a null ID, whatever the removal signal passes.
     connect(
         m_energyEngine, &EnergyEngine::conEMSStateAdded, this, [=](const ConEMSState& conEMSState) {
+            configurationChanged(ConfigurationConEMSState, QUuid(), ConfigurationChange::KindAdded);
             QVariantMap params;
             params.insert("conEMSState", pack(conEMSState));
             emit ConEMSStateAdded(params);
@@ -620,6 +804,8 @@ ConsolinnoJsonHandler::ConsolinnoJsonHandler(
 
     connect(
         m_energyEngine, &EnergyEngine::conEMSStateRemoved, this, [=](const QUuid& conEMSStateID) {
+            configurationChanged(
+                ConfigurationConEMSState, QUuid(), ConfigurationChange::KindRemoved);
             QVariantMap params;
             params.insert("conEMSStateID", conEMSStateID);
             emit ConEMSStateRemoved(params);
@@ -627,6 +813,8 @@ ConsolinnoJsonHandler::ConsolinnoJsonHandler(
 
     connect(m_energyEngine, &EnergyEngine::conEMSStateChanged, this,
         [=](const ConEMSState& conEMSState) {
+            configurationChanged(ConfigurationConEMSState,
+                QUuid(), ConfigurationChange::KindChanged);
             QVariantMap params;
             params.insert("conEMSState", pack(conEMSState));
             emit ConEMSStateChanged(params);
@@ -634,6 +822,8 @@ ConsolinnoJsonHandler::ConsolinnoJsonHandler(
 
     connect(m_energyEngine, &EnergyEngine::pvConfigurationAdded, this,
         [=](const PvConfiguration& pvConfiguration) {
+            configurationChanged(ConfigurationPv,
+                pvConfiguration.pvThingId(), ConfigurationChange::KindAdded);
             QVariantMap params;
             params.insert("pvConfiguration", pack(pvConfiguration));
             emit PvConfigurationAdded(params);
@@ -641,6 +831,7 @@ ConsolinnoJsonHandler::ConsolinnoJsonHandler(
 
     connect(
         m_energyEngine, &EnergyEngine::pvConfigurationRemoved, this, [=](const ThingId& pvThingId) {
+            configurationChanged(ConfigurationPv, pvThingId, ConfigurationChange::KindRemoved);
             QVariantMap params;
             params.insert("pvThingId", pvThingId);
             emit PvConfigurationRemoved(params);
@@ -648,13 +839,24 @@ ConsolinnoJsonHandler::ConsolinnoJsonHandler(
 
     connect(m_energyEngine, &EnergyEngine::pvConfigurationChanged, this,
         [=](const PvConfiguration& pvConfiguration) {
+            configurationChanged(ConfigurationPv,
+                pvConfiguration.pvThingId(), ConfigurationChange::KindChanged);
             QVariantMap params;
             params.insert("pvConfiguration", pack(pvConfiguration));
             emit PvConfigurationChanged(params);
         });
 
+    // Sessions get added without a notification, only the cached reply needs to know
+    connect(m_energyEngine, &EnergyEngine::chargingSessionConfigurationAdded, this,
+        [=](const ChargingSessionConfiguration& chargingSessionConfiguration) {
+            configurationChanged(ConfigurationChargingSession,
+                chargingSessionConfiguration.evChargerThingId(), ConfigurationChange::KindAdded);
+        });
+
     connect(m_energyEngine, &EnergyEngine::chargingSessionConfigurationRemoved, this,
         [=](const ThingId& evChargerThingId) {
+            configurationChanged(ConfigurationChargingSession,
+                evChargerThingId, ConfigurationChange::KindRemoved);
             QVariantMap params;
             params.insert("evChargerThingId", evChargerThingId);
             emit ChargingSessionConfigurationRemoved(params);
@@ -662,6 +864,8 @@ ConsolinnoJsonHandler::ConsolinnoJsonHandler(
 
     connect(m_energyEngine, &EnergyEngine::chargingSessionConfigurationChanged, this,
         [=](const ChargingSessionConfiguration& chargingSessionConfiguration) {
+            configurationChanged(ConfigurationChargingSession,
+                chargingSessionConfiguration.evChargerThingId(), ConfigurationChange::KindChanged);
             QVariantMap params;
             params.insert("chargingSessionConfiguration", pack(chargingSessionConfiguration));
             emit ChargingSessionConfigurationChanged(params);
@@ -670,6 +874,8 @@ ConsolinnoJsonHandler::ConsolinnoJsonHandler(
     // Charging connections
     connect(m_energyEngine, &EnergyEngine::chargingConfigurationAdded, this,
         [=](const ChargingConfiguration& chargingConfiguration) {
+            configurationChanged(ConfigurationCharging,
+                chargingConfiguration.evChargerThingId(), ConfigurationChange::KindAdded);
             QVariantMap params;
             params.insert("chargingConfiguration", pack(chargingConfiguration));
             emit ChargingConfigurationAdded(params);
@@ -677,6 +883,8 @@ ConsolinnoJsonHandler::ConsolinnoJsonHandler(
 
     connect(m_energyEngine, &EnergyEngine::chargingConfigurationRemoved, this,
         [=](const ThingId& evChargerThingId) {
+            configurationChanged(ConfigurationCharging,
+                evChargerThingId, ConfigurationChange::KindRemoved);
             QVariantMap params;
             params.insert("evChargerThingId", evChargerThingId);
             emit ChargingConfigurationRemoved(params);
@@ -684,6 +892,8 @@ ConsolinnoJsonHandler::ConsolinnoJsonHandler(
 
     connect(m_energyEngine, &EnergyEngine::chargingConfigurationChanged, this,
         [=](const ChargingConfiguration& chargingConfiguration) {
+            configurationChanged(ConfigurationCharging,
+                chargingConfiguration.evChargerThingId(), ConfigurationChange::KindChanged);
             QVariantMap params;
             params.insert("chargingConfiguration", pack(chargingConfiguration));
             emit ChargingConfigurationChanged(params);
@@ -692,6 +902,9 @@ ConsolinnoJsonHandler::ConsolinnoJsonHandler(
     // Charging optimization connections
     connect(m_energyEngine, &EnergyEngine::chargingOptimizationConfigurationAdded, this,
         [=](const ChargingOptimizationConfiguration& chargingOptimizationConfiguration) {
+            configurationChanged(ConfigurationChargingOptimization,
+                chargingOptimizationConfiguration.evChargerThingId(),
+                ConfigurationChange::KindAdded);
             QVariantMap params;
             params.insert(
                 "chargingOptimizationConfiguration", pack(chargingOptimizationConfiguration));
@@ -700,6 +913,8 @@ ConsolinnoJsonHandler::ConsolinnoJsonHandler(
 
     connect(m_energyEngine, &EnergyEngine::chargingOptimizationConfigurationRemoved, this,
         [=](const ThingId& evChargerThingId) {
+            configurationChanged(ConfigurationChargingOptimization,
+                evChargerThingId, ConfigurationChange::KindRemoved);
             QVariantMap params;
             params.insert("evChargerThingId", evChargerThingId);
             emit ChargingOptimizationConfigurationRemoved(params);
@@ -707,6 +922,9 @@ ConsolinnoJsonHandler::ConsolinnoJsonHandler(
 
     connect(m_energyEngine, &EnergyEngine::chargingOptimizationConfigurationChanged, this,
         [=](const ChargingOptimizationConfiguration& chargingOptimizationConfiguration) {
+            configurationChanged(ConfigurationChargingOptimization,
+                chargingOptimizationConfiguration.evChargerThingId(),
+                ConfigurationChange::KindChanged);
             QVariantMap params;
             params.insert(
                 "chargingOptimizationConfiguration", pack(chargingOptimizationConfiguration));
@@ -715,6 +933,8 @@ ConsolinnoJsonHandler::ConsolinnoJsonHandler(
 
     connect(m_energyEngine, &EnergyEngine::batteryConfigurationAdded, this,
         [=](const BatteryConfiguration& batteryConfiguration) {
+            configurationChanged(ConfigurationBattery,
+                batteryConfiguration.batteryThingId(), ConfigurationChange::KindAdded);
             QVariantMap params;
             params.insert("batteryConfiguration", pack(batteryConfiguration));
             emit BatteryConfigurationAdded(params);
@@ -722,6 +942,8 @@ ConsolinnoJsonHandler::ConsolinnoJsonHandler(
 
     connect(m_energyEngine, &EnergyEngine::batteryConfigurationRemoved, this,
         [=](const ThingId& batteryThingId) {
+            configurationChanged(ConfigurationBattery,
+                batteryThingId, ConfigurationChange::KindRemoved);
             QVariantMap params;
             params.insert("batteryThingId", batteryThingId);
             emit BatteryConfigurationRemoved(params);
@@ -729,6 +951,8 @@ ConsolinnoJsonHandler::ConsolinnoJsonHandler(
 
     connect(m_energyEngine, &EnergyEngine::batteryConfigurationChanged, this,
         [=](const BatteryConfiguration& batteryConfiguration) {
+            configurationChanged(ConfigurationBattery,
+                batteryConfiguration.batteryThingId(), ConfigurationChange::KindChanged);
             QVariantMap params;
             params.insert("batteryConfiguration", pack(batteryConfiguration));
             emit BatteryConfigurationChanged(params);
@@ -737,6 +961,75 @@ ConsolinnoJsonHandler::ConsolinnoJsonHandler(
 
 QString ConsolinnoJsonHandler::name() const { return "Hems"; }
 
+template <typename T>
+void ConsolinnoJsonHandler::initReplyCache(
+    ConfigurationType type, const QString& key, QList<T> (EnergyEngine::*configurations)() const)
+{
+    m_replyCache[type].build = [this, key, configurations]() -> QVariantMap {
+        QVariantList packed;
+        foreach (const T& configuration, (m_energyEngine->*configurations)()) {
+            packed << pack(configuration);
+        }
+        QVariantMap returns;
+        returns.insert(key, packed);
+        return returns;
+    };
+}
+
+// One packing function per configuration type, it only runs if the cached reply is stale
+void ConsolinnoJsonHandler::initReplyCache()
+{
+    initReplyCache(ConfigurationUser, "userConfigurations", &EnergyEngine::userConfigurations);
+    initReplyCache(
+        ConfigurationHeating, "heatingConfigurations", &EnergyEngine::heatingConfigurations);
+    initReplyCache(ConfigurationHeatingRod, "heatingRodConfigurations",
+        &EnergyEngine::heatingRodConfigurations);
+    initReplyCache(ConfigurationDynamicElectricPricing, "dynamicElectricPricingConfigurations",
+        &EnergyEngine::dynamicElectricPricingConfigurations);
+    initReplyCache(ConfigurationWashingMachine, "washingMachineConfigurations",
+        &EnergyEngine::washingMachineConfigurations);
+    initReplyCache(
+        ConfigurationCharging, "chargingConfigurations", &EnergyEngine::chargingConfigurations);
+    initReplyCache(ConfigurationChargingOptimization, "chargingOptimizationConfigurations",
+        &EnergyEngine::chargingOptimizationConfigurations);
+    initReplyCache(
+        ConfigurationBattery, "batteryConfigurations", &EnergyEngine::batteryConfigurations);
+    initReplyCache(ConfigurationPv, "pvConfigurations", &EnergyEngine::pvConfigurations);
+    initReplyCache(ConfigurationChargingSession, "chargingSessionConfigurations",
+        &EnergyEngine::chargingSessionConfigurations);
+
+    // There is only one state, it gets returned as a list like the configurations
+    m_replyCache[ConfigurationConEMSState].build = [this]() -> QVariantMap {
+        QVariantMap returns;
+        returns.insert("conEMSState", QVariantList() << pack(m_energyEngine->ConemsState()));
+        return returns;
+    };
+}
+
+void ConsolinnoJsonHandler::configurationChanged(
+    ConfigurationType type, const QUuid& thingId, ConfigurationChange::Kind kind)
+{
+    static const std::array<const char*, ConfigurationTypeCount> typeNames = {
+        { "userConfiguration", "heatingConfiguration", "heatingRodConfiguration",
+            "dynamicElectricPricingConfiguration", "washingMachineConfiguration",
+            "chargingConfiguration", "chargingOptimizationConfiguration", "batteryConfiguration",
+            "pvConfiguration", "chargingSessionConfiguration", "conEMSState" }
+    };
+
+    m_replyCache[type].revision++;
+    m_changeLog.append(QString::fromLatin1(typeNames.at(type)), thingId, kind);
+}
+
+const QVariantMap& ConsolinnoJsonHandler::cachedReturns(ConfigurationType type)
+{
+    CachedReply& cached = m_replyCache[type];
+    if (cached.packedRevision != cached.revision) {
+        cached.returns = cached.build();
+        cached.packedRevision = cached.revision;
+    }
+    return cached.returns;
+}
+
 JsonReply* ConsolinnoJsonHandler::GetHEMSVersion(const QVariantMap& params)
 {
     Q_UNUSED(params)
@@ -747,6 +1040,78 @@ JsonReply* ConsolinnoJsonHandler::GetHEMSVersion(const QVariantMap& params)
     return createReply(returns);
 }
 
+void ConsolinnoJsonHandler::updateGridSupportThing()
+{
+    Thing* gridSupportThing = m_energyEngine->gridSupportDevice();
+    QString gridSupportThingId = gridSupportThing ? gridSupportThing->id().toString() : QString();
+    if (gridSupportThingId != m_gridSupportThingId) {
+        m_gridSupportThingId = gridSupportThingId;
+        m_changeLog.append("gridSupportThing", gridSupportThing ? gridSupportThing->id() : QUuid(),
+            ConfigurationChange::KindChanged);
+    }
+}
+
+void ConsolinnoJsonHandler::packSnapshot(QVariantMap& returns)
+{
+    returns.insert("availableUseCases", flagValueNames(m_energyEngine->availableUseCases()));
+    returns.insert("housholdPhaseLimit", m_energyEngine->housholdPhaseLimit());
+    for (int type = 0; type < ConfigurationTypeCount; type++) {
+        const QVariantMap& cached = cachedReturns(static_cast<ConfigurationType>(type));
+        for (auto it = cached.cbegin(), end = cached.cend(); it != end; ++it) {
+            returns.insert(it.key(), it.value());
+        }
+    }
+    if (!m_gridSupportThingId.isEmpty()) {
+        returns.insert("gridSupportThingId", m_gridSupportThingId);
+    }
+}
+
+JsonReply* ConsolinnoJsonHandler::GetSnapshot(const QVariantMap& params)
+{
+    updateGridSupportThing();
+
+    QVariantMap returns;
+    returns.insert("revision", m_changeLog.revision());
+    returns.insert("runId", m_runId);
+    if (params.contains("ifNoneMatch") && params.value("runId").toUuid() == m_runId
+        && params.value("ifNoneMatch").toULongLong() == m_changeLog.revision()) {
+        returns.insert("notModified", true);
+        return createReply(returns);
+    }
+
+    returns.insert("notModified", false);
+    packSnapshot(returns);
+    return createReply(returns);
+}
+
+JsonReply* ConsolinnoJsonHandler::GetChangesSince(const QVariantMap& params)
+{
+    updateGridSupportThing();
+
+    QVariantMap returns;
+    returns.insert("revision", m_changeLog.revision());
+    returns.insert("runId", m_runId);
+
+    // Revisions of an earlier run say nothing about this one
+    QList<ConfigurationChange> changes;
+    if (params.value("runId").toUuid() != m_runId
+        || !m_changeLog.changesSince(params.value("revision").toULongLong(), &changes)) {
+        qCDebug(dcConsolinnoEnergy()) << "Changes since revision" << params.value("revision")
+                                      << "are not in the change log, returning a snapshot";
+        returns.insert("truncated", true);
+        packSnapshot(returns);
+        return createReply(returns);
+    }
+
+    QVariantList changeList;
+    foreach (const ConfigurationChange& change, changes) {
+        changeList << pack(change);
+    }
+    returns.insert("truncated", false);
+    returns.insert("changes", changeList);
+    return createReply(returns);
+}
+
 JsonReply* ConsolinnoJsonHandler::GetAvailableUseCases(const QVariantMap& params)
 {
     Q_UNUSED(params)
@@ -776,17 +1141,8 @@ JsonReply* ConsolinnoJsonHandler::SetHousholdPhaseLimit(const QVariantMap& param
 
 JsonReply* ConsolinnoJsonHandler::GetPvConfigurations(const QVariantMap& params)
 {
-
-    // qCDebug(dcConsolinnoEnergy()) << "GetPvConfigurationJsonHandler:" << params << "\n";
     Q_UNUSED(params)
-    QVariantMap returns;
-    QVariantList configurations;
-    foreach (const PvConfiguration& pvConfig, m_energyEngine->pvConfigurations()) {
-        configurations << pack(pvConfig);
-    }
-    returns.insert("pvConfigurations", configurations);
-
-    return createReply(returns);
+    return createReply(cachedReturns(ConfigurationPv));
 }
 
 JsonReply* ConsolinnoJsonHandler::SetPvConfiguration(const QVariantMap& params)
@@ -802,13 +1158,7 @@ JsonReply* ConsolinnoJsonHandler::SetPvConfiguration(const QVariantMap& params)
 JsonReply* ConsolinnoJsonHandler::GetUserConfigurations(const QVariantMap& params)
 {
     Q_UNUSED(params)
-    QVariantMap returns;
-    QVariantList configurations;
-    foreach (const UserConfiguration& userConfig, m_energyEngine->userConfigurations()) {
-        configurations << pack(userConfig);
-    }
-    returns.insert("userConfigurations", configurations);
-    return createReply(returns);
+    return createReply(cachedReturns(ConfigurationUser));
 }
 
 JsonReply* ConsolinnoJsonHandler::SetUserConfiguration(const QVariantMap& params)
@@ -824,13 +1174,7 @@ JsonReply* ConsolinnoJsonHandler::SetUserConfiguration(const QVariantMap& params
 JsonReply* ConsolinnoJsonHandler::GetHeatingConfigurations(const QVariantMap& params)
 {
     Q_UNUSED(params)
-    QVariantMap returns;
-    QVariantList configurations;
-    foreach (const HeatingConfiguration& heatingConfig, m_energyEngine->heatingConfigurations()) {
-        configurations << pack(heatingConfig);
-    }
-    returns.insert("heatingConfigurations", configurations);
-    return createReply(returns);
+    return createReply(cachedReturns(ConfigurationHeating));
 }
 
 JsonReply* ConsolinnoJsonHandler::SetHeatingConfiguration(const QVariantMap& params)
@@ -846,14 +1190,7 @@ JsonReply* ConsolinnoJsonHandler::SetHeatingConfiguration(const QVariantMap& par
 JsonReply* ConsolinnoJsonHandler::GetHeatingRodConfigurations(const QVariantMap& params)
 {
     Q_UNUSED(params)
-    QVariantMap returns;
-    QVariantList configurations;
-    foreach (const HeatingRodConfiguration& heatingRodConfig,
-        m_energyEngine->heatingRodConfigurations()) {
-        configurations << pack(heatingRodConfig);
-    }
-    returns.insert("heatingRodConfigurations", configurations);
-    return createReply(returns);
+    return createReply(cachedReturns(ConfigurationHeatingRod));
 }
 
 JsonReply* ConsolinnoJsonHandler::SetHeatingRodConfiguration(const QVariantMap& params)
@@ -869,14 +1206,7 @@ JsonReply* ConsolinnoJsonHandler::SetHeatingRodConfiguration(const QVariantMap&
 JsonReply* ConsolinnoJsonHandler::GetDynamicElectricPricingConfigurations(const QVariantMap& params)
 {
     Q_UNUSED(params)
-    QVariantMap returns;
-    QVariantList configurations;
-    foreach (const DynamicElectricPricingConfiguration& dynamicElectricPricingConfig,
-        m_energyEngine->dynamicElectricPricingConfigurations()) {
-        configurations << pack(dynamicElectricPricingConfig);
-    }
-    returns.insert("dynamicElectricPricingConfigurations", configurations);
-    return createReply(returns);
+    return createReply(cachedReturns(ConfigurationDynamicElectricPricing));
 }
 
 JsonReply* ConsolinnoJsonHandler::SetDynamicElectricPricingConfiguration(const QVariantMap& params)
@@ -893,14 +1223,7 @@ JsonReply* ConsolinnoJsonHandler::SetDynamicElectricPricingConfiguration(const Q
 JsonReply* ConsolinnoJsonHandler::GetWashingMachineConfigurations(const QVariantMap& params)
 {
     Q_UNUSED(params)
-    QVariantMap returns;
-    QVariantList configurations;
-    foreach (const WashingMachineConfiguration& washingMachineConfig,
-        m_energyEngine->washingMachineConfigurations()) {
-        configurations << pack(washingMachineConfig);
-    }
-    returns.insert("washingMachineConfigurations", configurations);
-    return createReply(returns);
+    return createReply(cachedReturns(ConfigurationWashingMachine));
 }
 
 JsonReply* ConsolinnoJsonHandler::SetWashingMachineConfiguration(const QVariantMap& params)
@@ -916,13 +1239,7 @@ JsonReply* ConsolinnoJsonHandler::SetWashingMachineConfiguration(const QVariantM
 JsonReply* ConsolinnoJsonHandler::GetConEMSState(const QVariantMap& params)
 {
     Q_UNUSED(params)
-    QVariantMap returns;
-    QVariantList Cstates;
-
-    Cstates << pack(m_energyEngine->ConemsState());
-
-    returns.insert("conEMSState", Cstates);
-    return createReply(returns);
+    return createReply(cachedReturns(ConfigurationConEMSState));
 }
 
 JsonReply* ConsolinnoJsonHandler::SetConEMSState(const QVariantMap& params)
@@ -976,16 +1293,7 @@ JsonReply* ConsolinnoJsonHandler::GetGridSupportThing(const QVariantMap& params)
 JsonReply* ConsolinnoJsonHandler::GetChargingConfigurations(const QVariantMap& params)
 {
     Q_UNUSED(params)
-
-    QVariantMap returns;
-    QVariantList configurations;
-    foreach (
-        const ChargingConfiguration& chargingConfig, m_energyEngine->chargingConfigurations()) {
-        configurations << pack(chargingConfig);
-    }
-    returns.insert("chargingConfigurations", configurations);
-
-    return createReply(returns);
+    return createReply(cachedReturns(ConfigurationCharging));
 }
 
 JsonReply* ConsolinnoJsonHandler::SetChargingConfiguration(const QVariantMap& params)
@@ -1001,16 +1309,7 @@ JsonReply* ConsolinnoJsonHandler::SetChargingConfiguration(const QVariantMap& pa
 JsonReply* ConsolinnoJsonHandler::GetChargingOptimizationConfigurations(const QVariantMap& params)
 {
     Q_UNUSED(params)
-
-    QVariantMap returns;
-    QVariantList configurations;
-    foreach (const ChargingOptimizationConfiguration& chargingOptimizationConfig,
-        m_energyEngine->chargingOptimizationConfigurations()) {
-        configurations << pack(chargingOptimizationConfig);
-    }
-    returns.insert("chargingOptimizationConfigurations", configurations);
-
-    return createReply(returns);
+    return createReply(cachedReturns(ConfigurationChargingOptimization));
 }
 
 JsonReply* ConsolinnoJsonHandler::SetChargingOptimizationConfiguration(const QVariantMap& params)
@@ -1024,20 +1323,22 @@ JsonReply* ConsolinnoJsonHandler::SetChargingOptimizationConfiguration(const QVa
     return createReply(returns);
 }
 
-JsonReply* ConsolinnoJsonHandler::GetBatteryConfigurations(const QVariantMap& params)
+JsonReply* ConsolinnoJsonHandler::StartChargingAutoTune(const QVariantMap& params)
 {
-    Q_UNUSED(params)
-
+    EnergyEngine::HemsError error = m_energyEngine->startChargingAutoTune(
+        ThingId(params.value("evChargerThingId").toUuid()),
+        params.value("stepCurrent", 2).toDouble());
     QVariantMap returns;
-    QVariantList configurations;
-    foreach (const BatteryConfiguration& batteryConfig, m_energyEngine->batteryConfigurations()) {
-        configurations << pack(batteryConfig);
-    }
-    returns.insert("batteryConfigurations", configurations);
-
+    returns.insert("hemsError", enumValueName(error));
     return createReply(returns);
 }
 
+JsonReply* ConsolinnoJsonHandler::GetBatteryConfigurations(const QVariantMap& params)
+{
+    Q_UNUSED(params)
+    return createReply(cachedReturns(ConfigurationBattery));
+}
+
 JsonReply* ConsolinnoJsonHandler::SetBatteryConfiguration(const QVariantMap& params)
 {
     qCDebug(dcConsolinnoEnergy()) << params;
@@ -1051,16 +1352,7 @@ JsonReply* ConsolinnoJsonHandler::SetBatteryConfiguration(const QVariantMap& par
 JsonReply* ConsolinnoJsonHandler::GetChargingSessionConfigurations(const QVariantMap& params)
 {
     Q_UNUSED(params)
-
-    QVariantMap returns;
-    QVariantList configurations;
-    foreach (const ChargingSessionConfiguration& chargingSessionConfig,
-        m_energyEngine->chargingSessionConfigurations()) {
-        configurations << pack(chargingSessionConfig);
-    }
-    returns.insert("chargingSessionConfigurations", configurations);
-
-    return createReply(returns);
+    return createReply(cachedReturns(ConfigurationChargingSession));
 }
 
 JsonReply* ConsolinnoJsonHandler::SetChargingSessionConfiguration(const QVariantMap& params)
@@ -1072,3 +1364,75 @@ JsonReply* ConsolinnoJsonHandler::SetChargingSessionConfiguration(const QVariant
     returns.insert("hemsError", enumValueName(error));
     return createReply(returns);
 }
+
+JsonReply* ConsolinnoJsonHandler::GetChargingSessions(const QVariantMap& params)
+{
+    ThingId evChargerThingId = params.value("evChargerThingId").toUuid();
+    qint64 from = params.value("from", 0).toLongLong();
+    qint64 to = params.value("to", std::numeric_limits<qint64>::max()).toLongLong();
+    int limit = params.value("limit", 0).toInt();
+
+    QVariantMap returns;
+    QVariantList sessions;
+    foreach (const ChargingSessionConfiguration& chargingSession,
+        m_energyEngine->chargingSessions(evChargerThingId, from, to, limit)) {
+        sessions << pack(chargingSession);
+    }
+    returns.insert("chargingSessions", sessions);
+
+    return createReply(returns);
+}
+
+JsonReply* ConsolinnoJsonHandler::GetDecisionTrace(const QVariantMap& params)
+{
+    QVariantMap returns;
+    QVariantList decisions;
+    foreach (const ControlDecision& decision,
+        m_energyEngine->decisionTrace(params.value("limit", 0).toInt())) {
+        decisions << pack(decision);
+    }
+    returns.insert("decisions", decisions);
+
+    return createReply(returns);
+}
+
+JsonReply* ConsolinnoJsonHandler::GetHeatPumpTransitions(const QVariantMap& params)
+{
+    QVariantMap returns;
+    QVariantList transitions;
+    foreach (const HeatPumpTransition& transition,
+        m_energyEngine->heatPumpTransitions(params.value("limit", 0).toInt())) {
+        transitions << pack(transition);
+    }
+    returns.insert("transitions", transitions);
+
+    return createReply(returns);
+}
+
+JsonReply* ConsolinnoJsonHandler::GetControlLatencyStats(const QVariantMap& params)
+{
+    Q_UNUSED(params)
+
+    QVariantMap returns;
+    QVariantList latencyStats;
+    foreach (const ControlLatencyStats& stats, m_energyEngine->controlLatencyStats()) {
+        latencyStats << pack(stats);
+    }
+    returns.insert("latencyStats", latencyStats);
+
+    return createReply(returns);
+}
+
+JsonReply* ConsolinnoJsonHandler::GetLimitSources(const QVariantMap& params)
+{
+    Q_UNUSED(params)
+
+    QVariantMap returns;
+    QVariantList limitSources;
+    foreach (const LimitSourceStatus& limitSource, m_energyEngine->limitSources()) {
+        limitSources << pack(limitSource);
+    }
+    returns.insert("limitSources", limitSources);
+
+    return createReply(returns);
+}
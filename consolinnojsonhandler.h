@@ -6,10 +6,14 @@
 #ifndef CONSOLINNOJSONHANDLER_H
 #define CONSOLINNOJSONHANDLER_H
 
+#include "configurationchangelog.h"
 #include "energypluginconsolinno.h"
 #include "jsonrpc/jsonhandler.h"
 #include <QObject>
 
+#include <array>
+#include <functional>
+
 class EnergyEngine;
 
 class ConsolinnoJsonHandler : public JsonHandler {
@@ -21,6 +25,8 @@ public:
     QString name() const override;
 
     Q_INVOKABLE JsonReply* GetHEMSVersion(const QVariantMap& params);
+    Q_INVOKABLE JsonReply* GetSnapshot(const QVariantMap& params);
+    Q_INVOKABLE JsonReply* GetChangesSince(const QVariantMap& params);
     Q_INVOKABLE JsonReply* GetAvailableUseCases(const QVariantMap& params);
 
     Q_INVOKABLE JsonReply* GetHousholdPhaseLimit(const QVariantMap& params);
@@ -46,12 +52,14 @@ public:
 
     Q_INVOKABLE JsonReply* GetChargingSessionConfigurations(const QVariantMap& params);
     Q_INVOKABLE JsonReply* SetChargingSessionConfiguration(const QVariantMap& params);
+    Q_INVOKABLE JsonReply* GetChargingSessions(const QVariantMap& params);
 
     Q_INVOKABLE JsonReply* GetChargingConfigurations(const QVariantMap& params);
     Q_INVOKABLE JsonReply* SetChargingConfiguration(const QVariantMap& params);
 
     Q_INVOKABLE JsonReply* GetChargingOptimizationConfigurations(const QVariantMap& params);
     Q_INVOKABLE JsonReply* SetChargingOptimizationConfiguration(const QVariantMap& params);
+    Q_INVOKABLE JsonReply* StartChargingAutoTune(const QVariantMap& params);
 
     Q_INVOKABLE JsonReply* GetBatteryConfigurations(const QVariantMap& params);
     Q_INVOKABLE JsonReply* SetBatteryConfiguration(const QVariantMap& params);
@@ -61,6 +69,11 @@ public:
 
     Q_INVOKABLE JsonReply* GetGridSupportThing(const QVariantMap& params);
 
+    Q_INVOKABLE JsonReply* GetDecisionTrace(const QVariantMap& params);
+    Q_INVOKABLE JsonReply* GetHeatPumpTransitions(const QVariantMap& params);
+    Q_INVOKABLE JsonReply* GetControlLatencyStats(const QVariantMap& params);
+    Q_INVOKABLE JsonReply* GetLimitSources(const QVariantMap& params);
+
 signals:
     void PluggedInChanged(const QVariantMap& params);
 
@@ -115,6 +128,51 @@ signals:
 private:
     EnergyEngine* m_energyEngine = nullptr;
     HEMSVersionInfo m_versionInfo;
+
+    enum ConfigurationType {
+        ConfigurationUser,
+        ConfigurationHeating,
+        ConfigurationHeatingRod,
+        ConfigurationDynamicElectricPricing,
+        ConfigurationWashingMachine,
+        ConfigurationCharging,
+        ConfigurationChargingOptimization,
+        ConfigurationBattery,
+        ConfigurationPv,
+        ConfigurationChargingSession,
+        ConfigurationConEMSState,
+        ConfigurationTypeCount
+    };
+
+    // The Get*Configurations replies get packed once per revision of their type. Apps poll them,
+    // a cached reply is served without copying the configurations or packing them again.
+    struct CachedReply {
+        quint64 revision = 1;
+        // Revision the returns were packed for
+        quint64 packedRevision = 0;
+        QVariantMap returns;
+        std::function<QVariantMap()> build;
+    };
+    std::array<CachedReply, ConfigurationTypeCount> m_replyCache;
+
+    // Every change of what GetSnapshot returns, its revision is the revision of the snapshot
+    ConfigurationChangeLog m_changeLog;
+    // Revisions restart with every run to fit the Uint of the API, the run ID tells runs apart
+    QUuid m_runId = QUuid::createUuid();
+    QString m_gridSupportThingId;
+
+    void initReplyCache();
+    // Packs all configurations the getter returns into the reply under the given key
+    template <typename T>
+    void initReplyCache(ConfigurationType type, const QString& key,
+        QList<T> (EnergyEngine::*configurations)() const);
+    // Called for every add, change and remove of a configuration
+    void configurationChanged(
+        ConfigurationType type, const QUuid& thingId, ConfigurationChange::Kind kind);
+    const QVariantMap& cachedReturns(ConfigurationType type);
+    // The grid support thing has no notification, it gets compared whenever a client syncs
+    void updateGridSupportThing();
+    void packSnapshot(QVariantMap& returns);
 };
 
 #endif // CONSOLINNOJSONHANDLER_H
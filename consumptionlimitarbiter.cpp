@@ -0,0 +1,156 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include "consumptionlimitarbiter.h"
+
+ConsumptionLimitArbiter::ConsumptionLimitArbiter()
+{
+    // The order of the enum, the iec server before the opc-ua client
+    for (int source = 0; source < ControlLatencyTracker::SourceCount; source++) {
+        m_entries[source].rank = source;
+    }
+}
+
+ConsumptionLimitArbiter::Policy ConsumptionLimitArbiter::policyFromString(
+    const QString& policy, Policy defaultPolicy)
+{
+    if (policy == QLatin1String("strictest"))
+        return PolicyStrictest;
+    if (policy == QLatin1String("priority"))
+        return PolicyPriority;
+    if (policy == QLatin1String("mostRecent"))
+        return PolicyMostRecent;
+
+    return defaultPolicy;
+}
+
+QString ConsumptionLimitArbiter::policyName(Policy policy)
+{
+    switch (policy) {
+    case PolicyStrictest:
+        return QStringLiteral("strictest");
+    case PolicyPriority:
+        return QStringLiteral("priority");
+    case PolicyMostRecent:
+        return QStringLiteral("mostRecent");
+    }
+    return QString();
+}
+
+ConsumptionLimitArbiter::Policy ConsumptionLimitArbiter::policy() const { return m_policy; }
+
+void ConsumptionLimitArbiter::setPolicy(Policy policy)
+{
+    m_policy = policy;
+    recompute();
+}
+
+void ConsumptionLimitArbiter::setPriorities(const QList<Source>& priorities)
+{
+    for (int source = 0; source < ControlLatencyTracker::SourceCount; source++) {
+        int rank = priorities.indexOf(static_cast<Source>(source));
+        m_entries[source].rank = rank < 0 ? ControlLatencyTracker::SourceCount + source : rank;
+    }
+    recompute();
+}
+
+void ConsumptionLimitArbiter::setValidity(Source source, qint64 validity)
+{
+    m_entries[source].validity = qMax<qint64>(0, validity);
+}
+
+bool ConsumptionLimitArbiter::update(Source source, qlonglong consumptionLimit, qint64 now)
+{
+    Entry& entry = m_entries[source];
+    entry.valid = true;
+    entry.consumptionLimit = consumptionLimit < 0 ? -1 : consumptionLimit;
+    entry.receivedAt = now;
+    return recompute();
+}
+
+bool ConsumptionLimitArbiter::expire(qint64 now)
+{
+    bool expired = false;
+    for (Entry& entry : m_entries) {
+        if (entry.valid && entry.validity > 0 && now - entry.receivedAt >= entry.validity) {
+            entry.valid = false;
+            expired = true;
+        }
+    }
+
+    return expired && recompute();
+}
+
+qlonglong ConsumptionLimitArbiter::effectiveLimit() const { return m_effectiveLimit; }
+
+ConsumptionLimitArbiter::Source ConsumptionLimitArbiter::effectiveSource() const
+{
+    return static_cast<Source>(qMax(0, m_effectiveSource));
+}
+
+bool ConsumptionLimitArbiter::hasEffectiveSource() const { return m_effectiveSource >= 0; }
+
+qint64 ConsumptionLimitArbiter::nextExpiry() const
+{
+    qint64 nextExpiry = -1;
+    for (const Entry& entry : m_entries) {
+        if (!entry.valid || entry.validity <= 0)
+            continue;
+
+        qint64 expiry = entry.receivedAt + entry.validity;
+        if (nextExpiry < 0 || expiry < nextExpiry) {
+            nextExpiry = expiry;
+        }
+    }
+    return nextExpiry;
+}
+
+bool ConsumptionLimitArbiter::recompute()
+{
+    int selected = -1;
+    for (int source = 0; source < ControlLatencyTracker::SourceCount; source++) {
+        const Entry& entry = m_entries.at(source);
+        if (!entry.valid)
+            continue;
+
+        if (selected < 0) {
+            selected = source;
+            continue;
+        }
+
+        const Entry& current = m_entries.at(selected);
+        bool better = false;
+        switch (m_policy) {
+        case PolicyStrictest:
+            // Any limit is stricter than none, ties go to the higher priority
+            if (entry.consumptionLimit >= 0 && current.consumptionLimit >= 0) {
+                better = entry.consumptionLimit < current.consumptionLimit
+                    || (entry.consumptionLimit == current.consumptionLimit
+                        && entry.rank < current.rank);
+            } else if (entry.consumptionLimit >= 0) {
+                better = true;
+            } else if (current.consumptionLimit < 0) {
+                better = entry.rank < current.rank;
+            }
+            break;
+        case PolicyPriority:
+            better = entry.rank < current.rank;
+            break;
+        case PolicyMostRecent:
+            better = entry.receivedAt > current.receivedAt;
+            break;
+        }
+
+        if (better) {
+            selected = source;
+        }
+    }
+
+    qlonglong effectiveLimit = selected < 0 ? -1 : m_entries.at(selected).consumptionLimit;
+    bool changed = effectiveLimit != m_effectiveLimit || selected != m_effectiveSource;
+    m_effectiveLimit = effectiveLimit;
+    m_effectiveSource = selected;
+    return changed;
+}
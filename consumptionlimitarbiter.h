@@ -0,0 +1,80 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#ifndef CONSUMPTIONLIMITARBITER_H
+#define CONSUMPTIONLIMITARBITER_H
+
+#include <QList>
+#include <QString>
+
+#include <array>
+
+#include "controllatency.h"
+
+/*!
+ * \brief The ConsumptionLimitArbiter class combines the limits of all sources into one.
+ * \details Every source keeps its latest limit with the time it was received. A limit of -1 means
+ * the source does not restrict the consumption. A limit older than the validity of its source
+ * expires, a validity of 0 keeps it until the source sends a new one. The effective limit gets
+ * recomputed whenever a limit arrives or expires and is cached in between, so reading it is free.
+ *
+ * Policies:
+ * - strictest: the lowest limit of all sources, a shutoff (0) of any source wins
+ * - priority: the limit of the first source in the priority order that has one
+ * - mostRecent: the limit received last, which was the behaviour before the arbitration
+ */
+class ConsumptionLimitArbiter {
+public:
+    typedef ControlLatencyTracker::Source Source;
+
+    enum Policy { PolicyStrictest, PolicyPriority, PolicyMostRecent };
+
+    ConsumptionLimitArbiter();
+
+    static Policy policyFromString(const QString& policy, Policy defaultPolicy);
+    static QString policyName(Policy policy);
+
+    Policy policy() const;
+    void setPolicy(Policy policy);
+
+    // Sources in the order of their priority, highest first. Missing sources rank last.
+    void setPriorities(const QList<Source>& priorities);
+
+    // Milliseconds a limit of the source stays valid, 0 for no expiry
+    void setValidity(Source source, qint64 validity);
+
+    // Both return true if the effective limit or its source changed. now is in milliseconds of a
+    // monotonic clock, see EngineClock::monotonicTime().
+    bool update(Source source, qlonglong consumptionLimit, qint64 now);
+    bool expire(qint64 now);
+
+    // -1 if no source restricts the consumption
+    qlonglong effectiveLimit() const;
+    // Only meaningful while hasEffectiveSource() is true
+    Source effectiveSource() const;
+    bool hasEffectiveSource() const;
+
+    // Monotonic time the next limit expires at, -1 if none will
+    qint64 nextExpiry() const;
+
+private:
+    struct Entry {
+        bool valid = false;
+        qlonglong consumptionLimit = -1;
+        qint64 receivedAt = 0;
+        qint64 validity = 0;
+        int rank = 0;
+    };
+
+    Policy m_policy = PolicyStrictest;
+    std::array<Entry, ControlLatencyTracker::SourceCount> m_entries;
+
+    qlonglong m_effectiveLimit = -1;
+    int m_effectiveSource = -1;
+
+    bool recompute();
+};
+
+#endif // CONSUMPTIONLIMITARBITER_H
@@ -0,0 +1,229 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include "controllatency.h"
+
+#include <QtAlgorithms>
+
+#include <cmath>
+
+void LatencyHistogram::record(qint64 microseconds)
+{
+    microseconds = qMax<qint64>(0, microseconds);
+    m_buckets[bucketIndex(microseconds)]++;
+
+    if (m_count == 0 || microseconds < m_min) {
+        m_min = microseconds;
+    }
+    if (m_count == 0 || microseconds > m_max) {
+        m_max = microseconds;
+    }
+    m_count++;
+    m_sum += microseconds;
+}
+
+void LatencyHistogram::reset() { *this = LatencyHistogram(); }
+
+quint64 LatencyHistogram::count() const { return m_count; }
+
+qint64 LatencyHistogram::min() const { return m_min; }
+
+qint64 LatencyHistogram::max() const { return m_max; }
+
+double LatencyHistogram::mean() const { return m_count > 0 ? m_sum / m_count : 0; }
+
+qint64 LatencyHistogram::percentile(double percentile) const
+{
+    if (m_count == 0)
+        return 0;
+
+    double rank = std::ceil(qBound(0.0, percentile, 100.0) / 100 * m_count);
+    quint64 target = qMax<quint64>(1, static_cast<quint64>(rank));
+
+    quint64 seen = 0;
+    for (int i = 0; i < static_cast<int>(m_buckets.size()); i++) {
+        seen += m_buckets[i];
+        if (seen >= target)
+            return qMin(bucketUpperBound(i), m_max);
+    }
+
+    return m_max;
+}
+
+// Values below subBucketCount get a bucket each, above that every power of two is split into
+// subBucketCount linear buckets
+int LatencyHistogram::bucketIndex(qint64 microseconds)
+{
+    if (microseconds < subBucketCount)
+        return static_cast<int>(microseconds);
+
+    int msb = 63 - qCountLeadingZeroBits(static_cast<quint64>(microseconds));
+    int shift = msb - subBucketBits;
+    int subBucket = static_cast<int>(microseconds >> shift) - subBucketCount;
+    int index = subBucketCount + shift * subBucketCount + subBucket;
+    return qMin(index, magnitudeCount * subBucketCount - 1);
+}
+
+qint64 LatencyHistogram::bucketUpperBound(int index)
+{
+    if (index < subBucketCount)
+        return index;
+
+    int shift = (index - subBucketCount) / subBucketCount;
+    int subBucket = (index - subBucketCount) % subBucketCount;
+    qint64 lower = static_cast<qint64>(subBucketCount + subBucket) << shift;
+    return lower + (static_cast<qint64>(1) << shift) - 1;
+}
+
+ControlLatencyStats::ControlLatencyStats() { }
+
+ControlLatencyStats::ControlLatencyStats(const QString& source,
+    const LatencyHistogram& actionLatency, const LatencyHistogram& meterLatency)
+    : m_source(source)
+    , m_actionLatency(actionLatency)
+    , m_meterLatency(meterLatency)
+{
+}
+
+QString ControlLatencyStats::source() const { return m_source; }
+
+uint ControlLatencyStats::actionCount() const { return static_cast<uint>(m_actionLatency.count()); }
+
+double ControlLatencyStats::actionMin() const { return m_actionLatency.min() / 1000.0; }
+
+double ControlLatencyStats::actionMean() const { return m_actionLatency.mean() / 1000.0; }
+
+double ControlLatencyStats::actionP50() const { return m_actionLatency.percentile(50) / 1000.0; }
+
+double ControlLatencyStats::actionP90() const { return m_actionLatency.percentile(90) / 1000.0; }
+
+double ControlLatencyStats::actionP99() const { return m_actionLatency.percentile(99) / 1000.0; }
+
+double ControlLatencyStats::actionMax() const { return m_actionLatency.max() / 1000.0; }
+
+uint ControlLatencyStats::meterCount() const { return static_cast<uint>(m_meterLatency.count()); }
+
+double ControlLatencyStats::meterMin() const { return m_meterLatency.min() / 1000.0; }
+
+double ControlLatencyStats::meterMean() const { return m_meterLatency.mean() / 1000.0; }
+
+double ControlLatencyStats::meterP50() const { return m_meterLatency.percentile(50) / 1000.0; }
+
+double ControlLatencyStats::meterP90() const { return m_meterLatency.percentile(90) / 1000.0; }
+
+double ControlLatencyStats::meterP99() const { return m_meterLatency.percentile(99) / 1000.0; }
+
+double ControlLatencyStats::meterMax() const { return m_meterLatency.max() / 1000.0; }
+
+QDebug operator<<(QDebug debug, const ControlLatencyStats& controlLatencyStats)
+{
+    debug.nospace() << "ControlLatencyStats(" << controlLatencyStats.source() << ", ";
+    debug.nospace() << "actions: " << controlLatencyStats.actionCount() << ", ";
+    debug.nospace() << "action p99: " << controlLatencyStats.actionP99() << " ms, ";
+    debug.nospace() << "meter: " << controlLatencyStats.meterCount() << ", ";
+    debug.nospace() << "meter p99: " << controlLatencyStats.meterP99() << " ms";
+    debug.nospace() << ")";
+    return debug.maybeSpace();
+}
+
+QString ControlLatencyTracker::sourceName(Source source)
+{
+    switch (source) {
+    case SourceIec61850Path1:
+        return "iec61850/1";
+    case SourceIec61850Path2:
+        return "iec61850/2";
+    case SourceIec61850Path3:
+        return "iec61850/3";
+    case SourceIec61850Path4:
+        return "iec61850/4";
+    case SourceOpcUa:
+        return "opcua";
+    case SourceCount:
+        break;
+    }
+    return QString();
+}
+
+void ControlLatencyTracker::limitSignalled(
+    Source source, double rootMeterPower, quint64 snapshotRevision)
+{
+    // A newer limit replaces a measurement still in progress
+    m_phase = PhaseAwaitingActions;
+    m_source = source;
+    m_powerAtSignal = rootMeterPower;
+    m_signalRevision = snapshotRevision;
+    m_timer.start();
+}
+
+void ControlLatencyTracker::actionExecuted(quint64 snapshotRevision)
+{
+    // Computed before the limit was known
+    if (m_phase != PhaseAwaitingActions || snapshotRevision <= m_signalRevision)
+        return;
+
+    qint64 elapsed = m_timer.nsecsElapsed() / 1000;
+    m_actionLatency[m_source].record(elapsed);
+    m_lastActionLatency = elapsed / 1000.0;
+}
+
+void ControlLatencyTracker::evaluationFinished(int actions, quint64 snapshotRevision)
+{
+    if (m_phase != PhaseAwaitingActions || snapshotRevision <= m_signalRevision)
+        return;
+
+    // Only the evaluation following the signal belongs to it
+    m_phase = actions > 0 ? PhaseAwaitingPowerDrop : PhaseIdle;
+}
+
+bool ControlLatencyTracker::rootMeterPowerChanged(double power)
+{
+    if (m_phase != PhaseAwaitingPowerDrop)
+        return false;
+
+    if (m_timer.hasExpired(m_meterTimeout)) {
+        m_phase = PhaseIdle;
+        return false;
+    }
+
+    if (power > m_powerAtSignal - m_powerDropThreshold)
+        return false;
+
+    qint64 elapsed = m_timer.nsecsElapsed() / 1000;
+    m_meterLatency[m_source].record(elapsed);
+    m_lastMeterLatency = elapsed / 1000.0;
+    m_phase = PhaseIdle;
+    return true;
+}
+
+double ControlLatencyTracker::powerDropThreshold() const { return m_powerDropThreshold; }
+
+void ControlLatencyTracker::setPowerDropThreshold(double powerDropThreshold)
+{
+    m_powerDropThreshold = qMax(0.0, powerDropThreshold);
+}
+
+int ControlLatencyTracker::meterTimeout() const { return m_meterTimeout; }
+
+void ControlLatencyTracker::setMeterTimeout(int meterTimeout)
+{
+    m_meterTimeout = qMax(0, meterTimeout);
+}
+
+bool ControlLatencyTracker::isAwaitingEvaluation() const { return m_phase == PhaseAwaitingActions; }
+
+double ControlLatencyTracker::lastActionLatency() const { return m_lastActionLatency; }
+
+double ControlLatencyTracker::lastMeterLatency() const { return m_lastMeterLatency; }
+
+QList<ControlLatencyStats> ControlLatencyTracker::statistics() const
+{
+    QList<ControlLatencyStats> statistics;
+    for (int source = 0; source < SourceCount; source++) {
+        statistics.append(ControlLatencyStats(sourceName(static_cast<Source>(source)),
+            m_actionLatency[source], m_meterLatency[source]));
+    }
+    return statistics;
+}
@@ -0,0 +1,167 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#ifndef CONTROLLATENCY_H
+#define CONTROLLATENCY_H
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QObject>
+
+#include <array>
+
+/*!
+ * \brief The LatencyHistogram class counts latencies in logarithmic buckets.
+ * \details Like an HDR histogram every power of two is split into a fixed number of linear sub
+ * buckets, which keeps the relative error of every percentile below 1/subBucketCount over the
+ * whole range from microseconds to minutes with constant memory and constant time recording.
+ */
+class LatencyHistogram {
+public:
+    static const int subBucketBits = 4;
+    static const int subBucketCount = 1 << subBucketBits;
+    static const int magnitudeCount = 28; // Up to 2^31 us, about 35 minutes
+
+    void record(qint64 microseconds);
+    void reset();
+
+    quint64 count() const;
+    qint64 min() const;
+    qint64 max() const;
+    double mean() const;
+    // Upper bound of the bucket holding the given percentile (0..100), in microseconds
+    qint64 percentile(double percentile) const;
+
+private:
+    std::array<quint32, magnitudeCount * subBucketCount> m_buckets = {};
+    quint64 m_count = 0;
+    qint64 m_min = 0;
+    qint64 m_max = 0;
+    double m_sum = 0;
+
+    static int bucketIndex(qint64 microseconds);
+    static qint64 bucketUpperBound(int index);
+};
+
+/*!
+ * \brief The ControlLatencyStats class summarizes the latencies of one limit source in
+ * milliseconds.
+ * \details The action latency is the time from receiving a consumption limit to executing an
+ * action for it, the meter latency the time until the root meter reported the resulting drop.
+ */
+class ControlLatencyStats {
+    Q_GADGET
+    Q_PROPERTY(QString source READ source)
+    Q_PROPERTY(uint actionCount READ actionCount)
+    Q_PROPERTY(double actionMin READ actionMin)
+    Q_PROPERTY(double actionMean READ actionMean)
+    Q_PROPERTY(double actionP50 READ actionP50)
+    Q_PROPERTY(double actionP90 READ actionP90)
+    Q_PROPERTY(double actionP99 READ actionP99)
+    Q_PROPERTY(double actionMax READ actionMax)
+    Q_PROPERTY(uint meterCount READ meterCount)
+    Q_PROPERTY(double meterMin READ meterMin)
+    Q_PROPERTY(double meterMean READ meterMean)
+    Q_PROPERTY(double meterP50 READ meterP50)
+    Q_PROPERTY(double meterP90 READ meterP90)
+    Q_PROPERTY(double meterP99 READ meterP99)
+    Q_PROPERTY(double meterMax READ meterMax)
+
+public:
+    ControlLatencyStats();
+    ControlLatencyStats(const QString& source, const LatencyHistogram& actionLatency,
+        const LatencyHistogram& meterLatency);
+
+    QString source() const;
+
+    uint actionCount() const;
+    double actionMin() const;
+    double actionMean() const;
+    double actionP50() const;
+    double actionP90() const;
+    double actionP99() const;
+    double actionMax() const;
+
+    uint meterCount() const;
+    double meterMin() const;
+    double meterMean() const;
+    double meterP50() const;
+    double meterP90() const;
+    double meterP99() const;
+    double meterMax() const;
+
+private:
+    QString m_source;
+    LatencyHistogram m_actionLatency;
+    LatencyHistogram m_meterLatency;
+};
+
+QDebug operator<<(QDebug debug, const ControlLatencyStats& controlLatencyStats);
+
+/*!
+ * \brief The ControlLatencyTracker class measures how fast a consumption limit takes effect.
+ * \details A limit signal starts a measurement on the monotonic clock. Every action executed by
+ * the following evaluation records its latency. If that evaluation executed any action, the
+ * measurement continues until the root meter reports a power at least powerDropThreshold below the
+ * power seen when the limit arrived, or gets dropped after the meter timeout.
+ *
+ * Evaluations are computed on snapshots by the optimizer thread, so the result of a snapshot
+ * published before the limit arrived can still come back after the signal. Only results of
+ * snapshots newer than the one published last at the signal belong to the measurement.
+ */
+class ControlLatencyTracker {
+public:
+    enum Source {
+        SourceIec61850Path1,
+        SourceIec61850Path2,
+        SourceIec61850Path3,
+        SourceIec61850Path4,
+        SourceOpcUa,
+        SourceCount
+    };
+
+    static QString sourceName(Source source);
+
+    // snapshotRevision is the revision of the snapshot published last, results up to it are
+    // ignored
+    void limitSignalled(Source source, double rootMeterPower, quint64 snapshotRevision);
+    void actionExecuted(quint64 snapshotRevision);
+    void evaluationFinished(int actions, quint64 snapshotRevision);
+    // Returns true if the power drop completed a measurement
+    bool rootMeterPowerChanged(double power);
+    // True while a signalled limit waits for the evaluation following it
+    bool isAwaitingEvaluation() const;
+
+    // Power drop in watts the root meter has to show before the meter latency gets recorded
+    double powerDropThreshold() const;
+    void setPowerDropThreshold(double powerDropThreshold);
+
+    int meterTimeout() const;
+    void setMeterTimeout(int meterTimeout);
+
+    // Latest completed latencies in milliseconds, -1 if none has been measured yet
+    double lastActionLatency() const;
+    double lastMeterLatency() const;
+
+    QList<ControlLatencyStats> statistics() const;
+
+private:
+    enum Phase { PhaseIdle, PhaseAwaitingActions, PhaseAwaitingPowerDrop };
+
+    Phase m_phase = PhaseIdle;
+    Source m_source = SourceIec61850Path1;
+    QElapsedTimer m_timer;
+    quint64 m_signalRevision = 0;
+    double m_powerAtSignal = 0;
+    double m_powerDropThreshold = 500;
+    int m_meterTimeout = 5 * 60 * 1000;
+    double m_lastActionLatency = -1;
+    double m_lastMeterLatency = -1;
+
+    std::array<LatencyHistogram, SourceCount> m_actionLatency;
+    std::array<LatencyHistogram, SourceCount> m_meterLatency;
+};
+
+#endif // CONTROLLATENCY_H
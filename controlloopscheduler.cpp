@@ -0,0 +1,85 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include "controlloopscheduler.h"
+#include "engineclock.h"
+
+ControlLoopScheduler::ControlLoopScheduler(QObject* parent)
+    : QObject(parent)
+{
+    m_timer.setSingleShot(true);
+    connect(&m_timer, &QTimer::timeout, this, &ControlLoopScheduler::run);
+    connect(EngineClock::instance(), &EngineClock::virtualTimeAdvanced, this,
+        &ControlLoopScheduler::onVirtualTimeAdvanced);
+}
+
+int ControlLoopScheduler::interval() const { return m_interval; }
+
+void ControlLoopScheduler::setInterval(int interval) { m_interval = qMax(0, interval); }
+
+bool ControlLoopScheduler::isDirty() const { return m_dirty; }
+
+quint64 ControlLoopScheduler::ticks() const { return m_ticks; }
+
+quint64 ControlLoopScheduler::coalescedTicks() const { return m_coalescedTicks; }
+
+quint64 ControlLoopScheduler::skippedTicks() const { return m_skippedTicks; }
+
+void ControlLoopScheduler::requestEvaluation()
+{
+    if (m_dirty) {
+        m_coalescedTicks++;
+        return;
+    }
+
+    m_dirty = true;
+
+    // Run at the end of the current interval, or with the next event loop pass if it already passed
+    qint64 remaining = 0;
+    if (m_lastEvaluation >= 0) {
+        remaining
+            = qMax<qint64>(0, m_interval - (EngineClock::monotonicTime() - m_lastEvaluation));
+    }
+
+    // The virtual time does not pass while waiting, onVirtualTimeAdvanced() runs the tick
+    if (remaining > 0 && EngineClock::isVirtual())
+        return;
+
+    m_timer.start(static_cast<int>(remaining));
+}
+
+void ControlLoopScheduler::requestImmediateEvaluation()
+{
+    if (m_timer.isActive()) {
+        m_timer.stop();
+        m_skippedTicks++;
+    }
+
+    m_dirty = true;
+    run();
+}
+
+void ControlLoopScheduler::run()
+{
+    if (!m_dirty)
+        return;
+
+    // Requests made during the evaluation schedule the next tick
+    m_dirty = false;
+    m_lastEvaluation = EngineClock::monotonicTime();
+    m_ticks++;
+    emit evaluate();
+}
+
+void ControlLoopScheduler::onVirtualTimeAdvanced(qint64 msecsSinceEpoch)
+{
+    Q_UNUSED(msecsSinceEpoch)
+    if (!m_dirty || m_timer.isActive())
+        return;
+
+    if (EngineClock::monotonicTime() - m_lastEvaluation >= m_interval) {
+        run();
+    }
+}
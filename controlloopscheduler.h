@@ -0,0 +1,62 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#ifndef CONTROLLOOPSCHEDULER_H
+#define CONTROLLOOPSCHEDULER_H
+
+#include <QObject>
+#include <QTimer>
+
+/*!
+ * \brief The ControlLoopScheduler class rate limits the evaluations of the energy engine.
+ * \details Meter, limit and configuration changes only mark the control loop dirty. At most one
+ * evaluation runs per interval; requests arriving while an evaluation is pending are coalesced
+ * into it. Safety critical changes, like a dropping consumption limit, bypass the interval and get
+ * evaluated right away, which also takes care of any pending tick. The interval is measured with
+ * the EngineClock, under a virtual time a pending tick runs once the virtual time reached it.
+ */
+class ControlLoopScheduler : public QObject {
+    Q_OBJECT
+public:
+    explicit ControlLoopScheduler(QObject* parent = nullptr);
+
+    // Minimum time in milliseconds between two regular evaluations
+    int interval() const;
+    void setInterval(int interval);
+
+    bool isDirty() const;
+
+    // Number of evaluations that have been run
+    quint64 ticks() const;
+    // Requests merged into an already pending evaluation
+    quint64 coalescedTicks() const;
+    // Pending evaluations dropped because an immediate evaluation got there first
+    quint64 skippedTicks() const;
+
+public slots:
+    // Evaluates at the next tick, at the latest one interval after the last evaluation
+    void requestEvaluation();
+    // Evaluates right away, for changes that must not wait for the next tick
+    void requestImmediateEvaluation();
+
+signals:
+    void evaluate();
+
+private:
+    int m_interval = 1000;
+    QTimer m_timer;
+    // EngineClock::monotonicTime() of the last evaluation, -1 before the first one
+    qint64 m_lastEvaluation = -1;
+    bool m_dirty = false;
+
+    quint64 m_ticks = 0;
+    quint64 m_coalescedTicks = 0;
+    quint64 m_skippedTicks = 0;
+
+    void run();
+    void onVirtualTimeAdvanced(qint64 msecsSinceEpoch);
+};
+
+#endif // CONTROLLOOPSCHEDULER_H
@@ -0,0 +1,149 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include "decisiontrace.h"
+
+ControlDecision::ControlDecision() { }
+
+qlonglong ControlDecision::timestamp() const { return m_timestamp; }
+
+uint ControlDecision::tick() const { return m_tick; }
+
+double ControlDecision::phasePowerA() const { return m_phasePower[0]; }
+
+double ControlDecision::phasePowerB() const { return m_phasePower[1]; }
+
+double ControlDecision::phasePowerC() const { return m_phasePower[2]; }
+
+double ControlDecision::consumptionLimit() const { return m_consumptionLimit; }
+
+bool ControlDecision::householdLimitExceeded() const { return m_householdLimitExceeded; }
+
+double ControlDecision::marginPower() const { return m_marginPower; }
+
+double ControlDecision::overshotPower() const { return m_overshotPower; }
+
+QString ControlDecision::plimStatus() const { return m_plimStatus; }
+
+uint ControlDecision::chargingCurrentActions() const { return m_chargingCurrentActions; }
+
+uint ControlDecision::heatPumpActions() const { return m_heatPumpActions; }
+
+uint ControlDecision::heatingRodActions() const { return m_heatingRodActions; }
+
+double ControlDecision::allocatedPower() const { return m_allocatedPower; }
+
+QVariantList ControlDecision::actions() const { return m_actions; }
+
+QDebug operator<<(QDebug debug, const ControlDecision& controlDecision)
+{
+    debug.nospace() << "ControlDecision(";
+    debug.nospace() << "tick: " << controlDecision.tick() << ", ";
+    debug.nospace() << "timestamp: " << controlDecision.timestamp() << ", ";
+    debug.nospace() << "plimStatus: " << controlDecision.plimStatus() << ", ";
+    debug.nospace() << "marginPower: " << controlDecision.marginPower() << ", ";
+    debug.nospace() << "overshotPower: " << controlDecision.overshotPower() << ", ";
+    debug.nospace() << "actions: " << controlDecision.actions().count();
+    debug.nospace() << ")";
+    return debug.maybeSpace();
+}
+
+DecisionTrace::DecisionTrace(int capacity)
+    : m_records(qMax(1, capacity))
+{
+}
+
+void DecisionTrace::Record::addAction(const QUuid& thingId, ActionKind kind, float value)
+{
+    if (actionCount >= maxActions)
+        return;
+
+    Action& action = actions[actionCount++];
+    action.thingId = thingId;
+    action.kind = kind;
+    action.value = value;
+}
+
+int DecisionTrace::capacity() const { return m_records.count(); }
+
+int DecisionTrace::count() const { return m_count; }
+
+void DecisionTrace::append(const Record& record)
+{
+    m_records[m_next] = record;
+    m_next = (m_next + 1) % m_records.count();
+    if (m_count < m_records.count()) {
+        m_count++;
+    }
+}
+
+QList<ControlDecision> DecisionTrace::decisions(int limit) const
+{
+    int count = limit > 0 ? qMin(limit, m_count) : m_count;
+    int capacity = m_records.count();
+
+    QList<ControlDecision> decisions;
+    decisions.reserve(count);
+    for (int i = count; i > 0; i--) {
+        const Record& record = m_records.at((m_next - i + capacity) % capacity);
+
+        ControlDecision decision;
+        decision.m_timestamp = record.timestamp;
+        decision.m_tick = record.tick;
+        for (int phase = 0; phase < 3; phase++) {
+            decision.m_phasePower[phase] = record.phasePower[phase];
+        }
+        decision.m_consumptionLimit = record.consumptionLimit;
+        decision.m_householdLimitExceeded = record.householdLimitExceeded;
+        decision.m_marginPower = record.marginPower;
+        decision.m_overshotPower = record.overshotPower;
+        decision.m_chargingCurrentActions = record.chargingCurrentActions;
+        decision.m_heatPumpActions = record.heatPumpActions;
+        decision.m_heatingRodActions = record.heatingRodActions;
+        decision.m_allocatedPower = record.allocatedPower;
+
+        switch (record.plimStatus) {
+        case PlimStatusUnrestricted:
+            decision.m_plimStatus = QStringLiteral("unrestricted");
+            break;
+        case PlimStatusLimited:
+            decision.m_plimStatus = QStringLiteral("limited");
+            break;
+        case PlimStatusShutoff:
+            decision.m_plimStatus = QStringLiteral("shutoff");
+            break;
+        case PlimStatusUnknown:
+            break;
+        }
+
+        for (int i = 0; i < record.actionCount; i++) {
+            const Action& action = record.actions[i];
+            QVariantMap actionMap;
+            actionMap.insert("thingId", action.thingId.toString());
+            switch (action.kind) {
+            case ActionChargingCurrent:
+                actionMap.insert("action", QStringLiteral("chargingCurrent"));
+                actionMap.insert("value", action.value);
+                break;
+            case ActionHeatPumpOff:
+            case ActionHeatPumpStandard:
+                actionMap.insert("action", QStringLiteral("heatPump"));
+                actionMap.insert("value",
+                    action.kind == ActionHeatPumpOff ? QStringLiteral("Off")
+                                                     : QStringLiteral("Standard"));
+                break;
+            case ActionHeatingRodOff:
+                actionMap.insert("action", QStringLiteral("heatingRod"));
+                actionMap.insert("value", false);
+                break;
+            }
+            decision.m_actions.append(actionMap);
+        }
+
+        decisions.append(decision);
+    }
+
+    return decisions;
+}
@@ -0,0 +1,148 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#ifndef DECISIONTRACE_H
+#define DECISIONTRACE_H
+
+#include <QDebug>
+#include <QObject>
+#include <QUuid>
+#include <QVariantList>
+#include <QVector>
+
+/*!
+ * \brief The ControlDecision class is the readable form of one DecisionTrace record.
+ */
+class ControlDecision {
+    Q_GADGET
+    Q_PROPERTY(qlonglong timestamp READ timestamp)
+    Q_PROPERTY(uint tick READ tick)
+    Q_PROPERTY(double phasePowerA READ phasePowerA)
+    Q_PROPERTY(double phasePowerB READ phasePowerB)
+    Q_PROPERTY(double phasePowerC READ phasePowerC)
+    Q_PROPERTY(double consumptionLimit READ consumptionLimit)
+    Q_PROPERTY(bool householdLimitExceeded READ householdLimitExceeded)
+    Q_PROPERTY(double marginPower READ marginPower)
+    Q_PROPERTY(double overshotPower READ overshotPower)
+    Q_PROPERTY(QString plimStatus READ plimStatus)
+    Q_PROPERTY(uint chargingCurrentActions READ chargingCurrentActions)
+    Q_PROPERTY(uint heatPumpActions READ heatPumpActions)
+    Q_PROPERTY(uint heatingRodActions READ heatingRodActions)
+    Q_PROPERTY(double allocatedPower READ allocatedPower)
+    Q_PROPERTY(QVariantList actions READ actions)
+
+public:
+    ControlDecision();
+
+    // Milliseconds since epoch
+    qlonglong timestamp() const;
+    uint tick() const;
+    double phasePowerA() const;
+    double phasePowerB() const;
+    double phasePowerC() const;
+    double consumptionLimit() const;
+    bool householdLimitExceeded() const;
+    double marginPower() const;
+    double overshotPower() const;
+    QString plimStatus() const;
+    uint chargingCurrentActions() const;
+    uint heatPumpActions() const;
+    uint heatingRodActions() const;
+    // Power in W granted to the CLS units while a limit is active
+    double allocatedPower() const;
+    // The executed actions as maps of thingId, action and value, at most DecisionTrace::maxActions
+    QVariantList actions() const;
+
+private:
+    friend class DecisionTrace;
+
+    qlonglong m_timestamp = 0;
+    uint m_tick = 0;
+    double m_phasePower[3] = { 0, 0, 0 };
+    double m_consumptionLimit = -1;
+    bool m_householdLimitExceeded = false;
+    double m_marginPower = 0;
+    double m_overshotPower = 0;
+    QString m_plimStatus;
+    uint m_chargingCurrentActions = 0;
+    uint m_heatPumpActions = 0;
+    uint m_heatingRodActions = 0;
+    double m_allocatedPower = 0;
+    QVariantList m_actions;
+};
+
+QDebug operator<<(QDebug debug, const ControlDecision& controlDecision);
+
+/*!
+ * \brief The DecisionTrace class records every control loop decision in a fixed-size ring.
+ * \details Records are plain structs written into preallocated memory, recording one costs a
+ * copy of a few hundred bytes and no formatting. Besides the counters every record keeps the first
+ * maxActions actions it executed. The oldest record gets overwritten once the ring is
+ * full. Records are only converted into ControlDecisions when the trace is read out, so the trace
+ * can stay enabled all the time instead of the debug output.
+ */
+class DecisionTrace {
+public:
+    enum PlimStatus : quint8 {
+        PlimStatusUnknown = 0,
+        PlimStatusUnrestricted = 1,
+        PlimStatusLimited = 2,
+        PlimStatusShutoff = 3
+    };
+
+    enum ActionKind : quint8 {
+        ActionChargingCurrent = 0,
+        ActionHeatPumpOff = 1,
+        ActionHeatPumpStandard = 2,
+        ActionHeatingRodOff = 3
+    };
+
+    // One executed action, the value is the charging current in A
+    struct Action {
+        QUuid thingId;
+        float value = 0;
+        ActionKind kind = ActionChargingCurrent;
+    };
+
+    // Actions recorded per decision, the counters of a record count all of them
+    static const int maxActions = 8;
+
+    struct Record {
+        qint64 timestamp = 0;
+        float phasePower[3] = { 0, 0, 0 };
+        float consumptionLimit = -1;
+        float marginPower = 0;
+        float overshotPower = 0;
+        float allocatedPower = 0;
+        quint32 tick = 0;
+        quint16 chargingCurrentActions = 0;
+        quint16 heatPumpActions = 0;
+        quint16 heatingRodActions = 0;
+        bool householdLimitExceeded = false;
+        PlimStatus plimStatus = PlimStatusUnknown;
+        quint8 actionCount = 0;
+        Action actions[maxActions];
+
+        // Drops the action once maxActions are recorded
+        void addAction(const QUuid& thingId, ActionKind kind, float value = 0);
+    };
+
+    explicit DecisionTrace(int capacity = 4096);
+
+    int capacity() const;
+    int count() const;
+
+    void append(const Record& record);
+
+    // The latest records, oldest first. A limit of 0 returns all records.
+    QList<ControlDecision> decisions(int limit = 0) const;
+
+private:
+    QVector<Record> m_records;
+    int m_next = 0;
+    int m_count = 0;
+};
+
+#endif // DECISIONTRACE_H
@@ -4,9 +4,20 @@
  */
 
 #include "energyengine.h"
+#include "chargingsessionhistory.h"
+#include "controllatency.h"
+#include "controlloopscheduler.h"
+#include "decisiontrace.h"
+#include "enginecapture.h"
+#include "engineclock.h"
 #include "nymeasettings.h"
+#include "optimizerworker.h"
+#include "sessionjournal.h"
+#include "setpointactuator.h"
+#include "settingsstore.h"
 #include <integrations/integrationplugin.h>
 
+#include <QElapsedTimer>
 #include <QJsonDocument>
 #include <QNetworkReply>
 // Include qdbus
@@ -15,13 +26,115 @@
 
 Q_DECLARE_LOGGING_CATEGORY(dcConsolinnoEnergy)
 
+static const char* const phaseNames[EnergyEngine::phaseCount] = { "A", "B", "C" };
+
+// Snapshots kept for reuse, a few cover an optimizer that is one or two evaluations behind
+static const int snapshotPoolSize = 4;
+
+// Without a limit only the ev chargers in the snapshot and the heat pumps matter to the optimizer
+static bool hasSameUnits(const EngineSnapshot& snapshot, const EngineSnapshot& other)
+{
+    if (snapshot.evChargers.size() != other.evChargers.size()
+        || snapshot.heatPumps.size() != other.heatPumps.size())
+        return false;
+
+    for (int i = 0; i < snapshot.heatPumps.size(); i++) {
+        const EngineSnapshot::HeatPump& heatPump = snapshot.heatPumps.at(i);
+        const EngineSnapshot::HeatPump& otherHeatPump = other.heatPumps.at(i);
+        if (heatPump.thingId != otherHeatPump.thingId
+            || heatPump.sgReadyMode != otherHeatPump.sgReadyMode)
+            return false;
+    }
+    return true;
+}
+
 EnergyEngine::EnergyEngine(
     ThingManager* thingManager, EnergyManager* energyManager, QObject* parent)
     : QObject(parent)
     , m_thingManager(thingManager)
     , m_energyManager(energyManager)
+    // All configurations are kept in memory, changes get written back to disk in one go
+    , m_settings(new SettingsStore(NymeaSettings::settingsPath() + "/consolinno.conf", this))
+    , m_userConfigurationStore(m_settings, "UserConfigurations", "userConfigID")
+    , m_heatingConfigurationStore(m_settings, "HeatingConfigurations", "heatPumpThingId")
+    , m_heatingRodConfigurationStore(m_settings, "HeatingRodConfigurations", "heatingRodThingId")
+    , m_dynamicElectricPricingConfigurationStore(
+          m_settings, "DynamicElectricPricingConfigurations", "dynamicElectricPricingThingId")
+    , m_washingMachineConfigurationStore(
+          m_settings, "WashingMachineConfigurations", "washingMachineThingId")
+    , m_chargingConfigurationStore(m_settings, "ChargingConfigurations", "evChargerThingId")
+    , m_chargingOptimizationConfigurationStore(
+          m_settings, "ChargingOptimizationConfigurations", "evChargerThingId")
+    , m_batteryConfigurationStore(m_settings, "BatteryConfigurations", "batteryThingId")
+    , m_pvConfigurationStore(m_settings, "PvConfigurations", "pvThingId")
+    , m_chargingSessionConfigurationStore(
+          m_settings, "ChargingSessionConfigurations", "evChargerThingId")
 {
     qCDebug(dcConsolinnoEnergy()) << "======> Initializing consolinno energy engine...";
+    QElapsedTimer startupTimer;
+    startupTimer.start();
+
+    m_settings->setFlushInterval(m_settings->value("Settings/flushInterval", 5000).toInt());
+    initSessionJournal();
+
+    m_chargingSessionHistory = new ChargingSessionHistory(
+        NymeaSettings::settingsPath() + "/consolinno-sessions.history",
+        m_settings->value("Settings/sessionHistoryCapacity", 8192).toUInt(), this);
+    m_chargingSessionHistory->setRetentionDays(
+        m_settings->value("Settings/sessionHistoryRetentionDays", 365).toInt());
+
+    // Connected before the control loop, a limit expiring under a virtual time is gone for a tick
+    // due at the same time
+    connect(EngineClock::instance(), &EngineClock::virtualTimeAdvanced, this,
+        &EnergyEngine::onVirtualTimeAdvanced);
+
+    // Meter samples, limits and configuration changes only request an evaluation, the control
+    // loop runs at most once per interval
+    m_controlLoop = new ControlLoopScheduler(this);
+    m_controlLoop->setInterval(m_settings->value("Settings/controlLoopInterval", 1000).toInt());
+    connect(m_controlLoop, &ControlLoopScheduler::evaluate, this,
+        &EnergyEngine::evaluateAndSetMaxChargingCurrent);
+
+    m_decisionTrace
+        = DecisionTrace(m_settings->value("Settings/decisionTraceCapacity", 4096).toInt());
+
+    m_controlLatency.setPowerDropThreshold(
+        m_settings->value("Settings/latencyPowerDropThreshold", 500).toDouble());
+    m_controlLatency.setMeterTimeout(
+        m_settings->value("Settings/latencyMeterTimeout", 300000).toInt());
+
+    initCapture();
+
+    m_setpointActuator = new SetpointActuator(m_thingManager, this);
+    m_setpointActuator->setRefreshInterval(
+        m_settings->value("Settings/actuationRefreshInterval", 60000).toInt());
+    m_setpointActuator->setConfirmTimeout(
+        m_settings->value("Settings/actuationConfirmTimeout", 15000).toInt());
+
+    // The allocations get computed off the main thread on immutable snapshots, only the resulting
+    // actions come back to be executed here
+    m_optimizer = new OptimizerWorker();
+    HeatPumpSwitchParameters heatPumpSwitchParameters;
+    heatPumpSwitchParameters.hysteresis
+        = m_settings->value("Settings/heatPumpHysteresis", 500).toDouble();
+    heatPumpSwitchParameters.minOnTime
+        = m_settings->value("Settings/heatPumpMinOnTime", 5 * 60 * 1000).toLongLong();
+    heatPumpSwitchParameters.minOffTime
+        = m_settings->value("Settings/heatPumpMinOffTime", 20 * 60 * 1000).toLongLong();
+    m_optimizer->setHeatPumpSwitchParameters(heatPumpSwitchParameters);
+    PidAutoTuneParameters autoTuneParameters;
+    autoTuneParameters.baselineTime
+        = m_settings->value("Settings/autoTuneBaselineTime", 30 * 1000).toLongLong();
+    autoTuneParameters.stepTime
+        = m_settings->value("Settings/autoTuneStepTime", 120 * 1000).toLongLong();
+    m_optimizer->setAutoTuneParameters(autoTuneParameters);
+    m_heatPumpTransitions = HeatPumpTransitionLog(
+        m_settings->value("Settings/heatPumpTransitionCapacity", 1024).toInt());
+    m_optimizer->moveToThread(&m_optimizerThread);
+    connect(&m_optimizerThread, &QThread::finished, m_optimizer, &QObject::deleteLater);
+    connect(m_optimizer, &OptimizerWorker::computed, this, &EnergyEngine::applyOptimizerResult);
+    m_optimizerThread.setObjectName("ConsolinnoOptimizer");
+    m_optimizerThread.start();
 
     // Energy engine
     connect(
@@ -32,15 +145,21 @@ EnergyEngine::EnergyEngine(
     addGridSupportThingIfNotExists();
 
     // Thing manager
-    foreach (Thing* thing, m_thingManager->configuredThings()) {
+    // Attach all configured things in one pass and evaluate the use cases once at the end instead
+    // of after every single thing.
+    m_bulkLoading = true;
+    Things configuredThings = m_thingManager->configuredThings();
+    foreach (Thing* thing, configuredThings) {
         onThingAdded(thing);
     }
+    m_bulkLoading = false;
+    evaluateAvailableUseCases();
 
     connect(thingManager, &ThingManager::thingAdded, this, &EnergyEngine::onThingAdded);
     connect(thingManager, &ThingManager::thingRemoved, this, &EnergyEngine::onThingRemoved);
 
     // Load configurations
-    QSettings settings(NymeaSettings::settingsPath() + "/consolinno.conf", QSettings::IniFormat);
+    ConsolinnoSettings settings(m_settings);
 
     // Load UserConfig
     monitorUserConfig();
@@ -55,15 +174,46 @@ EnergyEngine::EnergyEngine(
     m_hybridSimulationMap = settings.value("mappings").toMap();
     settings.endGroup();
 
+    m_housholdPhasePowerLimit = 230.0 * m_housholdPhaseLimit;
     m_housholdPowerLimit = m_housholdPhaseLimit * m_housholdPhaseCount * 230;
     qCDebug(dcConsolinnoEnergy()) << "Houshold phase limit" << m_housholdPhaseLimit << "[A] using"
                                   << m_housholdPhaseCount << "phases: max power"
                                   << m_housholdPowerLimit << "[W]";
 
+    // All limit sources feed the arbiter, the control loop only reads the effective limit
+    m_limitArbiter.setPolicy(ConsumptionLimitArbiter::policyFromString(
+        m_settings->value("Settings/limitPolicy", "strictest").toString(),
+        ConsumptionLimitArbiter::PolicyStrictest));
+    // Source names as in the latency statistics, e.g. "opcua" or "iec61850/1"
+    QList<ControlLatencyTracker::Source> priorities;
+    foreach (const QString& name, m_settings->value("Settings/limitPriorities").toStringList()) {
+        for (int i = 0; i < ControlLatencyTracker::SourceCount; i++) {
+            ControlLatencyTracker::Source source = static_cast<ControlLatencyTracker::Source>(i);
+            if (ControlLatencyTracker::sourceName(source) == name) {
+                priorities.append(source);
+            }
+        }
+    }
+    if (!priorities.isEmpty()) {
+        m_limitArbiter.setPriorities(priorities);
+    }
+    qint64 limitValidity = m_settings->value("Settings/limitValidity", 0).toLongLong();
+    for (int source = 0; source < ControlLatencyTracker::SourceCount; source++) {
+        m_limitArbiter.setValidity(
+            static_cast<ControlLatencyTracker::Source>(source), limitValidity);
+    }
+    m_limitExpiryTimer.setSingleShot(true);
+    connect(&m_limitExpiryTimer, &QTimer::timeout, this, &EnergyEngine::onConsumptionLimitExpired);
+    qCDebug(dcConsolinnoEnergy()) << "Consumption limit policy"
+                                  << ConsumptionLimitArbiter::policyName(m_limitArbiter.policy());
+
+    captureConfigurations();
     initDBUS();
 
     qCDebug(dcConsolinnoEnergy()) << "======> Consolinno energy engine initialized"
                                   << m_availableUseCases;
+    qCInfo(dcConsolinnoEnergy()) << "Energy engine startup took" << startupTimer.elapsed()
+                                 << "ms for" << configuredThings.count() << "configured things";
 
     if (m_hybridSimulationEnabled) {
         qCInfo(dcConsolinnoEnergy()) << "======> Hybrid simulation enabled";
@@ -74,115 +224,130 @@ EnergyEngine::EnergyEngine(
     }
 }
 
-void EnergyEngine::initDBUS()
+EnergyEngine::~EnergyEngine()
 {
-    std::string sDbusService = "de.consolinno.fnnstb.iec61850";
-    std::string sDbusPath1 = "/de/consolinno/fnnstb/iec61850/cls/actpow_ggio001/1";
-    std::string sDbusPath2 = "/de/consolinno/fnnstb/iec61850/cls/actpow_ggio001/2";
-    std::string sDbusPath3 = "/de/consolinno/fnnstb/iec61850/cls/actpow_ggio001/3";
-    std::string sDbusPath4 = "/de/consolinno/fnnstb/iec61850/cls/actpow_ggio001/4";
-    std::string sDbusInterface = "de.consolinno.fnnstb.iec61850.cls.actpow_ggio001";
-
-    std::string sDbusOPCService = "de.consolinno.fnnstb.opcua";
-    std::string sDbusOPCPath = "/de/consolinno/fnnstb/opcua/cls/actpow_ggio001/1";
-    std::string sDbusOPCInterface = "de.consolinno.fnnstb.opcua.cls.actpow_ggio001";
-
-    // Load current p-lim for consumption limit from iec server / only on hems with integrated iec
-    // server
-    QDBusInterface iface(sDbusService.c_str(), sDbusPath1.c_str(), sDbusInterface.c_str(),
-        QDBusConnection::systemBus());
-    // Get DBUS Property anout in format (xtixx) / struct, with first x as float value of current
-    // consumption limit
-    QVariant reply = iface.property("AnOut_mxVal_f");
-    if (reply.isValid()) {
-        // Got power limit from dbus
-        qCDebug(dcConsolinnoEnergy()) << "Reply: " << reply.toFloat();
-        m_consumptionLimit = reply.toFloat();
-    } else {
-        qCWarning(dcConsolinnoEnergy()) << "Error getting consumption limit from dbus";
-    }
-
-    qCDebug(dcConsolinnoEnergy()) << "DBUS Signal Handler implementation";
+    // Results still queued for this object get dropped along with it
+    m_optimizerThread.quit();
+    m_optimizerThread.wait();
+}
 
-    // Add signal handler for consumption limit with same name as property on iface
-    qCDebug(dcConsolinnoEnergy()) << "Signal subscribe: " << "sDbusService" << sDbusService.c_str()
-                                  << "; " << "sDbusPath1" << sDbusPath1.c_str() << "; "
-                                  << "sDbusInterface" << sDbusInterface.c_str() << "AnOut_mxVal_f";
+/*!
+ * \brief EnergyEngine::initCapture
+ * \details If Settings/captureFile is set, all inputs of the control loop get recorded into that
+ * file: root meter samples, consumption limits signalled or read from their sources, pluggedIn
+ * changes and the configurations the control loop depends on. The configurations in effect are
+ * recorded first, once the things have been attached. The capture can be replayed offline with
+ * tests/enginereplay.
+ */
+void EnergyEngine::initCapture()
+{
+    QString captureFile = m_settings->value("Settings/captureFile").toString();
+    if (captureFile.isEmpty())
+        return;
 
-    // QDBusConnection::systemBus().connect(sDbusService.c_str(), sDbusPath1.c_str(),
-    //     sDbusInterface.c_str(), "AnOut_mxVal_f", this, &EnergyEngine::onConsumptionLimitChanged);
+    m_capture = new EngineCaptureWriter(captureFile,
+        m_settings->value("Settings/captureMaxSize", 64 * 1024 * 1024).toLongLong(), this);
 
-    // QDBusConnection::systemBus().connect(sDbusService.c_str(), sDbusPath1.c_str(),
-    //     sDbusInterface.c_str(), "AnOut_mxVal_f", this,
-    //     SLOT(onConsumptionLimitChanged(qlonglong)));
+    connect(this, &EnergyEngine::housholdPhaseLimitChanged, m_capture, [this](uint limit) {
+        QVariantMap configuration;
+        configuration.insert("housholdPhaseLimit", limit);
+        m_capture->recordConfiguration("HousholdPhaseLimit", configuration);
+    });
+    connect(this, &EnergyEngine::chargingConfigurationChanged, m_capture,
+        [this](const ChargingConfiguration& configuration) {
+            m_capture->recordConfiguration(configuration);
+        });
+    connect(this, &EnergyEngine::chargingOptimizationConfigurationChanged, m_capture,
+        [this](const ChargingOptimizationConfiguration& configuration) {
+            m_capture->recordConfiguration(configuration);
+        });
+    connect(this, &EnergyEngine::heatingConfigurationChanged, m_capture,
+        [this](const HeatingConfiguration& configuration) {
+            m_capture->recordConfiguration(configuration);
+        });
+}
+
+// A replay starts with the configurations in effect when the capture started
+void EnergyEngine::captureConfigurations()
+{
+    if (!m_capture)
+        return;
 
-    if (!QDBusConnection::systemBus().connect(sDbusService.c_str(), sDbusPath1.c_str(),
-            sDbusInterface.c_str(), "AnOut_mxVal_f", this,
-            SLOT(onConsumptionLimitChanged(qlonglong)))) {
-        qCWarning(dcConsolinnoEnergy())
-            << "Error subscribing to consumption limit signal from iec server actpow_ggio001/1";
-    } else {
-        qCDebug(dcConsolinnoEnergy()) << "Subscribed to consumption limit signal actpow_ggio001/1";
+    QVariantMap housholdPhaseLimit;
+    housholdPhaseLimit.insert("housholdPhaseLimit", m_housholdPhaseLimit);
+    m_capture->recordConfiguration("HousholdPhaseLimit", housholdPhaseLimit);
+    foreach (const ChargingConfiguration& configuration, m_chargingConfigurations) {
+        m_capture->recordConfiguration(configuration);
     }
-
-    if (!QDBusConnection::systemBus().connect(sDbusService.c_str(), sDbusPath2.c_str(),
-            sDbusInterface.c_str(), "AnOut_mxVal_f", this,
-            SLOT(onConsumptionLimitChanged(qlonglong)))) {
-        qCWarning(dcConsolinnoEnergy())
-            << "Error subscribing to consumption limit signal from iec server actpow_ggio001/2";
-    } else {
-        qCDebug(dcConsolinnoEnergy()) << "Subscribed to consumption limit signal actpow_ggio001/2";
+    foreach (const ChargingOptimizationConfiguration& configuration,
+        m_chargingOptimizationConfigurations) {
+        m_capture->recordConfiguration(configuration);
     }
-
-    if (!QDBusConnection::systemBus().connect(sDbusService.c_str(), sDbusPath3.c_str(),
-            sDbusInterface.c_str(), "AnOut_mxVal_f", this,
-            SLOT(onConsumptionLimitChanged(qlonglong)))) {
-        qCWarning(dcConsolinnoEnergy())
-            << "Error subscribing to consumption limit signal from iec server actpow_ggio001/3";
-    } else {
-        qCDebug(dcConsolinnoEnergy()) << "Subscribed to consumption limit signal actpow_ggio001/3";
+    foreach (const HeatingConfiguration& configuration, m_heatingConfigurations) {
+        m_capture->recordConfiguration(configuration);
     }
+}
 
-    if (!QDBusConnection::systemBus().connect(sDbusService.c_str(), sDbusPath4.c_str(),
-            sDbusInterface.c_str(), "AnOut_mxVal_f", this,
-            SLOT(onConsumptionLimitChanged(qlonglong)))) {
-        qCWarning(dcConsolinnoEnergy())
-            << "Error subscribing to consumption limit signal from iec server actpow_ggio001/4";
-    } else {
-        qCDebug(dcConsolinnoEnergy()) << "Subscribed to consumption limit signal actpow_ggio001/4";
-    }
-
-    // Load current p-lim for consumption limit from opc-ua client / only on hems with integrated
-    // opc-ua client
-    QDBusInterface ifaceOPC(sDbusOPCService.c_str(), sDbusOPCPath.c_str(),
-        sDbusOPCInterface.c_str(), QDBusConnection::systemBus());
-    // Get DBUS Property anout in format (xtixx) / struct, with first x as float value of current
-    // consumption limit
-    QVariant replyOPC = ifaceOPC.property("AnOut_mxVal_f");
-    if (replyOPC.isValid()) {
-        // Got power limit from dbus
-        qCDebug(dcConsolinnoEnergy()) << "Reply: " << replyOPC.toFloat();
-        m_consumptionLimit = replyOPC.toFloat();
-    } else {
-        qCWarning(dcConsolinnoEnergy())
-            << "Error getting consumption limit from dbus over opc-ua client";
+/*!
+ * \brief EnergyEngine::initSessionJournal
+ * \details Charging session updates are appended to a journal instead of rewriting
+ * consolinno.conf. Records left over from the last run are replayed into the settings store before
+ * any configuration gets loaded. Every time the store has been written the journal is obsolete and
+ * gets dropped.
+ */
+void EnergyEngine::initSessionJournal()
+{
+    m_sessionJournal
+        = new SessionJournal(NymeaSettings::settingsPath() + "/consolinno-sessions.journal", this);
+    m_sessionJournal->setCompactionThreshold(
+        m_settings->value("Settings/journalCompactionThreshold", 64 * 1024).toLongLong());
+    m_sessionJournal->setCompactionInterval(
+        m_settings->value("Settings/journalCompactionInterval", 10 * 60 * 1000).toInt());
+
+    QList<SessionJournalEntry> entries = m_sessionJournal->replay();
+    foreach (const SessionJournalEntry& entry, entries) {
+        if (entry.removed) {
+            m_chargingSessionConfigurationStore.remove(entry.evChargerThingId);
+        } else {
+            m_chargingSessionConfigurationStore.setValue(entry.configuration, true);
+        }
     }
 
-    // Add signal handler for consumption limit with same name as property on iface for opc-ua
-    // client
-    qCDebug(dcConsolinnoEnergy()) << "Signal subscribe: " << "sDbusOPCService"
-                                  << sDbusOPCService.c_str() << "; " << "sDbusOPCPath"
-                                  << sDbusOPCPath.c_str() << "; " << "sDbusOPCInterface"
-                                  << sDbusOPCInterface.c_str() << "AnOut_mxVal_f";
+    connect(m_settings, &SettingsStore::flushed, m_sessionJournal, &SessionJournal::clear);
+    // Writing the whole store takes long on slow flash, the journal keeps the records until then
+    connect(m_sessionJournal, &SessionJournal::compactionRequested, m_settings,
+        &SettingsStore::flushInBackground);
 
-    if (!QDBusConnection::systemBus().connect("", sDbusOPCPath.c_str(), sDbusOPCInterface.c_str(),
-            "AnOut_mxVal_f", this, SLOT(onConsumptionLimitChangedOPC(qlonglong)))) {
-        qCWarning(dcConsolinnoEnergy())
-            << "Error subscribing to consumption limit signal from opc-ua client";
-    } else {
-        qCDebug(dcConsolinnoEnergy())
-            << "Subscribed to consumption limit signal from opc-ua client";
+    // Compact right away, the replayed records are now part of the store
+    if (!entries.isEmpty()) {
+        m_settings->flush();
+    }
+}
+
+void EnergyEngine::initDBUS()
+{
+    // Nothing blocks here: the initial limits arrive asynchronously, and sources showing up on the
+    // bus later get subscribed and read once they are there
+    QDBusConnection connection = QDBusConnection::systemBus();
+
+    // A private dbus-daemon with stand-in limit services replaces the system bus on test setups
+    QString busAddress = m_settings->value("Settings/limitSourceBusAddress").toString();
+    if (!busAddress.isEmpty()) {
+        connection = QDBusConnection::connectToBus(busAddress, "ConsolinnoLimitSources");
+        if (!connection.isConnected()) {
+            qCWarning(dcConsolinnoEnergy()) << "Could not connect to the limit source bus"
+                                            << busAddress << connection.lastError().message();
+        } else {
+            qCInfo(dcConsolinnoEnergy()) << "Receiving consumption limits on" << busAddress;
+        }
     }
+
+    m_limitSources = new LimitSourceManager(connection, this);
+    connect(m_limitSources, &LimitSourceManager::consumptionLimitChanged, this,
+        &EnergyEngine::onConsumptionLimitChanged);
+    connect(m_limitSources, &LimitSourceManager::consumptionLimitFetched, this,
+        &EnergyEngine::onConsumptionLimitFetched);
+    m_limitSources->start();
 }
 
 void EnergyEngine::addGridSupportThingIfNotExists()
@@ -223,19 +388,28 @@ EnergyEngine::HemsError EnergyEngine::setHousholdPhaseLimit(uint housholdPhaseLi
     if (housholdPhaseLimit == 0)
         return HemsErrorInvalidPhaseLimit;
 
+    // A lower fuse limit has to be enforced right away
+    bool limitDropped = housholdPhaseLimit < m_housholdPhaseLimit;
     m_housholdPhaseLimit = housholdPhaseLimit;
     emit housholdPhaseLimitChanged(m_housholdPhaseLimit);
 
+    m_housholdPhasePowerLimit = 230.0 * m_housholdPhaseLimit;
     m_housholdPowerLimit = m_housholdPhaseLimit * m_housholdPhaseCount * 230;
     qCDebug(dcConsolinnoEnergy()) << "Houshold phase limit changed to" << m_housholdPhaseLimit
                                   << "[A] using" << m_housholdPhaseCount << "phases: max power"
                                   << m_housholdPowerLimit << "[W]";
 
-    QSettings settings(NymeaSettings::settingsPath() + "/consolinno.conf", QSettings::IniFormat);
+    ConsolinnoSettings settings(m_settings);
     settings.beginGroup("BlackoutProtection");
     settings.setValue("housholdPhaseLimit", m_housholdPhaseLimit);
     settings.endGroup();
 
+    if (limitDropped) {
+        m_controlLoop->requestImmediateEvaluation();
+    } else {
+        m_controlLoop->requestEvaluation();
+    }
+
     return HemsErrorNoError;
 }
 
@@ -294,7 +468,7 @@ EnergyEngine::HemsError EnergyEngine::setHeatingConfiguration(
         != heatingConfiguration) {
         m_heatingConfigurations[heatingConfiguration.heatPumpThingId()] = heatingConfiguration;
         qCDebug(dcConsolinnoEnergy()) << "Heating configuration changed" << heatingConfiguration;
-        saveHeatingConfigurationToSettings(heatingConfiguration);
+        m_heatingConfigurationStore.setValue(heatingConfiguration);
         emit heatingConfigurationChanged(heatingConfiguration);
     }
 
@@ -325,7 +499,7 @@ EnergyEngine::HemsError EnergyEngine::setHeatingRodConfiguration(
             = heatingRodConfiguration;
         qCDebug(dcConsolinnoEnergy())
             << "Heating rod configuration changed" << heatingRodConfiguration;
-        saveHeatingRodConfigurationToSettings(heatingRodConfiguration);
+        m_heatingRodConfigurationStore.setValue(heatingRodConfiguration);
         emit heatingRodConfigurationChanged(heatingRodConfiguration);
     }
 
@@ -360,7 +534,7 @@ EnergyEngine::HemsError EnergyEngine::setDynamicElectricPricingConfiguration(
             = dynamicElectricPricingConfiguration;
         qCDebug(dcConsolinnoEnergy()) << "Dynamic electric pricing configuration changed"
                                       << dynamicElectricPricingConfiguration;
-        saveDynamicElectricPricingConfigurationToSettings(dynamicElectricPricingConfiguration);
+        m_dynamicElectricPricingConfigurationStore.setValue(dynamicElectricPricingConfiguration);
         emit dynamicElectricPricingConfigurationChanged(dynamicElectricPricingConfiguration);
     }
 
@@ -392,7 +566,7 @@ EnergyEngine::HemsError EnergyEngine::setWashingMachineConfiguration(
             = washingMachineConfiguration;
         qCDebug(dcConsolinnoEnergy())
             << "Washing machine configuration changed" << washingMachineConfiguration;
-        saveWashingMachineConfigurationToSettings(washingMachineConfiguration);
+        m_washingMachineConfigurationStore.setValue(washingMachineConfiguration);
         emit washingMachineConfigurationChanged(washingMachineConfiguration);
     }
 
@@ -453,9 +627,9 @@ EnergyEngine::HemsError EnergyEngine::setChargingConfiguration(
         != chargingConfiguration) {
         m_chargingConfigurations[chargingConfiguration.evChargerThingId()] = chargingConfiguration;
         qCDebug(dcConsolinnoEnergy()) << "Charging configuration changed" << chargingConfiguration;
-        saveChargingConfigurationToSettings(chargingConfiguration);
+        m_chargingConfigurationStore.setValue(chargingConfiguration);
         emit chargingConfigurationChanged(chargingConfiguration);
-        evaluateAndSetMaxChargingCurrent();
+        m_controlLoop->requestEvaluation();
     }
 
     return HemsErrorNoError;
@@ -488,7 +662,7 @@ EnergyEngine::HemsError EnergyEngine::setChargingOptimizationConfiguration(
             = chargingOptimizationConfiguration;
         qCDebug(dcConsolinnoEnergy())
             << "Charging configuration changed" << chargingOptimizationConfiguration;
-        saveChargingOptimizationConfigurationToSettings(chargingOptimizationConfiguration);
+        m_chargingOptimizationConfigurationStore.setValue(chargingOptimizationConfiguration);
         emit chargingOptimizationConfigurationChanged(chargingOptimizationConfiguration);
     }
 
@@ -516,7 +690,7 @@ EnergyEngine::HemsError EnergyEngine::setBatteryConfiguration(
 
         m_batteryConfigurations[batteryConfiguration.batteryThingId()] = batteryConfiguration;
         qCDebug(dcConsolinnoEnergy()) << "Battery configuration changed" << batteryConfiguration;
-        saveBatteryConfigurationToSettings(batteryConfiguration);
+        m_batteryConfigurationStore.setValue(batteryConfiguration);
         emit batteryConfigurationChanged(batteryConfiguration);
     }
 
@@ -541,7 +715,7 @@ EnergyEngine::HemsError EnergyEngine::setPvConfiguration(const PvConfiguration&
 
         m_pvConfigurations[pvConfiguration.pvThingId()] = pvConfiguration;
         qCDebug(dcConsolinnoEnergy()) << "Pv configuration changed" << pvConfiguration;
-        savePvConfigurationToSettings(pvConfiguration);
+        m_pvConfigurationStore.setValue(pvConfiguration);
         emit pvConfigurationChanged(pvConfiguration);
     }
 
@@ -565,8 +739,18 @@ EnergyEngine::HemsError EnergyEngine::setChargingSessionConfiguration(
         return HemsErrorInvalidThing;
     }
 
-    if (m_chargingSessionConfigurations.value(chargingSessionConfiguration.evChargerThingId())
-        != chargingSessionConfiguration) {
+    ChargingSessionConfiguration previousSession
+        = m_chargingSessionConfigurations.value(chargingSessionConfiguration.evChargerThingId());
+    if (previousSession != chargingSessionConfiguration) {
+        // Only one session per charger is kept here, so a new session ends the previous one.
+        // Keep both the ended session and a finished one in the history.
+        if (!previousSession.sessionId().isNull()
+            && previousSession.sessionId() != chargingSessionConfiguration.sessionId()) {
+            m_chargingSessionHistory->record(previousSession);
+        }
+        if (!chargingSessionConfiguration.finishedAt().isEmpty()) {
+            m_chargingSessionHistory->record(chargingSessionConfiguration);
+        }
 
         m_chargingSessionConfigurations[chargingSessionConfiguration.evChargerThingId()]
             = chargingSessionConfiguration;
@@ -582,6 +766,12 @@ EnergyEngine::HemsError EnergyEngine::setChargingSessionConfiguration(
     return HemsErrorNoError;
 }
 
+QList<ChargingSessionConfiguration> EnergyEngine::chargingSessions(
+    const ThingId& evChargerThingId, qint64 from, qint64 to, int limit) const
+{
+    return m_chargingSessionHistory->sessions(evChargerThingId, from, to, limit);
+}
+
 QList<UserConfiguration> EnergyEngine::userConfigurations() const
 {
     return m_userConfigurations.values();
@@ -604,7 +794,7 @@ EnergyEngine::HemsError EnergyEngine::setUserConfiguration(
 
         m_userConfigurations[userConfiguration.userConfigID()] = userConfiguration;
         qCDebug(dcConsolinnoEnergy()) << "User configuration changed" << userConfiguration;
-        saveUserConfigurationToSettings(userConfiguration);
+        m_userConfigurationStore.setValue(userConfiguration);
         emit userConfigurationChanged(userConfiguration);
     }
 
@@ -640,6 +830,7 @@ void EnergyEngine::monitorHeatPump(Thing* thing)
 {
     qCDebug(dcConsolinnoEnergy()) << "Start monitoring heatpump" << thing;
     m_heatPumps.insert(thing->id(), thing);
+    m_stateAccessors.accessors(thing);
     evaluateAvailableUseCases();
     loadHeatingConfiguration(thing->id());
 }
@@ -653,6 +844,7 @@ void EnergyEngine::monitorGridSupportDevice(Thing* thing)
 {
     qCDebug(dcConsolinnoEnergy()) << "Start monitoring 14a device" << thing;
     m_gridsupportDevice = thing;
+    m_stateAccessors.accessors(thing);
 }
 
 /*!
@@ -706,25 +898,30 @@ void EnergyEngine::monitorEvCharger(Thing* thing)
     loadChargingOptimizationConfiguration(thing->id());
 
     // This signal tells us, which state has changed (can also tell us to which value)
-    connect(thing, &Thing::stateValueChanged, this, [=](const StateTypeId& stateTypeId) {
-        StateType stateType
-            = m_evChargers.value(thing->id())->thingClass().getStateType(stateTypeId);
-        // use case: EvCharger gets unplugged, while an optimization is happening
-        if (stateType.name() == "pluggedIn") {
-            qCDebug(dcConsolinnoEnergy()) << "EvCharger pluggedin value changed ";
-
-            if (m_evChargers.value(thing->id())->state(stateTypeId).value() == false) {
-                qCDebug(dcConsolinnoEnergy()) << "the pluggedIn value changed to false";
-                pluggedInEventHandling(thing);
+    ThingClassAccessorsPointer accessors = m_stateAccessors.accessors(thing);
+    connect(thing, &Thing::stateValueChanged, this,
+        [=](const StateTypeId& stateTypeId, const QVariant& value) {
+            // use case: EvCharger gets unplugged, while an optimization is happening
+            if (stateTypeId == accessors->pluggedIn) {
+                qCDebug(dcConsolinnoEnergy()) << "EvCharger pluggedin value changed ";
+                if (m_capture) {
+                    m_capture->recordPluggedIn(thing->id(), value.toBool());
+                }
+
+                if (value == false) {
+                    qCDebug(dcConsolinnoEnergy()) << "the pluggedIn value changed to false";
+                    pluggedInEventHandling(thing);
+                }
+            } else if (dcConsolinnoEnergy().isDebugEnabled()) {
+                qCDebug(dcConsolinnoEnergy())
+                    << "The state: " << thing->thingClass().getStateType(stateTypeId).name()
+                    << " changed";
             }
-        } else {
-            qCDebug(dcConsolinnoEnergy()) << "The state: " << stateType.name() << " changed";
-        }
 
-        if (stateType.name() == "currentPower") {
-            updateHybridSimulation(thing);
-        }
-    });
+            if (stateTypeId == accessors->currentPower) {
+                updateHybridSimulation(thing);
+            }
+        });
 }
 
 void EnergyEngine::monitorChargingSession(Thing* thing)
@@ -788,8 +985,7 @@ void EnergyEngine::onThingAdded(Thing* thing)
                 m_hybridSimulationMap.insert(
                     thing->id().toString(), info->thing()->id().toString());
                 qCDebug(dcConsolinnoEnergy()) << "Hybrid simulation map: " << m_hybridSimulationMap;
-                QSettings settings(
-                    NymeaSettings::settingsPath() + "/consolinno.conf", QSettings::IniFormat);
+                ConsolinnoSettings settings(m_settings);
                 settings.beginGroup("HybridSimulation");
                 settings.setValue("mappings", QVariant(m_hybridSimulationMap));
                 settings.endGroup();
@@ -808,6 +1004,8 @@ void EnergyEngine::onThingAdded(Thing* thing)
 
 void EnergyEngine::onThingRemoved(const ThingId& thingId)
 {
+    m_setpointActuator->forget(thingId);
+
     // Grid Support
     if (thingId == m_gridsupportThingId) {
         m_gridsupportDevice = nullptr;
@@ -826,7 +1024,7 @@ void EnergyEngine::onThingRemoved(const ThingId& thingId)
 
         if (m_batteryConfigurations.contains(thingId)) {
             BatteryConfiguration batteryConfig = m_batteryConfigurations.take(thingId);
-            removeBatteryConfigurationFromSettings(thingId);
+            m_batteryConfigurationStore.remove(thingId);
             emit batteryConfigurationRemoved(thingId);
             qCDebug(dcConsolinnoEnergy()) << "Removed battery configuration" << batteryConfig;
         }
@@ -840,7 +1038,7 @@ void EnergyEngine::onThingRemoved(const ThingId& thingId)
 
         if (m_pvConfigurations.contains(thingId)) {
             PvConfiguration pvConfig = m_pvConfigurations.take(thingId);
-            removePvConfigurationFromSettings(thingId);
+            m_pvConfigurationStore.remove(thingId);
             emit pvConfigurationRemoved(thingId);
             qCDebug(dcConsolinnoEnergy()) << "Removed pv configuration" << pvConfig;
         }
@@ -854,7 +1052,7 @@ void EnergyEngine::onThingRemoved(const ThingId& thingId)
 
         if (m_heatingConfigurations.contains(thingId)) {
             HeatingConfiguration heatingConfig = m_heatingConfigurations.take(thingId);
-            removeHeatingConfigurationFromSettings(thingId);
+            m_heatingConfigurationStore.remove(thingId);
             emit heatingConfigurationRemoved(thingId);
             qCDebug(dcConsolinnoEnergy()) << "Removed heating configuration" << heatingConfig;
         }
@@ -868,7 +1066,7 @@ void EnergyEngine::onThingRemoved(const ThingId& thingId)
 
         if (m_heatingRodConfigurations.contains(thingId)) {
             HeatingRodConfiguration heatingRodConfig = m_heatingRodConfigurations.take(thingId);
-            removeHeatingRodConfigurationFromSettings(thingId);
+            m_heatingRodConfigurationStore.remove(thingId);
             emit heatingRodConfigurationRemoved(thingId);
             qCDebug(dcConsolinnoEnergy())
                 << "Removed heating rod configuration" << heatingRodConfig;
@@ -884,7 +1082,7 @@ void EnergyEngine::onThingRemoved(const ThingId& thingId)
         if (m_dynamicElectricPricingConfigurations.contains(thingId)) {
             DynamicElectricPricingConfiguration dynamicElectricPricingConfig
                 = m_dynamicElectricPricingConfigurations.take(thingId);
-            removeDynamicElectricPricingConfigurationFromSettings(thingId);
+            m_dynamicElectricPricingConfigurationStore.remove(thingId);
             emit dynamicElectricPricingConfigurationRemoved(thingId);
             qCDebug(dcConsolinnoEnergy())
                 << "Removed dynamic electric pricing configuration" << dynamicElectricPricingConfig;
@@ -900,7 +1098,7 @@ void EnergyEngine::onThingRemoved(const ThingId& thingId)
         if (m_washingMachineConfigurations.contains(thingId)) {
             WashingMachineConfiguration washingMachineConfig
                 = m_washingMachineConfigurations.take(thingId);
-            removeWashingMachineConfigurationFromSettings(thingId);
+            m_washingMachineConfigurationStore.remove(thingId);
             emit washingMachineConfigurationRemoved(thingId);
             qCDebug(dcConsolinnoEnergy())
                 << "Removed washing Machine configuration" << washingMachineConfig;
@@ -915,7 +1113,7 @@ void EnergyEngine::onThingRemoved(const ThingId& thingId)
         // Chargeing
         if (m_chargingConfigurations.contains(thingId)) {
             ChargingConfiguration chargingConfig = m_chargingConfigurations.take(thingId);
-            removeChargingConfigurationFromSettings(thingId);
+            m_chargingConfigurationStore.remove(thingId);
             emit chargingConfigurationRemoved(thingId);
             qCDebug(dcConsolinnoEnergy()) << "Removed charging configuration" << chargingConfig;
         }
@@ -924,7 +1122,7 @@ void EnergyEngine::onThingRemoved(const ThingId& thingId)
         if (m_chargingOptimizationConfigurations.contains(thingId)) {
             ChargingOptimizationConfiguration chargingConfig
                 = m_chargingOptimizationConfigurations.take(thingId);
-            removeChargingOptimizationConfigurationFromSettings(thingId);
+            m_chargingOptimizationConfigurationStore.remove(thingId);
             emit chargingOptimizationConfigurationRemoved(thingId);
             qCDebug(dcConsolinnoEnergy())
                 << "Removed charging Optimization configuration" << chargingConfig;
@@ -971,8 +1169,7 @@ void EnergyEngine::onThingRemoved(const ThingId& thingId)
         if (m_hybridSimulationMap.contains(thingId.toString())) {
             ThingId linkedThingId = m_hybridSimulationMap.value(thingId.toString()).toUuid();
             m_hybridSimulationMap.remove(thingId.toString());
-            QSettings settings(
-                NymeaSettings::settingsPath() + "/consolinno.conf", QSettings::IniFormat);
+            ConsolinnoSettings settings(m_settings);
             settings.beginGroup("HybridSimulation");
             settings.setValue("mappings", QVariant(m_hybridSimulationMap));
             settings.endGroup();
@@ -985,17 +1182,20 @@ void EnergyEngine::onThingRemoved(const ThingId& thingId)
 
 void EnergyEngine::onRootMeterChanged()
 {
-    if (m_energyManager->rootMeter()) {
-        qCDebug(dcConsolinnoEnergy()) << "Using root meter" << m_energyManager->rootMeter();
-        connect(m_energyManager->rootMeter(), &Thing::stateValueChanged, this,
-            [=](const StateTypeId& stateTypeId, const QVariant& value) {
-                Q_UNUSED(value)
-                StateType stateType
-                    = m_energyManager->rootMeter()->thingClass().getStateType(stateTypeId);
-                if (stateType.name() == "currentPower") {
-                    evaluateAndSetMaxChargingCurrent();
-                }
-            });
+    // Only follow the current root meter, a previous one must not trigger evaluations any more
+    if (m_rootMeter) {
+        disconnect(m_rootMeter, &Thing::stateValueChanged, this,
+            &EnergyEngine::onRootMeterStateValueChanged);
+    }
+    m_rootMeter = m_energyManager->rootMeter();
+    m_rootMeterAccessors.reset();
+
+    if (m_rootMeter) {
+        qCDebug(dcConsolinnoEnergy()) << "Using root meter" << m_rootMeter.data();
+        m_rootMeterAccessors = m_stateAccessors.accessors(m_rootMeter);
+        connect(m_rootMeter, &Thing::stateValueChanged, this,
+            &EnergyEngine::onRootMeterStateValueChanged);
+        m_controlLoop->requestEvaluation();
     } else {
         qCWarning(dcConsolinnoEnergy())
             << "There is no root meter configured. Optimization will not be available until a root "
@@ -1005,21 +1205,54 @@ void EnergyEngine::onRootMeterChanged()
     evaluateAvailableUseCases();
 }
 
-void EnergyEngine::onConsumptionLimitChanged(qlonglong consumptionLimit)
+void EnergyEngine::onRootMeterStateValueChanged(
+    const StateTypeId& stateTypeId, const QVariant& value)
 {
+    if (stateTypeId == m_rootMeterAccessors->currentPower) {
+        if (m_capture) {
+            PhaseVector phasePower;
+            for (int phase = 0; phase < phaseCount; phase++) {
+                phasePower[phase]
+                    = m_rootMeter->stateValue(m_rootMeterAccessors->currentPowerPhase[phase])
+                          .toDouble();
+            }
+            m_capture->recordRootMeterSample(value.toDouble(), phasePower.data());
+        }
+        if (m_controlLatency.rootMeterPowerChanged(value.toDouble())) {
+            publishControlLatency();
+        }
+        m_controlLoop->requestEvaluation();
+    }
+}
+
+void EnergyEngine::onConsumptionLimitChanged(
+    ControlLatencyTracker::Source source, qlonglong consumptionLimit)
+{
+    if (m_capture) {
+        m_capture->recordLimitSignal(source, consumptionLimit);
+    }
+
     // Echo to debug log, function "onConsumptionLimitChanged" is called
     qDebug() << "##### onConsumptionLimitChanged called with new consumption limit:"
              << consumptionLimit;
     qCDebug(dcConsolinnoEnergy())
-        << "##### onConsumptionLimitChanged called with new consumption limit:" << consumptionLimit;
+        << "##### onConsumptionLimitChanged called with new consumption limit:" << consumptionLimit
+        << "from" << ControlLatencyTracker::sourceName(source);
     qCDebug(dcConsolinnoEnergy()) << "Previous consumption limit:" << m_consumptionLimit;
 
+    // A limit that does not change the effective limit, like a looser one under the strictest
+    // policy, triggers no evaluation and no latency measurement
+    bool changed
+        = m_limitArbiter.update(source, consumptionLimit, EngineClock::monotonicTime());
+    scheduleConsumptionLimitExpiry();
+
     if (m_energyManager->rootMeter()) {
         qCDebug(dcConsolinnoEnergy()) << "onConsumptionLimitChanged called and root meter is set";
         qCDebug(dcConsolinnoEnergy()) << "Using root meter" << m_energyManager->rootMeter();
-        // set new consumption limit
-        m_consumptionLimit = consumptionLimit;
-        evaluateAndSetMaxChargingCurrent();
+        // The latency can only be measured against the power of the root meter
+        if (changed) {
+            m_controlLatency.limitSignalled(source, rootMeterPower(), m_snapshotRevision);
+        }
         // sendLimitOverJSONRPC(1, consumptionLimit);
     } else {
         qCDebug(dcConsolinnoEnergy())
@@ -1029,29 +1262,90 @@ void EnergyEngine::onConsumptionLimitChanged(qlonglong consumptionLimit)
                "meter has been declared in the energy experience.";
     }
 
+    // Applied without a root meter as well, the arbiter does not report an identical resend as a
+    // change once a meter shows up
+    if (changed) {
+        applyEffectiveConsumptionLimit();
+    }
+
     evaluateAvailableUseCases();
 }
 
-void EnergyEngine::onConsumptionLimitChangedOPC(qlonglong consumptionLimit)
+// The current limit of a source read at startup or when its service (re)appeared. It is no new
+// instruction of the grid operator, so it does not count for the control latency.
+void EnergyEngine::onConsumptionLimitFetched(
+    ControlLatencyTracker::Source source, qlonglong consumptionLimit)
 {
-    // Echo to debug log, function "onConsumptionLimitChanged" is called
-    qCDebug(dcConsolinnoEnergy()) << "onConsumptionLimitChangedOPC called";
-    if (m_energyManager->rootMeter()) {
-        qCDebug(dcConsolinnoEnergy())
-            << "onConsumptionLimitChangedOPC called and root meter is set";
-        qCDebug(dcConsolinnoEnergy()) << "Using root meter" << m_energyManager->rootMeter();
-        // set new consumption limit
-        m_consumptionLimit = consumptionLimit;
-        evaluateAndSetMaxChargingCurrent();
+    qCDebug(dcConsolinnoEnergy()) << "Consumption limit" << consumptionLimit << "read from"
+                                  << ControlLatencyTracker::sourceName(source);
+
+    // A replay has to start with the limits in effect as well, it applies them like a signal
+    if (m_capture) {
+        m_capture->recordLimitSignal(source, consumptionLimit);
+    }
+
+    if (m_limitArbiter.update(source, consumptionLimit, EngineClock::monotonicTime())) {
+        applyEffectiveConsumptionLimit();
+    }
+    scheduleConsumptionLimitExpiry();
+}
+
+void EnergyEngine::onConsumptionLimitExpired()
+{
+    if (m_limitArbiter.expire(EngineClock::monotonicTime())) {
+        qCInfo(dcConsolinnoEnergy()) << "Consumption limit expired";
+        applyEffectiveConsumptionLimit();
+    }
+    scheduleConsumptionLimitExpiry();
+}
+
+void EnergyEngine::applyEffectiveConsumptionLimit()
+{
+    qlonglong consumptionLimit = m_limitArbiter.effectiveLimit();
+    if (m_limitArbiter.hasEffectiveSource()) {
+        qCInfo(dcConsolinnoEnergy())
+            << "Effective consumption limit" << consumptionLimit << "W from"
+            << ControlLatencyTracker::sourceName(m_limitArbiter.effectiveSource());
     } else {
-        qCDebug(dcConsolinnoEnergy())
-            << "onConsumptionLimitChangedOPC called and root meter is not set";
-        qCWarning(dcConsolinnoEnergy())
-            << "There is no root meter configured. Optimization will not be available until a root "
-               "meter has been declared in the energy experience.";
+        qCInfo(dcConsolinnoEnergy()) << "No consumption limit from any source";
     }
 
-    evaluateAvailableUseCases();
+    bool limitDropped = isConsumptionLimitDrop(consumptionLimit);
+    m_consumptionLimit = consumptionLimit;
+    if (limitDropped) {
+        m_controlLoop->requestImmediateEvaluation();
+    } else {
+        m_controlLoop->requestEvaluation();
+    }
+}
+
+void EnergyEngine::scheduleConsumptionLimitExpiry()
+{
+    qint64 nextExpiry = m_limitArbiter.nextExpiry();
+    if (nextExpiry < 0) {
+        m_limitExpiryTimer.stop();
+        return;
+    }
+
+    // Under a virtual time onVirtualTimeAdvanced() expires the limit
+    if (EngineClock::isVirtual()) {
+        m_limitExpiryTimer.stop();
+        return;
+    }
+
+    // The validity is measured on the monotonic clock, a step of the wall clock does not move it
+    m_limitExpiryTimer.start(
+        static_cast<int>(qMax<qint64>(0, nextExpiry - EngineClock::monotonicTime())));
+}
+
+void EnergyEngine::onVirtualTimeAdvanced(qint64 msecsSinceEpoch)
+{
+    // The monotonic time follows the virtual time
+    Q_UNUSED(msecsSinceEpoch)
+    qint64 nextExpiry = m_limitArbiter.nextExpiry();
+    if (nextExpiry >= 0 && nextExpiry <= EngineClock::monotonicTime()) {
+        onConsumptionLimitExpired();
+    }
 }
 
 void EnergyEngine::updateHybridSimulation(Thing* thing)
@@ -1106,162 +1400,295 @@ void EnergyEngine::updateHybridSimulation(Thing* thing)
     linkedSimulatedThing->setStateValue("power", thing->stateValue("power"));
 }
 
-void EnergyEngine::dimmWallbox()
+// The optimizer is done with every snapshot up to the applied revision. The one published last
+// stays untouched, the next snapshot gets compared against it.
+QSharedPointer<EngineSnapshot> EnergyEngine::acquireSnapshot()
 {
-    qCDebug(dcConsolinnoEnergy()) << "dimmWallbox";
+    foreach (const QSharedPointer<EngineSnapshot>& snapshot, m_snapshotPool) {
+        if (snapshot->revision <= m_appliedRevision && snapshot != m_publishedSnapshot)
+            return snapshot;
+    }
 
-    double maxChargingCurrentMaxValue = 0;
-    double maxChargingCurrentMinValue = 0;
-    double actualMaxChargingCurrent = 0;
+    // The optimizer is behind, the pool only grows up to a few snapshots
+    QSharedPointer<EngineSnapshot> snapshot(new EngineSnapshot);
+    if (m_snapshotPool.size() < snapshotPoolSize) {
+        m_snapshotPool.append(snapshot);
+    }
+    return snapshot;
+}
 
-    // if the limit is exceeded or below max, we adjust the charging current for each EV charger
-    // foreach (Thing* thing, m_evChargers) {
+// Collect everything the optimizer needs, the worker must not touch things or configurations.
+// The snapshot gets its revision when it is published.
+QSharedPointer<EngineSnapshot> EnergyEngine::createSnapshot(
+    const DecisionTrace::Record& decision, bool limitActive, double gridPower)
+{
+    QSharedPointer<EngineSnapshot> snapshot = acquireSnapshot();
+    snapshot->revision = 0;
+    snapshot->limitActive = limitActive;
+    snapshot->consumptionLimit = m_consumptionLimit;
+    snapshot->gridPower = gridPower;
+    snapshot->monotonicTime = EngineClock::monotonicTime();
+    snapshot->decision = decision;
+    // Clearing keeps the capacity of a reused snapshot
+    snapshot->evChargers.clear();
+    snapshot->heatPumps.clear();
+    snapshot->heatingRods.clear();
+    snapshot->batteries.clear();
 
-    for (auto i = m_evChargers.cbegin(), end = m_evChargers.cend(); i != end; ++i) {
+    // Heat pumps blocked by an earlier limit have to be released once the limit is lifted
+    snapshot->heatPumps.reserve(m_heatPumps.size());
+    for (auto i = m_heatPumps.cbegin(), end = m_heatPumps.cend(); i != end; ++i) {
         ThingId thingID = i.key();
-        Thing* thing = i.value();
 
-        /* Find config in qhash. */
-        QHash<ThingId, ChargingOptimizationConfiguration>::const_iterator it
-            = m_chargingOptimizationConfigurations.find(thingID);
-        if (it == m_chargingOptimizationConfigurations.end()) {
-            qCDebug(dcConsolinnoEnergy())
-                << "No charging optimization configuration found for " << thing->name();
+        /* Find heating config in qhash. */
+        QHash<ThingId, HeatingConfiguration>::const_iterator it
+            = m_heatingConfigurations.constFind(thingID);
+        if (it == m_heatingConfigurations.constEnd()) {
+            if (limitActive) {
+                qCDebug(dcConsolinnoEnergy())
+                    << "No heating configuration found for" << i.value()->name();
+            }
             continue;
         }
 
-        ChargingOptimizationConfiguration config = it.value();
+        /*
+        Ob es sich um eine CLS-Anlage handelt steht in der Config. In dieser Config ist die Thing
+        ID mit den Variablen verbunden, dadurch muss nicht jedes Plugin angepasst werden.
+        */
+        const HeatingConfiguration& config = it.value();
         if (!config.controllableLocalSystem()) {
-            qCDebug(dcConsolinnoEnergy()) << "Unit is not a CLS";
             continue;
         }
 
-        qCDebug(dcConsolinnoEnergy())
-            << "Blackout protection: Checking EV charger thing with name: " << thing->name();
-
-        maxChargingCurrentMaxValue = thing->thingClass()
-                                         .stateTypes()
-                                         .findByName("maxChargingCurrent")
-                                         .maxValue()
-                                         .toFloat();
-        maxChargingCurrentMinValue = thing->thingClass()
-                                         .stateTypes()
-                                         .findByName("maxChargingCurrent")
-                                         .minValue()
-                                         .toFloat();
-        actualMaxChargingCurrent = thing->state("maxChargingCurrent").value().toFloat();
-
-        qCDebug(dcConsolinnoEnergy())
-            << "Blackout protection: Absolute limits: min=" << maxChargingCurrentMinValue
-            << "A, max=" << maxChargingCurrentMaxValue
-            << "A, actual max value :" << actualMaxChargingCurrent << "A";
-
-        // TODO: only if the WB is a CLS unit
+        ThingClassAccessorsPointer accessors = m_stateAccessors.accessors(i.value());
+        EngineSnapshot::HeatPump heatPump;
+        heatPump.thingId = thingID;
+        heatPump.sgReadyModeStateTypeId = accessors->sgReadyMode;
+        heatPump.sgReadyModeActionTypeId = accessors->sgReadyModeAction;
+        heatPump.sgReadyMode = i.value()->stateValue(accessors->sgReadyMode).toString();
+        // Configured in kW
+        heatPump.maxElectricalPower = config.maxElectricalPower() * 1000;
+        heatPump.clsPriority = config.clsPriority();
+        heatPump.clsMinPower = config.clsMinPower();
+        snapshot->heatPumps.append(heatPump);
+    }
 
-        float newMaxChargingCurrentLimit = maxChargingCurrentMinValue;
+    snapshot->evChargers.reserve(m_evChargers.size());
+    for (auto i = m_evChargers.cbegin(), end = m_evChargers.cend(); i != end; ++i) {
+        ThingId thingID = i.key();
+        Thing* thing = i.value();
 
-        // if (allCLSOff) { // TODO for next version
-        //     newMaxChargingCurrentLimit = 0;
-        // }
+        /* Find config in qhash. */
+        QHash<ThingId, ChargingOptimizationConfiguration>::const_iterator it
+            = m_chargingOptimizationConfigurations.constFind(thingID);
+        if (it == m_chargingOptimizationConfigurations.constEnd()) {
+            if (limitActive) {
+                qCDebug(dcConsolinnoEnergy())
+                    << "No charging optimization configuration found for " << thing->name();
+            }
+            continue;
+        }
 
-        StateTypeId actionTypeId
-            = thing->thingClass().stateTypes().findByName("maxChargingCurrent").id();
-        QString actionTypeIdString = actionTypeId.toString();
-        qCInfo(dcConsolinnoEnergy()) << "maxChargingCurrent has state id: " << actionTypeIdString;
+        // Chargers with a setpoint regulate the grid point power all the time
+        const ChargingOptimizationConfiguration& config = it.value();
+        bool limited = limitActive && config.controllableLocalSystem();
+        if (!limited && config.setpoint() <= 0 && !m_autoTuning.contains(thingID)) {
+            continue;
+        }
 
-        Action action(actionTypeId, thing->id());
-        ParamList params;
-        params.append(Param(actionTypeId, newMaxChargingCurrentLimit));
-        action.setParams(params);
-        m_thingManager->executeAction(action);
+        ThingClassAccessorsPointer accessors = m_stateAccessors.accessors(thing);
+        EngineSnapshot::EvCharger evCharger;
+        evCharger.thingId = thingID;
+        evCharger.maxChargingCurrentStateTypeId = accessors->maxChargingCurrent;
+        evCharger.maxChargingCurrentActionTypeId = accessors->maxChargingCurrentAction;
+        evCharger.maxChargingCurrent = thing->stateValue(accessors->maxChargingCurrent).toFloat();
+        evCharger.maxChargingCurrentMinValue = accessors->maxChargingCurrentMinValue;
+        evCharger.maxChargingCurrentMaxValue = accessors->maxChargingCurrentMaxValue;
+        if (!accessors->phaseCount.isNull()) {
+            evCharger.phaseCount = thing->stateValue(accessors->phaseCount).toInt();
+        }
+        if (!accessors->pluggedIn.isNull()) {
+            evCharger.pluggedIn = thing->stateValue(accessors->pluggedIn).toBool();
+        }
+        evCharger.controllableLocalSystem = config.controllableLocalSystem();
+        evCharger.clsPriority = config.clsPriority();
+        evCharger.clsMinPower = config.clsMinPower();
+        evCharger.p = config.p_value();
+        evCharger.i = config.i_value();
+        evCharger.d = config.d_value();
+        evCharger.setpoint = config.setpoint();
+        snapshot->evChargers.append(evCharger);
 
-        qCInfo(dcConsolinnoEnergy())
-            << "Blackout protection: consumptionLimitCLSExceeded -> Ajdusted limit of "
-               "charging current "
-               "per "
-               "Phase down to"
-            << thing->state("maxChargingCurrent").value().toInt() << "A";
+        qCDebug(dcConsolinnoEnergy())
+            << "Blackout protection: EV charger" << thing->name()
+            << "absolute limits: min=" << evCharger.maxChargingCurrentMinValue
+            << "A, max=" << evCharger.maxChargingCurrentMaxValue
+            << "A, actual max value :" << evCharger.maxChargingCurrent << "A";
     }
-}
 
-void EnergyEngine::deactivateHeatPump()
-{
+    // Without a limit no other CLS unit needs to be looked at
+    if (!limitActive)
+        return snapshot;
 
-    qCDebug(dcConsolinnoEnergy()) << "deactivateHeatPump";
-
-    // Adding the logic for the heat pumps
-    /*
-    Gedanken zur Regelung der Wärmepumpe: Diese soll ausgeschaltet werden, wenn das
-    consumptionLimitCLSExceeded. Problem ist, dass es zu einer Oszilation kommt, denn nach dem
-    Ausschalten ist das limit nicht mehr überschritten und die Anlage wird direkt wieder
-    eingeschaltet. Einfache Lösung: wir gehen davon aus, dass wenn ein Limit da ist, die Anlage
-    immer ausgeschlatet wird. Problem: Wenn wir vor dem ausschlaten bereits unter dem Limit sind
-    wird die Anlage auch ausgeschlatet. Gehen wir davon aus, das die Anlage 10kW zieht, dann könnten
-    wir die Logik so anpassen und Fälle schaffen, in denen die Wärmepumpe nicht ausgeschaltet werden
-    muss. Besser wäre es aber die Anlage zu messen.
-    */
+    snapshot->heatingRods.reserve(m_heatingRods.size());
+    for (auto i = m_heatingRods.cbegin(), end = m_heatingRods.cend(); i != end; ++i) {
+        auto it = m_heatingRodConfigurations.constFind(i.key());
+        if (it == m_heatingRodConfigurations.constEnd() || !it.value().controllableLocalSystem())
+            continue;
 
-    for (auto i = m_heatPumps.cbegin(), end = m_heatPumps.cend(); i != end; ++i) {
-        ThingId thingID = i.key();
-        Thing* thing = i.value();
+        // Heating rods without a power switch cannot be limited
+        ThingClassAccessorsPointer accessors = m_stateAccessors.accessors(i.value());
+        if (accessors->powerAction.isNull())
+            continue;
 
-        /* Find heating config in qhash. */
-        QHash<ThingId, HeatingConfiguration>::const_iterator it
-            = m_heatingConfigurations.find(thingID);
-        if (it == m_heatingConfigurations.end()) {
-            // TODO print warning
+        EngineSnapshot::HeatingRod heatingRod;
+        heatingRod.thingId = i.key();
+        heatingRod.powerStateTypeId = accessors->power;
+        heatingRod.powerActionTypeId = accessors->powerAction;
+        heatingRod.power = i.value()->stateValue(accessors->power).toBool();
+        // Configured in kW, like the heat pumps
+        heatingRod.maxElectricalPower = it.value().maxElectricalPower() * 1000;
+        heatingRod.clsPriority = it.value().clsPriority();
+        heatingRod.clsMinPower = it.value().clsMinPower();
+        snapshot->heatingRods.append(heatingRod);
+    }
+
+    snapshot->batteries.reserve(m_batteries.size());
+    for (auto i = m_batteries.cbegin(), end = m_batteries.cend(); i != end; ++i) {
+        auto it = m_batteryConfigurations.constFind(i.key());
+        if (it == m_batteryConfigurations.constEnd() || !it.value().controllableLocalSystem())
             continue;
+
+        // Positive power is charging
+        ThingClassAccessorsPointer accessors = m_stateAccessors.accessors(i.value());
+        EngineSnapshot::Battery battery;
+        battery.thingId = i.key();
+        battery.chargingPower
+            = qMax(0.0, i.value()->stateValue(accessors->currentPower).toDouble());
+        battery.clsPriority = it.value().clsPriority();
+        battery.clsMinPower = it.value().clsMinPower();
+        snapshot->batteries.append(battery);
+    }
+
+    return snapshot;
+}
+
+// Runs on the main thread, only here the actions computed by the optimizer get executed
+void EnergyEngine::applyOptimizerResult(const OptimizerResult& result)
+{
+    m_appliedRevision = result.revision;
+    m_optimizerIdle = result.idle;
+    DecisionTrace::Record decision = result.decision;
+
+    foreach (const PlannedAction& action, result.actions) {
+        // The thing might have been removed while the optimizer was running
+        Thing* thing = nullptr;
+        switch (action.kind) {
+        case PlannedAction::KindChargingCurrent:
+            thing = m_evChargers.value(action.thingId);
+            break;
+        case PlannedAction::KindHeatPump:
+            thing = m_heatPumps.value(action.thingId);
+            break;
+        case PlannedAction::KindHeatingRod:
+            thing = m_heatingRods.value(action.thingId);
+            break;
         }
+        if (!thing)
+            continue;
 
-        /* Check if heatpump is CLS. */
-        HeatingConfiguration config = it.value();
-        if (!config.controllableLocalSystem()) {
+        // Only changed setpoints are written, the integrations poll slow buses
+        if (!m_setpointActuator->setTarget(
+                thing, action.actionTypeId, action.stateTypeId, action.target)) {
+            qCDebug(dcConsolinnoEnergy())
+                << "PLim:" << thing->name() << "already at" << action.target;
             continue;
         }
+        m_controlLatency.actionExecuted(result.revision);
+
+        switch (action.kind) {
+        case PlannedAction::KindChargingCurrent:
+            decision.chargingCurrentActions++;
+            decision.addAction(action.thingId, DecisionTrace::ActionChargingCurrent,
+                action.target.toFloat());
+            qCInfo(dcConsolinnoEnergy()) << "Adjusted charging current per phase of"
+                                         << thing->name() << "to" << action.target.toInt() << "A";
+            break;
+        case PlannedAction::KindHeatPump:
+            decision.heatPumpActions++;
+            decision.addAction(action.thingId,
+                action.target.toString() == QLatin1String("Off")
+                    ? DecisionTrace::ActionHeatPumpOff
+                    : DecisionTrace::ActionHeatPumpStandard);
+            qCInfo(dcConsolinnoEnergy())
+                << "PLim: Heat pump" << thing->name() << "set to" << action.target.toString();
+            break;
+        case PlannedAction::KindHeatingRod:
+            decision.heatingRodActions++;
+            decision.addAction(action.thingId, DecisionTrace::ActionHeatingRodOff);
+            qCInfo(dcConsolinnoEnergy()) << "PLim: Heating rod" << thing->name() << "switched off";
+            break;
+        }
+    }
 
-        // foreach (config, m_heatingConfigurations) {
-
-        // oder feste Liste mit CLS devices, und bei jeder Änderung der Konfiguration das Event
-        // abfragen
+    foreach (const HeatPumpTransition& transition, result.transitions) {
+        qCInfo(dcConsolinnoEnergy()) << "PLim:" << transition;
+        m_heatPumpTransitions.append(transition);
+    }
 
-        // m_heatingConfigurations
+    foreach (const ChargingAutoTuneResult& autoTuneResult, result.autoTuneResults) {
+        m_autoTuning.remove(autoTuneResult.thingId);
+        Thing* thing = m_evChargers.value(autoTuneResult.thingId);
+        QString name = thing ? thing->name() : autoTuneResult.thingId.toString();
+        if (!autoTuneResult.success) {
+            qCWarning(dcConsolinnoEnergy())
+                << "PID auto tuning of" << name << "failed:" << autoTuneResult.errorMessage;
+            continue;
+        }
 
-        /*
-        TODO: only if the HP is a CLS unit
-        Wenn wir den Status, ob es sich um eine CLS-Anlage handelt als Variable im Thing zur
-        Verfügung haben wollen, müssten wir jedes Plugin anpassen. Alternativ können wir diese
-        Variable in die Config schreiben. In diser Config ist die Thing ID mit den Varibalen
-        verbunden und könnten hier abgerufen werden.
-        */
+        qCInfo(dcConsolinnoEnergy())
+            << "PID auto tuning of" << name << "finished: gain" << autoTuneResult.processGain
+            << "W/A, time constant" << autoTuneResult.timeConstant << "s, dead time"
+            << autoTuneResult.deadTime << "s -> p" << autoTuneResult.p << "i" << autoTuneResult.i
+            << "d" << autoTuneResult.d;
+
+        // The configuration might have been removed with the charger in the meantime
+        auto it = m_chargingOptimizationConfigurations.constFind(autoTuneResult.thingId);
+        if (it == m_chargingOptimizationConfigurations.constEnd())
+            continue;
 
-        StateTypeId actionTypeId = thing->thingClass().stateTypes().findByName("sgReadyMode").id();
-        QString actionTypeIdString = actionTypeId.toString();
-        qCInfo(dcConsolinnoEnergy()) << "sgReadyMode has state id: " << actionTypeIdString;
+        ChargingOptimizationConfiguration config = it.value();
+        config.setP_value(autoTuneResult.p);
+        config.setI_value(autoTuneResult.i);
+        config.setD_value(autoTuneResult.d);
+        setChargingOptimizationConfiguration(config);
+    }
 
-        Action action(actionTypeId, thing->id());
-        ParamList params;
-        params.append(Param(actionTypeId, "Off"));
-        action.setParams(params);
-        m_thingManager->executeAction(action);
+    if (decision.plimStatus == DecisionTrace::PlimStatusLimited) {
+        qCDebug(dcConsolinnoEnergy()) << "PLim: Allocated" << decision.allocatedPower << "W of"
+                                      << decision.consumptionLimit << "W to the CLS units";
+    }
 
-        qCInfo(dcConsolinnoEnergy()) << "PLim: Heat pump set to Off.";
+    m_decisionTrace.append(decision);
 
-        QString sgReadyMode = thing->state("sgReadyMode").value().toString();
-        qCDebug(dcConsolinnoEnergy())
-            << "Smart grid mode for Heat Pump with name: " << thing->name()
-            << " is: " << sgReadyMode;
+    int actions
+        = decision.chargingCurrentActions + decision.heatPumpActions + decision.heatingRodActions;
+    m_controlLatency.evaluationFinished(actions, result.revision);
+    if (actions > 0) {
+        publishControlLatency();
     }
 }
 
-void EnergyEngine::check14a()
+bool EnergyEngine::check14a(DecisionTrace::Record& decision)
 {
     qCDebug(dcConsolinnoEnergy()) << "check 14a";
 
     if (!m_gridsupportDevice) {
         qCWarning(dcConsolinnoEnergy()) << "No 14a plugin devices found!";
-        return;
+        return false;
     }
 
+    ThingClassAccessorsPointer accessors = m_stateAccessors.accessors(m_gridsupportDevice);
     bool consumptionLimitCLSExceeded = false;
 
     /*              "unrestricted",
@@ -1269,133 +1696,235 @@ void EnergyEngine::check14a()
                     "limited"
     */
 
+    QString plimStatus;
     if (m_consumptionLimit > 0) {
         consumptionLimitCLSExceeded = true;
         qCDebug(dcConsolinnoEnergy()) << "Consumption limit exceeded: limited";
-        m_gridsupportDevice->setStateValue("plimStatus", "limited");
-        deactivateHeatPump();
-        dimmWallbox();
+        plimStatus = QStringLiteral("limited");
+        decision.plimStatus = DecisionTrace::PlimStatusLimited;
     } else if (m_consumptionLimit == 0) {
         consumptionLimitCLSExceeded = true;
         qCDebug(dcConsolinnoEnergy()) << "Consumption limit exceeded: shutoff";
-        m_gridsupportDevice->setStateValue("plimStatus", "shutoff");
-        deactivateHeatPump();
-        dimmWallbox();
+        plimStatus = QStringLiteral("shutoff");
+        decision.plimStatus = DecisionTrace::PlimStatusShutoff;
     } else {
         consumptionLimitCLSExceeded = false;
         qCDebug(dcConsolinnoEnergy()) << "Consumption limit not exceeded";
-        m_gridsupportDevice->setStateValue("plimStatus", "unrestricted");
+        plimStatus = QStringLiteral("unrestricted");
+        decision.plimStatus = DecisionTrace::PlimStatusUnrestricted;
     }
 
-    m_gridsupportDevice->setStateValue("plim", m_consumptionLimit);
+    // Setting a state validates the value against its state type, most ticks change nothing
+    if (m_gridsupportDevice->stateValue(accessors->plimStatus).toString() != plimStatus) {
+        m_gridsupportDevice->setStateValue(accessors->plimStatus, plimStatus);
+    }
+    if (m_gridsupportDevice->stateValue(accessors->plim).toFloat() != m_consumptionLimit) {
+        m_gridsupportDevice->setStateValue(accessors->plim, m_consumptionLimit);
+    }
 
     qCDebug(dcConsolinnoEnergy()) << "done with check 14a";
+    return consumptionLimitCLSExceeded;
+}
+
+double EnergyEngine::rootMeterPower()
+{
+    Thing* rootMeter = m_energyManager->rootMeter();
+    if (!rootMeter)
+        return 0;
+
+    return rootMeter->stateValue(m_stateAccessors.accessors(rootMeter)->currentPower).toDouble();
+}
+
+// Mirror the latest latencies on the grid support thing, if its thing class provides the states
+void EnergyEngine::publishControlLatency()
+{
+    if (!m_gridsupportDevice)
+        return;
+
+    ThingClassAccessorsPointer accessors = m_stateAccessors.accessors(m_gridsupportDevice);
+    if (!accessors->plimActionLatency.isNull() && m_controlLatency.lastActionLatency() >= 0) {
+        m_gridsupportDevice->setStateValue(
+            accessors->plimActionLatency, m_controlLatency.lastActionLatency());
+    }
+    if (!accessors->plimMeterLatency.isNull() && m_controlLatency.lastMeterLatency() >= 0) {
+        m_gridsupportDevice->setStateValue(
+            accessors->plimMeterLatency, m_controlLatency.lastMeterLatency());
+    }
+}
+
+QList<LimitSourceStatus> EnergyEngine::limitSources() const
+{
+    return m_limitSources->sources();
+}
+
+QList<ControlLatencyStats> EnergyEngine::controlLatencyStats() const
+{
+    return m_controlLatency.statistics();
+}
+
+// A new or lower consumption limit must not wait for the next control loop tick
+bool EnergyEngine::isConsumptionLimitDrop(qlonglong consumptionLimit) const
+{
+    if (consumptionLimit < 0)
+        return false;
+
+    return m_consumptionLimit < 0 || consumptionLimit < m_consumptionLimit;
 }
 
 /*!
  * \brief EnergyEngine::evaluateAndSetMaxChargingCurrent
  * \details This function evaluates the current power consumption and sets the maxChargingCurrent
- * for each ev charger. This is currently a bang-bang control.
+ * for each ev charger. Under a §14a limit every CLS charger gets its share of the allowed power,
+ * chargers with a setpoint in their ChargingOptimizationConfiguration regulate the grid point
+ * power to it with a PID controller.
+ *
+ * This runs on the nymea main thread for every control loop tick. Apart from the debug output and
+ * posting the snapshot to the optimizer it does not allocate: phases live in a fixed PhaseVector,
+ * states are read through the cached accessors, the limits are precomputed whenever the
+ * household phase limit changes and snapshots get reused. Without a limit the snapshot only gets
+ * posted if the optimizer has something to do, tests/auto/controltick counts the allocations of
+ * such a tick. The actions are computed by the OptimizerWorker on its own thread and executed in
+ * applyOptimizerResult().
  */
 void EnergyEngine::evaluateAndSetMaxChargingCurrent()
 {
-
-    if (!m_energyManager->rootMeter())
+    Thing* rootMeter = m_energyManager->rootMeter();
+    if (!rootMeter)
         return;
 
-    qCDebug(dcConsolinnoEnergy()) << "============> Evaluate system:"
-                                  << QDateTime::currentDateTime().toString("dd.MM.yyyy hh:mm:ss");
+    qCDebug(dcConsolinnoEnergy()) << "============> Evaluate system: tick" << m_controlLoop->ticks()
+                                  << "coalesced" << m_controlLoop->coalescedTicks() << "skipped"
+                                  << m_controlLoop->skippedTicks();
 
-    double currentPowerNAP = m_energyManager->rootMeter()->stateValue("currentPower").toDouble();
+    // Every decision gets recorded in the trace, independent of the debug output
+    DecisionTrace::Record decision;
+    decision.timestamp = EngineClock::currentMSecsSinceEpoch();
+    decision.tick = static_cast<quint32>(m_controlLoop->ticks());
+    decision.consumptionLimit = m_consumptionLimit;
+
+    ThingClassAccessorsPointer rootMeterAccessors = m_stateAccessors.accessors(rootMeter);
+    double currentPowerNAP = rootMeter->stateValue(rootMeterAccessors->currentPower).toDouble();
     qCDebug(dcConsolinnoEnergy()) << "Current Power at NAP: " << currentPowerNAP << "W";
 
     // Blackout protection just in case something is still over the limit
     qCDebug(dcConsolinnoEnergy()) << "--> Evaluating blackout protection";
-    QHash<QString, double> allPhasesCurrentPower = {
-        { "A", m_energyManager->rootMeter()->stateValue("currentPowerPhaseA").toDouble() },
-        { "B", m_energyManager->rootMeter()->stateValue("currentPowerPhaseB").toDouble() },
-        { "C", m_energyManager->rootMeter()->stateValue("currentPowerPhaseC").toDouble() },
-    };
-
-    // Log the power values for each phase
-    qCDebug(dcConsolinnoEnergy()) << "Phase A current power:" << allPhasesCurrentPower.value("A")
-                                  << "W";
-    qCDebug(dcConsolinnoEnergy()) << "Phase B current power:" << allPhasesCurrentPower.value("B")
-                                  << "W";
-    qCDebug(dcConsolinnoEnergy()) << "Phase C current power:" << allPhasesCurrentPower.value("C")
-                                  << "W";
+    PhaseVector allPhasesCurrentPower;
+    for (int phase = 0; phase < phaseCount; phase++) {
+        allPhasesCurrentPower[phase]
+            = rootMeter->stateValue(rootMeterAccessors->currentPowerPhase[phase]).toDouble();
+        decision.phasePower[phase] = static_cast<float>(allPhasesCurrentPower[phase]);
+        qCDebug(dcConsolinnoEnergy()) << "Phase" << phaseNames[phase]
+                                      << "current power:" << allPhasesCurrentPower[phase] << "W";
+    }
 
     bool householdLimitExceeded = false;
-    double phasePowerLimit = 230 * m_housholdPhaseLimit; // m_housholdPhaseLimit sind zB 63A
+    double phasePowerLimit = m_housholdPhasePowerLimit;
     double maxPhaseOvershotPower = 0;
-    double minPhaseMarginPower
-        = 230 * m_housholdPhaseLimit; // the minPhaseMarginPower is the minimum available power per
-                                      // phase for which it can be increased
+    // the minPhaseMarginPower is the minimum available power per phase for which it can be
+    // increased
+    double minPhaseMarginPower = phasePowerLimit;
 
     // Check if the power consumption limit is exceeded in regards to phasePowerLimit
     qCDebug(dcConsolinnoEnergy()) << "Houshold physical phase limit:" << m_housholdPhaseLimit
                                   << "[A] =" << phasePowerLimit << "[W] at 230V";
-    qCDebug(dcConsolinnoEnergy()) << "Houshold physical power limit total:" << phasePowerLimit * 3
-                                  << "[W] at 230V";
+    qCDebug(dcConsolinnoEnergy()) << "Houshold physical power limit total:"
+                                  << phasePowerLimit * phaseCount << "[W] at 230V";
 
-    // first check if any of the currents exceed the limit
-    foreach (const QString& phase, allPhasesCurrentPower.keys()) {
-        if (allPhasesCurrentPower.value(phase) > phasePowerLimit) {
-            double phaseOvershotPower = allPhasesCurrentPower.value(phase) - phasePowerLimit;
-            qCDebug(dcConsolinnoEnergy())
-                << "!!! Phase" << phase << "exceeds limit by" << phaseOvershotPower << "W";
+    // Take the largest overshot power, or the smallest margin if no phase exceeds the limit
+    for (int phase = 0; phase < phaseCount; phase++) {
+        if (allPhasesCurrentPower[phase] > phasePowerLimit) {
+            double phaseOvershotPower = allPhasesCurrentPower[phase] - phasePowerLimit;
+            qCDebug(dcConsolinnoEnergy()) << "!!! Phase" << phaseNames[phase] << "exceeds limit by"
+                                          << phaseOvershotPower << "W";
 
             householdLimitExceeded = true;
-
-            // Update the maxPhaseOvershotPower
-            if (phaseOvershotPower > maxPhaseOvershotPower) {
-                maxPhaseOvershotPower = phaseOvershotPower;
-            }
+            maxPhaseOvershotPower = qMax(maxPhaseOvershotPower, phaseOvershotPower);
+        } else {
+            minPhaseMarginPower
+                = qMin(minPhaseMarginPower, phasePowerLimit - allPhasesCurrentPower[phase]);
         }
     }
+
     if (householdLimitExceeded) {
         qCDebug(dcConsolinnoEnergy())
             << "Maximum phase overshot power:" << maxPhaseOvershotPower << "W";
     } else {
         qCDebug(dcConsolinnoEnergy()) << "No phase exceeds the physical limit right now";
+        qCDebug(dcConsolinnoEnergy()) << "The minimum phase power that can be increased without "
+                                         "exceeding the physical phase limit is:"
+                                      << minPhaseMarginPower << "W";
+    }
+
+    decision.householdLimitExceeded = householdLimitExceeded;
+    decision.overshotPower = static_cast<float>(maxPhaseOvershotPower);
+    decision.marginPower = householdLimitExceeded ? 0 : static_cast<float>(minPhaseMarginPower);
+
+    // The optimizer works on a snapshot in its own thread, its actions get applied in
+    // applyOptimizerResult() back on this thread
+    bool limitActive = check14a(decision);
+    QSharedPointer<EngineSnapshot> snapshot
+        = createSnapshot(decision, limitActive, currentPowerNAP);
+
+    // Without a limit the optimizer mostly has nothing to do. As long as the units stay the same
+    // its result would not change, the decision gets recorded right away instead of posting the
+    // snapshot.
+    if (!limitActive && m_optimizerIdle && !isEvaluationPending()
+        && !m_controlLatency.isAwaitingEvaluation() && m_publishedSnapshot
+        && hasSameUnits(*snapshot, *m_publishedSnapshot)) {
+        m_decisionTrace.append(decision);
+        return;
     }
 
-    // dependent on the limitExceeded value, we either set the maxPhaseOvershotPower or the
-    // minPhaseMarginPower
-    foreach (const QString& phase, allPhasesCurrentPower.keys()) {
-        if (allPhasesCurrentPower.value(phase) > phasePowerLimit && householdLimitExceeded) {
-            double phaseOvershotPower = allPhasesCurrentPower.value(phase) - phasePowerLimit;
-            // take the largest overshot power
-            if (phaseOvershotPower > maxPhaseOvershotPower) {
-                maxPhaseOvershotPower = phaseOvershotPower;
-                qCDebug(dcConsolinnoEnergy())
-                    << "The maximum phase power that can be reduced per Phase "
-                       "without exceeding the phase limit is:"
-                    << maxPhaseOvershotPower << "W";
-            }
-        } else if (allPhasesCurrentPower.value(phase) < phasePowerLimit
-            && !householdLimitExceeded) {
-            // update to the smallest minPhaseMarginPower
-            double phaseMarginPower = phasePowerLimit - allPhasesCurrentPower.value(phase);
-            if (phaseMarginPower < minPhaseMarginPower) {
-                minPhaseMarginPower = phaseMarginPower;
-            }
-        } else {
-            // this case is not relevant for maxPhaseOvershotPower and minPhaseMarginPower
-        }
-    }
+    snapshot->revision = ++m_snapshotRevision;
+    m_publishedSnapshot = snapshot;
+    m_optimizerIdle = false;
+    m_optimizer->setLatestRevision(snapshot->revision);
+    QMetaObject::invokeMethod(m_optimizer, "compute", Qt::QueuedConnection,
+        Q_ARG(EngineSnapshotPointer, m_publishedSnapshot));
+}
+
+QList<ControlDecision> EnergyEngine::decisionTrace(int limit) const
+{
+    return m_decisionTrace.decisions(limit);
+}
 
-    qCDebug(dcConsolinnoEnergy()) << "The minimum phase power that can be increased without "
-                                     "exceeding the physical phase limit is:"
-                                  << minPhaseMarginPower << "W";
+// Outdated snapshots get skipped by the optimizer, but the latest one always comes back
+bool EnergyEngine::isEvaluationPending() const { return m_appliedRevision < m_snapshotRevision; }
 
-    check14a();
+EnergyEngine::HemsError EnergyEngine::startChargingAutoTune(
+    const ThingId& evChargerThingId, double stepCurrent)
+{
+    if (!m_evChargers.contains(evChargerThingId))
+        return HemsErrorThingNotFound;
+
+    if (!m_chargingOptimizationConfigurations.contains(evChargerThingId))
+        return HemsErrorInvalidThing;
+
+    if (stepCurrent < 1)
+        return HemsErrorInvalidParameter;
+
+    qCInfo(dcConsolinnoEnergy()) << "Starting PID auto tuning of"
+                                 << m_evChargers.value(evChargerThingId)->name() << "with a step of"
+                                 << stepCurrent << "A";
+    m_autoTuning.insert(evChargerThingId);
+    QMetaObject::invokeMethod(m_optimizer, "startAutoTune", Qt::QueuedConnection,
+        Q_ARG(QUuid, evChargerThingId), Q_ARG(double, stepCurrent));
+    return HemsErrorNoError;
+}
+
+QList<HeatPumpTransition> EnergyEngine::heatPumpTransitions(int limit) const
+{
+    return m_heatPumpTransitions.transitions(limit);
 }
 
 // check whether e.g charging is possible, by checking if the necessary things are available
 // (charger, car and rootMeter)
 void EnergyEngine::evaluateAvailableUseCases()
 {
+    // During the startup all things get attached first, the use cases are evaluated once afterwards
+    if (m_bulkLoading)
+        return;
+
     HemsUseCases availableUseCases;
     if (m_energyManager->rootMeter()) {
         // We need a root meter for the blackout protection
@@ -1481,623 +2010,122 @@ void EnergyEngine::pluggedInEventHandling(Thing* thing)
         qCDebug(dcConsolinnoEnergy()) << "Setting OptimizationEnabled to false";
     }
     setChargingConfiguration(configuration);
-    saveChargingConfigurationToSettings(configuration);
+    m_chargingConfigurationStore.setValue(configuration);
 }
 
 // every configuration needs to be loaded, saved and removed at some point
-void EnergyEngine::loadHeatingConfiguration(const ThingId& heatPumpThingId)
+/*!
+ * \brief EnergyEngine::restoreConfiguration
+ * \details Returns the stored configuration for the given id. If the use case is available and
+ * this thing has no configuration yet, a default configuration gets stored and returned.
+ */
+template <typename T>
+T EnergyEngine::restoreConfiguration(ConfigurationStore<T>& store, const QUuid& id)
 {
-    QSettings settings(NymeaSettings::settingsPath() + "/consolinno.conf", QSettings::IniFormat);
-    settings.beginGroup("HeatingConfigurations");
-    if (settings.childGroups().contains(heatPumpThingId.toString())) {
-        settings.beginGroup(heatPumpThingId.toString());
-
-        HeatingConfiguration configuration;
-        configuration.setHeatPumpThingId(heatPumpThingId);
-        configuration.setOptimizationEnabled(settings.value("optimizationEnabled").toBool());
-        configuration.setHouseType(
-            static_cast<HeatingConfiguration::HouseType>(settings.value("houseType").toInt()));
-        configuration.setFloorHeatingArea(settings.value("floorHeatingArea").toDouble());
-        configuration.setMaxElectricalPower(settings.value("maxElectricalPower").toDouble());
-        configuration.setMaxThermalEnergy(settings.value("maxThermalEnergy").toDouble());
-        configuration.setControllableLocalSystem(
-            settings.value("controllableLocalSystem").toBool());
-        configuration.setHeatMeterThingId(ThingId(settings.value("heatMeterThingId").toUuid()));
-        settings.endGroup(); // ThingId
-
-        m_heatingConfigurations.insert(heatPumpThingId, configuration);
-        emit heatingConfigurationAdded(configuration);
-
+    bool stored = store.contains(id);
+    T configuration = store.value(id);
+    if (stored) {
         qCDebug(dcConsolinnoEnergy()) << "Loaded" << configuration;
     } else {
-        // Heating usecase is available and this heat pump has no configuration yet, lets add
-        // one
-        HeatingConfiguration configuration;
-        configuration.setHeatPumpThingId(heatPumpThingId);
-        m_heatingConfigurations.insert(heatPumpThingId, configuration);
-        emit heatingConfigurationAdded(configuration);
+        store.setValue(configuration);
         qCDebug(dcConsolinnoEnergy()) << "Added new" << configuration;
-        saveHeatingConfigurationToSettings(configuration);
     }
-    settings.endGroup(); // HeatingConfigurations
-}
 
-void EnergyEngine::saveHeatingConfigurationToSettings(
-    const HeatingConfiguration& heatingConfiguration)
-{
-    QSettings settings(NymeaSettings::settingsPath() + "/consolinno.conf", QSettings::IniFormat);
-    settings.beginGroup("HeatingConfigurations");
-    settings.beginGroup(heatingConfiguration.heatPumpThingId().toString());
-    settings.setValue("optimizationEnabled", heatingConfiguration.optimizationEnabled());
-    settings.setValue("houseType", heatingConfiguration.houseType());
-    settings.setValue("floorHeatingArea", heatingConfiguration.floorHeatingArea());
-    settings.setValue("maxElectricalPower", heatingConfiguration.maxElectricalPower());
-    settings.setValue("maxThermalEnergy", heatingConfiguration.maxThermalEnergy());
-    settings.setValue("heatMeterThingId", heatingConfiguration.heatMeterThingId());
-    settings.setValue("controllableLocalSystem", heatingConfiguration.controllableLocalSystem());
-    settings.endGroup();
-    settings.endGroup();
+    return configuration;
 }
 
-void EnergyEngine::removeHeatingConfigurationFromSettings(const ThingId& heatPumpThingId)
+void EnergyEngine::loadHeatingConfiguration(const ThingId& heatPumpThingId)
 {
-    QSettings settings(NymeaSettings::settingsPath() + "/consolinno.conf", QSettings::IniFormat);
-    settings.beginGroup("HeatingConfigurations");
-    settings.beginGroup(heatPumpThingId.toString());
-    settings.remove("");
-    settings.endGroup();
-    settings.endGroup();
+    HeatingConfiguration configuration
+        = restoreConfiguration(m_heatingConfigurationStore, heatPumpThingId);
+    m_heatingConfigurations.insert(heatPumpThingId, configuration);
+    emit heatingConfigurationAdded(configuration);
 }
 
 void EnergyEngine::loadHeatingRodConfiguration(const ThingId& heatingRodThingId)
 {
-    QSettings settings(NymeaSettings::settingsPath() + "/consolinno.conf", QSettings::IniFormat);
-    settings.beginGroup("HeatingRodConfigurations");
-    if (settings.childGroups().contains(heatingRodThingId.toString())) {
-        settings.beginGroup(heatingRodThingId.toString());
-
-        HeatingRodConfiguration configuration;
-        configuration.setHeatingRodThingId(heatingRodThingId);
-        configuration.setOptimizationEnabled(settings.value("optimizationEnabled").toBool());
-        configuration.setMaxElectricalPower(settings.value("maxElectricalPower").toDouble());
-        configuration.setControllableLocalSystem(
-            settings.value("controllableLocalSystem").toBool());
-        settings.endGroup(); // ThingId
-
-        m_heatingRodConfigurations.insert(heatingRodThingId, configuration);
-        emit heatingRodConfigurationAdded(configuration);
-
-        qCDebug(dcConsolinnoEnergy()) << "Loaded" << configuration;
-    } else {
-        // HeatingRod usecase is available and this heat pump has no configuration yet, lets add
-        // one
-        HeatingRodConfiguration configuration;
-        configuration.setHeatingRodThingId(heatingRodThingId);
-        m_heatingRodConfigurations.insert(heatingRodThingId, configuration);
-        emit heatingRodConfigurationAdded(configuration);
-        qCDebug(dcConsolinnoEnergy()) << "Added new" << configuration;
-        saveHeatingRodConfigurationToSettings(configuration);
-    }
-    settings.endGroup(); // HeatingRodConfigurations
-}
-
-void EnergyEngine::saveHeatingRodConfigurationToSettings(
-    const HeatingRodConfiguration& heatingRodConfiguration)
-{
-    QSettings settings(NymeaSettings::settingsPath() + "/consolinno.conf", QSettings::IniFormat);
-    settings.beginGroup("HeatingRodConfigurations");
-    settings.beginGroup(heatingRodConfiguration.heatingRodThingId().toString());
-    settings.setValue("optimizationEnabled", heatingRodConfiguration.optimizationEnabled());
-    settings.setValue("maxElectricalPower", heatingRodConfiguration.maxElectricalPower());
-    settings.setValue("controllableLocalSystem", heatingRodConfiguration.controllableLocalSystem());
-    settings.endGroup();
-    settings.endGroup();
-}
-
-void EnergyEngine::removeHeatingRodConfigurationFromSettings(const ThingId& heatingRodThingId)
-{
-    QSettings settings(NymeaSettings::settingsPath() + "/consolinno.conf", QSettings::IniFormat);
-    settings.beginGroup("HeatingRodConfigurations");
-    settings.beginGroup(heatingRodThingId.toString());
-    settings.remove("");
-    settings.endGroup();
-    settings.endGroup();
+    HeatingRodConfiguration configuration
+        = restoreConfiguration(m_heatingRodConfigurationStore, heatingRodThingId);
+    m_heatingRodConfigurations.insert(heatingRodThingId, configuration);
+    emit heatingRodConfigurationAdded(configuration);
 }
 
 void EnergyEngine::loadDynamicElectricPricingConfiguration(
     const ThingId& dynamicElectricPricingThingId)
 {
-    QSettings settings(NymeaSettings::settingsPath() + "/consolinno.conf", QSettings::IniFormat);
-    settings.beginGroup("DynamicElectricPricingConfigurations");
-    if (settings.childGroups().contains(dynamicElectricPricingThingId.toString())) {
-        settings.beginGroup(dynamicElectricPricingThingId.toString());
-
-        DynamicElectricPricingConfiguration configuration;
-        configuration.setDynamicElectricPricingThingId(dynamicElectricPricingThingId);
-        configuration.setOptimizationEnabled(settings.value("optimizationEnabled").toBool());
-        configuration.setMaxElectricalPower(settings.value("maxElectricalPower").toDouble());
-        settings.endGroup(); // ThingId
-
-        m_dynamicElectricPricingConfigurations.insert(dynamicElectricPricingThingId, configuration);
-        emit dynamicElectricPricingConfigurationAdded(configuration);
-
-        qCDebug(dcConsolinnoEnergy()) << "Loaded" << configuration;
-    } else {
-        // Dynamic Electric Pricing usecase is available and this heat pump has no configuration
-        // yet, lets add one
-        DynamicElectricPricingConfiguration configuration;
-        configuration.setDynamicElectricPricingThingId(dynamicElectricPricingThingId);
-        m_dynamicElectricPricingConfigurations.insert(dynamicElectricPricingThingId, configuration);
-        emit dynamicElectricPricingConfigurationAdded(configuration);
-        qCDebug(dcConsolinnoEnergy()) << "Added new" << configuration;
-        saveDynamicElectricPricingConfigurationToSettings(configuration);
-    }
-    settings.endGroup(); // DynamicElectricPricingConfigurations
-}
-
-void EnergyEngine::saveDynamicElectricPricingConfigurationToSettings(
-    const DynamicElectricPricingConfiguration& dynamicElectricPricingConfiguration)
-{
-    QSettings settings(NymeaSettings::settingsPath() + "/consolinno.conf", QSettings::IniFormat);
-    settings.beginGroup("DynamicElectricPricingConfigurations");
-    settings.beginGroup(
-        dynamicElectricPricingConfiguration.dynamicElectricPricingThingId().toString());
-    settings.setValue(
-        "optimizationEnabled", dynamicElectricPricingConfiguration.optimizationEnabled());
-    settings.setValue(
-        "maxElectricalPower", dynamicElectricPricingConfiguration.maxElectricalPower());
-    settings.endGroup();
-    settings.endGroup();
-}
-
-void EnergyEngine::removeDynamicElectricPricingConfigurationFromSettings(
-    const ThingId& dynamicElectricPricingThingId)
-{
-    QSettings settings(NymeaSettings::settingsPath() + "/consolinno.conf", QSettings::IniFormat);
-    settings.beginGroup("DynamicElectricPricingConfigurations");
-    settings.beginGroup(dynamicElectricPricingThingId.toString());
-    settings.remove("");
-    settings.endGroup();
-    settings.endGroup();
+    DynamicElectricPricingConfiguration configuration = restoreConfiguration(
+        m_dynamicElectricPricingConfigurationStore, dynamicElectricPricingThingId);
+    m_dynamicElectricPricingConfigurations.insert(dynamicElectricPricingThingId, configuration);
+    emit dynamicElectricPricingConfigurationAdded(configuration);
 }
 
 void EnergyEngine::loadWashingMachineConfiguration(const ThingId& washingMachineThingId)
 {
-    QSettings settings(NymeaSettings::settingsPath() + "/consolinno.conf", QSettings::IniFormat);
-    settings.beginGroup("WashingMachineConfigurations");
-    if (settings.childGroups().contains(washingMachineThingId.toString())) {
-        settings.beginGroup(washingMachineThingId.toString());
-
-        WashingMachineConfiguration configuration;
-        configuration.setWashingMachineThingId(washingMachineThingId);
-        configuration.setOptimizationEnabled(settings.value("optimizationEnabled").toBool());
-        configuration.setMaxElectricalPower(settings.value("maxElectricalPower").toDouble());
-        settings.endGroup(); // ThingId
-
-        m_washingMachineConfigurations.insert(washingMachineThingId, configuration);
-        emit washingMachineConfigurationAdded(configuration);
-
-        qCDebug(dcConsolinnoEnergy()) << "Loaded" << configuration;
-    } else {
-        // WashingMachine usecase is available and this heat pump has no configuration yet, lets add
-        // one
-        WashingMachineConfiguration configuration;
-        configuration.setWashingMachineThingId(washingMachineThingId);
-        m_washingMachineConfigurations.insert(washingMachineThingId, configuration);
-        emit washingMachineConfigurationAdded(configuration);
-        qCDebug(dcConsolinnoEnergy()) << "Added new" << configuration;
-        saveWashingMachineConfigurationToSettings(configuration);
-    }
-    settings.endGroup(); // WashingMachineConfigurations
-}
-
-void EnergyEngine::saveWashingMachineConfigurationToSettings(
-    const WashingMachineConfiguration& washingMachineConfiguration)
-{
-    QSettings settings(NymeaSettings::settingsPath() + "/consolinno.conf", QSettings::IniFormat);
-    settings.beginGroup("WashingMachineConfigurations");
-    settings.beginGroup(washingMachineConfiguration.washingMachineThingId().toString());
-    settings.setValue("optimizationEnabled", washingMachineConfiguration.optimizationEnabled());
-    settings.setValue("maxElectricalPower", washingMachineConfiguration.maxElectricalPower());
-    settings.endGroup();
-    settings.endGroup();
-}
-
-void EnergyEngine::removeWashingMachineConfigurationFromSettings(
-    const ThingId& washingMachineThingId)
-{
-    QSettings settings(NymeaSettings::settingsPath() + "/consolinno.conf", QSettings::IniFormat);
-    settings.beginGroup("WashingMachineConfigurations");
-    settings.beginGroup(washingMachineThingId.toString());
-    settings.remove("");
-    settings.endGroup();
-    settings.endGroup();
+    WashingMachineConfiguration configuration
+        = restoreConfiguration(m_washingMachineConfigurationStore, washingMachineThingId);
+    m_washingMachineConfigurations.insert(washingMachineThingId, configuration);
+    emit washingMachineConfigurationAdded(configuration);
 }
 
 void EnergyEngine::loadUserConfiguration()
 {
     QUuid userConfigID = "528b3820-1b6d-4f37-aea7-a99d21d42e72";
-    QSettings settings(NymeaSettings::settingsPath() + "/consolinno.conf", QSettings::IniFormat);
-    settings.beginGroup("UserConfigurations");
-    if (settings.childGroups().contains(userConfigID.toString())) {
-        settings.beginGroup(userConfigID.toString());
-
-        UserConfiguration configuration;
-        configuration.setLastSelectedCar(settings.value("lastSelectedCar").toUuid());
-        configuration.setDefaultChargingMode(settings.value("defaultChargingMode").toInt());
-        configuration.setInstallerName(settings.value("installerName").toString());
-        configuration.setInstallerEmail(settings.value("installerEmail").toString());
-        configuration.setInstallerPhoneNr(settings.value("installerPhoneNr").toString());
-        configuration.setInstallerWorkplace(settings.value("installerWorkplace").toString());
-
-        settings.endGroup(); // ThingId
-
-        m_userConfigurations.insert(userConfigID, configuration);
-        emit userConfigurationAdded(configuration);
-
-        qCDebug(dcConsolinnoEnergy()) << "Loaded" << configuration;
-    } else {
-        // UserConfig does not exist yet, so add one
-        UserConfiguration configuration;
-        m_userConfigurations.insert(userConfigID, configuration);
-        emit userConfigurationAdded(configuration);
-        qCDebug(dcConsolinnoEnergy()) << "Added new" << configuration;
-        saveUserConfigurationToSettings(configuration);
-    }
-    settings.endGroup(); // HeatingConfigurations
-}
-
-void EnergyEngine::saveUserConfigurationToSettings(const UserConfiguration& userConfiguration)
-{
-    qCDebug(dcConsolinnoEnergy()) << "saveUserConfiguration" << userConfiguration;
-    QSettings settings(NymeaSettings::settingsPath() + "/consolinno.conf", QSettings::IniFormat);
-    settings.beginGroup("UserConfigurations");
-    settings.beginGroup(userConfiguration.userConfigID().toString());
-    settings.setValue("lastSelectedCar", userConfiguration.lastSelectedCar());
-    settings.setValue("defaultChargingMode", userConfiguration.defaultChargingMode());
-    settings.setValue("installerName", userConfiguration.installerName());
-    settings.setValue("installerEmail", userConfiguration.installerEmail());
-    settings.setValue("installerPhoneNr", userConfiguration.installerPhoneNr());
-    settings.setValue("installerWorkplace", userConfiguration.installerWorkplace());
-
-    settings.endGroup();
-    settings.endGroup();
-}
-
-void EnergyEngine::removeUserConfigurationFromSettings()
-{
-    QUuid userConfigID = "528b3820-1b6d-4f37-aea7-a99d21d42e72";
-    QSettings settings(NymeaSettings::settingsPath() + "/consolinno.conf", QSettings::IniFormat);
-    settings.beginGroup("UserConfigurations");
-    settings.beginGroup(userConfigID.toString());
-    settings.remove("");
-    settings.endGroup();
-    settings.endGroup();
+    UserConfiguration configuration = restoreConfiguration(m_userConfigurationStore, userConfigID);
+    m_userConfigurations.insert(userConfigID, configuration);
+    emit userConfigurationAdded(configuration);
 }
 
 void EnergyEngine::loadBatteryConfiguration(const ThingId& batteryThingId)
 {
-
-    QSettings settings(NymeaSettings::settingsPath() + "/consolinno.conf", QSettings::IniFormat);
-    settings.beginGroup("BatteryConfigurations");
-    if (settings.childGroups().contains(batteryThingId.toString())) {
-        settings.beginGroup(batteryThingId.toString());
-
-        BatteryConfiguration configuration;
-        configuration.setBatteryThingId(batteryThingId);
-        configuration.setOptimizationEnabled(settings.value("optimizationEnabled").toBool());
-        configuration.setControllableLocalSystem(
-            settings.value("controllableLocalSystem").toBool());
-        settings.endGroup();
-
-        m_batteryConfigurations.insert(batteryThingId, configuration);
-        emit batteryConfigurationAdded(configuration);
-
-        qCDebug(dcConsolinnoEnergy()) << "Loaded" << configuration;
-    } else {
-        // Battery usecase is available and this battery has no configuration yet, lets add one
-        BatteryConfiguration configuration;
-        configuration.setBatteryThingId(batteryThingId);
-        m_batteryConfigurations.insert(batteryThingId, configuration);
-        emit batteryConfigurationAdded(configuration);
-
-        qCDebug(dcConsolinnoEnergy()) << "Added new" << configuration;
-        saveBatteryConfigurationToSettings(configuration);
-    }
-    settings.endGroup(); // BatteryConfigurations
-}
-
-void EnergyEngine::saveBatteryConfigurationToSettings(
-    const BatteryConfiguration& batteryConfiguration)
-{
-    QSettings settings(NymeaSettings::settingsPath() + "/consolinno.conf", QSettings::IniFormat);
-    settings.beginGroup("BatteryConfigurations");
-    settings.beginGroup(batteryConfiguration.batteryThingId().toString());
-    settings.setValue("optimizationEnabled", batteryConfiguration.optimizationEnabled());
-    settings.setValue("controllableLocalSystem", batteryConfiguration.controllableLocalSystem());
-    settings.endGroup();
-    settings.endGroup();
-}
-
-void EnergyEngine::removeBatteryConfigurationFromSettings(const ThingId& batteryThingId)
-{
-    QSettings settings(NymeaSettings::settingsPath() + "/consolinno.conf", QSettings::IniFormat);
-    settings.beginGroup("BatteryConfigurations");
-    settings.beginGroup(batteryThingId.toString());
-    settings.remove("");
-    settings.endGroup();
-    settings.endGroup();
+    BatteryConfiguration configuration
+        = restoreConfiguration(m_batteryConfigurationStore, batteryThingId);
+    m_batteryConfigurations.insert(batteryThingId, configuration);
+    emit batteryConfigurationAdded(configuration);
 }
 
 void EnergyEngine::loadChargingConfiguration(const ThingId& evChargerThingId)
 {
-    QSettings settings(NymeaSettings::settingsPath() + "/consolinno.conf", QSettings::IniFormat);
-    settings.beginGroup("ChargingConfigurations");
-    if (settings.childGroups().contains(evChargerThingId.toString())) {
-        settings.beginGroup(evChargerThingId.toString());
-
-        ChargingConfiguration configuration;
-        configuration.setEvChargerThingId(evChargerThingId);
-        configuration.setOptimizationEnabled(settings.value("optimizationEnabled").toBool());
-        configuration.setCarThingId(ThingId(settings.value("carThingId").toUuid()));
-        configuration.setEndTime(settings.value("endTime").toString());
-        configuration.setTargetPercentage(settings.value("targetPercentage").toUInt());
-        configuration.setOptimizationMode(settings.value("optimizationMode").toInt());
-        configuration.setUniqueIdentifier(settings.value("uniqueIdentifier").toUuid());
-        configuration.setControllableLocalSystem(
-            settings.value("controllableLocalSystem").toBool());
-        configuration.setPriceThreshold(settings.value("priceThreshold").toFloat());
-        settings.endGroup();
-
-        m_chargingConfigurations.insert(evChargerThingId, configuration);
-        emit chargingConfigurationAdded(configuration);
-
-        qCDebug(dcConsolinnoEnergy()) << "Loaded" << configuration;
-    } else {
-        // Charging usecase is available and this ev charger has no configuration yet, lets add
-        // one
-        ChargingConfiguration configuration;
-        configuration.setEvChargerThingId(evChargerThingId);
-        m_chargingConfigurations.insert(evChargerThingId, configuration);
-        emit chargingConfigurationAdded(configuration);
-
-        qCDebug(dcConsolinnoEnergy()) << "Added new" << configuration;
-        saveChargingConfigurationToSettings(configuration);
-    }
-    settings.endGroup(); // ChargingConfigurations
-}
-
-void EnergyEngine::saveChargingConfigurationToSettings(
-    const ChargingConfiguration& chargingConfiguration)
-{
-    QSettings settings(NymeaSettings::settingsPath() + "/consolinno.conf", QSettings::IniFormat);
-    settings.beginGroup("ChargingConfigurations");
-    settings.beginGroup(chargingConfiguration.evChargerThingId().toString());
-
-    settings.setValue("optimizationEnabled", chargingConfiguration.optimizationEnabled());
-    settings.setValue("carThingId", chargingConfiguration.carThingId());
-    settings.setValue("endTime", chargingConfiguration.endTime());
-    settings.setValue("targetPercentage", chargingConfiguration.targetPercentage());
-    settings.setValue("optimizationMode", chargingConfiguration.optimizationMode());
-    settings.setValue("uniqueIdentifier", chargingConfiguration.uniqueIdentifier());
-    settings.setValue("controllableLocalSystem", chargingConfiguration.controllableLocalSystem());
-    settings.setValue("priceThreshold", chargingConfiguration.priceThreshold());
-    
-    settings.endGroup();
-    settings.endGroup();
-}
-
-void EnergyEngine::removeChargingConfigurationFromSettings(const ThingId& evChargerThingId)
-{
-    QSettings settings(NymeaSettings::settingsPath() + "/consolinno.conf", QSettings::IniFormat);
-    settings.beginGroup("ChargingConfigurations");
-    settings.beginGroup(evChargerThingId.toString());
-    settings.remove("");
-    settings.endGroup();
-    settings.endGroup();
+    ChargingConfiguration configuration
+        = restoreConfiguration(m_chargingConfigurationStore, evChargerThingId);
+    m_chargingConfigurations.insert(evChargerThingId, configuration);
+    emit chargingConfigurationAdded(configuration);
 }
 
 void EnergyEngine::loadChargingOptimizationConfiguration(const ThingId& evChargerThingId)
 {
-
-    QSettings settings(NymeaSettings::settingsPath() + "/consolinno.conf", QSettings::IniFormat);
-    settings.beginGroup("ChargingOptimizationConfigurations");
-    if (settings.childGroups().contains(evChargerThingId.toString())) {
-        settings.beginGroup(evChargerThingId.toString());
-
-        ChargingOptimizationConfiguration configuration;
-        configuration.setEvChargerThingId(evChargerThingId);
-        configuration.setReenableChargepoint(settings.value("reenableChargepoint").toBool());
-        configuration.setP_value(settings.value("p_value").toFloat());
-        configuration.setI_value(settings.value("i_value").toFloat());
-        configuration.setD_value(settings.value("d_value").toFloat());
-        configuration.setSetpoint(settings.value("setpoint").toFloat());
-        configuration.setControllableLocalSystem(
-            settings.value("controllableLocalSystem").toBool());
-
-        settings.endGroup();
-
-        m_chargingOptimizationConfigurations.insert(evChargerThingId, configuration);
-        emit chargingOptimizationConfigurationAdded(configuration);
-
-        qCDebug(dcConsolinnoEnergy()) << "Loaded" << configuration;
-    } else {
-        // Charging usecase is available and this ev charger has no configuration yet, lets add
-        // one
-        ChargingOptimizationConfiguration configuration;
-        configuration.setEvChargerThingId(evChargerThingId);
-        m_chargingOptimizationConfigurations.insert(evChargerThingId, configuration);
-        emit chargingOptimizationConfigurationAdded(configuration);
-
-        qCDebug(dcConsolinnoEnergy()) << "Added new" << configuration;
-        saveChargingOptimizationConfigurationToSettings(configuration);
-    }
-    settings.endGroup(); // ChargingOptimizationConfigurations
-}
-
-void EnergyEngine::saveChargingOptimizationConfigurationToSettings(
-    const ChargingOptimizationConfiguration& chargingOptimizationConfiguration)
-{
-    QSettings settings(NymeaSettings::settingsPath() + "/consolinno.conf", QSettings::IniFormat);
-    settings.beginGroup("ChargingOptimizationConfigurations");
-    settings.beginGroup(chargingOptimizationConfiguration.evChargerThingId().toString());
-    settings.setValue(
-        "reenableChargepoint", chargingOptimizationConfiguration.reenableChargepoint());
-    settings.setValue("p_value", chargingOptimizationConfiguration.p_value());
-    settings.setValue("i_value", chargingOptimizationConfiguration.i_value());
-    settings.setValue("d_value", chargingOptimizationConfiguration.d_value());
-    settings.setValue("setpoint", chargingOptimizationConfiguration.setpoint());
-    settings.setValue(
-        "controllableLocalSystem", chargingOptimizationConfiguration.controllableLocalSystem());
-
-    settings.endGroup();
-    settings.endGroup();
-}
-
-void EnergyEngine::removeChargingOptimizationConfigurationFromSettings(
-    const ThingId& evChargerThingId)
-{
-    QSettings settings(NymeaSettings::settingsPath() + "/consolinno.conf", QSettings::IniFormat);
-    settings.beginGroup("ChargingOptimizationConfigurations");
-    settings.beginGroup(evChargerThingId.toString());
-    settings.remove("");
-    settings.endGroup();
-    settings.endGroup();
-}
-
-void EnergyEngine::savePvConfigurationToSettings(const PvConfiguration& pvConfiguration)
-{
-
-    QSettings settings(NymeaSettings::settingsPath() + "/consolinno.conf", QSettings::IniFormat);
-    settings.beginGroup("PvConfigurations");
-    settings.beginGroup(pvConfiguration.pvThingId().toString());
-    settings.setValue("longitude", pvConfiguration.longitude());
-    settings.setValue("latitude", pvConfiguration.latitude());
-    settings.setValue("roofPitch", pvConfiguration.roofPitch());
-    settings.setValue("alignment", pvConfiguration.alignment());
-    settings.setValue("kwPeak", pvConfiguration.kwPeak());
-    settings.endGroup();
-    settings.endGroup();
-}
-
-void EnergyEngine::removePvConfigurationFromSettings(const ThingId& pvThingId)
-{
-
-    QSettings settings(NymeaSettings::settingsPath() + "/consolinno.conf", QSettings::IniFormat);
-    settings.beginGroup("PvConfigurations");
-    settings.beginGroup(pvThingId.toString());
-    settings.remove("");
-    settings.endGroup();
-    settings.endGroup();
+    ChargingOptimizationConfiguration configuration
+        = restoreConfiguration(m_chargingOptimizationConfigurationStore, evChargerThingId);
+    m_chargingOptimizationConfigurations.insert(evChargerThingId, configuration);
+    emit chargingOptimizationConfigurationAdded(configuration);
 }
 
 void EnergyEngine::loadPvConfiguration(const ThingId& pvThingId)
 {
-
-    QSettings settings(NymeaSettings::settingsPath() + "/consolinno.conf", QSettings::IniFormat);
-    settings.beginGroup("PvConfigurations");
-    qCDebug(dcConsolinnoEnergy()) << "Pv settings: " << settings.childGroups();
-    if (settings.childGroups().contains(pvThingId.toString())) {
-        settings.beginGroup(pvThingId.toString());
-
-        PvConfiguration configuration;
-        configuration.setPvThingId(pvThingId);
-        configuration.setLongitude(settings.value("longitude").toFloat());
-        configuration.setLatitude(settings.value("latitude").toFloat());
-        configuration.setRoofPitch(settings.value("roofPitch").toInt());
-        configuration.setAlignment(settings.value("alignment").toInt());
-        configuration.setKwPeak(settings.value("kwPeak").toFloat());
-
-        settings.endGroup(); // ThingId
-
-        m_pvConfigurations.insert(pvThingId, configuration);
-
-        emit pvConfigurationAdded(configuration);
-
-        qCDebug(dcConsolinnoEnergy()) << "Loaded";
-    } else {
-        // Pv usecase is available and this inverter has no configuration yet, lets add one
-        PvConfiguration configuration;
-        configuration.setPvThingId(pvThingId);
-        m_pvConfigurations.insert(pvThingId, configuration);
-        emit pvConfigurationAdded(configuration);
-        qCDebug(dcConsolinnoEnergy()) << "Added new";
-        savePvConfigurationToSettings(configuration);
-    }
-    settings.endGroup(); // PvConfigurations
+    PvConfiguration configuration = restoreConfiguration(m_pvConfigurationStore, pvThingId);
+    m_pvConfigurations.insert(pvThingId, configuration);
+    emit pvConfigurationAdded(configuration);
 }
 
 void EnergyEngine::loadChargingSessionConfiguration(const ThingId& evChargerThingId)
 {
-    QSettings settings(NymeaSettings::settingsPath() + "/consolinno.conf", QSettings::IniFormat);
-    settings.beginGroup("ChargingSessionConfigurations");
-    // qCDebug(dcConsolinnoEnergy()) << "Charging Session settings: " << settings.childGroups();
-    if (settings.childGroups().contains(evChargerThingId.toString())) {
-        settings.beginGroup(evChargerThingId.toString());
-
-        ChargingSessionConfiguration configuration;
-
-        configuration.setEvChargerThingId(evChargerThingId);
-        configuration.setCarThingId(settings.value("carThingId").toUuid());
-        configuration.setStartedAt(settings.value("startedAt").toString());
-        configuration.setFinishedAt(settings.value("finishedAt").toString());
-        configuration.setInitialBatteryEnergy(settings.value("initialBatteryEnergy").toFloat());
-        configuration.setDuration(settings.value("duration").toInt());
-        configuration.setEnergyCharged(settings.value("energyCharged").toFloat());
-        configuration.setEnergyBattery(settings.value("energyBattery").toFloat());
-        configuration.setBatteryLevel(settings.value("batteryLevel").toInt());
-        configuration.setSessionId(settings.value("sessionId").toUuid());
-        configuration.setState(settings.value("state").toInt());
-        configuration.setTimestamp(settings.value("timestamp").toInt());
-
-        settings.endGroup();
-
-        m_chargingSessionConfigurations.insert(evChargerThingId, configuration);
-        emit chargingSessionConfigurationAdded(configuration);
-
-        // qCDebug(dcConsolinnoEnergy()) << "Loaded" << configuration;
-    } else {
-        // Charging usecase is available and this ev charger has no configuration yet, lets add
-        // one
-        ChargingSessionConfiguration configuration;
-        configuration.setEvChargerThingId(evChargerThingId);
-        m_chargingSessionConfigurations.insert(evChargerThingId, configuration);
-        emit chargingSessionConfigurationAdded(configuration);
-
-        // qCDebug(dcConsolinnoEnergy()) << "Added new" << configuration;
-        saveChargingSessionConfigurationToSettings(configuration);
-    }
-    settings.endGroup(); // ChargingSessionConfigurations
+    ChargingSessionConfiguration configuration
+        = restoreConfiguration(m_chargingSessionConfigurationStore, evChargerThingId);
+    m_chargingSessionConfigurations.insert(evChargerThingId, configuration);
+    emit chargingSessionConfigurationAdded(configuration);
 }
 
 void EnergyEngine::saveChargingSessionConfigurationToSettings(
     const ChargingSessionConfiguration& chargingSessionConfiguration)
 {
-    // qCDebug(dcConsolinnoEnergy() ) << " saving ChargingSessionConfiguration" ;
-    QSettings settings(NymeaSettings::settingsPath() + "/consolinno.conf", QSettings::IniFormat);
-    settings.beginGroup("ChargingSessionConfigurations");
-    settings.beginGroup(chargingSessionConfiguration.evChargerThingId().toString());
-    settings.setValue("carThingId", chargingSessionConfiguration.carThingId());
-    settings.setValue("startedAt", chargingSessionConfiguration.startedAt());
-    settings.setValue("finishedAt", chargingSessionConfiguration.finishedAt());
-    settings.setValue("initialBatteryEnergy", chargingSessionConfiguration.initialBatteryEnergy());
-    settings.setValue("duration", chargingSessionConfiguration.duration());
-    settings.setValue("energyCharged", chargingSessionConfiguration.energyCharged());
-    settings.setValue("energyBattery", chargingSessionConfiguration.energyBattery());
-    settings.setValue("batteryLevel", chargingSessionConfiguration.batteryLevel());
-    settings.setValue("sessionId", chargingSessionConfiguration.sessionId());
-    settings.setValue("state", chargingSessionConfiguration.state());
-    settings.setValue("timestamp", chargingSessionConfiguration.timestamp());
-    settings.endGroup();
-    settings.endGroup();
+    // Sessions change continuously, the journal keeps them durable until the next flush. If the
+    // journal can not be written, fall back to a regular store write.
+    bool journaled = m_sessionJournal->append(chargingSessionConfiguration);
+    m_chargingSessionConfigurationStore.setValue(chargingSessionConfiguration, journaled);
 }
 
 void EnergyEngine::removeChargingSessionConfigurationFromSettings(const ThingId& evChargerThingId)
 {
-    QSettings settings(NymeaSettings::settingsPath() + "/consolinno.conf", QSettings::IniFormat);
-    settings.beginGroup("ChargingSessionConfigurations");
-    settings.beginGroup(evChargerThingId.toString());
-    settings.remove("");
-    settings.endGroup();
-    settings.endGroup();
+    // Make sure older journal records do not bring the session back if we crash before the flush
+    m_sessionJournal->appendRemoval(evChargerThingId);
+    m_chargingSessionConfigurationStore.remove(evChargerThingId);
 }
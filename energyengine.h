@@ -8,8 +8,13 @@
 
 #include <QHash>
 #include <QNetworkAccessManager>
+#include <QPointer>
+#include <QSet>
+#include <QThread>
 #include <QTimer>
 
+#include <array>
+
 #include <energymanager.h>
 #include <integrations/integrationplugin.h>
 #include <integrations/thingmanager.h>
@@ -26,6 +31,21 @@
 #include "configurations/userconfiguration.h"
 #include "configurations/washingmachineconfiguration.h"
 
+#include "configurationstore.h"
+#include "consumptionlimitarbiter.h"
+#include "controllatency.h"
+#include "decisiontrace.h"
+#include "heatpumpswitching.h"
+#include "limitsourcemanager.h"
+#include "optimizerworker.h"
+#include "stateaccessorcache.h"
+
+class ChargingSessionHistory;
+class ControlLoopScheduler;
+class EngineCaptureWriter;
+class SessionJournal;
+class SetpointActuator;
+
 // #include "jsonrpccxx/iclientconnector.hpp"
 // #include "jsonrpccxx/client.hpp"
 
@@ -65,8 +85,12 @@ public:
     Q_DECLARE_FLAGS(HemsUseCases, HemsUseCase)
     Q_FLAG(HemsUseCases)
 
+    static const int phaseCount = 3;
+    typedef std::array<double, phaseCount> PhaseVector;
+
     explicit EnergyEngine(
         ThingManager* thingManager, EnergyManager* energyManager, QObject* parent = nullptr);
+    ~EnergyEngine() override;
 
     EnergyEngine::HemsUseCases availableUseCases() const;
 
@@ -117,6 +141,31 @@ public:
     EnergyEngine::HemsError setChargingSessionConfiguration(
         const ChargingSessionConfiguration& chargingSessionConfiguration);
 
+    // Finished charging sessions recorded within [from, to] in seconds since epoch, oldest first.
+    // A limit keeps the newest sessions of the range.
+    QList<ChargingSessionConfiguration> chargingSessions(
+        const ThingId& evChargerThingId, qint64 from, qint64 to, int limit) const;
+
+    // Steps the charging current of the ev charger and derives its PID gains from the grid power
+    // response, the gains get stored in the charging optimization configuration. stepCurrent in A.
+    EnergyEngine::HemsError startChargingAutoTune(const ThingId& evChargerThingId,
+        double stepCurrent);
+
+    // Latest control loop decisions, oldest first
+    QList<ControlDecision> decisionTrace(int limit) const;
+
+    // True while the actions of the latest evaluation are still computed by the optimizer
+    bool isEvaluationPending() const;
+
+    // Latest SG-ready transitions of the CLS heat pumps, oldest first
+    QList<HeatPumpTransition> heatPumpTransitions(int limit) const;
+
+    // Connection state of the consumption limit sources
+    QList<LimitSourceStatus> limitSources() const;
+
+    // Latencies from receiving a consumption limit to the resulting actions, per limit source
+    QList<ControlLatencyStats> controlLatencyStats() const;
+
     // Pv configurations
     QList<PvConfiguration> pvConfigurations() const;
     EnergyEngine::HemsError setPvConfiguration(const PvConfiguration& pvConfiguration);
@@ -187,14 +236,56 @@ signals:
 private:
     ThingManager* m_thingManager = nullptr;
     EnergyManager* m_energyManager = nullptr;
+    SettingsStore* m_settings = nullptr;
+    SessionJournal* m_sessionJournal = nullptr;
+    ChargingSessionHistory* m_chargingSessionHistory = nullptr;
+    ControlLoopScheduler* m_controlLoop = nullptr;
+    SetpointActuator* m_setpointActuator = nullptr;
+    EngineCaptureWriter* m_capture = nullptr;
+    LimitSourceManager* m_limitSources = nullptr;
+    OptimizerWorker* m_optimizer = nullptr;
+    QThread m_optimizerThread;
+    quint64 m_snapshotRevision = 0;
+    quint64 m_appliedRevision = 0;
+    // Snapshots the optimizer is done with get filled again, see acquireSnapshot()
+    QVector<QSharedPointer<EngineSnapshot>> m_snapshotPool;
+    EngineSnapshotPointer m_publishedSnapshot;
+    bool m_optimizerIdle = false;
+    // Ev chargers the optimizer is tuning, they are part of every snapshot until it reports back
+    QSet<ThingId> m_autoTuning;
+    QPointer<Thing> m_rootMeter;
+    ThingClassAccessorsPointer m_rootMeterAccessors;
+
+    DecisionTrace m_decisionTrace;
+    HeatPumpTransitionLog m_heatPumpTransitions;
+
+    // Effective consumption limit of all limit sources, cached in m_consumptionLimit
+    ConsumptionLimitArbiter m_limitArbiter;
+    QTimer m_limitExpiryTimer;
+    ControlLatencyTracker m_controlLatency;
+
+    // Resolved state and action types of all monitored thing classes
+    StateAccessorCache m_stateAccessors;
+
+    ConfigurationStore<UserConfiguration> m_userConfigurationStore;
+    ConfigurationStore<HeatingConfiguration> m_heatingConfigurationStore;
+    ConfigurationStore<HeatingRodConfiguration> m_heatingRodConfigurationStore;
+    ConfigurationStore<DynamicElectricPricingConfiguration>
+        m_dynamicElectricPricingConfigurationStore;
+    ConfigurationStore<WashingMachineConfiguration> m_washingMachineConfigurationStore;
+    ConfigurationStore<ChargingConfiguration> m_chargingConfigurationStore;
+    ConfigurationStore<ChargingOptimizationConfiguration> m_chargingOptimizationConfigurationStore;
+    ConfigurationStore<BatteryConfiguration> m_batteryConfigurationStore;
+    ConfigurationStore<PvConfiguration> m_pvConfigurationStore;
+    ConfigurationStore<ChargingSessionConfiguration> m_chargingSessionConfigurationStore;
 
     // System information
     HemsUseCases m_availableUseCases;
     uint m_housholdPhaseLimit = 25;
     uint m_housholdPhaseCount = 3;
     float m_consumptionLimit = -1;
-    float m_consumptionLimitOPC = -1;
     double m_housholdPowerLimit = m_housholdPhaseCount * m_housholdPhaseLimit;
+    double m_housholdPhasePowerLimit = 230.0 * m_housholdPhaseLimit;
 
     QHash<ThingId, HeatingConfiguration> m_heatingConfigurations;
     QHash<ThingId, HeatingRodConfiguration> m_heatingRodConfigurations;
@@ -218,6 +309,9 @@ private:
     Thing* m_gridsupportDevice = nullptr;
     ThingId m_gridsupportThingId;
 
+    // True while the configured things get attached on startup
+    bool m_bulkLoading = false;
+
     bool m_hybridSimulationEnabled = false;
     QMap<QString, QVariant> m_hybridSimulationMap;
     bool m_hybridSimIgnoreSimulated = true;
@@ -235,75 +329,63 @@ private:
 
     void pluggedInEventHandling(Thing* thing);
 
-    void deactivateHeatPump();
-    void dimmWallbox();
-    void check14a();
+    // Returns true if the CLS units have to be limited
+    bool check14a(DecisionTrace::Record& decision);
+    QSharedPointer<EngineSnapshot> acquireSnapshot();
+    QSharedPointer<EngineSnapshot> createSnapshot(
+        const DecisionTrace::Record& decision, bool limitActive, double gridPower);
+    bool isConsumptionLimitDrop(qlonglong consumptionLimit) const;
+    void applyEffectiveConsumptionLimit();
+    void scheduleConsumptionLimitExpiry();
+    double rootMeterPower();
+    void publishControlLatency();
 
     bool m_gridSupportThingAdded = false;
     void addGridSupportThingIfNotExists();
 
     void initDBUS();
 
+    void initSessionJournal();
+    void initCapture();
+    void captureConfigurations();
+
+    template <typename T> T restoreConfiguration(ConfigurationStore<T>& store, const QUuid& id);
+
 public slots:
-    void onConsumptionLimitChanged(qlonglong consumptionLimit);
-    void onConsumptionLimitChangedOPC(qlonglong consumptionLimit);
+    void onConsumptionLimitChanged(
+        ControlLatencyTracker::Source source, qlonglong consumptionLimit);
+    void onConsumptionLimitFetched(
+        ControlLatencyTracker::Source source, qlonglong consumptionLimit);
 
 private slots:
     void onThingAdded(Thing* thing);
     void onThingRemoved(const ThingId& thingId);
 
     void onRootMeterChanged();
+    void onRootMeterStateValueChanged(const StateTypeId& stateTypeId, const QVariant& value);
 
     void evaluateAndSetMaxChargingCurrent();
+    void applyOptimizerResult(const OptimizerResult& result);
+    void onConsumptionLimitExpired();
+    void onVirtualTimeAdvanced(qint64 msecsSinceEpoch);
     void updateHybridSimulation(Thing* thing);
 
     void evaluateAvailableUseCases();
 
     void loadUserConfiguration();
-    void saveUserConfigurationToSettings(const UserConfiguration& userConfiguration);
-    void removeUserConfigurationFromSettings();
-
     void loadHeatingConfiguration(const ThingId& heatPumpThingId);
-    void saveHeatingConfigurationToSettings(const HeatingConfiguration& heatingConfiguration);
-    void removeHeatingConfigurationFromSettings(const ThingId& heatPumpThingId);
-
     void loadHeatingRodConfiguration(const ThingId& heatingRodThingId);
-    void saveHeatingRodConfigurationToSettings(
-        const HeatingRodConfiguration& heatingRodConfiguration);
-    void removeHeatingRodConfigurationFromSettings(const ThingId& heatingRodThingId);
-
     void loadDynamicElectricPricingConfiguration(const ThingId& dynamicElectricPricingThingId);
-    void saveDynamicElectricPricingConfigurationToSettings(
-        const DynamicElectricPricingConfiguration& dynamicElectricPricingConfiguration);
-    void removeDynamicElectricPricingConfigurationFromSettings(
-        const ThingId& dynamicElectricPricingThingId);
-
     void loadWashingMachineConfiguration(const ThingId& washingMachineThingId);
-    void saveWashingMachineConfigurationToSettings(
-        const WashingMachineConfiguration& washingMachineConfiguration);
-    void removeWashingMachineConfigurationFromSettings(const ThingId& washingMachineThingId);
-
     void loadChargingConfiguration(const ThingId& evChargerThingId);
-    void saveChargingConfigurationToSettings(const ChargingConfiguration& chargingConfiguration);
-    void removeChargingConfigurationFromSettings(const ThingId& evChargerThingId);
-
     void loadChargingOptimizationConfiguration(const ThingId& evChargerThingId);
-    void saveChargingOptimizationConfigurationToSettings(
-        const ChargingOptimizationConfiguration& chargingOptimizationConfiguration);
-    void removeChargingOptimizationConfigurationFromSettings(const ThingId& evChargerThingId);
-
     void loadBatteryConfiguration(const ThingId& batteryThingId);
-    void saveBatteryConfigurationToSettings(const BatteryConfiguration& batteryConfiguration);
-    void removeBatteryConfigurationFromSettings(const ThingId& batteryThingId);
+    void loadPvConfiguration(const ThingId& pvThingId);
 
     void loadChargingSessionConfiguration(const ThingId& chargingSessionThingId);
     void saveChargingSessionConfigurationToSettings(
         const ChargingSessionConfiguration& chargingSessionConfiguration);
     void removeChargingSessionConfigurationFromSettings(const ThingId& chargingSessionThingId);
-
-    void loadPvConfiguration(const ThingId& pvThingId);
-    void savePvConfigurationToSettings(const PvConfiguration& pvConfiguration);
-    void removePvConfigurationFromSettings(const ThingId& pvThingId);
 };
 
 Q_DECLARE_OPERATORS_FOR_FLAGS(EnergyEngine::HemsUseCases)
@@ -0,0 +1,227 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include "enginecapture.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QLoggingCategory>
+
+Q_DECLARE_LOGGING_CATEGORY(dcConsolinnoEnergy)
+
+// File layout: [magic:u32][version:u32][startTime:i64] followed by the events
+static const quint32 captureMagic = 0x43454331; // "CEC1"
+static const quint32 captureVersion = 1;
+static const int captureHeaderSize = 16;
+static const int eventHeaderSize = 7;
+
+static void prepareStream(QDataStream& stream)
+{
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+}
+
+EngineCaptureWriter::EngineCaptureWriter(const QString& fileName, qint64 maxSize, QObject* parent)
+    : QObject(parent)
+    , m_file(fileName)
+    , m_maxSize(maxSize)
+{
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qCWarning(dcConsolinnoEnergy()) << "EngineCapture: Could not open" << m_file.fileName()
+                                        << m_file.errorString();
+        return;
+    }
+
+    QByteArray header;
+    QDataStream stream(&header, QIODevice::WriteOnly);
+    prepareStream(stream);
+    stream << captureMagic << captureVersion
+           << static_cast<qint64>(QDateTime::currentMSecsSinceEpoch());
+    m_file.write(header);
+    m_size = header.size();
+    m_clock.start();
+
+    m_flushTimer.setInterval(1000);
+    connect(&m_flushTimer, &QTimer::timeout, this, [this]() { m_file.flush(); });
+    m_flushTimer.start();
+
+    qCInfo(dcConsolinnoEnergy())
+        << "EngineCapture: Recording engine inputs to" << m_file.fileName();
+}
+
+EngineCaptureWriter::~EngineCaptureWriter() { m_file.close(); }
+
+bool EngineCaptureWriter::isRecording() const { return m_file.isOpen(); }
+
+void EngineCaptureWriter::recordRootMeterSample(double currentPower, const double phasePower[3])
+{
+    if (!isRecording())
+        return;
+
+    QByteArray payload;
+    payload.reserve(16);
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    prepareStream(stream);
+    stream << static_cast<float>(currentPower) << static_cast<float>(phasePower[0])
+           << static_cast<float>(phasePower[1]) << static_cast<float>(phasePower[2]);
+    writeEvent(EngineCaptureEvent::TypeRootMeterSample, payload);
+}
+
+void EngineCaptureWriter::recordLimitSignal(quint8 source, qint64 consumptionLimit)
+{
+    if (!isRecording())
+        return;
+
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    prepareStream(stream);
+    stream << source << consumptionLimit;
+    writeEvent(EngineCaptureEvent::TypeLimitSignal, payload);
+}
+
+void EngineCaptureWriter::recordPluggedIn(const ThingId& thingId, bool pluggedIn)
+{
+    if (!isRecording())
+        return;
+
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    prepareStream(stream);
+    stream << static_cast<QUuid>(thingId) << pluggedIn;
+    writeEvent(EngineCaptureEvent::TypePluggedIn, payload);
+}
+
+void EngineCaptureWriter::recordConfiguration(
+    const QString& configurationType, const QVariantMap& configuration)
+{
+    if (!isRecording())
+        return;
+
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    prepareStream(stream);
+    stream << configurationType << configuration;
+    writeEvent(EngineCaptureEvent::TypeConfiguration, payload);
+}
+
+void EngineCaptureWriter::writeEvent(EngineCaptureEvent::Type type, const QByteArray& payload)
+{
+    if (payload.size() > 0xffff) {
+        qCWarning(dcConsolinnoEnergy()) << "EngineCapture: Dropping oversized event" << type;
+        return;
+    }
+
+    // QFile::size() would flush the write buffer, so the written bytes are counted instead
+    if (m_size + eventHeaderSize + payload.size() > m_maxSize) {
+        stop("maximum capture size reached");
+        return;
+    }
+
+    qint64 now = m_clock.elapsed();
+    quint32 delta = static_cast<quint32>(qBound<qint64>(0, now - m_lastEvent, 0xffffffff));
+    m_lastEvent = now;
+
+    QByteArray event;
+    event.reserve(eventHeaderSize + payload.size());
+    QDataStream stream(&event, QIODevice::WriteOnly);
+    prepareStream(stream);
+    stream << static_cast<quint8>(type) << delta << static_cast<quint16>(payload.size());
+    event.append(payload);
+
+    if (m_file.write(event) != event.size()) {
+        stop(m_file.errorString());
+        return;
+    }
+    m_size += event.size();
+}
+
+void EngineCaptureWriter::stop(const QString& reason)
+{
+    qCWarning(dcConsolinnoEnergy()) << "EngineCapture: Stopped recording to" << m_file.fileName()
+                                    << reason;
+    m_flushTimer.stop();
+    m_file.close();
+}
+
+bool EngineCaptureReader::open(const QString& fileName)
+{
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        qCWarning(dcConsolinnoEnergy())
+            << "EngineCapture: Could not open" << fileName << m_file.errorString();
+        return false;
+    }
+
+    QDataStream stream(m_file.read(captureHeaderSize));
+    prepareStream(stream);
+    quint32 magic = 0, version = 0;
+    stream >> magic >> version >> m_startTime;
+    if (stream.status() != QDataStream::Ok || magic != captureMagic
+        || version != captureVersion) {
+        qCWarning(dcConsolinnoEnergy()) << "EngineCapture: Unknown capture format" << fileName;
+        m_file.close();
+        return false;
+    }
+
+    m_time = 0;
+    return true;
+}
+
+qint64 EngineCaptureReader::startTime() const { return m_startTime; }
+
+bool EngineCaptureReader::next(EngineCaptureEvent& event)
+{
+    if (!m_file.isOpen())
+        return false;
+
+    QByteArray header = m_file.read(eventHeaderSize);
+    if (header.size() < eventHeaderSize)
+        return false;
+
+    QDataStream headerStream(header);
+    prepareStream(headerStream);
+    quint8 type = 0;
+    quint32 delta = 0;
+    quint16 length = 0;
+    headerStream >> type >> delta >> length;
+
+    QByteArray payload = m_file.read(length);
+    if (payload.size() < length) {
+        qCWarning(dcConsolinnoEnergy()) << "EngineCapture: Truncated event at the end of"
+                                        << m_file.fileName();
+        return false;
+    }
+
+    m_time += delta;
+    event = EngineCaptureEvent();
+    event.type = static_cast<EngineCaptureEvent::Type>(type);
+    event.time = m_time;
+
+    QDataStream stream(payload);
+    prepareStream(stream);
+    switch (event.type) {
+    case EngineCaptureEvent::TypeRootMeterSample:
+        stream >> event.currentPower >> event.phasePower[0] >> event.phasePower[1]
+            >> event.phasePower[2];
+        break;
+    case EngineCaptureEvent::TypeLimitSignal:
+        stream >> event.source >> event.consumptionLimit;
+        break;
+    case EngineCaptureEvent::TypePluggedIn: {
+        QUuid thingId;
+        stream >> thingId >> event.pluggedIn;
+        event.thingId = thingId;
+        break;
+    }
+    case EngineCaptureEvent::TypeConfiguration:
+        stream >> event.configurationType >> event.configuration;
+        break;
+    default:
+        qCWarning(dcConsolinnoEnergy()) << "EngineCapture: Unknown event type" << type;
+        return false;
+    }
+
+    return stream.status() == QDataStream::Ok;
+}
@@ -0,0 +1,115 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#ifndef ENGINECAPTURE_H
+#define ENGINECAPTURE_H
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMetaProperty>
+#include <QObject>
+#include <QTimer>
+#include <QVariantMap>
+
+#include <typeutils.h>
+
+/*!
+ * \brief The EngineCaptureEvent struct is one input of the energy engine in a capture.
+ */
+struct EngineCaptureEvent {
+    enum Type : quint8 {
+        TypeRootMeterSample = 1,
+        TypeLimitSignal = 2,
+        TypePluggedIn = 3,
+        TypeConfiguration = 4
+    };
+
+    Type type = TypeRootMeterSample;
+    // Milliseconds since the start of the capture
+    qint64 time = 0;
+
+    // TypeRootMeterSample
+    float currentPower = 0;
+    float phasePower[3] = { 0, 0, 0 };
+
+    // TypeLimitSignal, the source is a ControlLatencyTracker::Source
+    quint8 source = 0;
+    qint64 consumptionLimit = -1;
+
+    // TypePluggedIn
+    ThingId thingId;
+    bool pluggedIn = false;
+
+    // TypeConfiguration, the gadget class name and its properties
+    QString configurationType;
+    QVariantMap configuration;
+};
+
+/*!
+ * \brief The EngineCaptureWriter class records the inputs of the energy engine into a file.
+ * \details The capture starts with a header holding the wall clock start time. Every event is
+ * stored as [type:u8][delta:u32][length:u16][payload], the delta being the milliseconds since the
+ * previous event on the monotonic clock. Root meter samples, which make up nearly all events, have
+ * a fixed 16 byte payload. The file is written through a buffer that gets flushed every second and
+ * recording stops once the maximum size is reached.
+ */
+class EngineCaptureWriter : public QObject {
+    Q_OBJECT
+public:
+    explicit EngineCaptureWriter(
+        const QString& fileName, qint64 maxSize = 64 * 1024 * 1024, QObject* parent = nullptr);
+    ~EngineCaptureWriter() override;
+
+    bool isRecording() const;
+
+    void recordRootMeterSample(double currentPower, const double phasePower[3]);
+    void recordLimitSignal(quint8 source, qint64 consumptionLimit);
+    void recordPluggedIn(const ThingId& thingId, bool pluggedIn);
+
+    template <typename T> void recordConfiguration(const T& configuration)
+    {
+        const QMetaObject& metaObject = T::staticMetaObject;
+        QVariantMap properties;
+        for (int i = metaObject.propertyOffset(); i < metaObject.propertyCount(); i++) {
+            QMetaProperty property = metaObject.property(i);
+            properties.insert(property.name(), property.readOnGadget(&configuration));
+        }
+        recordConfiguration(metaObject.className(), properties);
+    }
+    void recordConfiguration(const QString& configurationType, const QVariantMap& configuration);
+
+private:
+    QFile m_file;
+    qint64 m_maxSize = 0;
+    // Bytes written so far, including the ones still in the write buffer
+    qint64 m_size = 0;
+    QElapsedTimer m_clock;
+    qint64 m_lastEvent = 0;
+    QTimer m_flushTimer;
+
+    void writeEvent(EngineCaptureEvent::Type type, const QByteArray& payload);
+    void stop(const QString& reason);
+};
+
+/*!
+ * \brief The EngineCaptureReader class reads the events of a capture in order.
+ */
+class EngineCaptureReader {
+public:
+    bool open(const QString& fileName);
+
+    // Milliseconds since epoch when the capture has been started
+    qint64 startTime() const;
+
+    // Returns false at the end of the capture or on a damaged event
+    bool next(EngineCaptureEvent& event);
+
+private:
+    QFile m_file;
+    qint64 m_startTime = 0;
+    qint64 m_time = 0;
+};
+
+#endif // ENGINECAPTURE_H
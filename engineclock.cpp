@@ -0,0 +1,45 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include "engineclock.h"
+
+#include <QDateTime>
+
+EngineClock::EngineClock(QObject* parent)
+    : QObject(parent)
+{
+    m_monotonicTimer.start();
+}
+
+EngineClock* EngineClock::instance()
+{
+    static EngineClock clock;
+    return &clock;
+}
+
+qint64 EngineClock::currentMSecsSinceEpoch()
+{
+    EngineClock* clock = instance();
+    return clock->m_virtual ? clock->m_virtualTime : QDateTime::currentMSecsSinceEpoch();
+}
+
+qint64 EngineClock::monotonicTime()
+{
+    EngineClock* clock = instance();
+    return clock->m_virtual ? clock->m_virtualTime : clock->m_monotonicTimer.elapsed();
+}
+
+bool EngineClock::isVirtual() { return instance()->m_virtual; }
+
+void EngineClock::setVirtualTime(qint64 msecsSinceEpoch)
+{
+    EngineClock* clock = instance();
+    if (clock->m_virtual && msecsSinceEpoch <= clock->m_virtualTime)
+        return;
+
+    clock->m_virtual = true;
+    clock->m_virtualTime = msecsSinceEpoch;
+    emit clock->virtualTimeAdvanced(msecsSinceEpoch);
+}
@@ -0,0 +1,47 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#ifndef ENGINECLOCK_H
+#define ENGINECLOCK_H
+
+#include <QElapsedTimer>
+#include <QObject>
+
+/*!
+ * \brief The EngineClock class is the time source of the control loop.
+ * \details The engine reads the time of its decisions, limit validities, control loop intervals
+ * and setpoint refreshes from here. Normally that is the wall clock. A replay of a capture sets a
+ * virtual time instead and advances it event by event, so the control loop sees the timing of the
+ * capture while running as fast as the CPU allows. Timers waiting for the virtual time are
+ * replaced by checks whenever the virtual time advances.
+ *
+ * The clock is only used on the main thread, the optimizer gets the time with its snapshot.
+ */
+class EngineClock : public QObject {
+    Q_OBJECT
+public:
+    static EngineClock* instance();
+
+    // Milliseconds since epoch
+    static qint64 currentMSecsSinceEpoch();
+    // Milliseconds of a monotonic clock, for measuring intervals
+    static qint64 monotonicTime();
+
+    static bool isVirtual();
+    // Switches to the virtual time, before the engine gets created. Time never goes backwards.
+    static void setVirtualTime(qint64 msecsSinceEpoch);
+
+signals:
+    void virtualTimeAdvanced(qint64 msecsSinceEpoch);
+
+private:
+    explicit EngineClock(QObject* parent = nullptr);
+
+    QElapsedTimer m_monotonicTimer;
+    bool m_virtual = false;
+    qint64 m_virtualTime = 0;
+};
+
+#endif // ENGINECLOCK_H
@@ -0,0 +1,138 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include "heatpumpswitching.h"
+
+HeatPumpTransition::HeatPumpTransition() { }
+
+HeatPumpTransition::HeatPumpTransition(qint64 timestamp, const ThingId& heatPumpThingId,
+    State state, Reason reason, qint64 dwellTime)
+    : m_timestamp(timestamp)
+    , m_heatPumpThingId(heatPumpThingId)
+    , m_state(state)
+    , m_reason(reason)
+    , m_dwellTime(dwellTime)
+{
+}
+
+qlonglong HeatPumpTransition::timestamp() const { return m_timestamp; }
+
+QUuid HeatPumpTransition::heatPumpThingId() const { return m_heatPumpThingId; }
+
+QString HeatPumpTransition::state() const
+{
+    return m_state == StateBlocked ? QStringLiteral("blocked") : QStringLiteral("released");
+}
+
+QString HeatPumpTransition::reason() const
+{
+    switch (m_reason) {
+    case ReasonLimited:
+        return QStringLiteral("limited");
+    case ReasonShutoff:
+        return QStringLiteral("shutoff");
+    case ReasonPowerAvailable:
+        return QStringLiteral("powerAvailable");
+    case ReasonLimitLifted:
+        return QStringLiteral("limitLifted");
+    }
+    return QString();
+}
+
+double HeatPumpTransition::dwellTime() const { return m_dwellTime / 1000.0; }
+
+QDebug operator<<(QDebug debug, const HeatPumpTransition& heatPumpTransition)
+{
+    debug.nospace() << "HeatPumpTransition(" << heatPumpTransition.heatPumpThingId().toString();
+    debug.nospace() << ", " << heatPumpTransition.state();
+    debug.nospace() << ", reason: " << heatPumpTransition.reason();
+    debug.nospace() << ", after " << heatPumpTransition.dwellTime() << " s";
+    debug.nospace() << ")";
+    return debug.maybeSpace();
+}
+
+HeatPumpSwitch::HeatPumpSwitch() { }
+
+HeatPumpSwitch::HeatPumpSwitch(
+    State state, qint64 now, const HeatPumpSwitchParameters& parameters)
+    : m_state(state)
+    , m_enteredAt(now
+          - (state == HeatPumpTransition::StateBlocked ? parameters.minOffTime
+                                                       : parameters.minOnTime))
+{
+}
+
+HeatPumpSwitch::State HeatPumpSwitch::state() const { return m_state; }
+
+double HeatPumpSwitch::requiredPower(
+    double maxElectricalPower, const HeatPumpSwitchParameters& parameters) const
+{
+    if (m_state == HeatPumpTransition::StateBlocked)
+        return maxElectricalPower + parameters.hysteresis;
+
+    return maxElectricalPower;
+}
+
+bool HeatPumpSwitch::canBlock(HeatPumpTransition::Reason reason, qint64 now,
+    const HeatPumpSwitchParameters& parameters) const
+{
+    // The shutoff is mandatory, a reduced limit waits for the minimum run time
+    return m_state == HeatPumpTransition::StateReleased
+        && (reason == HeatPumpTransition::ReasonShutoff
+            || now - m_enteredAt >= parameters.minOnTime);
+}
+
+bool HeatPumpSwitch::canRelease(qint64 now, const HeatPumpSwitchParameters& parameters) const
+{
+    return m_state == HeatPumpTransition::StateBlocked
+        && now - m_enteredAt >= parameters.minOffTime;
+}
+
+bool HeatPumpSwitch::update(const ThingId& heatPumpThingId, bool powerAvailable,
+    HeatPumpTransition::Reason reason, qint64 now, qint64 timestamp,
+    const HeatPumpSwitchParameters& parameters, HeatPumpTransition* transition)
+{
+    qint64 dwellTime = now - m_enteredAt;
+
+    if (m_state == HeatPumpTransition::StateReleased) {
+        if (powerAvailable || !canBlock(reason, now, parameters))
+            return false;
+
+        m_state = HeatPumpTransition::StateBlocked;
+    } else {
+        if (!powerAvailable || !canRelease(now, parameters))
+            return false;
+
+        m_state = HeatPumpTransition::StateReleased;
+    }
+
+    m_enteredAt = now;
+    if (transition) {
+        *transition = HeatPumpTransition(timestamp, heatPumpThingId, m_state, reason, dwellTime);
+    }
+    return true;
+}
+
+HeatPumpTransitionLog::HeatPumpTransitionLog(int capacity)
+    : m_capacity(qMax(1, capacity))
+{
+}
+
+void HeatPumpTransitionLog::append(const HeatPumpTransition& transition)
+{
+    // Transitions are rare, dropping the oldest one from the list is cheap enough
+    m_transitions.append(transition);
+    while (m_transitions.count() > m_capacity) {
+        m_transitions.removeFirst();
+    }
+}
+
+QList<HeatPumpTransition> HeatPumpTransitionLog::transitions(int limit) const
+{
+    if (limit <= 0 || limit >= m_transitions.count())
+        return m_transitions;
+
+    return m_transitions.mid(m_transitions.count() - limit);
+}
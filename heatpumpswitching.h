@@ -0,0 +1,132 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#ifndef HEATPUMPSWITCHING_H
+#define HEATPUMPSWITCHING_H
+
+#include <QDebug>
+#include <QList>
+#include <QObject>
+
+#include <typeutils.h>
+
+/*!
+ * \brief The HeatPumpTransition class records one SG-ready switching decision of a heat pump.
+ */
+class HeatPumpTransition {
+    Q_GADGET
+    Q_PROPERTY(qlonglong timestamp READ timestamp)
+    Q_PROPERTY(QUuid heatPumpThingId READ heatPumpThingId)
+    Q_PROPERTY(QString state READ state)
+    Q_PROPERTY(QString reason READ reason)
+    Q_PROPERTY(double dwellTime READ dwellTime)
+
+public:
+    enum State : quint8 { StateReleased, StateBlocked };
+
+    enum Reason : quint8 {
+        // Blocked because the allocated power does not cover the heat pump
+        ReasonLimited,
+        ReasonShutoff,
+        // Released because the allocated power covers the heat pump plus the hysteresis
+        ReasonPowerAvailable,
+        ReasonLimitLifted
+    };
+
+    HeatPumpTransition();
+    HeatPumpTransition(qint64 timestamp, const ThingId& heatPumpThingId, State state,
+        Reason reason, qint64 dwellTime);
+
+    // Milliseconds since epoch
+    qlonglong timestamp() const;
+    QUuid heatPumpThingId() const;
+    // The state entered, "released" or "blocked"
+    QString state() const;
+    QString reason() const;
+    // Seconds spent in the previous state
+    double dwellTime() const;
+
+private:
+    qint64 m_timestamp = 0;
+    ThingId m_heatPumpThingId;
+    State m_state = StateReleased;
+    Reason m_reason = ReasonLimited;
+    qint64 m_dwellTime = 0;
+};
+
+QDebug operator<<(QDebug debug, const HeatPumpTransition& heatPumpTransition);
+
+struct HeatPumpSwitchParameters {
+    // Power in W a blocked heat pump needs on top of its own before it gets released again
+    double hysteresis = 500;
+    // Milliseconds a released heat pump runs at least before a limit may block it, a shutoff
+    // blocks right away
+    qint64 minOnTime = 5 * 60 * 1000;
+    // Milliseconds a blocked heat pump stays off at least to protect the compressor
+    qint64 minOffTime = 20 * 60 * 1000;
+};
+
+/*!
+ * \brief The HeatPumpSwitch class is the SG-ready actuation state machine of one heat pump.
+ * \details Switching a heat pump off removes the overshoot it caused, so without a dead band the
+ * next evaluation would release it again and the heat pump would oscillate with the control loop.
+ * A blocked heat pump therefore only gets released once the allocated power covers it plus the
+ * hysteresis and the compressor lockout (minOffTime) has passed. A released heat pump only gets
+ * blocked after running for minOnTime, unless the grid operator requests a shutoff.
+ */
+class HeatPumpSwitch {
+public:
+    typedef HeatPumpTransition::State State;
+
+    HeatPumpSwitch();
+    // A heat pump seen for the first time starts in the state it reports, without any dwell time.
+    // All times of the switch are monotonic milliseconds, see EngineClock::monotonicTime().
+    HeatPumpSwitch(State state, qint64 now, const HeatPumpSwitchParameters& parameters);
+
+    State state() const;
+
+    // Power in W that has to be allocated to the heat pump to release or keep it released
+    double requiredPower(
+        double maxElectricalPower, const HeatPumpSwitchParameters& parameters) const;
+
+    // Whether update() may switch the heat pump right now, decided before the power gets
+    // allocated: a released heat pump that cannot be blocked yet keeps drawing its power, a
+    // blocked one that cannot be released yet draws none
+    bool canBlock(HeatPumpTransition::Reason reason, qint64 now,
+        const HeatPumpSwitchParameters& parameters) const;
+    bool canRelease(qint64 now, const HeatPumpSwitchParameters& parameters) const;
+
+    // Returns true and fills the transition if the state changed. now is the monotonic time in ms
+    // the dwell times are measured on, timestamp the wall clock time logged with the transition.
+    bool update(const ThingId& heatPumpThingId, bool powerAvailable,
+        HeatPumpTransition::Reason reason, qint64 now, qint64 timestamp,
+        const HeatPumpSwitchParameters& parameters, HeatPumpTransition* transition);
+
+    // Revision of the last snapshot containing the heat pump
+    quint64 lastSeen = 0;
+
+private:
+    State m_state = HeatPumpTransition::StateReleased;
+    qint64 m_enteredAt = 0;
+};
+
+/*!
+ * \brief The HeatPumpTransitionLog class keeps the latest heat pump transitions.
+ */
+class HeatPumpTransitionLog {
+public:
+    explicit HeatPumpTransitionLog(int capacity = 1024);
+
+    void append(const HeatPumpTransition& transition);
+
+    // The latest transitions, oldest first. A limit of 0 returns all transitions.
+    QList<HeatPumpTransition> transitions(int limit = 0) const;
+
+private:
+    int m_capacity = 1024;
+    QList<HeatPumpTransition> m_transitions;
+};
+
+#endif // HEATPUMPSWITCHING_H
@@ -0,0 +1,245 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include "limitsourcemanager.h"
+
+#include <QDBusMessage>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QDBusServiceWatcher>
+#include <QDBusVariant>
+#include <QDateTime>
+#include <QLoggingCategory>
+#include <QtMath>
+
+Q_DECLARE_LOGGING_CATEGORY(dcConsolinnoEnergy)
+
+namespace {
+
+struct LimitSourceDefinition {
+    ControlLatencyTracker::Source source;
+    const char* service;
+    const char* path;
+    const char* interface;
+    // The opc-ua client does not emit its signals under its well known name
+    bool anySender;
+};
+
+const char* const iecService = "de.consolinno.fnnstb.iec61850";
+const char* const iecInterface = "de.consolinno.fnnstb.iec61850.cls.actpow_ggio001";
+const char* const opcService = "de.consolinno.fnnstb.opcua";
+const char* const opcInterface = "de.consolinno.fnnstb.opcua.cls.actpow_ggio001";
+
+// Indexed by the source
+const LimitSourceDefinition limitSources[ControlLatencyTracker::SourceCount] = {
+    { ControlLatencyTracker::SourceIec61850Path1, iecService,
+        "/de/consolinno/fnnstb/iec61850/cls/actpow_ggio001/1", iecInterface, false },
+    { ControlLatencyTracker::SourceIec61850Path2, iecService,
+        "/de/consolinno/fnnstb/iec61850/cls/actpow_ggio001/2", iecInterface, false },
+    { ControlLatencyTracker::SourceIec61850Path3, iecService,
+        "/de/consolinno/fnnstb/iec61850/cls/actpow_ggio001/3", iecInterface, false },
+    { ControlLatencyTracker::SourceIec61850Path4, iecService,
+        "/de/consolinno/fnnstb/iec61850/cls/actpow_ggio001/4", iecInterface, false },
+    { ControlLatencyTracker::SourceOpcUa, opcService,
+        "/de/consolinno/fnnstb/opcua/cls/actpow_ggio001/1", opcInterface, true },
+};
+
+// The limit is published as property and as signal with the same name
+const char* const limitMember = "AnOut_mxVal_f";
+
+// A service that is on the bus but hangs must not keep the source in connecting forever
+const int fetchTimeout = 5000;
+
+}
+
+LimitSourceStatus::LimitSourceStatus() { }
+
+LimitSourceStatus::LimitSourceStatus(const QString& source, const QString& service,
+    const QString& path, State state, qint64 stateChanged)
+    : m_source(source)
+    , m_service(service)
+    , m_path(path)
+    , m_state(state)
+    , m_stateChanged(stateChanged)
+{
+}
+
+QString LimitSourceStatus::source() const { return m_source; }
+
+QString LimitSourceStatus::service() const { return m_service; }
+
+QString LimitSourceStatus::path() const { return m_path; }
+
+QString LimitSourceStatus::state() const
+{
+    switch (m_state) {
+    case StateDisconnected:
+        return QStringLiteral("disconnected");
+    case StateConnecting:
+        return QStringLiteral("connecting");
+    case StateConnected:
+        return QStringLiteral("connected");
+    }
+    return QString();
+}
+
+qlonglong LimitSourceStatus::stateChanged() const { return m_stateChanged; }
+
+QDebug operator<<(QDebug debug, const LimitSourceStatus& limitSourceStatus)
+{
+    debug.nospace() << "LimitSourceStatus(" << limitSourceStatus.source();
+    debug.nospace() << ", " << limitSourceStatus.state();
+    debug.nospace() << ")";
+    return debug.maybeSpace();
+}
+
+LimitSourceManager::LimitSourceManager(const QDBusConnection& connection, QObject* parent)
+    : QObject(parent)
+    , m_connection(connection)
+{
+    m_states.fill(LimitSourceStatus::StateDisconnected);
+    m_stateChanged.fill(0);
+
+    m_serviceWatcher = new QDBusServiceWatcher(this);
+    m_serviceWatcher->setConnection(m_connection);
+    m_serviceWatcher->setWatchMode(
+        QDBusServiceWatcher::WatchForRegistration | QDBusServiceWatcher::WatchForUnregistration);
+    m_serviceWatcher->addWatchedService(iecService);
+    m_serviceWatcher->addWatchedService(opcService);
+    connect(m_serviceWatcher, &QDBusServiceWatcher::serviceRegistered, this,
+        &LimitSourceManager::onServiceRegistered);
+    connect(m_serviceWatcher, &QDBusServiceWatcher::serviceUnregistered, this,
+        &LimitSourceManager::onServiceUnregistered);
+}
+
+void LimitSourceManager::start()
+{
+    for (int source = 0; source < ControlLatencyTracker::SourceCount; source++) {
+        subscribe(static_cast<Source>(source));
+        fetch(static_cast<Source>(source));
+    }
+}
+
+LimitSourceStatus::State LimitSourceManager::state(Source source) const
+{
+    return m_states.at(source);
+}
+
+QList<LimitSourceStatus> LimitSourceManager::sources() const
+{
+    QList<LimitSourceStatus> sources;
+    for (int source = 0; source < ControlLatencyTracker::SourceCount; source++) {
+        const LimitSourceDefinition& definition = limitSources[source];
+        sources.append(LimitSourceStatus(
+            ControlLatencyTracker::sourceName(definition.source), definition.service,
+            definition.path, m_states.at(source), m_stateChanged.at(source)));
+    }
+    return sources;
+}
+
+// All sources deliver to the same slot, the object path tells them apart
+void LimitSourceManager::onLimitSignal(qlonglong consumptionLimit)
+{
+    if (!calledFromDBus())
+        return;
+
+    QString path = message().path();
+    for (int source = 0; source < ControlLatencyTracker::SourceCount; source++) {
+        if (path != QLatin1String(limitSources[source].path))
+            continue;
+
+        setState(static_cast<Source>(source), LimitSourceStatus::StateConnected);
+        emit consumptionLimitChanged(static_cast<Source>(source), consumptionLimit);
+        return;
+    }
+
+    qCWarning(dcConsolinnoEnergy()) << "Consumption limit signal from unknown path" << path;
+}
+
+void LimitSourceManager::onServiceRegistered(const QString& service)
+{
+    qCInfo(dcConsolinnoEnergy()) << "Consumption limit service" << service << "appeared";
+    for (int source = 0; source < ControlLatencyTracker::SourceCount; source++) {
+        if (service != QLatin1String(limitSources[source].service))
+            continue;
+
+        // Subscribing again is harmless and covers a bus connection that lost the match rules
+        subscribe(static_cast<Source>(source));
+        fetch(static_cast<Source>(source));
+    }
+}
+
+void LimitSourceManager::onServiceUnregistered(const QString& service)
+{
+    qCWarning(dcConsolinnoEnergy()) << "Consumption limit service" << service << "disappeared";
+    for (int source = 0; source < ControlLatencyTracker::SourceCount; source++) {
+        if (service == QLatin1String(limitSources[source].service)) {
+            setState(static_cast<Source>(source), LimitSourceStatus::StateDisconnected);
+        }
+    }
+}
+
+void LimitSourceManager::subscribe(Source source)
+{
+    const LimitSourceDefinition& definition = limitSources[source];
+    QString service = definition.anySender ? QString() : QString(definition.service);
+
+    m_connection.disconnect(service, definition.path, definition.interface, limitMember, this,
+        SLOT(onLimitSignal(qlonglong)));
+    if (!m_connection.connect(service, definition.path, definition.interface, limitMember, this,
+            SLOT(onLimitSignal(qlonglong)))) {
+        qCWarning(dcConsolinnoEnergy()) << "Error subscribing to consumption limit signal"
+                                        << ControlLatencyTracker::sourceName(source);
+    } else {
+        qCDebug(dcConsolinnoEnergy()) << "Subscribed to consumption limit signal"
+                                      << ControlLatencyTracker::sourceName(source);
+    }
+}
+
+void LimitSourceManager::fetch(Source source)
+{
+    const LimitSourceDefinition& definition = limitSources[source];
+    QDBusMessage call = QDBusMessage::createMethodCall(definition.service, definition.path,
+        QStringLiteral("org.freedesktop.DBus.Properties"), QStringLiteral("Get"));
+    call << QString(definition.interface) << QString(limitMember);
+
+    setState(source, LimitSourceStatus::StateConnecting);
+    QDBusPendingCallWatcher* watcher
+        = new QDBusPendingCallWatcher(m_connection.asyncCall(call, fetchTimeout), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this,
+        [this, source](QDBusPendingCallWatcher* watcher) {
+            watcher->deleteLater();
+            QDBusPendingReply<QDBusVariant> reply = *watcher;
+
+            if (reply.isError()) {
+                qCDebug(dcConsolinnoEnergy())
+                    << "Could not fetch consumption limit from"
+                    << ControlLatencyTracker::sourceName(source) << reply.error().message();
+                // A signal might have connected the source in the meantime
+                if (m_states.at(source) == LimitSourceStatus::StateConnecting) {
+                    setState(source, LimitSourceStatus::StateDisconnected);
+                }
+                return;
+            }
+
+            QVariant value = reply.value().variant();
+            qCDebug(dcConsolinnoEnergy()) << "Fetched consumption limit" << value.toFloat()
+                                          << "from" << ControlLatencyTracker::sourceName(source);
+            setState(source, LimitSourceStatus::StateConnected);
+            emit consumptionLimitFetched(source, qRound64(value.toFloat()));
+        });
+}
+
+void LimitSourceManager::setState(Source source, LimitSourceStatus::State state)
+{
+    if (m_states.at(source) == state)
+        return;
+
+    m_states[source] = state;
+    m_stateChanged[source] = QDateTime::currentMSecsSinceEpoch();
+    qCDebug(dcConsolinnoEnergy()) << "Consumption limit source"
+                                  << ControlLatencyTracker::sourceName(source) << "is now"
+                                  << sources().at(source).state();
+}
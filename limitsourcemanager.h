@@ -0,0 +1,109 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#ifndef LIMITSOURCEMANAGER_H
+#define LIMITSOURCEMANAGER_H
+
+#include <QDBusConnection>
+#include <QDBusContext>
+#include <QDebug>
+#include <QObject>
+
+#include <array>
+
+#include "controllatency.h"
+
+class QDBusServiceWatcher;
+
+/*!
+ * \brief The LimitSourceStatus class reports the connection state of one consumption limit source.
+ */
+class LimitSourceStatus {
+    Q_GADGET
+    Q_PROPERTY(QString source READ source)
+    Q_PROPERTY(QString service READ service)
+    Q_PROPERTY(QString path READ path)
+    Q_PROPERTY(QString state READ state)
+    Q_PROPERTY(qlonglong stateChanged READ stateChanged)
+
+public:
+    enum State : quint8 {
+        // The service is not on the bus
+        StateDisconnected,
+        // The initial value is being fetched
+        StateConnecting,
+        // The initial value has been fetched or a signal has been received
+        StateConnected
+    };
+
+    LimitSourceStatus();
+    LimitSourceStatus(const QString& source, const QString& service, const QString& path,
+        State state, qint64 stateChanged);
+
+    QString source() const;
+    QString service() const;
+    QString path() const;
+    // "disconnected", "connecting" or "connected"
+    QString state() const;
+    // Milliseconds since epoch, 0 if the state never changed
+    qlonglong stateChanged() const;
+
+private:
+    QString m_source;
+    QString m_service;
+    QString m_path;
+    State m_state = StateDisconnected;
+    qint64 m_stateChanged = 0;
+};
+
+QDebug operator<<(QDebug debug, const LimitSourceStatus& limitSourceStatus);
+
+/*!
+ * \brief The LimitSourceManager class receives the consumption limits of the grid operator.
+ * \details The limit sources (the four actpow_ggio001 paths of the IEC 61850 server and the OPC UA
+ * client) are described in one table. Nothing here blocks: the initial values are read with
+ * asynchronous Properties.Get calls, a missing service answers right away with an error from the
+ * bus daemon instead of running into the call timeout. A QDBusServiceWatcher resubscribes to the
+ * signals and fetches the value again whenever a service (re)appears, so a server started after
+ * nymead or restarted later is picked up without a restart.
+ */
+class LimitSourceManager : public QObject, protected QDBusContext {
+    Q_OBJECT
+public:
+    typedef ControlLatencyTracker::Source Source;
+
+    explicit LimitSourceManager(const QDBusConnection& connection = QDBusConnection::systemBus(),
+        QObject* parent = nullptr);
+
+    // Subscribes to all sources and fetches their initial values, returns right away
+    void start();
+
+    LimitSourceStatus::State state(Source source) const;
+    QList<LimitSourceStatus> sources() const;
+
+signals:
+    // A limit signalled by a source
+    void consumptionLimitChanged(LimitSourceManager::Source source, qlonglong consumptionLimit);
+    // The current value read after startup or after the source (re)appeared
+    void consumptionLimitFetched(LimitSourceManager::Source source, qlonglong consumptionLimit);
+
+private slots:
+    void onLimitSignal(qlonglong consumptionLimit);
+    void onServiceRegistered(const QString& service);
+    void onServiceUnregistered(const QString& service);
+
+private:
+    QDBusConnection m_connection;
+    QDBusServiceWatcher* m_serviceWatcher = nullptr;
+
+    std::array<LimitSourceStatus::State, ControlLatencyTracker::SourceCount> m_states;
+    std::array<qint64, ControlLatencyTracker::SourceCount> m_stateChanged;
+
+    void subscribe(Source source);
+    void fetch(Source source);
+    void setState(Source source, LimitSourceStatus::State state);
+};
+
+#endif // LIMITSOURCEMANAGER_H
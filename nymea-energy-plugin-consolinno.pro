@@ -1,6 +1,7 @@
 QT -= gui
 QT += network
 QT += dbus
+QT += concurrent
 
 TARGET = $$qtLibraryTarget(nymea_energypluginconsolinno)
 TEMPLATE = lib
@@ -26,9 +27,28 @@ HEADERS += \
     configurations/heatingrodconfiguration.h \
     configurations/dynamicelectricpricingconfiguration.h \
     configurations/washingmachineconfiguration.h \
+    chargingsessionhistory.h \
+    clspowerallocator.h \
+    configurationchangelog.h \
+    configurationstore.h \
     consolinnojsonhandler.h \
+    consumptionlimitarbiter.h \
+    controllatency.h \
+    controlloopscheduler.h \
+    decisiontrace.h \
     energyengine.h \
-    energypluginconsolinno.h
+    enginecapture.h \
+    engineclock.h \
+    energypluginconsolinno.h \
+    heatpumpswitching.h \
+    limitsourcemanager.h \
+    optimizerworker.h \
+    pidautotuner.h \
+    pidcontroller.h \
+    sessionjournal.h \
+    setpointactuator.h \
+    stateaccessorcache.h \
+    settingsstore.h
 
 SOURCES += \
     configurations/batteryconfiguration.cpp \
@@ -42,9 +62,27 @@ SOURCES += \
     configurations/heatingrodconfiguration.cpp \
     configurations/dynamicelectricpricingconfiguration.cpp \
     configurations/washingmachineconfiguration.cpp \
+    chargingsessionhistory.cpp \
+    clspowerallocator.cpp \
+    configurationchangelog.cpp \
     consolinnojsonhandler.cpp \
+    consumptionlimitarbiter.cpp \
+    controllatency.cpp \
+    controlloopscheduler.cpp \
+    decisiontrace.cpp \
     energyengine.cpp \
-    energypluginconsolinno.cpp
+    enginecapture.cpp \
+    engineclock.cpp \
+    energypluginconsolinno.cpp \
+    heatpumpswitching.cpp \
+    limitsourcemanager.cpp \
+    optimizerworker.cpp \
+    pidautotuner.cpp \
+    pidcontroller.cpp \
+    sessionjournal.cpp \
+    setpointactuator.cpp \
+    stateaccessorcache.cpp \
+    settingsstore.cpp
 
 target.path = $$[QT_INSTALL_LIBS]/nymea/energy/
 INSTALLS += target
@@ -0,0 +1,426 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include "optimizerworker.h"
+#include "clspowerallocator.h"
+
+#include <QLoggingCategory>
+#include <QThread>
+#include <QtMath>
+
+Q_DECLARE_LOGGING_CATEGORY(dcConsolinnoEnergy)
+
+OptimizerWorker::OptimizerWorker(QObject* parent)
+    : QObject(parent)
+{
+    // Both cross the thread boundary through queued connections
+    qRegisterMetaType<EngineSnapshotPointer>("EngineSnapshotPointer");
+    qRegisterMetaType<OptimizerResult>("OptimizerResult");
+}
+
+static ChargingAutoTuneResult autoTuneFailure(const ThingId& thingId, const QString& errorMessage)
+{
+    ChargingAutoTuneResult autoTuneResult;
+    autoTuneResult.thingId = thingId;
+    autoTuneResult.errorMessage = errorMessage;
+    return autoTuneResult;
+}
+
+void OptimizerWorker::setLatestRevision(quint64 revision)
+{
+    m_latestRevision.storeRelease(revision);
+}
+
+void OptimizerWorker::setHeatPumpSwitchParameters(const HeatPumpSwitchParameters& parameters)
+{
+    m_heatPumpSwitchParameters = parameters;
+}
+
+void OptimizerWorker::setAutoTuneParameters(const PidAutoTuneParameters& parameters)
+{
+    m_autoTuneParameters = parameters;
+}
+
+void OptimizerWorker::setComputeDelay(int computeDelay)
+{
+    m_computeDelay = computeDelay;
+}
+
+void OptimizerWorker::startAutoTune(const QUuid& evChargerThingId, double stepCurrent)
+{
+    m_autoTuneRequests.insert(ThingId(evChargerThingId), stepCurrent);
+}
+
+HeatPumpSwitch& OptimizerWorker::heatPumpSwitch(
+    const EngineSnapshot::HeatPump& heatPump, const EngineSnapshot& snapshot)
+{
+    auto it = m_heatPumpSwitches.find(heatPump.thingId);
+    if (it == m_heatPumpSwitches.end()) {
+        // Only a heat pump found Off during a limit counts as blocked, without a limit it might
+        // have been switched off on purpose
+        bool blocked = snapshot.limitActive && heatPump.sgReadyMode == QLatin1String("Off");
+        HeatPumpTransition::State state
+            = blocked ? HeatPumpTransition::StateBlocked : HeatPumpTransition::StateReleased;
+        it = m_heatPumpSwitches.insert(heatPump.thingId,
+            HeatPumpSwitch(state, snapshot.monotonicTime, m_heatPumpSwitchParameters));
+    }
+
+    it.value().lastSeen = snapshot.revision;
+    return it.value();
+}
+
+// Off although the engine released it, so the user or another automation switched it off
+bool OptimizerWorker::isSwitchedOffByUser(
+    const EngineSnapshot::HeatPump& heatPump, const HeatPumpSwitch& heatPumpSwitch)
+{
+    return heatPumpSwitch.state() == HeatPumpTransition::StateReleased
+        && heatPump.sgReadyMode == QLatin1String("Off");
+}
+
+// The PID regulates the grid point power to the setpoint of the charger, its output is the
+// charging current. Under a §14a limit the share of the charger caps the output.
+float OptimizerWorker::regulateChargingCurrent(const EngineSnapshot::EvCharger& evCharger,
+    float maxChargingCurrent, const EngineSnapshot& snapshot)
+{
+    ChargingControl& control = m_chargingControls[evCharger.thingId];
+    control.lastSeen = snapshot.revision;
+
+    PidController& controller = control.controller;
+    controller.setGains(evCharger.p, evCharger.i, evCharger.d);
+    controller.setOutputLimits(evCharger.maxChargingCurrentMinValue, maxChargingCurrent);
+    if (!controller.isInitialized()) {
+        controller.reset(evCharger.maxChargingCurrent);
+    }
+
+    double current
+        = controller.update(evCharger.setpoint, snapshot.gridPower, snapshot.monotonicTime);
+    return qBound(evCharger.maxChargingCurrentMinValue, static_cast<float>(qFloor(current)),
+        maxChargingCurrent);
+}
+
+// While a charger gets tuned the tuner commands its current instead of the PID. Returns false if
+// the charger is not being tuned.
+bool OptimizerWorker::autoTuneChargingCurrent(const EngineSnapshot::EvCharger& evCharger,
+    bool limited, const EngineSnapshot& snapshot, OptimizerResult& result, float* chargingCurrent)
+{
+    auto request = m_autoTuneRequests.find(evCharger.thingId);
+    if (request != m_autoTuneRequests.end()) {
+        ChargingAutoTune& autoTune = m_autoTunes[evCharger.thingId];
+        autoTune.tuner = PidAutoTuner(evCharger.maxChargingCurrent, request.value(),
+            evCharger.maxChargingCurrentMinValue, evCharger.maxChargingCurrentMaxValue,
+            evCharger.phaseCount, snapshot.monotonicTime, m_autoTuneParameters);
+        m_autoTuneRequests.erase(request);
+    }
+
+    auto it = m_autoTunes.find(evCharger.thingId);
+    if (it == m_autoTunes.end())
+        return false;
+
+    PidAutoTuner& tuner = it.value().tuner;
+    it.value().lastSeen = snapshot.revision;
+
+    // A §14a limit has priority, and without a car the grid power does not follow the current.
+    // Both end the tuning for good, it would continue with a stale baseline otherwise.
+    if (limited) {
+        tuner.abort(QStringLiteral("Aborted by a consumption limit"));
+    } else if (!evCharger.pluggedIn) {
+        tuner.abort(QStringLiteral("No car plugged in"));
+    }
+
+    float current = tuner.initialCurrent();
+    if (tuner.isRunning()) {
+        current = qFloor(tuner.update(snapshot.gridPower, snapshot.monotonicTime));
+    }
+
+    // Reported once, the tuning gets dropped below
+    if (tuner.phase() == PidAutoTuner::PhaseFailed) {
+        result.autoTuneResults.append(autoTuneFailure(evCharger.thingId, tuner.errorMessage()));
+    } else if (tuner.phase() == PidAutoTuner::PhaseFinished) {
+        ChargingAutoTuneResult autoTuneResult;
+        autoTuneResult.thingId = evCharger.thingId;
+        autoTuneResult.success = true;
+        autoTuneResult.p = tuner.kp();
+        autoTuneResult.i = tuner.ki();
+        autoTuneResult.d = tuner.kd();
+        autoTuneResult.processGain = tuner.processGain();
+        autoTuneResult.timeConstant = tuner.timeConstant();
+        autoTuneResult.deadTime = tuner.deadTime();
+        result.autoTuneResults.append(autoTuneResult);
+    }
+
+    // The PID starts over from the restored current with the new gains
+    if (!tuner.isRunning()) {
+        m_autoTunes.erase(it);
+        m_chargingControls.remove(evCharger.thingId);
+    }
+
+    // A limit takes over in this very evaluation
+    if (limited)
+        return false;
+
+    *chargingCurrent = current;
+    return true;
+}
+
+void OptimizerWorker::computeActions(const EngineSnapshot& snapshot, OptimizerResult& result)
+{
+    // One load per unit: ev chargers, heat pumps, heating rods and batteries, in that order
+    QVector<ClsLoad> loads;
+    loads.reserve(snapshot.evChargers.size() + snapshot.heatPumps.size()
+        + snapshot.heatingRods.size() + snapshot.batteries.size());
+
+    foreach (const EngineSnapshot::EvCharger& evCharger, snapshot.evChargers) {
+        // Chargers only regulating the grid point power take no share
+        ClsLoad load;
+        if (!evCharger.controllableLocalSystem) {
+            loads.append(load);
+            continue;
+        }
+
+        double wattsPerAmpere = 230.0 * qMax(1, evCharger.phaseCount);
+        load.priority = evCharger.clsPriority;
+        load.stepless = true;
+        // A wallbox cannot charge below its minimum current
+        load.minPower
+            = qMax(evCharger.clsMinPower, evCharger.maxChargingCurrentMinValue * wattsPerAmpere);
+        // Without a car only the minimum gets reserved
+        load.maxPower = evCharger.pluggedIn
+            ? evCharger.maxChargingCurrentMaxValue * wattsPerAmpere
+            : load.minPower;
+        loads.append(load);
+    }
+
+    // A blocked heat pump has to fit including the hysteresis to get released again. Units that
+    // are off and that this engine does not switch on reserve nothing: a released heat pump the
+    // user switched off and a heating rod that is off. Whether a heat pump can be switched at all
+    // is decided first: one that has to keep running for its minimum run time is a fixed load,
+    // one that is still in its compressor lockout gets nothing the others could use.
+    HeatPumpTransition::Reason limitReason = snapshot.consumptionLimit == 0
+        ? HeatPumpTransition::ReasonShutoff
+        : HeatPumpTransition::ReasonLimited;
+    foreach (const EngineSnapshot::HeatPump& heatPump, snapshot.heatPumps) {
+        const HeatPumpSwitch& heatPumpSwitch = this->heatPumpSwitch(heatPump, snapshot);
+        qint64 now = snapshot.monotonicTime;
+        bool switchedOff = isSwitchedOffByUser(heatPump, heatPumpSwitch);
+        bool released = heatPumpSwitch.state() == HeatPumpTransition::StateReleased;
+        ClsLoad load;
+        load.priority = heatPump.clsPriority;
+        if (!switchedOff && released
+            && !heatPumpSwitch.canBlock(limitReason, now, m_heatPumpSwitchParameters)) {
+            load.fixed = true;
+            load.minPower = heatPump.maxElectricalPower;
+            load.maxPower = heatPump.maxElectricalPower;
+        } else if (!switchedOff
+            && (released || heatPumpSwitch.canRelease(now, m_heatPumpSwitchParameters))) {
+            load.minPower = heatPump.clsMinPower;
+            load.maxPower = heatPumpSwitch.requiredPower(
+                heatPump.maxElectricalPower, m_heatPumpSwitchParameters);
+        }
+        loads.append(load);
+    }
+
+    foreach (const EngineSnapshot::HeatingRod& heatingRod, snapshot.heatingRods) {
+        ClsLoad load;
+        load.priority = heatingRod.clsPriority;
+        if (heatingRod.power) {
+            load.minPower = heatingRod.clsMinPower;
+            load.maxPower = heatingRod.maxElectricalPower;
+        }
+        loads.append(load);
+    }
+
+    foreach (const EngineSnapshot::Battery& battery, snapshot.batteries) {
+        ClsLoad load;
+        load.priority = battery.clsPriority;
+        load.stepless = true;
+        load.minPower = qMin(battery.clsMinPower, battery.chargingPower);
+        load.maxPower = battery.chargingPower;
+        loads.append(load);
+    }
+
+    // Without a limit every heat pump is free to run, a shutoff (limit 0) grants nothing
+    if (snapshot.limitActive) {
+        ClsPowerAllocator::allocate(snapshot.consumptionLimit, loads);
+    }
+
+    double allocatedPower = 0;
+    for (int i = 0; i < loads.size(); i++) {
+        allocatedPower += loads.at(i).grantedPower;
+    }
+
+    result.actions.reserve(
+        snapshot.evChargers.size() + snapshot.heatPumps.size() + snapshot.heatingRods.size());
+    int index = 0;
+
+    foreach (const EngineSnapshot::EvCharger& evCharger, snapshot.evChargers) {
+        const ClsLoad& load = loads.at(index++);
+        double wattsPerAmpere = 230.0 * qMax(1, evCharger.phaseCount);
+        bool limited = snapshot.limitActive && evCharger.controllableLocalSystem;
+
+        // Whole amperes only, rounding down keeps the wallbox within its share
+        float maxChargingCurrent = evCharger.maxChargingCurrentMaxValue;
+        if (limited) {
+            maxChargingCurrent = qBound(evCharger.maxChargingCurrentMinValue,
+                static_cast<float>(qFloor(load.grantedPower / wattsPerAmpere)),
+                evCharger.maxChargingCurrentMaxValue);
+        }
+
+        float newMaxChargingCurrentLimit = maxChargingCurrent;
+        bool tuning = autoTuneChargingCurrent(
+            evCharger, limited, snapshot, result, &newMaxChargingCurrentLimit);
+        if (!tuning && evCharger.setpoint > 0) {
+            newMaxChargingCurrentLimit
+                = regulateChargingCurrent(evCharger, maxChargingCurrent, snapshot);
+        } else if (!tuning && !limited) {
+            continue;
+        }
+
+        // if (allCLSOff) { // TODO for next version
+        //     newMaxChargingCurrentLimit = 0;
+        // }
+
+        PlannedAction action;
+        action.kind = PlannedAction::KindChargingCurrent;
+        action.thingId = evCharger.thingId;
+        action.actionTypeId = evCharger.maxChargingCurrentActionTypeId;
+        action.stateTypeId = evCharger.maxChargingCurrentStateTypeId;
+        action.target = newMaxChargingCurrentLimit;
+        result.actions.append(action);
+    }
+
+    /*
+    Gedanken zur Regelung der Wärmepumpe: Diese soll ausgeschaltet werden, wenn das
+    consumptionLimitCLSExceeded. Problem ist, dass es zu einer Oszilation kommt, denn nach dem
+    Ausschalten ist das limit nicht mehr überschritten und die Anlage wird direkt wieder
+    eingeschaltet. Deshalb wird nicht der gemessene Verbrauch, sondern die konfigurierte maximale
+    elektrische Leistung gegen das Limit gerechnet, und der HeatPumpSwitch sorgt mit Hysterese,
+    Mindestlaufzeit und Sperrzeit dafür, dass die Anlage nicht mit jedem Tick umschaltet.
+    */
+    foreach (const EngineSnapshot::HeatPump& heatPump, snapshot.heatPumps) {
+        const ClsLoad& load = loads.at(index++);
+        HeatPumpSwitch& heatPumpSwitch = m_heatPumpSwitches[heatPump.thingId];
+
+        // Nothing to limit on a heat pump the user switched off, it stays released
+        bool powerAvailable = !snapshot.limitActive || load.grantedPower > 0
+            || isSwitchedOffByUser(heatPump, heatPumpSwitch);
+        HeatPumpTransition::Reason reason = HeatPumpTransition::ReasonLimitLifted;
+        if (snapshot.limitActive) {
+            if (powerAvailable) {
+                reason = HeatPumpTransition::ReasonPowerAvailable;
+                // Only the heat pump itself draws power, the hysteresis stays unused
+                if (load.grantedPower > heatPump.maxElectricalPower) {
+                    allocatedPower -= load.grantedPower - heatPump.maxElectricalPower;
+                }
+            } else {
+                reason = limitReason;
+            }
+        }
+
+        HeatPumpTransition transition;
+        bool switched = heatPumpSwitch.update(heatPump.thingId, powerAvailable, reason,
+            snapshot.monotonicTime, snapshot.decision.timestamp, m_heatPumpSwitchParameters,
+            &transition);
+        if (switched) {
+            result.transitions.append(transition);
+        }
+
+        // A blocked heat pump is kept Off, a released one only gets switched back once
+        QString target;
+        if (heatPumpSwitch.state() == HeatPumpTransition::StateBlocked) {
+            target = QStringLiteral("Off");
+        } else if (switched) {
+            target = QStringLiteral("Standard");
+        } else {
+            continue;
+        }
+
+        PlannedAction action;
+        action.kind = PlannedAction::KindHeatPump;
+        action.thingId = heatPump.thingId;
+        action.actionTypeId = heatPump.sgReadyModeActionTypeId;
+        action.stateTypeId = heatPump.sgReadyModeStateTypeId;
+        action.target = target;
+        result.actions.append(action);
+    }
+
+    // Heating rods only get switched off, switching one on is up to the user
+    foreach (const EngineSnapshot::HeatingRod& heatingRod, snapshot.heatingRods) {
+        const ClsLoad& load = loads.at(index++);
+        if (load.grantedPower > 0 || !heatingRod.power)
+            continue;
+
+        PlannedAction action;
+        action.kind = PlannedAction::KindHeatingRod;
+        action.thingId = heatingRod.thingId;
+        action.actionTypeId = heatingRod.powerActionTypeId;
+        action.stateTypeId = heatingRod.powerStateTypeId;
+        action.target = false;
+        result.actions.append(action);
+    }
+
+    if (snapshot.limitActive) {
+        result.decision.allocatedPower = static_cast<float>(allocatedPower);
+    }
+}
+
+void OptimizerWorker::compute(const EngineSnapshotPointer& snapshot)
+{
+    // A newer snapshot is already queued, it replaces this one completely
+    if (snapshot->revision < m_latestRevision.loadAcquire()) {
+        qCDebug(dcConsolinnoEnergy())
+            << "Optimizer: Skipping outdated snapshot" << snapshot->revision;
+        return;
+    }
+
+    OptimizerResult result;
+    result.revision = snapshot->revision;
+    result.decision = snapshot->decision;
+    computeActions(*snapshot, result);
+    if (m_computeDelay > 0) {
+        QThread::msleep(m_computeDelay);
+    }
+
+    // Heat pumps and chargers that are gone or not controlled anymore start over when they come
+    // back
+    for (auto it = m_heatPumpSwitches.begin(); it != m_heatPumpSwitches.end();) {
+        if (it.value().lastSeen != snapshot->revision) {
+            it = m_heatPumpSwitches.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (auto it = m_chargingControls.begin(); it != m_chargingControls.end();) {
+        if (it.value().lastSeen != snapshot->revision) {
+            it = m_chargingControls.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (auto it = m_autoTunes.begin(); it != m_autoTunes.end();) {
+        if (it.value().lastSeen != snapshot->revision) {
+            result.autoTuneResults.append(
+                autoTuneFailure(it.key(), QStringLiteral("EV charger not available anymore")));
+            it = m_autoTunes.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (auto it = m_autoTuneRequests.cbegin(); it != m_autoTuneRequests.cend(); ++it) {
+        result.autoTuneResults.append(
+            autoTuneFailure(it.key(), QStringLiteral("EV charger not available")));
+    }
+    m_autoTuneRequests.clear();
+
+    result.idle = !snapshot->limitActive && snapshot->evChargers.isEmpty()
+        && result.actions.isEmpty() && result.transitions.isEmpty()
+        && result.autoTuneResults.isEmpty();
+    foreach (const HeatPumpSwitch& heatPumpSwitch, m_heatPumpSwitches) {
+        if (heatPumpSwitch.state() != HeatPumpTransition::StateReleased) {
+            result.idle = false;
+        }
+    }
+
+    emit computed(result);
+}
@@ -0,0 +1,213 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#ifndef OPTIMIZERWORKER_H
+#define OPTIMIZERWORKER_H
+
+#include <QAtomicInteger>
+#include <QHash>
+#include <QMetaType>
+#include <QObject>
+#include <QSharedPointer>
+#include <QString>
+#include <QVariant>
+#include <QVector>
+
+#include <typeutils.h>
+
+#include "decisiontrace.h"
+#include "heatpumpswitching.h"
+#include "pidautotuner.h"
+#include "pidcontroller.h"
+
+/*!
+ * \brief The EngineSnapshot struct is an immutable copy of everything the optimizer needs.
+ * \details The main thread fills a snapshot for every evaluation and hands it to the worker as a
+ * QSharedPointer<const EngineSnapshot>. The worker never touches things or configurations of the
+ * engine, so no locking is involved. Snapshots get reused by the engine once the result of their
+ * revision came back, the worker must not keep them.
+ */
+struct EngineSnapshot {
+    struct EvCharger {
+        ThingId thingId;
+        StateTypeId maxChargingCurrentStateTypeId;
+        ActionTypeId maxChargingCurrentActionTypeId;
+        float maxChargingCurrent = 0;
+        float maxChargingCurrentMinValue = 0;
+        float maxChargingCurrentMaxValue = 0;
+        int phaseCount = 3;
+        bool pluggedIn = true;
+        bool controllableLocalSystem = false;
+        int clsPriority = 0;
+        double clsMinPower = 0;
+        // Grid point power regulation, a setpoint of 0 W disables it
+        float p = 0;
+        float i = 0;
+        float d = 0;
+        float setpoint = 0;
+    };
+
+    struct HeatPump {
+        ThingId thingId;
+        StateTypeId sgReadyModeStateTypeId;
+        ActionTypeId sgReadyModeActionTypeId;
+        QString sgReadyMode;
+        // W
+        double maxElectricalPower = 0;
+        int clsPriority = 0;
+        double clsMinPower = 0;
+    };
+
+    struct HeatingRod {
+        ThingId thingId;
+        StateTypeId powerStateTypeId;
+        ActionTypeId powerActionTypeId;
+        bool power = false;
+        // W
+        double maxElectricalPower = 0;
+        int clsPriority = 0;
+        double clsMinPower = 0;
+    };
+
+    // Batteries cannot be actuated, their charging power only takes its share of the limit
+    struct Battery {
+        ThingId thingId;
+        double chargingPower = 0;
+        int clsPriority = 0;
+        double clsMinPower = 0;
+    };
+
+    quint64 revision = 0;
+    // True if a §14a limit is active and CLS units have to be limited
+    bool limitActive = false;
+    // Power in W the CLS units may consume together, 0 means shutoff
+    float consumptionLimit = -1;
+    // Power in W at the grid connection point, positive is consumption
+    double gridPower = 0;
+    // EngineClock::monotonicTime() when the snapshot was taken. All durations are measured on it,
+    // the wall clock time of the decision only gets logged, it may step with NTP.
+    qint64 monotonicTime = 0;
+
+    // The decision so far, the worker adds its actions to it
+    DecisionTrace::Record decision;
+
+    // Only controllable local systems end up in the snapshot, and the ev chargers regulating the
+    // grid point power or being auto tuned
+    QVector<EvCharger> evChargers;
+    QVector<HeatPump> heatPumps;
+    QVector<HeatingRod> heatingRods;
+    QVector<Battery> batteries;
+};
+
+typedef QSharedPointer<const EngineSnapshot> EngineSnapshotPointer;
+
+/*!
+ * \brief The PlannedAction struct is one setpoint the main thread should apply.
+ */
+struct PlannedAction {
+    enum Kind : quint8 { KindChargingCurrent, KindHeatPump, KindHeatingRod };
+
+    Kind kind = KindChargingCurrent;
+    ThingId thingId;
+    ActionTypeId actionTypeId;
+    StateTypeId stateTypeId;
+    QVariant target;
+};
+
+/*!
+ * \brief The ChargingAutoTuneResult struct reports a finished or aborted PID auto tuning.
+ */
+struct ChargingAutoTuneResult {
+    ThingId thingId;
+    bool success = false;
+    double p = 0;
+    double i = 0;
+    double d = 0;
+    // W/A, seconds and seconds
+    double processGain = 0;
+    double timeConstant = 0;
+    double deadTime = 0;
+    QString errorMessage;
+};
+
+struct OptimizerResult {
+    quint64 revision = 0;
+    // True if the same snapshot taken later would not change anything either: no limit, no
+    // charger regulated or tuned and every heat pump released
+    bool idle = false;
+    DecisionTrace::Record decision;
+    QVector<PlannedAction> actions;
+    QVector<HeatPumpTransition> transitions;
+    QVector<ChargingAutoTuneResult> autoTuneResults;
+};
+
+Q_DECLARE_METATYPE(EngineSnapshotPointer)
+Q_DECLARE_METATYPE(OptimizerResult)
+
+/*!
+ * \brief The OptimizerWorker class computes the actions of an evaluation on its own thread.
+ * \details compute() runs in the worker thread and posts the result back through computed(). If
+ * the worker falls behind, snapshots older than the latest published one are skipped, since every
+ * snapshot describes the complete desired state.
+ */
+class OptimizerWorker : public QObject {
+    Q_OBJECT
+public:
+    explicit OptimizerWorker(QObject* parent = nullptr);
+
+    // Called on the main thread before posting a snapshot
+    void setLatestRevision(quint64 revision);
+
+    // Must be set before the worker gets moved to its thread
+    void setHeatPumpSwitchParameters(const HeatPumpSwitchParameters& parameters);
+    void setAutoTuneParameters(const PidAutoTuneParameters& parameters);
+    // Every computation takes at least this long in milliseconds, a fixed load for the tests
+    void setComputeDelay(int computeDelay);
+
+    // Fills the actions, transitions and the allocated power of the result
+    void computeActions(const EngineSnapshot& snapshot, OptimizerResult& result);
+
+public slots:
+    void compute(const EngineSnapshotPointer& snapshot);
+
+    // The tuning starts with the next snapshot containing the charger, stepCurrent in A
+    void startAutoTune(const QUuid& evChargerThingId, double stepCurrent);
+
+signals:
+    void computed(const OptimizerResult& result);
+
+private:
+    QAtomicInteger<quint64> m_latestRevision;
+    int m_computeDelay = 0;
+
+    // Only accessed on the worker thread
+    HeatPumpSwitchParameters m_heatPumpSwitchParameters;
+    QHash<ThingId, HeatPumpSwitch> m_heatPumpSwitches;
+
+    struct ChargingControl {
+        PidController controller;
+        quint64 lastSeen = 0;
+    };
+    QHash<ThingId, ChargingControl> m_chargingControls;
+
+    PidAutoTuneParameters m_autoTuneParameters;
+    QHash<ThingId, double> m_autoTuneRequests;
+    struct ChargingAutoTune {
+        PidAutoTuner tuner;
+        quint64 lastSeen = 0;
+    };
+    QHash<ThingId, ChargingAutoTune> m_autoTunes;
+
+    HeatPumpSwitch& heatPumpSwitch(
+        const EngineSnapshot::HeatPump& heatPump, const EngineSnapshot& snapshot);
+    static bool isSwitchedOffByUser(
+        const EngineSnapshot::HeatPump& heatPump, const HeatPumpSwitch& heatPumpSwitch);
+    float regulateChargingCurrent(const EngineSnapshot::EvCharger& evCharger,
+        float maxChargingCurrent, const EngineSnapshot& snapshot);
+    bool autoTuneChargingCurrent(const EngineSnapshot::EvCharger& evCharger, bool limited,
+        const EngineSnapshot& snapshot, OptimizerResult& result, float* chargingCurrent);
+};
+
+#endif // OPTIMIZERWORKER_H
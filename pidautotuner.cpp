@@ -0,0 +1,172 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include "pidautotuner.h"
+
+#include <QtMath>
+
+PidAutoTuner::PidAutoTuner() { }
+
+PidAutoTuner::PidAutoTuner(double initialCurrent, double stepCurrent, double minCurrent,
+    double maxCurrent, int phaseCount, qint64 now, const PidAutoTuneParameters& parameters)
+    : m_parameters(parameters)
+    , m_phase(PhaseBaseline)
+    , m_initialCurrent(qBound(minCurrent, initialCurrent, maxCurrent))
+    , m_phaseCount(qMax(1, phaseCount))
+    , m_phaseStart(now)
+{
+    // Step up if there is room for it, down otherwise
+    m_stepTarget = m_initialCurrent + qAbs(stepCurrent);
+    if (m_stepTarget > maxCurrent) {
+        m_stepTarget = qMax(minCurrent, m_initialCurrent - qAbs(stepCurrent));
+    }
+
+    if (qAbs(m_stepTarget - m_initialCurrent) < 1) {
+        fail(QStringLiteral("The charging current range leaves no room for a step"));
+    }
+}
+
+PidAutoTuner::Phase PidAutoTuner::phase() const { return m_phase; }
+
+bool PidAutoTuner::isRunning() const
+{
+    return m_phase == PhaseBaseline || m_phase == PhaseStep;
+}
+
+double PidAutoTuner::update(double gridPower, qint64 now)
+{
+    qint64 elapsed = now - m_phaseStart;
+
+    switch (m_phase) {
+    case PhaseBaseline:
+        // The first third lets the wallbox settle on the initial current
+        if (elapsed >= m_parameters.baselineTime / 3) {
+            m_baselineSum += gridPower;
+            m_baselineCount++;
+        }
+        if (elapsed < m_parameters.baselineTime)
+            return m_initialCurrent;
+
+        if (m_baselineCount == 0) {
+            fail(QStringLiteral("No grid power samples during the baseline"));
+            return m_initialCurrent;
+        }
+        m_phase = PhaseStep;
+        m_phaseStart = now;
+        m_samples.clear();
+        m_samples.reserve(256);
+        return m_stepTarget;
+    case PhaseStep:
+        m_samples.append(qMakePair(elapsed, gridPower));
+        if (elapsed < m_parameters.stepTime)
+            return m_stepTarget;
+
+        evaluate();
+        return m_initialCurrent;
+    case PhaseFinished:
+    case PhaseFailed:
+        break;
+    }
+
+    return m_initialCurrent;
+}
+
+double PidAutoTuner::initialCurrent() const { return m_initialCurrent; }
+
+double PidAutoTuner::kp() const { return m_kp; }
+
+double PidAutoTuner::ki() const { return m_ki; }
+
+double PidAutoTuner::kd() const { return m_kd; }
+
+double PidAutoTuner::processGain() const { return m_processGain; }
+
+double PidAutoTuner::timeConstant() const { return m_timeConstant; }
+
+double PidAutoTuner::deadTime() const { return m_deadTime; }
+
+QString PidAutoTuner::errorMessage() const { return m_errorMessage; }
+
+void PidAutoTuner::evaluate()
+{
+    int count = m_samples.count();
+    if (count < 5) {
+        fail(QStringLiteral("Too few grid power samples during the step"));
+        return;
+    }
+
+    // The last fifth of the recording is taken as the settled value
+    double finalSum = 0;
+    int finalCount = 0;
+    for (int i = 0; i < count; i++) {
+        if (m_samples.at(i).first >= m_parameters.stepTime * 4 / 5) {
+            finalSum += m_samples.at(i).second;
+            finalCount++;
+        }
+    }
+    if (finalCount == 0) {
+        finalSum = m_samples.last().second;
+        finalCount = 1;
+    }
+
+    double baseline = m_baselineSum / m_baselineCount;
+    double powerChange = finalSum / finalCount - baseline;
+    double currentChange = m_stepTarget - m_initialCurrent;
+    double nominalChange = qAbs(currentChange) * 230 * m_phaseCount;
+    if (qAbs(powerChange) < m_parameters.minResponse * nominalChange) {
+        fail(QStringLiteral("The grid power did not follow the current step, is a car charging?"));
+        return;
+    }
+
+    m_processGain = powerChange / currentChange;
+    if (m_processGain <= 0) {
+        fail(QStringLiteral("The grid power moved against the current step"));
+        return;
+    }
+
+    // Two point method: first crossings of 28.3 % and 63.2 % of the final change
+    double t28 = -1;
+    double t63 = -1;
+    for (int i = 0; i < count && t63 < 0; i++) {
+        double fraction = (m_samples.at(i).second - baseline) / powerChange;
+        double time = m_samples.at(i).first / 1000.0;
+        if (t28 < 0 && fraction >= 0.283) {
+            t28 = time;
+        }
+        if (fraction >= 0.632) {
+            t63 = time;
+        }
+    }
+    if (t28 < 0 || t63 < 0) {
+        fail(QStringLiteral("Could not identify the step response"));
+        return;
+    }
+
+    double sampleTime = m_parameters.stepTime / 1000.0 / count;
+    m_timeConstant = qMax(sampleTime, 1.5 * (t63 - t28));
+    m_deadTime = qMax(0.0, t63 - m_timeConstant);
+
+    // SIMC PI tuning with the closed loop time constant set to the dead time
+    double closedLoopTime = qMax(m_deadTime, sampleTime);
+    m_kp = m_timeConstant / (m_processGain * (closedLoopTime + m_deadTime));
+    double integralTime = qMin(m_timeConstant, 4 * (closedLoopTime + m_deadTime));
+    m_ki = m_kp / integralTime;
+    m_kd = 0;
+
+    m_phase = PhaseFinished;
+}
+
+void PidAutoTuner::abort(const QString& errorMessage)
+{
+    if (isRunning()) {
+        fail(errorMessage);
+    }
+}
+
+void PidAutoTuner::fail(const QString& errorMessage)
+{
+    m_errorMessage = errorMessage;
+    m_phase = PhaseFailed;
+}
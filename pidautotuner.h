@@ -0,0 +1,89 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#ifndef PIDAUTOTUNER_H
+#define PIDAUTOTUNER_H
+
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+struct PidAutoTuneParameters {
+    // Milliseconds the initial current is held to measure the baseline grid power
+    qint64 baselineTime = 30 * 1000;
+    // Milliseconds the step response gets recorded
+    qint64 stepTime = 120 * 1000;
+    // A step has to move the grid power by at least this fraction of its nominal power
+    double minResponse = 0.3;
+};
+
+/*!
+ * \brief The PidAutoTuner class tunes the charging PID of one wallbox from a current step.
+ * \details The tuner holds the initial charging current to measure the baseline grid power, then
+ * steps the current and records the grid power. The response gets fitted to a first order plus
+ * dead time model with the two point method (28.3 % and 63.2 % of the final change), which gives
+ * the process gain in W/A, the time constant and the dead time. The gains follow the SIMC rules
+ * for a PI controller with the closed loop time constant set to the dead time, so slow wallboxes
+ * get gentle gains and fast ones tight gains. The derivative gain stays 0, the filtered derivative
+ * of the PidController is only worth it for second order responses.
+ */
+class PidAutoTuner {
+public:
+    enum Phase { PhaseBaseline, PhaseStep, PhaseFinished, PhaseFailed };
+
+    PidAutoTuner();
+    PidAutoTuner(double initialCurrent, double stepCurrent, double minCurrent, double maxCurrent,
+        int phaseCount, qint64 now, const PidAutoTuneParameters& parameters);
+
+    Phase phase() const;
+    bool isRunning() const;
+
+    // Feeds one grid power sample, returns the charging current to command. now is in
+    // milliseconds of a monotonic clock, like for the constructor.
+    double update(double gridPower, qint64 now);
+
+    // Stops a running tuning, e.g. when a limit takes over the charger
+    void abort(const QString& errorMessage);
+
+    // Current to restore once the tuner is done
+    double initialCurrent() const;
+
+    double kp() const;
+    double ki() const;
+    double kd() const;
+
+    // W/A, seconds and seconds
+    double processGain() const;
+    double timeConstant() const;
+    double deadTime() const;
+
+    QString errorMessage() const;
+
+private:
+    PidAutoTuneParameters m_parameters;
+    Phase m_phase = PhaseFailed;
+    double m_initialCurrent = 0;
+    // Current commanded during the step
+    double m_stepTarget = 0;
+    int m_phaseCount = 3;
+    qint64 m_phaseStart = 0;
+
+    double m_baselineSum = 0;
+    int m_baselineCount = 0;
+    QVector<QPair<qint64, double>> m_samples;
+
+    double m_kp = 0;
+    double m_ki = 0;
+    double m_kd = 0;
+    double m_processGain = 0;
+    double m_timeConstant = 0;
+    double m_deadTime = 0;
+    QString m_errorMessage;
+
+    void evaluate();
+    void fail(const QString& errorMessage);
+};
+
+#endif // PIDAUTOTUNER_H
@@ -0,0 +1,79 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include "pidcontroller.h"
+
+void PidController::setGains(double kp, double ki, double kd)
+{
+    m_kp = kp;
+    m_ki = ki;
+    m_kd = kd;
+}
+
+void PidController::setOutputLimits(double minimum, double maximum)
+{
+    m_minimum = minimum;
+    m_maximum = qMax(minimum, maximum);
+    m_integral = qBound(m_minimum, m_integral, m_maximum);
+}
+
+void PidController::setDerivativeFilterTime(double derivativeFilterTime)
+{
+    m_derivativeFilterTime = qMax(0.0, derivativeFilterTime);
+}
+
+void PidController::setMaxSampleTime(double maxSampleTime)
+{
+    m_maxSampleTime = qMax(0.0, maxSampleTime);
+}
+
+void PidController::reset(double initialOutput)
+{
+    m_output = qBound(m_minimum, initialOutput, m_maximum);
+    m_integral = m_output;
+    m_derivative = 0;
+    m_hasPrevious = false;
+    m_initialized = true;
+}
+
+bool PidController::isInitialized() const { return m_initialized; }
+
+double PidController::update(double setpoint, double measurement, qint64 time)
+{
+    double error = setpoint - measurement;
+    double dt = m_hasPrevious ? (time - m_previousTime) / 1000.0 : 0;
+
+    // A gap or a clock jump invalidates the derivative, the integral keeps its value
+    if (dt <= 0 || dt > m_maxSampleTime) {
+        m_derivative = 0;
+        dt = 0;
+    } else {
+        double rawDerivative = -(measurement - m_previousMeasurement) / dt;
+        double alpha = m_derivativeFilterTime / (m_derivativeFilterTime + dt);
+        m_derivative = alpha * m_derivative + (1 - alpha) * rawDerivative;
+    }
+
+    double proportional = m_kp * error;
+    double derivative = m_kd * m_derivative;
+
+    // The integral holds the output bias, so it is kept within the output range as well
+    double integral = qBound(m_minimum, m_integral + m_ki * error * dt, m_maximum);
+    double output = proportional + integral + derivative;
+
+    // Conditional integration: no integration further into a saturated output
+    bool saturatedHigh = output > m_maximum && error > 0;
+    bool saturatedLow = output < m_minimum && error < 0;
+    if (!saturatedHigh && !saturatedLow) {
+        m_integral = integral;
+    }
+
+    m_output = qBound(m_minimum, proportional + m_integral + derivative, m_maximum);
+    m_previousMeasurement = measurement;
+    m_previousTime = time;
+    m_hasPrevious = true;
+    return m_output;
+}
+
+double PidController::output() const { return m_output; }
@@ -0,0 +1,58 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#ifndef PIDCONTROLLER_H
+#define PIDCONTROLLER_H
+
+#include <QtGlobal>
+
+/*!
+ * \brief The PidController class is a discrete PID controller for irregular sample times.
+ * \details Every term uses the actual time since the previous sample, so delayed or coalesced
+ * control loop ticks do not change the loop gain. The derivative acts on the measurement instead
+ * of the error, which avoids a kick on setpoint changes, and passes a first order low pass with
+ * the time constant derivativeFilterTime. The integral is clamped by conditional integration: it
+ * only integrates while the output is not saturated in the direction of the error, so it does not
+ * wind up while the output sits at a limit.
+ *
+ * The first update after reset() starts from the given initial output (bumpless transfer).
+ */
+class PidController {
+public:
+    void setGains(double kp, double ki, double kd);
+    void setOutputLimits(double minimum, double maximum);
+
+    // Seconds
+    void setDerivativeFilterTime(double derivativeFilterTime);
+    // Samples further apart than this restart the derivative, in seconds
+    void setMaxSampleTime(double maxSampleTime);
+
+    void reset(double initialOutput);
+    bool isInitialized() const;
+
+    // time in milliseconds of a monotonic clock, returns the clamped output
+    double update(double setpoint, double measurement, qint64 time);
+
+    double output() const;
+
+private:
+    double m_kp = 0;
+    double m_ki = 0;
+    double m_kd = 0;
+    double m_minimum = 0;
+    double m_maximum = 0;
+    double m_derivativeFilterTime = 5;
+    double m_maxSampleTime = 30;
+
+    bool m_initialized = false;
+    bool m_hasPrevious = false;
+    double m_integral = 0;
+    double m_derivative = 0;
+    double m_previousMeasurement = 0;
+    qint64 m_previousTime = 0;
+    double m_output = 0;
+};
+
+#endif // PIDCONTROLLER_H
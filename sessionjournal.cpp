@@ -0,0 +1,267 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include "sessionjournal.h"
+
+#include <QDataStream>
+#include <QLoggingCategory>
+
+#include <unistd.h>
+
+Q_DECLARE_LOGGING_CATEGORY(dcConsolinnoEnergy)
+
+// File layout: magic, followed by records of [type:u8][length:u16][payload][crc:u16]
+static const quint32 journalMagic = 0x43534a31; // "CSJ1"
+static const int recordHeaderSize = 3;
+static const int recordTrailerSize = 2;
+
+static quint16 recordChecksum(quint8 type, const QByteArray& payload)
+{
+    QByteArray data;
+    data.reserve(payload.size() + 1);
+    data.append(static_cast<char>(type));
+    data.append(payload);
+    return qChecksum(data.constData(), static_cast<uint>(data.size()));
+}
+
+SessionJournal::SessionJournal(const QString& fileName, QObject* parent)
+    : QObject(parent)
+    , m_file(fileName)
+{
+    m_compactionTimer.setSingleShot(true);
+    m_compactionTimer.setInterval(10 * 60 * 1000);
+    connect(&m_compactionTimer, &QTimer::timeout, this, &SessionJournal::compactionRequested);
+}
+
+SessionJournal::~SessionJournal() { m_file.close(); }
+
+QString SessionJournal::fileName() const { return m_file.fileName(); }
+
+qint64 SessionJournal::size() const
+{
+    return m_file.isOpen() ? m_file.size() : QFile(m_file.fileName()).size();
+}
+
+bool SessionJournal::append(const ChargingSessionConfiguration& chargingSessionConfiguration)
+{
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+    stream << static_cast<QUuid>(chargingSessionConfiguration.evChargerThingId())
+           << static_cast<QUuid>(chargingSessionConfiguration.carThingId())
+           << chargingSessionConfiguration.startedAt() << chargingSessionConfiguration.finishedAt()
+           << chargingSessionConfiguration.initialBatteryEnergy()
+           << static_cast<qint32>(chargingSessionConfiguration.duration())
+           << chargingSessionConfiguration.energyCharged()
+           << chargingSessionConfiguration.energyBattery()
+           << static_cast<qint32>(chargingSessionConfiguration.batteryLevel())
+           << chargingSessionConfiguration.sessionId()
+           << static_cast<qint32>(chargingSessionConfiguration.state())
+           << static_cast<qint32>(chargingSessionConfiguration.timestamp());
+
+    return writeRecord(RecordTypeUpdate, payload);
+}
+
+bool SessionJournal::appendRemoval(const ThingId& evChargerThingId)
+{
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << static_cast<QUuid>(evChargerThingId);
+
+    return writeRecord(RecordTypeRemove, payload);
+}
+
+QList<SessionJournalEntry> SessionJournal::replay() const
+{
+    QList<SessionJournalEntry> entries;
+
+    QFile file(m_file.fileName());
+    if (!file.exists())
+        return entries;
+
+    if (!file.open(QIODevice::ReadOnly)) {
+        qCWarning(dcConsolinnoEnergy())
+            << "SessionJournal: Could not open" << file.fileName() << file.errorString();
+        return entries;
+    }
+
+    // The journal gets compacted regularly, reading it at once is fine
+    QByteArray data = file.readAll();
+    file.close();
+
+    if (data.size() < static_cast<int>(sizeof(journalMagic)))
+        return entries;
+
+    QDataStream magicStream(data);
+    quint32 magic = 0;
+    magicStream >> magic;
+    if (magic != journalMagic) {
+        qCWarning(dcConsolinnoEnergy())
+            << "SessionJournal: Ignoring" << file.fileName() << "with unknown format";
+        return entries;
+    }
+
+    int offset = sizeof(journalMagic);
+    while (offset + recordHeaderSize <= data.size()) {
+        quint8 type = static_cast<quint8>(data.at(offset));
+        int length = (static_cast<quint8>(data.at(offset + 1)) << 8)
+            | static_cast<quint8>(data.at(offset + 2));
+        if (offset + recordHeaderSize + length + recordTrailerSize > data.size()) {
+            qCWarning(dcConsolinnoEnergy()) << "SessionJournal: Dropping truncated record at"
+                                            << offset;
+            break;
+        }
+
+        QByteArray payload = data.mid(offset + recordHeaderSize, length);
+        int crcOffset = offset + recordHeaderSize + length;
+        quint16 crc = static_cast<quint16>((static_cast<quint8>(data.at(crcOffset)) << 8)
+            | static_cast<quint8>(data.at(crcOffset + 1)));
+        if (crc != recordChecksum(type, payload)) {
+            qCWarning(dcConsolinnoEnergy()) << "SessionJournal: Dropping corrupt record at"
+                                            << offset;
+            break;
+        }
+
+        QDataStream stream(payload);
+        stream.setVersion(QDataStream::Qt_5_0);
+        stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+        SessionJournalEntry entry;
+        QUuid evChargerThingId;
+        stream >> evChargerThingId;
+        entry.evChargerThingId = evChargerThingId;
+
+        if (type == RecordTypeUpdate) {
+            QUuid carThingId, sessionId;
+            QString startedAt, finishedAt;
+            float initialBatteryEnergy = 0, energyCharged = 0, energyBattery = 0;
+            qint32 duration = 0, batteryLevel = 0, state = 0, timestamp = 0;
+            stream >> carThingId >> startedAt >> finishedAt >> initialBatteryEnergy >> duration
+                >> energyCharged >> energyBattery >> batteryLevel >> sessionId >> state
+                >> timestamp;
+
+            entry.configuration.setEvChargerThingId(entry.evChargerThingId);
+            entry.configuration.setCarThingId(carThingId);
+            entry.configuration.setStartedAt(startedAt);
+            entry.configuration.setFinishedAt(finishedAt);
+            entry.configuration.setInitialBatteryEnergy(initialBatteryEnergy);
+            entry.configuration.setDuration(duration);
+            entry.configuration.setEnergyCharged(energyCharged);
+            entry.configuration.setEnergyBattery(energyBattery);
+            entry.configuration.setBatteryLevel(batteryLevel);
+            entry.configuration.setSessionId(sessionId);
+            entry.configuration.setState(state);
+            entry.configuration.setTimestamp(timestamp);
+        } else if (type == RecordTypeRemove) {
+            entry.removed = true;
+        } else {
+            qCWarning(dcConsolinnoEnergy()) << "SessionJournal: Unknown record type" << type;
+            break;
+        }
+
+        if (stream.status() != QDataStream::Ok) {
+            qCWarning(dcConsolinnoEnergy()) << "SessionJournal: Dropping unreadable record at"
+                                            << offset;
+            break;
+        }
+
+        entries.append(entry);
+        offset = crcOffset + recordTrailerSize;
+    }
+
+    qCDebug(dcConsolinnoEnergy()) << "SessionJournal: Replayed" << entries.count() << "records from"
+                                  << file.fileName();
+    return entries;
+}
+
+qint64 SessionJournal::compactionThreshold() const { return m_compactionThreshold; }
+
+void SessionJournal::setCompactionThreshold(qint64 compactionThreshold)
+{
+    m_compactionThreshold = compactionThreshold;
+}
+
+int SessionJournal::compactionInterval() const { return m_compactionTimer.interval(); }
+
+void SessionJournal::setCompactionInterval(int compactionInterval)
+{
+    m_compactionTimer.setInterval(qMax(0, compactionInterval));
+}
+
+void SessionJournal::clear()
+{
+    m_compactionTimer.stop();
+    m_file.close();
+
+    if (m_file.exists() && !m_file.remove()) {
+        qCWarning(dcConsolinnoEnergy())
+            << "SessionJournal: Could not remove" << m_file.fileName() << m_file.errorString();
+    }
+}
+
+bool SessionJournal::open()
+{
+    if (m_file.isOpen())
+        return true;
+
+    if (!m_file.open(QIODevice::ReadWrite | QIODevice::Append)) {
+        qCWarning(dcConsolinnoEnergy())
+            << "SessionJournal: Could not open" << m_file.fileName() << m_file.errorString();
+        return false;
+    }
+
+    if (m_file.size() == 0) {
+        QByteArray header;
+        QDataStream stream(&header, QIODevice::WriteOnly);
+        stream << journalMagic;
+        m_file.write(header);
+    }
+
+    return true;
+}
+
+bool SessionJournal::writeRecord(RecordType type, const QByteArray& payload)
+{
+    if (!open())
+        return false;
+
+    if (payload.size() > 0xffff) {
+        qCWarning(dcConsolinnoEnergy()) << "SessionJournal: Record too large" << payload.size();
+        return false;
+    }
+
+    quint16 length = static_cast<quint16>(payload.size());
+    quint16 crc = recordChecksum(type, payload);
+
+    QByteArray record;
+    record.reserve(recordHeaderSize + payload.size() + recordTrailerSize);
+    record.append(static_cast<char>(type));
+    record.append(static_cast<char>(length >> 8));
+    record.append(static_cast<char>(length & 0xff));
+    record.append(payload);
+    record.append(static_cast<char>(crc >> 8));
+    record.append(static_cast<char>(crc & 0xff));
+
+    if (m_file.write(record) != record.size() || !m_file.flush()) {
+        qCWarning(dcConsolinnoEnergy())
+            << "SessionJournal: Could not write to" << m_file.fileName() << m_file.errorString();
+        return false;
+    }
+
+    // The record is only a few bytes, make sure it survives a power cut
+    ::fdatasync(m_file.handle());
+
+    if (!m_compactionTimer.isActive()) {
+        m_compactionTimer.start();
+    }
+
+    if (m_file.size() >= m_compactionThreshold) {
+        emit compactionRequested();
+    }
+
+    return true;
+}
@@ -0,0 +1,71 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#ifndef SESSIONJOURNAL_H
+#define SESSIONJOURNAL_H
+
+#include <QFile>
+#include <QObject>
+#include <QTimer>
+
+#include "configurations/chargingsessionconfiguration.h"
+
+struct SessionJournalEntry {
+    bool removed = false;
+    ThingId evChargerThingId;
+    ChargingSessionConfiguration configuration;
+};
+
+/*!
+ * \brief The SessionJournal class is an append-only log of charging session updates.
+ * \details Charging sessions change every few seconds while a car is charging. Instead of
+ * rewriting consolinno.conf for each update, every update gets appended as a small checksummed
+ * record and synced to disk. On startup the records are replayed on top of the settings store.
+ * Once the journal grew beyond the compaction threshold or the compaction interval expired,
+ * compactionRequested() is emitted; the owner writes the settings store, in the background if it
+ * likes, and calls clear() once the store is on disk.
+ */
+class SessionJournal : public QObject {
+    Q_OBJECT
+public:
+    explicit SessionJournal(const QString& fileName, QObject* parent = nullptr);
+    ~SessionJournal() override;
+
+    QString fileName() const;
+    qint64 size() const;
+
+    bool append(const ChargingSessionConfiguration& chargingSessionConfiguration);
+    bool appendRemoval(const ThingId& evChargerThingId);
+
+    // Returns all intact records in order, a torn record at the end (power cut) is dropped
+    QList<SessionJournalEntry> replay() const;
+
+    // Size in bytes after which a compaction gets requested
+    qint64 compactionThreshold() const;
+    void setCompactionThreshold(qint64 compactionThreshold);
+
+    // Time in milliseconds after the first record before a compaction gets requested
+    int compactionInterval() const;
+    void setCompactionInterval(int compactionInterval);
+
+public slots:
+    // Drops all records, call this once their content has been persisted elsewhere
+    void clear();
+
+signals:
+    void compactionRequested();
+
+private:
+    enum RecordType : quint8 { RecordTypeUpdate = 1, RecordTypeRemove = 2 };
+
+    QFile m_file;
+    qint64 m_compactionThreshold = 64 * 1024;
+    QTimer m_compactionTimer;
+
+    bool open();
+    bool writeRecord(RecordType type, const QByteArray& payload);
+};
+
+#endif // SESSIONJOURNAL_H
@@ -0,0 +1,107 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include "setpointactuator.h"
+#include "engineclock.h"
+
+#include <QLoggingCategory>
+
+#include <integrations/thingactioninfo.h>
+
+Q_DECLARE_LOGGING_CATEGORY(dcConsolinnoEnergy)
+
+SetpointActuator::SetpointActuator(ThingManager* thingManager, QObject* parent)
+    : QObject(parent)
+    , m_thingManager(thingManager)
+{
+}
+
+int SetpointActuator::refreshInterval() const { return m_refreshInterval; }
+
+void SetpointActuator::setRefreshInterval(int refreshInterval)
+{
+    m_refreshInterval = qMax(0, refreshInterval);
+}
+
+int SetpointActuator::confirmTimeout() const { return m_confirmTimeout; }
+
+void SetpointActuator::setConfirmTimeout(int confirmTimeout)
+{
+    m_confirmTimeout = qMax(0, confirmTimeout);
+}
+
+bool SetpointActuator::setTarget(Thing* thing, const ActionTypeId& actionTypeId,
+    const StateTypeId& stateTypeId, const QVariant& target)
+{
+    SetpointKey key(thing->id(), actionTypeId);
+    Setpoint& setpoint = m_setpoints[key];
+
+    bool commanded = setpoint.commanded.isValid() && setpoint.commanded == target;
+    if (commanded && setpoint.inFlight) {
+        m_suppressedActions++;
+        return false;
+    }
+
+    qint64 now = EngineClock::monotonicTime();
+    bool expired = setpoint.commandedAt < 0 || now - setpoint.commandedAt > m_refreshInterval;
+    if (commanded && !expired) {
+        // The thing reports the value with its next poll, until then the command is trusted
+        bool confirming
+            = setpoint.succeededAt >= 0 && now - setpoint.succeededAt <= m_confirmTimeout;
+        if (confirming || thing->stateValue(stateTypeId) == target) {
+            m_suppressedActions++;
+            return false;
+        }
+
+        qCDebug(dcConsolinnoEnergy())
+            << "Setpoint" << target << "on" << thing->name() << "not confirmed, sending again";
+    }
+
+    setpoint.commanded = target;
+    setpoint.commandedAt = now;
+    setpoint.succeededAt = -1;
+    setpoint.inFlight = true;
+    m_sentActions++;
+
+    Action action(actionTypeId, thing->id());
+    ParamList params;
+    params.append(Param(actionTypeId, target));
+    action.setParams(params);
+
+    ThingActionInfo* info = m_thingManager->executeAction(action);
+    connect(info, &ThingActionInfo::finished, this, [this, key, target, info]() {
+        auto it = m_setpoints.find(key);
+        // The thing may be gone or a newer target may have been sent meanwhile
+        if (it == m_setpoints.end() || it.value().commanded != target)
+            return;
+
+        it.value().inFlight = false;
+        if (info->status() != Thing::ThingErrorNoError) {
+            qCWarning(dcConsolinnoEnergy()) << "Setting" << target << "on" << key.first.toString()
+                                            << "failed:" << info->status();
+            it.value().commanded = QVariant();
+            return;
+        }
+
+        it.value().succeededAt = EngineClock::monotonicTime();
+    });
+
+    return true;
+}
+
+void SetpointActuator::forget(const ThingId& thingId)
+{
+    for (auto it = m_setpoints.begin(); it != m_setpoints.end();) {
+        if (it.key().first == thingId) {
+            it = m_setpoints.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+quint64 SetpointActuator::sentActions() const { return m_sentActions; }
+
+quint64 SetpointActuator::suppressedActions() const { return m_suppressedActions; }
@@ -0,0 +1,71 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#ifndef SETPOINTACTUATOR_H
+#define SETPOINTACTUATOR_H
+
+#include <QHash>
+#include <QObject>
+#include <QPair>
+#include <QVariant>
+
+#include <integrations/thingmanager.h>
+
+/*!
+ * \brief The SetpointActuator class only sends actions that change something.
+ * \details For every thing and action type the last commanded value is kept. An action gets
+ * executed if the target differs from the commanded value, or if the refresh interval since the
+ * last command expired. While an action is in flight the same target is not sent again; a
+ * different target is sent right away. A successfully executed action is authoritative until the
+ * confirm timeout expired: integrations polling a slow bus report the new value only with their
+ * next poll. Only a mismatch between the commanded value and the value the thing reports
+ * (confirmed value) after that timeout sends the target again. A failed action forgets the
+ * commanded value, so the next evaluation retries.
+ */
+class SetpointActuator : public QObject {
+    Q_OBJECT
+public:
+    explicit SetpointActuator(ThingManager* thingManager, QObject* parent = nullptr);
+
+    // Time in milliseconds after which an unchanged setpoint gets sent again
+    int refreshInterval() const;
+    void setRefreshInterval(int refreshInterval);
+
+    // Time in milliseconds a successfully executed action waits for the thing to report the value
+    int confirmTimeout() const;
+    void setConfirmTimeout(int confirmTimeout);
+
+    // Executes the action setting the state to target unless it is already commanded and
+    // confirmed. Returns true if an action has been executed.
+    bool setTarget(Thing* thing, const ActionTypeId& actionTypeId, const StateTypeId& stateTypeId,
+        const QVariant& target);
+
+    void forget(const ThingId& thingId);
+
+    quint64 sentActions() const;
+    quint64 suppressedActions() const;
+
+private:
+    // Times are EngineClock::monotonicTime(), -1 if not set
+    struct Setpoint {
+        QVariant commanded;
+        qint64 commandedAt = -1;
+        // Set when the action finished successfully
+        qint64 succeededAt = -1;
+        bool inFlight = false;
+    };
+
+    typedef QPair<ThingId, ActionTypeId> SetpointKey;
+
+    ThingManager* m_thingManager = nullptr;
+    int m_refreshInterval = 60000;
+    int m_confirmTimeout = 15000;
+    QHash<SetpointKey, Setpoint> m_setpoints;
+
+    quint64 m_sentActions = 0;
+    quint64 m_suppressedActions = 0;
+};
+
+#endif // SETPOINTACTUATOR_H
@@ -0,0 +1,531 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include "settingsstore.h"
+
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QLoggingCategory>
+#include <QSettings>
+#include <QtConcurrent>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+Q_DECLARE_LOGGING_CATEGORY(dcConsolinnoEnergy)
+
+// Snapshot layout: [magic:u32][format:u32][generation:u64][length:u32][crc32:u32][payload]
+static const quint32 snapshotMagic = 0x43535331; // "CSS1"
+static const quint32 snapshotFormat = 1;
+static const int snapshotHeaderSize = 24;
+
+namespace {
+
+struct Crc32Table {
+    quint32 entries[256];
+
+    Crc32Table()
+    {
+        for (quint32 i = 0; i < 256; i++) {
+            quint32 c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+            }
+            entries[i] = c;
+        }
+    }
+};
+
+}
+
+static quint32 crc32(const QByteArray& data)
+{
+    // Function local statics get initialized exactly once, even with concurrent callers
+    static const Crc32Table table;
+
+    quint32 crc = 0xffffffff;
+    const uchar* bytes = reinterpret_cast<const uchar*>(data.constData());
+    for (int i = 0; i < data.size(); i++) {
+        crc = table.entries[(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+    }
+    return crc ^ 0xffffffff;
+}
+
+// Keeps a damaged snapshot for analysis, it must never become the last known good one
+static void keepCorrupt(const QString& fileName)
+{
+    if (!QFile::exists(fileName))
+        return;
+
+    QFile::remove(fileName + ".corrupt");
+    QFile::rename(fileName, fileName + ".corrupt");
+}
+
+SettingsStore::SettingsStore(const QString& fileName, QObject* parent)
+    : QObject(parent)
+    , m_fileName(fileName)
+    , m_snapshotFileName(fileName + ".snapshot")
+{
+    m_flushTimer.setSingleShot(true);
+    m_flushTimer.setInterval(5000);
+    connect(&m_flushTimer, &QTimer::timeout, this, &SettingsStore::flush);
+    connect(&m_backgroundFlush, &QFutureWatcher<bool>::finished, this,
+        &SettingsStore::finishBackgroundFlush);
+
+    // Make sure nothing gets lost if nymead shuts down before the flush timer fired
+    if (QCoreApplication::instance()) {
+        connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit, this,
+            &SettingsStore::flush);
+    }
+
+    load();
+}
+
+SettingsStore::~SettingsStore() { flush(); }
+
+QString SettingsStore::fileName() const { return m_fileName; }
+
+QString SettingsStore::snapshotFileName() const { return m_snapshotFileName; }
+
+quint64 SettingsStore::generation() const { return m_generation; }
+
+QStringList SettingsStore::childGroups(const QString& group) const
+{
+    QString prefix = group.isEmpty() ? QString() : group + '/';
+
+    // The keys are sorted, so all keys of a group are contiguous and the child groups show up in
+    // order. We only need to walk the keys below the given prefix.
+    QStringList groups;
+    for (auto it = m_values.lowerBound(prefix); it != m_values.cend(); ++it) {
+        if (!it.key().startsWith(prefix))
+            break;
+
+        int separator = it.key().indexOf('/', prefix.length());
+        if (separator < 0)
+            continue;
+
+        QString childGroup = it.key().mid(prefix.length(), separator - prefix.length());
+        if (groups.isEmpty() || groups.last() != childGroup) {
+            groups.append(childGroup);
+        }
+    }
+
+    return groups;
+}
+
+bool SettingsStore::containsGroup(const QString& group) const
+{
+    QString prefix = group + '/';
+    auto it = m_values.lowerBound(prefix);
+    return it != m_values.cend() && it.key().startsWith(prefix);
+}
+
+bool SettingsStore::contains(const QString& key) const { return m_values.contains(key); }
+
+QVariant SettingsStore::value(const QString& key, const QVariant& defaultValue) const
+{
+    return m_values.value(key, defaultValue);
+}
+
+bool SettingsStore::setValue(const QString& key, const QVariant& value)
+{
+    auto it = m_values.find(key);
+    if (it != m_values.end() && it.value() == value)
+        return false;
+
+    m_values.insert(key, value);
+    markDirty();
+    return true;
+}
+
+bool SettingsStore::setValueDeferred(const QString& key, const QVariant& value)
+{
+    auto it = m_values.find(key);
+    if (it != m_values.end() && it.value() == value)
+        return false;
+
+    m_values.insert(key, value);
+    markDeferredDirty();
+    return true;
+}
+
+void SettingsStore::remove(const QString& key)
+{
+    bool removed = m_values.remove(key) > 0;
+
+    QString prefix = key.isEmpty() ? QString() : key + '/';
+    auto it = m_values.lowerBound(prefix);
+    while (it != m_values.end() && it.key().startsWith(prefix)) {
+        it = m_values.erase(it);
+        removed = true;
+    }
+
+    if (removed) {
+        markDirty();
+    }
+}
+
+int SettingsStore::flushInterval() const { return m_flushTimer.interval(); }
+
+void SettingsStore::setFlushInterval(int flushInterval)
+{
+    m_flushTimer.setInterval(qMax(0, flushInterval));
+}
+
+bool SettingsStore::isDirty() const { return m_dirty || m_deferredDirty; }
+
+void SettingsStore::flush()
+{
+    // Both would write the same temporary file, and the generations have to stay in order
+    if (m_backgroundFlushPending) {
+        m_backgroundFlush.waitForFinished();
+        finishBackgroundFlush();
+    }
+
+    m_flushTimer.stop();
+    if (!m_dirty && !m_deferredDirty)
+        return;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    if (!writeSnapshot(m_snapshotFileName, m_values, m_generation + 1)) {
+        // Keep the changes in memory, the next change or the shutdown retries
+        return;
+    }
+
+    m_generation++;
+    m_dirty = false;
+    m_deferredDirty = false;
+    // The migrated values are on disk now, the INI file must not be read again
+    if (m_migrating) {
+        retireIniFile();
+    }
+    qCDebug(dcConsolinnoEnergy()) << "SettingsStore: Flushed" << m_values.count() << "values to"
+                                  << m_snapshotFileName << "generation" << m_generation << "in"
+                                  << timer.nsecsElapsed() / 1000 << "us";
+    emit flushed();
+}
+
+void SettingsStore::flushInBackground()
+{
+    if (m_backgroundFlushPending || (!m_dirty && !m_deferredDirty))
+        return;
+
+    m_flushTimer.stop();
+    m_backgroundFlushPending = true;
+    m_backgroundGeneration = m_generation + 1;
+    m_backgroundChanges = m_changes;
+    m_backgroundValueCount = m_values.count();
+    m_backgroundFlush.setFuture(QtConcurrent::run(&SettingsStore::writeSnapshot,
+        m_snapshotFileName, m_values, m_backgroundGeneration));
+}
+
+void SettingsStore::finishBackgroundFlush()
+{
+    // flush() might have finished it already
+    if (!m_backgroundFlushPending)
+        return;
+
+    m_backgroundFlushPending = false;
+    if (!m_backgroundFlush.result()) {
+        // The changes are still dirty, the next change or the shutdown retries
+        if (m_dirty && !m_flushTimer.isActive()) {
+            m_flushTimer.start();
+        }
+        return;
+    }
+
+    m_generation = m_backgroundGeneration;
+    if (m_migrating) {
+        retireIniFile();
+    }
+    qCDebug(dcConsolinnoEnergy()) << "SettingsStore: Flushed" << m_backgroundValueCount
+                                  << "values to" << m_snapshotFileName << "generation"
+                                  << m_generation << "in the background";
+
+    // Newer changes are not on disk yet, deferred ones are still journaled by the caller
+    if (m_changes != m_backgroundChanges) {
+        if (m_dirty && !m_flushTimer.isActive()) {
+            m_flushTimer.start();
+        }
+        return;
+    }
+
+    m_dirty = false;
+    m_deferredDirty = false;
+    emit flushed();
+}
+
+void SettingsStore::load()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    // A valid snapshot is all we need. If the current one is missing or damaged, a complete
+    // temporary file (power cut between the renames) or the last known good generation is used.
+    // The INI file is only read if there never was a snapshot (migration).
+    QString tempFileName = m_snapshotFileName + ".tmp";
+    QString previousFileName = m_snapshotFileName + ".prev";
+    if (readSnapshot(m_snapshotFileName)) {
+        qCDebug(dcConsolinnoEnergy())
+            << "SettingsStore: Loaded" << m_values.count() << "values from" << m_snapshotFileName
+            << "generation" << m_generation << "in" << timer.nsecsElapsed() / 1000 << "us";
+        // Boxes migrated before the INI file got retired still have it
+        retireIniFile();
+        return;
+    }
+
+    foreach (const QString& candidate, QStringList() << tempFileName << previousFileName) {
+        if (!readSnapshot(candidate))
+            continue;
+
+        qCWarning(dcConsolinnoEnergy()) << "SettingsStore: Recovered" << m_values.count()
+                                        << "values from" << candidate << "generation"
+                                        << m_generation;
+
+        keepCorrupt(m_snapshotFileName);
+        retireIniFile();
+        markDirty();
+        return;
+    }
+
+    if (QFile::exists(m_snapshotFileName) || QFile::exists(previousFileName)) {
+        // The INI file is retired after the migration, an old one would silently revert the
+        // configuration. Start without values and keep both generations for analysis, the next
+        // flush must not rotate a damaged snapshot into the last known good place.
+        qCCritical(dcConsolinnoEnergy())
+            << "SettingsStore: No valid snapshot found, keeping the damaged generations as"
+            << m_snapshotFileName + ".corrupt" << "and" << previousFileName + ".corrupt";
+        keepCorrupt(m_snapshotFileName);
+        keepCorrupt(previousFileName);
+        return;
+    }
+
+    if (!QFile::exists(m_fileName))
+        return;
+
+    QSettings settings(m_fileName, QSettings::IniFormat);
+    foreach (const QString& key, settings.allKeys()) {
+        m_values.insert(key, settings.value(key));
+    }
+
+    qCDebug(dcConsolinnoEnergy()) << "SettingsStore: Loaded" << m_values.count() << "values from"
+                                  << m_fileName;
+    // The INI file gets retired once the first snapshot is on disk
+    m_migrating = true;
+    markDirty();
+}
+
+void SettingsStore::retireIniFile()
+{
+    m_migrating = false;
+    if (!QFile::exists(m_fileName))
+        return;
+
+    QString migratedFileName = m_fileName + ".migrated";
+    QFile::remove(migratedFileName);
+    if (!QFile::rename(m_fileName, migratedFileName)) {
+        qCWarning(dcConsolinnoEnergy())
+            << "SettingsStore: Could not rename" << m_fileName << "to" << migratedFileName;
+        return;
+    }
+
+    qCInfo(dcConsolinnoEnergy()) << "SettingsStore: Migrated" << m_fileName << "to"
+                                 << migratedFileName;
+}
+
+bool SettingsStore::readSnapshot(const QString& fileName)
+{
+    QFile file(fileName);
+    if (!file.exists())
+        return false;
+
+    if (!file.open(QIODevice::ReadOnly)) {
+        qCWarning(dcConsolinnoEnergy())
+            << "SettingsStore: Could not open" << fileName << file.errorString();
+        return false;
+    }
+
+    QByteArray data = file.readAll();
+    file.close();
+
+    if (data.size() < snapshotHeaderSize) {
+        qCWarning(dcConsolinnoEnergy()) << "SettingsStore: Snapshot" << fileName << "is truncated";
+        return false;
+    }
+
+    QDataStream header(data);
+    quint32 magic = 0, format = 0, length = 0, checksum = 0;
+    quint64 generation = 0;
+    header >> magic >> format >> generation >> length >> checksum;
+    if (magic != snapshotMagic || format != snapshotFormat) {
+        qCWarning(dcConsolinnoEnergy()) << "SettingsStore: Snapshot" << fileName
+                                        << "has an unknown format";
+        return false;
+    }
+
+    QByteArray payload = data.mid(snapshotHeaderSize);
+    if (static_cast<quint32>(payload.size()) != length || crc32(payload) != checksum) {
+        qCWarning(dcConsolinnoEnergy()) << "SettingsStore: Snapshot" << fileName
+                                        << "failed the checksum validation";
+        return false;
+    }
+
+    QMap<QString, QVariant> values;
+    QDataStream stream(payload);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream >> values;
+    if (stream.status() != QDataStream::Ok) {
+        qCWarning(dcConsolinnoEnergy()) << "SettingsStore: Snapshot" << fileName
+                                        << "could not be parsed";
+        return false;
+    }
+
+    m_values = values;
+    m_generation = generation;
+    return true;
+}
+
+bool SettingsStore::writeSnapshot(const QString& snapshotFileName,
+    const QMap<QString, QVariant>& values, quint64 generation)
+{
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << values;
+
+    QByteArray data;
+    data.reserve(snapshotHeaderSize + payload.size());
+    QDataStream header(&data, QIODevice::WriteOnly);
+    header << snapshotMagic << snapshotFormat << generation
+           << static_cast<quint32>(payload.size()) << crc32(payload);
+    data.append(payload);
+
+    // Write the new generation next to the current one and make sure it is on disk before it
+    // replaces anything. A power cut leaves either the old or the new generation in place.
+    QString tempFileName = snapshotFileName + ".tmp";
+    QFile file(tempFileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qCWarning(dcConsolinnoEnergy())
+            << "SettingsStore: Could not open" << tempFileName << file.errorString();
+        return false;
+    }
+
+    if (file.write(data) != data.size() || !file.flush() || ::fsync(file.handle()) != 0) {
+        qCWarning(dcConsolinnoEnergy())
+            << "SettingsStore: Could not write" << tempFileName << file.errorString();
+        file.close();
+        file.remove();
+        return false;
+    }
+    file.close();
+
+    // Keep the current generation as last known good
+    QString previousFileName = snapshotFileName + ".prev";
+    if (QFile::exists(snapshotFileName)
+        && ::rename(QFile::encodeName(snapshotFileName).constData(),
+               QFile::encodeName(previousFileName).constData())
+            != 0) {
+        qCWarning(dcConsolinnoEnergy())
+            << "SettingsStore: Could not keep" << snapshotFileName << "as last known good";
+    }
+
+    if (::rename(QFile::encodeName(tempFileName).constData(),
+            QFile::encodeName(snapshotFileName).constData())
+        != 0) {
+        qCWarning(dcConsolinnoEnergy())
+            << "SettingsStore: Could not replace" << snapshotFileName;
+        return false;
+    }
+
+    // Persist the renames
+    int directory = ::open(
+        QFile::encodeName(QFileInfo(snapshotFileName).absolutePath()).constData(), O_RDONLY);
+    if (directory >= 0) {
+        ::fsync(directory);
+        ::close(directory);
+    }
+
+    return true;
+}
+
+void SettingsStore::markDirty()
+{
+    m_changes++;
+    m_dirty = true;
+    if (!m_flushTimer.isActive()) {
+        m_flushTimer.start();
+    }
+}
+
+void SettingsStore::markDeferredDirty()
+{
+    m_changes++;
+    m_deferredDirty = true;
+}
+
+ConsolinnoSettings::ConsolinnoSettings(SettingsStore* store)
+    : m_store(store)
+{
+}
+
+void ConsolinnoSettings::beginGroup(const QString& prefix) { m_groupStack.append(prefix); }
+
+void ConsolinnoSettings::endGroup()
+{
+    if (m_groupStack.isEmpty()) {
+        qCWarning(dcConsolinnoEnergy()) << "ConsolinnoSettings: endGroup() without beginGroup()";
+        return;
+    }
+
+    m_groupStack.removeLast();
+}
+
+QString ConsolinnoSettings::group() const { return m_groupStack.join('/'); }
+
+QStringList ConsolinnoSettings::childGroups() const { return m_store->childGroups(group()); }
+
+bool ConsolinnoSettings::containsGroup(const QString& group) const
+{
+    return m_store->containsGroup(absoluteKey(group));
+}
+
+bool ConsolinnoSettings::contains(const QString& key) const
+{
+    return m_store->contains(absoluteKey(key));
+}
+
+QVariant ConsolinnoSettings::value(const QString& key, const QVariant& defaultValue) const
+{
+    return m_store->value(absoluteKey(key), defaultValue);
+}
+
+void ConsolinnoSettings::setValue(const QString& key, const QVariant& value)
+{
+    m_store->setValue(absoluteKey(key), value);
+}
+
+void ConsolinnoSettings::setValueDeferred(const QString& key, const QVariant& value)
+{
+    m_store->setValueDeferred(absoluteKey(key), value);
+}
+
+void ConsolinnoSettings::remove(const QString& key) { m_store->remove(absoluteKey(key)); }
+
+QString ConsolinnoSettings::absoluteKey(const QString& key) const
+{
+    if (m_groupStack.isEmpty())
+        return key;
+
+    if (key.isEmpty())
+        return group();
+
+    return group() + '/' + key;
+}
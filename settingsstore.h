@@ -0,0 +1,135 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#ifndef SETTINGSSTORE_H
+#define SETTINGSSTORE_H
+
+#include <QFutureWatcher>
+#include <QMap>
+#include <QObject>
+#include <QStringList>
+#include <QTimer>
+#include <QVariant>
+
+/*!
+ * \brief The SettingsStore class keeps the consolinno configuration in memory.
+ * \details All reads are served from memory and writes are coalesced: every change marks the
+ * store dirty and a snapshot gets written once after the flush interval has passed. Call flush()
+ * to persist pending changes immediately, e.g. on shutdown. Keys are absolute paths in the
+ * QSettings notation ("Group/SubGroup/key"), use ConsolinnoSettings for group based access.
+ *
+ * Snapshots are written to a temporary file, synced and renamed over the current one, which is
+ * kept as last known good generation. Each snapshot carries a CRC32 of its content. On startup the
+ * first valid generation is loaded; the INI file given as fileName is only read as long as no
+ * snapshot exists, e.g. on the first start after an update. Once the first snapshot is on disk the
+ * INI file is renamed to fileName.migrated, so it is never read again. If no generation is valid,
+ * the damaged ones are moved to *.corrupt and the store starts empty.
+ *
+ * flushInBackground() writes a copy of the values on a thread of the global pool, the main thread
+ * only pays for the implicitly shared copy. flushed() is only emitted if nothing changed while the
+ * copy was written, a flush() in the meantime waits for the background write first.
+ */
+class SettingsStore : public QObject {
+    Q_OBJECT
+public:
+    explicit SettingsStore(const QString& fileName, QObject* parent = nullptr);
+    ~SettingsStore() override;
+
+    QString fileName() const;
+    QString snapshotFileName() const;
+    // Increases with every written snapshot
+    quint64 generation() const;
+
+    QStringList childGroups(const QString& group) const;
+    // Lookup in O(log n), prefer this over childGroups().contains()
+    bool containsGroup(const QString& group) const;
+    bool contains(const QString& key) const;
+
+    QVariant value(const QString& key, const QVariant& defaultValue = QVariant()) const;
+    // Returns false if the key already had this value
+    bool setValue(const QString& key, const QVariant& value);
+    // Updates the value in memory without starting the flush timer. The value is written with the
+    // next flush, the caller is responsible for making it durable until then (see SessionJournal).
+    bool setValueDeferred(const QString& key, const QVariant& value);
+    // Removes the key and everything below it
+    void remove(const QString& key);
+
+    // Time in milliseconds changes are collected before the file gets written
+    int flushInterval() const;
+    void setFlushInterval(int flushInterval);
+
+    bool isDirty() const;
+
+public slots:
+    void flush();
+    // Does nothing while a background write is running, the changes stay dirty until the next one
+    void flushInBackground();
+
+signals:
+    // Emitted after the in-memory tree, including deferred values, has been written to disk
+    void flushed();
+
+private:
+    QString m_fileName;
+    QString m_snapshotFileName;
+    quint64 m_generation = 0;
+    QMap<QString, QVariant> m_values;
+
+    QTimer m_flushTimer;
+    bool m_dirty = false;
+    bool m_deferredDirty = false;
+    // Loaded from the INI file, which gets retired with the first written snapshot
+    bool m_migrating = false;
+    // Counts the changes, a background write only covers the changes up to its start
+    quint64 m_changes = 0;
+
+    QFutureWatcher<bool> m_backgroundFlush;
+    bool m_backgroundFlushPending = false;
+    quint64 m_backgroundGeneration = 0;
+    quint64 m_backgroundChanges = 0;
+    int m_backgroundValueCount = 0;
+
+    void load();
+    bool readSnapshot(const QString& fileName);
+    // Only works on its arguments, it runs on the main thread and in the background
+    static bool writeSnapshot(const QString& snapshotFileName,
+        const QMap<QString, QVariant>& values, quint64 generation);
+    void finishBackgroundFlush();
+    void retireIniFile();
+    void markDirty();
+    void markDeferredDirty();
+};
+
+/*!
+ * \brief The ConsolinnoSettings class provides QSettings like group access to a SettingsStore.
+ * \details Create one on the stack where a QSettings object would be created. The group stack
+ * belongs to this object, so nested use (e.g. saving while loading) does not interfere.
+ */
+class ConsolinnoSettings {
+public:
+    explicit ConsolinnoSettings(SettingsStore* store);
+
+    void beginGroup(const QString& prefix);
+    void endGroup();
+    QString group() const;
+
+    QStringList childGroups() const;
+    bool containsGroup(const QString& group) const;
+    bool contains(const QString& key) const;
+
+    QVariant value(const QString& key, const QVariant& defaultValue = QVariant()) const;
+    void setValue(const QString& key, const QVariant& value);
+    void setValueDeferred(const QString& key, const QVariant& value);
+    // Same semantic as QSettings: an empty key removes the whole current group
+    void remove(const QString& key);
+
+private:
+    SettingsStore* m_store = nullptr;
+    QStringList m_groupStack;
+
+    QString absoluteKey(const QString& key) const;
+};
+
+#endif // SETTINGSSTORE_H
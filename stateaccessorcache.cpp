@@ -0,0 +1,68 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include "stateaccessorcache.h"
+
+#include <QLoggingCategory>
+
+Q_DECLARE_LOGGING_CATEGORY(dcConsolinnoEnergy)
+
+ThingClassAccessorsPointer StateAccessorCache::accessors(Thing* thing)
+{
+    auto it = m_accessors.constFind(thing->thingClassId());
+    if (it != m_accessors.constEnd())
+        return it.value();
+
+    ThingClassAccessorsPointer accessors(new ThingClassAccessors(resolve(thing->thingClass())));
+    m_accessors.insert(thing->thingClassId(), accessors);
+    return accessors;
+}
+
+int StateAccessorCache::count() const { return m_accessors.count(); }
+
+void StateAccessorCache::clear() { m_accessors.clear(); }
+
+ThingClassAccessors StateAccessorCache::resolve(const ThingClass& thingClass)
+{
+    ThingClassAccessors accessors;
+    accessors.thingClassId = thingClass.id();
+
+    StateTypes stateTypes = thingClass.stateTypes();
+    accessors.currentPower = stateTypes.findByName("currentPower").id();
+    accessors.currentPowerPhase[0] = stateTypes.findByName("currentPowerPhaseA").id();
+    accessors.currentPowerPhase[1] = stateTypes.findByName("currentPowerPhaseB").id();
+    accessors.currentPowerPhase[2] = stateTypes.findByName("currentPowerPhaseC").id();
+
+    accessors.pluggedIn = stateTypes.findByName("pluggedIn").id();
+    StateType maxChargingCurrent = stateTypes.findByName("maxChargingCurrent");
+    accessors.maxChargingCurrent = maxChargingCurrent.id();
+    accessors.maxChargingCurrentMinValue = maxChargingCurrent.minValue().toFloat();
+    accessors.maxChargingCurrentMaxValue = maxChargingCurrent.maxValue().toFloat();
+    accessors.phaseCount = stateTypes.findByName("phaseCount").id();
+
+    accessors.sgReadyMode = stateTypes.findByName("sgReadyMode").id();
+    accessors.power = stateTypes.findByName("power").id();
+
+    accessors.plim = stateTypes.findByName("plim").id();
+    accessors.plimStatus = stateTypes.findByName("plimStatus").id();
+    accessors.plimActionLatency = stateTypes.findByName("plimActionLatency").id();
+    accessors.plimMeterLatency = stateTypes.findByName("plimMeterLatency").id();
+
+    // Writable states share their id with the action setting them
+    ActionTypes actionTypes = thingClass.actionTypes();
+    accessors.maxChargingCurrentAction = actionTypes.findByName("maxChargingCurrent").id();
+    if (accessors.maxChargingCurrentAction.isNull()) {
+        accessors.maxChargingCurrentAction = ActionTypeId(accessors.maxChargingCurrent.toString());
+    }
+    accessors.sgReadyModeAction = actionTypes.findByName("sgReadyMode").id();
+    if (accessors.sgReadyModeAction.isNull()) {
+        accessors.sgReadyModeAction = ActionTypeId(accessors.sgReadyMode.toString());
+    }
+    accessors.powerAction = actionTypes.findByName("power").id();
+
+    qCDebug(dcConsolinnoEnergy()) << "Resolved state accessors of thing class" << thingClass.name()
+                                  << thingClass.id().toString();
+    return accessors;
+}
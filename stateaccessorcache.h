@@ -0,0 +1,77 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#ifndef STATEACCESSORCACHE_H
+#define STATEACCESSORCACHE_H
+
+#include <QHash>
+#include <QSharedPointer>
+
+#include <array>
+
+#include <integrations/thing.h>
+#include <types/thingclass.h>
+
+/*!
+ * \brief The ThingClassAccessors struct holds the resolved type ids of one thing class.
+ * \details Ids of states the thing class does not have stay null, so comparing a StateTypeId
+ * against them simply never matches.
+ */
+struct ThingClassAccessors {
+    ThingClassId thingClassId;
+
+    // Meters, ev chargers, inverters
+    StateTypeId currentPower;
+    std::array<StateTypeId, 3> currentPowerPhase; // Phases A, B and C
+
+    // Ev chargers
+    StateTypeId pluggedIn;
+    StateTypeId maxChargingCurrent;
+    ActionTypeId maxChargingCurrentAction;
+    float maxChargingCurrentMinValue = 0;
+    float maxChargingCurrentMaxValue = 0;
+    StateTypeId phaseCount;
+
+    // Heat pumps
+    StateTypeId sgReadyMode;
+    ActionTypeId sgReadyModeAction;
+
+    // Heating rods and everything else that can be switched
+    StateTypeId power;
+    ActionTypeId powerAction;
+
+    // Grid support
+    StateTypeId plim;
+    StateTypeId plimStatus;
+    StateTypeId plimActionLatency;
+    StateTypeId plimMeterLatency;
+};
+
+typedef QSharedPointer<const ThingClassAccessors> ThingClassAccessorsPointer;
+
+/*!
+ * \brief The StateAccessorCache class resolves the state and action types used by the control
+ * loop once per thing class.
+ * \details Looking up a state by name copies the thing class and searches its state types. The
+ * control loop does that for every meter sample and every ev charger, so the ids and limits get
+ * resolved when a thing of a class is monitored for the first time and are looked up by
+ * ThingClassId afterwards. The entries are shared, so a handed out pointer stays valid when the
+ * cache grows or gets cleared, e.g. in the state change handlers of a monitored thing.
+ */
+class StateAccessorCache {
+public:
+    // Resolves the thing class on first use
+    ThingClassAccessorsPointer accessors(Thing* thing);
+
+    int count() const;
+    void clear();
+
+private:
+    QHash<ThingClassId, ThingClassAccessorsPointer> m_accessors;
+
+    static ThingClassAccessors resolve(const ThingClass& thingClass);
+};
+
+#endif // STATEACCESSORCACHE_H
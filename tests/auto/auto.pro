@@ -0,0 +1,8 @@
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    chargingsessionhistory \
+    controltick \
+    limitpath \
+    optimizerworker \
+    pidcontroller
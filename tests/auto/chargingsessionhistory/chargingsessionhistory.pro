@@ -0,0 +1,18 @@
+include(../../tests.pri)
+
+QT += testlib
+CONFIG += testcase link_pkgconfig
+PKGCONFIG += nymea
+
+TARGET = testchargingsessionhistory
+
+HEADERS += \
+    $$ENGINE_DIR/chargingsessionhistory.h \
+    $$ENGINE_DIR/configurations/chargingsessionconfiguration.h \
+    $$ENGINE_DIR/engineclock.h
+
+SOURCES += \
+    $$ENGINE_DIR/chargingsessionhistory.cpp \
+    $$ENGINE_DIR/configurations/chargingsessionconfiguration.cpp \
+    $$ENGINE_DIR/engineclock.cpp \
+    testchargingsessionhistory.cpp
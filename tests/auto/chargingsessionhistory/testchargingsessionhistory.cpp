@@ -0,0 +1,292 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include <QLoggingCategory>
+#include <QTemporaryDir>
+#include <QtTest>
+
+#include <limits>
+
+#include "chargingsessionhistory.h"
+#include "engineclock.h"
+
+Q_LOGGING_CATEGORY(dcConsolinnoEnergy, "ConsolinnoEnergy")
+
+namespace {
+
+const qint64 day = 24 * 60 * 60;
+const qint64 forever = std::numeric_limits<qint64>::max();
+
+ChargingSessionConfiguration createSession(const ThingId& evChargerThingId, int timestamp)
+{
+    ChargingSessionConfiguration session;
+    session.setEvChargerThingId(evChargerThingId);
+    session.setSessionId(QUuid::createUuid());
+    session.setTimestamp(timestamp);
+    session.setEnergyCharged(timestamp / 10.0f);
+    return session;
+}
+
+QList<int> timestamps(const QList<ChargingSessionConfiguration>& sessions)
+{
+    QList<int> timestamps;
+    foreach (const ChargingSessionConfiguration& session, sessions) {
+        timestamps.append(session.timestamp());
+    }
+    return timestamps;
+}
+
+}
+
+/*!
+ * \brief The TestChargingSessionHistory class covers the ring file of the charging sessions.
+ * \details The history records on the EngineClock, the test runs it on a virtual time. That time
+ * never goes backwards, every test continues from the time the previous one stopped at.
+ */
+class TestChargingSessionHistory : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void wraparound();
+    void updateInPlace();
+    void retention();
+    void rangeBounds_data();
+    void rangeBounds();
+    void chargerFilter();
+    void rangeQuery_data();
+    void rangeQuery();
+
+private:
+    QTemporaryDir* m_dir = nullptr;
+    qint64 m_now = 0;
+
+    QString fileName() const;
+    // Seconds since epoch on the virtual clock
+    void advance(qint64 seconds);
+};
+
+void TestChargingSessionHistory::initTestCase()
+{
+    m_now = QDateTime(QDate(2026, 1, 1), QTime(0, 0), Qt::UTC).toMSecsSinceEpoch() / 1000;
+    EngineClock::setVirtualTime(m_now * 1000);
+}
+
+void TestChargingSessionHistory::init() { m_dir = new QTemporaryDir(); }
+
+void TestChargingSessionHistory::cleanup()
+{
+    delete m_dir;
+    m_dir = nullptr;
+}
+
+QString TestChargingSessionHistory::fileName() const
+{
+    return m_dir->path() + "/chargingsessions.bin";
+}
+
+void TestChargingSessionHistory::advance(qint64 seconds)
+{
+    m_now += seconds;
+    EngineClock::setVirtualTime(m_now * 1000);
+}
+
+void TestChargingSessionHistory::wraparound()
+{
+    ThingId evCharger = ThingId::createThingId();
+    {
+        ChargingSessionHistory history(fileName(), 4);
+        QVERIFY(history.isOpen());
+        for (int i = 1; i <= 6; i++) {
+            history.record(createSession(evCharger, i));
+            advance(1);
+        }
+
+        QCOMPARE(history.capacity(), 4u);
+        QCOMPARE(history.count(), 4u);
+        QCOMPARE(timestamps(history.sessions(evCharger, 0, forever)),
+            QList<int>() << 3 << 4 << 5 << 6);
+
+        // The oldest record gets overwritten again after a full turn
+        for (int i = 7; i <= 9; i++) {
+            history.record(createSession(evCharger, i));
+            advance(1);
+        }
+        QCOMPARE(timestamps(history.sessions(evCharger, 0, forever)),
+            QList<int>() << 6 << 7 << 8 << 9);
+    }
+
+    // The ring continues where it stopped, a new capacity does not apply to an existing file
+    ChargingSessionHistory history(fileName(), 16);
+    QCOMPARE(history.capacity(), 4u);
+    QCOMPARE(history.count(), 4u);
+    history.record(createSession(evCharger, 10));
+    QCOMPARE(timestamps(history.sessions(evCharger, 0, forever)),
+        QList<int>() << 7 << 8 << 9 << 10);
+}
+
+void TestChargingSessionHistory::updateInPlace()
+{
+    ThingId evCharger = ThingId::createThingId();
+    ChargingSessionHistory history(fileName(), 8);
+
+    ChargingSessionConfiguration session = createSession(evCharger, 1);
+    history.record(session);
+    advance(1);
+    session.setFinishedAt("2026-01-01T01:00:00");
+    session.setEnergyCharged(12.5f);
+    history.record(session);
+
+    QCOMPARE(history.count(), 1u);
+    QList<ChargingSessionConfiguration> sessions = history.sessions(evCharger, 0, forever);
+    QCOMPARE(sessions.count(), 1);
+    QCOMPARE(sessions.first().sessionId(), session.sessionId());
+    QCOMPARE(sessions.first().finishedAt(), QString("2026-01-01T01:00:00"));
+    QCOMPARE(sessions.first().energyCharged(), 12.5f);
+
+    // Only the last session of a charger gets updated, a new one gets appended
+    history.record(createSession(evCharger, 2));
+    advance(1);
+    history.record(session);
+    QCOMPARE(history.count(), 3u);
+}
+
+void TestChargingSessionHistory::retention()
+{
+    ThingId evCharger = ThingId::createThingId();
+    ChargingSessionHistory history(fileName(), 8);
+    history.setRetentionDays(1);
+
+    history.record(createSession(evCharger, 1));
+    advance(day / 2);
+    history.record(createSession(evCharger, 2));
+    advance(day / 2 + 1);
+
+    // Expired records are not returned anymore, even before the next append drops them
+    QCOMPARE(history.count(), 2u);
+    QCOMPARE(timestamps(history.sessions(evCharger, 0, forever)), QList<int>() << 2);
+
+    history.record(createSession(evCharger, 3));
+    QCOMPARE(history.count(), 2u);
+    QCOMPARE(timestamps(history.sessions(evCharger, 0, forever)), QList<int>() << 2 << 3);
+
+    advance(2 * day);
+    history.record(createSession(evCharger, 4));
+    QCOMPARE(history.count(), 1u);
+    QCOMPARE(timestamps(history.sessions(evCharger, 0, forever)), QList<int>() << 4);
+
+    // Without retention the ring keeps everything it can hold
+    history.setRetentionDays(0);
+    advance(30 * day);
+    history.record(createSession(evCharger, 5));
+    QCOMPARE(timestamps(history.sessions(evCharger, 0, forever)), QList<int>() << 4 << 5);
+}
+
+void TestChargingSessionHistory::rangeBounds_data()
+{
+    // Ten sessions recorded 10 s apart, at offsets 0 to 90 from the first one
+    QTest::addColumn<qint64>("from");
+    QTest::addColumn<qint64>("to");
+    QTest::addColumn<int>("limit");
+    QTest::addColumn<QList<int>>("expected");
+
+    QTest::newRow("all") << qint64(0) << forever << 0
+                         << (QList<int>() << 0 << 10 << 20 << 30 << 40 << 50 << 60 << 70 << 80
+                                          << 90);
+    QTest::newRow("inclusive bounds") << qint64(20) << qint64(40) << 0
+                                      << (QList<int>() << 20 << 30 << 40);
+    QTest::newRow("between records") << qint64(21) << qint64(39) << 0 << (QList<int>() << 30);
+    QTest::newRow("single record") << qint64(50) << qint64(50) << 0 << (QList<int>() << 50);
+    QTest::newRow("before the first") << qint64(-100) << qint64(-1) << 0 << QList<int>();
+    QTest::newRow("up to the first") << qint64(-100) << qint64(0) << 0 << (QList<int>() << 0);
+    QTest::newRow("from the last") << qint64(90) << qint64(1000) << 0 << (QList<int>() << 90);
+    QTest::newRow("after the last") << qint64(91) << forever << 0 << QList<int>();
+    QTest::newRow("empty range") << qint64(40) << qint64(20) << 0 << QList<int>();
+    QTest::newRow("limit keeps the newest") << qint64(0) << forever << 3
+                                            << (QList<int>() << 70 << 80 << 90);
+    QTest::newRow("limit within the range") << qint64(10) << qint64(55) << 2
+                                            << (QList<int>() << 40 << 50);
+    QTest::newRow("limit above the matches") << qint64(10) << qint64(30) << 5
+                                             << (QList<int>() << 10 << 20 << 30);
+}
+
+void TestChargingSessionHistory::rangeBounds()
+{
+    QFETCH(qint64, from);
+    QFETCH(qint64, to);
+    QFETCH(int, limit);
+    QFETCH(QList<int>, expected);
+
+    ThingId evCharger = ThingId::createThingId();
+    ChargingSessionHistory history(fileName(), 16);
+    qint64 start = m_now;
+    for (int offset = 0; offset < 100; offset += 10) {
+        history.record(createSession(evCharger, offset));
+        advance(10);
+    }
+
+    qint64 queryFrom = from == 0 ? 0 : start + from;
+    qint64 queryTo = to == forever ? forever : start + to;
+    QCOMPARE(timestamps(history.sessions(evCharger, queryFrom, queryTo, limit)), expected);
+}
+
+void TestChargingSessionHistory::chargerFilter()
+{
+    ThingId first = ThingId::createThingId();
+    ThingId second = ThingId::createThingId();
+    ChargingSessionHistory history(fileName(), 16);
+    for (int i = 0; i < 8; i++) {
+        history.record(createSession(i % 2 ? second : first, i));
+        advance(1);
+    }
+
+    QCOMPARE(timestamps(history.sessions(first, 0, forever)), QList<int>() << 0 << 2 << 4 << 6);
+    QCOMPARE(timestamps(history.sessions(second, 0, forever, 2)), QList<int>() << 5 << 7);
+    QCOMPARE(history.sessions(ThingId(), 0, forever).count(), 8);
+    QCOMPARE(history.sessions(ThingId::createThingId(), 0, forever).count(), 0);
+}
+
+void TestChargingSessionHistory::rangeQuery_data()
+{
+    QTest::addColumn<int>("days");
+    QTest::newRow("one day") << 1;
+    QTest::newRow("one month") << 30;
+    QTest::newRow("one year") << 365;
+}
+
+void TestChargingSessionHistory::rangeQuery()
+{
+    QFETCH(int, days);
+
+    // A year of sessions, one every hour, spread over ten chargers
+    QList<ThingId> evChargers;
+    for (int i = 0; i < 10; i++) {
+        evChargers.append(ThingId::createThingId());
+    }
+    ChargingSessionHistory history(fileName(), 16384);
+    history.setRetentionDays(0);
+    qint64 start = m_now;
+    for (int hour = 0; hour < 365 * 24; hour++) {
+        history.record(createSession(evChargers.at(hour % evChargers.count()), hour));
+        advance(60 * 60);
+    }
+    QCOMPARE(history.count(), 365u * 24);
+
+    // The range ends with the history, from the middle of a month for the shorter ones
+    qint64 to = m_now;
+    qint64 from = qMax(start, to - days * day);
+    QList<ChargingSessionConfiguration> sessions;
+    QBENCHMARK {
+        sessions = history.sessions(evChargers.first(), from, to);
+    }
+    QVERIFY(!sessions.isEmpty());
+    QVERIFY(sessions.count() <= days * 24 / evChargers.count() + 1);
+}
+
+QTEST_GUILESS_MAIN(TestChargingSessionHistory)
+#include "testchargingsessionhistory.moc"
@@ -0,0 +1,10 @@
+include(../../engine.pri)
+include(../../mocks/mocks.pri)
+
+QT += testlib
+CONFIG += testcase
+
+TARGET = testcontroltick
+
+SOURCES += \
+    testcontroltick.cpp
@@ -0,0 +1,263 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include <QLoggingCategory>
+#include <QTemporaryDir>
+#include <QtTest>
+
+#include <cstdlib>
+#include <new>
+
+#include "energyengine.h"
+#include "settingsstore.h"
+
+#include "mockenergymanager.h"
+#include "mockthingmanager.h"
+#include "mockthings.h"
+
+Q_LOGGING_CATEGORY(dcConsolinnoEnergy, "ConsolinnoEnergy")
+
+namespace {
+
+// Only the thread measuring counts, the optimizer thread allocates for its results in parallel
+thread_local bool counting = false;
+thread_local quint64 allocations = 0;
+
+inline void countAllocation()
+{
+    if (counting) {
+        allocations++;
+    }
+}
+
+}
+
+// The containers of Qt allocate with malloc, operator new of everything else ends up there as well
+#ifdef __GLIBC__
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* pointer, size_t size);
+void __libc_free(void* pointer);
+
+void* malloc(size_t size) noexcept
+{
+    countAllocation();
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) noexcept
+{
+    countAllocation();
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* pointer, size_t size) noexcept
+{
+    countAllocation();
+    return __libc_realloc(pointer, size);
+}
+
+void free(void* pointer) noexcept { __libc_free(pointer); }
+}
+
+void* operator new(std::size_t size)
+{
+    void* pointer = malloc(size > 0 ? size : 1);
+    if (!pointer)
+        throw std::bad_alloc();
+    return pointer;
+}
+#else
+void* operator new(std::size_t size)
+{
+    countAllocation();
+    void* pointer = std::malloc(size > 0 ? size : 1);
+    if (!pointer)
+        throw std::bad_alloc();
+    return pointer;
+}
+#endif
+
+void* operator new[](std::size_t size) { return operator new(size); }
+void operator delete(void* pointer) noexcept { std::free(pointer); }
+void operator delete[](void* pointer) noexcept { std::free(pointer); }
+
+namespace {
+
+const int ticks = 100;
+// Posting the snapshot to the optimizer thread: the queued call, its arguments and the event
+const quint64 maximumLimitedTickAllocations = 16;
+
+}
+
+/*!
+ * \brief The TestControlTick class counts the allocations of a control loop tick on the main
+ * thread.
+ * \details Every tick reads the root meter and the CLS units into a snapshot. Without a limit
+ * and with nothing for the optimizer to regulate it must not allocate at all. Under a limit the
+ * snapshot gets posted to the optimizer, that costs a few allocations, but never more with more
+ * units.
+ */
+class TestControlTick : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void idleTick_data();
+    void idleTick();
+    void limitedTick_data();
+    void limitedTick();
+
+private:
+    QTemporaryDir* m_settingsDir = nullptr;
+    MockThingManager* m_thingManager = nullptr;
+    MockEnergyManager* m_energyManager = nullptr;
+    EnergyEngine* m_engine = nullptr;
+    Thing* m_rootMeter = nullptr;
+
+    void startEngine(int evChargerCount);
+    void setGridPower(double power) const;
+    void waitForEvaluation() const;
+    // Average allocations of a tick, the grid power alternates between the given ones
+    double countTickAllocations(double lowPower, double highPower);
+};
+
+void TestControlTick::initTestCase()
+{
+    // Disabled categories do not format anything
+    QLoggingCategory::setFilterRules("*.debug=false\n*.info=false");
+}
+
+void TestControlTick::init()
+{
+    m_settingsDir = new QTemporaryDir();
+    qputenv("SNAP", "1");
+    qputenv("SNAP_DATA", m_settingsDir->path().toUtf8());
+    SettingsStore settings(m_settingsDir->path() + "/consolinno.conf");
+    // Only the ticks of the test run, no limit source from the system bus
+    settings.setValue("Settings/controlLoopInterval", 24 * 60 * 60 * 1000);
+    settings.setValue(
+        "Settings/limitSourceBusAddress", "unix:path=" + m_settingsDir->path() + "/no-bus");
+    settings.flush();
+}
+
+void TestControlTick::cleanup()
+{
+    delete m_engine;
+    m_engine = nullptr;
+    delete m_energyManager;
+    m_energyManager = nullptr;
+    delete m_thingManager;
+    m_thingManager = nullptr;
+    delete m_settingsDir;
+    m_settingsDir = nullptr;
+}
+
+void TestControlTick::startEngine(int evChargerCount)
+{
+    m_thingManager = new MockThingManager();
+    m_energyManager = new MockEnergyManager(m_thingManager);
+    m_rootMeter = MockThings::create(MockThings::rootMeterClass(), "Root meter");
+    m_thingManager->addThing(m_rootMeter);
+    m_energyManager->setRootMeter(m_rootMeter);
+    m_thingManager->addThing(MockThings::create(MockThings::gridSupportClass(), "Grid support"));
+    m_thingManager->addThing(MockThings::create(MockThings::inverterClass(), "Inverter"));
+    m_thingManager->addThing(MockThings::create(MockThings::heatPumpClass(), "Heat pump"));
+    for (int i = 0; i < evChargerCount; i++) {
+        m_thingManager->addThing(
+            MockThings::create(MockThings::evChargerClass(), QString("Ev charger %1").arg(i)));
+    }
+
+    m_engine = new EnergyEngine(m_thingManager, m_energyManager);
+    foreach (ChargingOptimizationConfiguration configuration,
+        m_engine->chargingOptimizationConfigurations()) {
+        configuration.setControllableLocalSystem(true);
+        m_engine->setChargingOptimizationConfiguration(configuration);
+    }
+    foreach (HeatingConfiguration configuration, m_engine->heatingConfigurations()) {
+        configuration.setControllableLocalSystem(true);
+        configuration.setMaxElectricalPower(3);
+        m_engine->setHeatingConfiguration(configuration);
+    }
+    waitForEvaluation();
+}
+
+void TestControlTick::setGridPower(double power) const
+{
+    for (int phase = 0; phase < EnergyEngine::phaseCount; phase++) {
+        m_rootMeter->setStateValue(QString("currentPowerPhase%1").arg(QChar('A' + phase)),
+            power / EnergyEngine::phaseCount);
+    }
+    m_rootMeter->setStateValue("currentPower", power);
+}
+
+void TestControlTick::waitForEvaluation() const
+{
+    QCoreApplication::processEvents();
+    QTRY_VERIFY(!m_engine->isEvaluationPending());
+}
+
+double TestControlTick::countTickAllocations(double lowPower, double highPower)
+{
+    // The first ticks fill the snapshot pool and let the optimizer report back
+    quint64 total = 0;
+    for (int tick = -3; tick < ticks; tick++) {
+        setGridPower(tick % 2 ? highPower : lowPower);
+        waitForEvaluation();
+
+        allocations = 0;
+        counting = true;
+        QMetaObject::invokeMethod(
+            m_engine, "evaluateAndSetMaxChargingCurrent", Qt::DirectConnection);
+        counting = false;
+        if (tick >= 0) {
+            total += allocations;
+        }
+    }
+    waitForEvaluation();
+    return static_cast<double>(total) / ticks;
+}
+
+void TestControlTick::idleTick_data()
+{
+    QTest::addColumn<int>("evChargerCount");
+    QTest::newRow("1 ev charger") << 1;
+    QTest::newRow("10 ev chargers") << 10;
+    QTest::newRow("50 ev chargers") << 50;
+}
+
+void TestControlTick::idleTick()
+{
+    QFETCH(int, evChargerCount);
+    startEngine(evChargerCount);
+
+    double tickAllocations = countTickAllocations(2000, 3000);
+    QCOMPARE(tickAllocations, 0.0);
+}
+
+void TestControlTick::limitedTick_data() { idleTick_data(); }
+
+void TestControlTick::limitedTick()
+{
+    QFETCH(int, evChargerCount);
+    startEngine(evChargerCount);
+
+    // Every charger and the heat pump have to give up some power
+    qlonglong consumptionLimit = 4000 * evChargerCount;
+    m_engine->onConsumptionLimitChanged(ControlLatencyTracker::SourceOpcUa, consumptionLimit);
+    waitForEvaluation();
+
+    double tickAllocations
+        = countTickAllocations(consumptionLimit * 0.8, consumptionLimit * 1.2);
+    QVERIFY2(tickAllocations <= maximumLimitedTickAllocations,
+        qPrintable(QString("%1 allocations per tick").arg(tickAllocations)));
+}
+
+QTEST_GUILESS_MAIN(TestControlTick)
+#include "testcontroltick.moc"
@@ -0,0 +1,11 @@
+include(../../engine.pri)
+include(../../mocks/mocks.pri)
+include(../../limitsourcestub/limitsourcestub.pri)
+
+QT += testlib
+CONFIG += testcase
+
+TARGET = testlimitpath
+
+SOURCES += \
+    testlimitpath.cpp
@@ -0,0 +1,443 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include <QElapsedTimer>
+#include <QLoggingCategory>
+#include <QProcess>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QThread>
+#include <QTimer>
+#include <QtTest>
+
+#include <functional>
+
+#include "energyengine.h"
+#include "enginecapture.h"
+#include "limitsourcemanager.h"
+#include "limitsourcestub.h"
+#include "settingsstore.h"
+
+#include "mockenergymanager.h"
+#include "mockthingmanager.h"
+#include "mockthings.h"
+
+Q_LOGGING_CATEGORY(dcConsolinnoEnergy, "ConsolinnoEnergy")
+
+namespace {
+
+// One three phase wallbox under a §14a limit: the low limit grants it 6 A, the high one 16 A. The
+// extra 100 W keep the rounding of the allocation away from the next lower ampere.
+const qlonglong lowLimit = 6 * 690 + 100;
+const qlonglong highLimit = 16 * 690 + 100;
+const int lowCurrent = 6;
+const int highCurrent = 16;
+
+const int latencySamples = 100;
+// Generous for shared CI machines, a regression of the limit path costs orders of magnitude
+const qint64 maximumLatency = 1000;
+const int timeout = 30000;
+const int probeInterval = 10;
+
+/*!
+ * \brief The StormSender class sends a signal storm off the main thread, so the rate does not
+ * depend on how fast the engine gets through the signals.
+ */
+class StormSender : public QThread {
+public:
+    StormSender(LimitSourceStub* stub, LimitSourceStub::Source source, quint64 count, double rate,
+        const QElapsedTimer* clock)
+        : m_stub(stub)
+        , m_source(source)
+        , m_count(count)
+        , m_rate(rate)
+        , m_clock(clock)
+    {
+    }
+
+    quint64 sent() const { return m_sent; }
+    // Time on the clock when the last signal had been sent, valid once finished
+    qint64 finishedAt() const { return m_finishedAt; }
+
+protected:
+    void run() override
+    {
+        m_sent = m_stub->sendLimits(
+            m_source, QList<qlonglong>() << lowLimit << highLimit, m_count, m_rate);
+        m_finishedAt = m_clock->nsecsElapsed();
+    }
+
+private:
+    LimitSourceStub* m_stub;
+    LimitSourceStub::Source m_source;
+    quint64 m_count;
+    double m_rate;
+    const QElapsedTimer* m_clock;
+    quint64 m_sent = 0;
+    qint64 m_finishedAt = 0;
+};
+
+}
+
+/*!
+ * \brief The TestLimitPath class sends consumption limits over D-Bus into the energy engine.
+ * \details A private dbus-daemon session carries the LimitSourceStub in place of the IEC 61850
+ * server and the OPC UA client, the engine receives from it through
+ * Settings/limitSourceBusAddress. The executed actions come from the mock thing manager, so the
+ * whole path from the signal on the bus to the action of the wallbox gets measured.
+ */
+class TestLimitPath : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void cleanup();
+
+    void sourcesConnect();
+    void limitToActionLatency_data();
+    void limitToActionLatency();
+    void signalStorm_data();
+    void signalStorm();
+    void limitActiveAtStartup();
+
+private:
+    QProcess m_busDaemon;
+    QTemporaryDir m_settingsDir;
+    LimitSourceStub* m_stub = nullptr;
+
+    MockThingManager* m_thingManager = nullptr;
+    MockEnergyManager* m_energyManager = nullptr;
+    EnergyEngine* m_engine = nullptr;
+    Thing* m_evCharger = nullptr;
+
+    QElapsedTimer m_clock;
+    // Limits received by the LimitSourceManager of the engine
+    quint64 m_received = 0;
+    qint64 m_receivedAt = 0;
+    // Charging current actions of the wallbox
+    quint64 m_actions = 0;
+    qint64 m_actionAt = 0;
+
+    void startEngine();
+    int chargingCurrent() const;
+    // Processes events until the condition holds, false after the timeout
+    static bool waitFor(const std::function<bool()>& condition, int timeout);
+};
+
+void TestLimitPath::initTestCase()
+{
+    QLoggingCategory::setFilterRules("ConsolinnoEnergy.debug=false\n"
+                                     "ConsolinnoEnergy.info=false\n"
+                                     "default.debug=false");
+
+    QString busDaemon = QStandardPaths::findExecutable("dbus-daemon");
+    if (busDaemon.isEmpty())
+        QSKIP("dbus-daemon is not installed");
+
+    m_busDaemon.start(busDaemon,
+        QStringList() << "--session" << "--print-address" << "--nofork" << "--nopidfile");
+    QVERIFY(m_busDaemon.waitForReadyRead(timeout));
+    QString address = QString::fromUtf8(m_busDaemon.readLine()).trimmed();
+    QVERIFY(!address.isEmpty());
+
+    QDBusConnection connection = QDBusConnection::connectToBus(address, "LimitSourceStub");
+    QVERIFY2(connection.isConnected(), qPrintable(connection.lastError().message()));
+    m_stub = new LimitSourceStub(connection, this);
+    QVERIFY(m_stub->registerSources());
+
+    QVERIFY(m_settingsDir.isValid());
+    qputenv("SNAP", "1");
+    qputenv("SNAP_DATA", m_settingsDir.path().toUtf8());
+    {
+        SettingsStore settings(m_settingsDir.path() + "/consolinno.conf");
+        // Every limit gets evaluated, a raise with the next event loop pass
+        settings.setValue("Settings/controlLoopInterval", 0);
+        settings.setValue("Settings/limitSourceBusAddress", address);
+        settings.flush();
+    }
+
+    m_thingManager = new MockThingManager(this);
+    m_energyManager = new MockEnergyManager(m_thingManager, this);
+    Thing* rootMeter = MockThings::create(MockThings::rootMeterClass(), "Root meter");
+    m_thingManager->addThing(rootMeter);
+    m_energyManager->setRootMeter(rootMeter);
+    m_thingManager->addThing(MockThings::create(MockThings::gridSupportClass(), "Grid support"));
+    m_evCharger = MockThings::create(MockThings::evChargerClass(), "Ev charger");
+    m_thingManager->addThing(m_evCharger);
+
+    m_clock.start();
+    StateTypeId maxChargingCurrent
+        = m_evCharger->thingClass().stateTypes().findByName("maxChargingCurrent").id();
+    connect(m_thingManager, &MockThingManager::actionRequested, this,
+        [this, maxChargingCurrent](Thing* thing, const Action& action) {
+            if (thing == m_evCharger
+                && action.actionTypeId().toString() == maxChargingCurrent.toString()) {
+                m_actions++;
+                m_actionAt = m_clock.nsecsElapsed();
+            }
+        });
+
+    startEngine();
+    if (QTest::currentTestFailed())
+        return;
+
+    // Stored in the settings, a restarted engine keeps it
+    QCOMPARE(m_engine->chargingOptimizationConfigurations().count(), 1);
+    ChargingOptimizationConfiguration configuration
+        = m_engine->chargingOptimizationConfigurations().first();
+    configuration.setControllableLocalSystem(true);
+    QCOMPARE(m_engine->setChargingOptimizationConfiguration(configuration),
+        EnergyEngine::HemsErrorNoError);
+}
+
+void TestLimitPath::cleanupTestCase()
+{
+    delete m_engine;
+    m_engine = nullptr;
+    if (m_stub) {
+        m_stub->unregisterSources();
+    }
+
+    if (m_busDaemon.state() != QProcess::NotRunning) {
+        m_busDaemon.terminate();
+        m_busDaemon.waitForFinished();
+    }
+}
+
+// Lifts the limits of all sources, under the strictest policy a limit left behind would hide the
+// limits of the next test
+void TestLimitPath::cleanup()
+{
+    if (!m_engine)
+        return;
+
+    quint64 expected = m_received;
+    for (int source = 0; source < ControlLatencyTracker::SourceCount; source++) {
+        if (m_stub->limit(static_cast<LimitSourceStub::Source>(source)) != -1) {
+            m_stub->setLimit(static_cast<LimitSourceStub::Source>(source), -1);
+            expected++;
+        }
+    }
+    QVERIFY(waitFor([&]() { return m_received == expected; }, timeout));
+    QVERIFY(waitFor([this]() { return !m_engine->isEvaluationPending(); }, timeout));
+}
+
+// The initial values are read with Properties.Get from the stub
+void TestLimitPath::sourcesConnect()
+{
+    QVERIFY(waitFor([this]() {
+        foreach (const LimitSourceStatus& status, m_engine->limitSources()) {
+            if (status.state() != QLatin1String("connected"))
+                return false;
+        }
+        return true;
+    }, timeout));
+}
+
+void TestLimitPath::limitToActionLatency_data()
+{
+    QTest::addColumn<int>("source");
+    for (int source = 0; source < ControlLatencyTracker::SourceCount; source++) {
+        QTest::newRow(qPrintable(
+            ControlLatencyTracker::sourceName(static_cast<ControlLatencyTracker::Source>(source))))
+            << source;
+    }
+}
+
+// From sending the signal to the charging current action of the wallbox, alternating between a
+// dropping limit, which gets evaluated right away, and a rising one, which waits for the next tick
+void TestLimitPath::limitToActionLatency()
+{
+    QFETCH(int, source);
+
+    LatencyHistogram latencies;
+    for (int sample = 0; sample < latencySamples; sample++) {
+        bool raise = chargingCurrent() == lowCurrent;
+        int expectedCurrent = raise ? highCurrent : lowCurrent;
+        quint64 actions = m_actions;
+
+        qint64 sentAt = m_clock.nsecsElapsed();
+        QVERIFY(m_stub->setLimit(
+            static_cast<LimitSourceStub::Source>(source), raise ? highLimit : lowLimit));
+        QVERIFY2(waitFor([&]() {
+            return m_actions > actions && chargingCurrent() == expectedCurrent;
+        }, timeout), qPrintable(QString("No action for sample %1").arg(sample)));
+        latencies.record((m_actionAt - sentAt) / 1000);
+    }
+
+    ControlLatencyStats engineStats;
+    foreach (const ControlLatencyStats& stats, m_engine->controlLatencyStats()) {
+        if (stats.source() == QTest::currentDataTag()) {
+            engineStats = stats;
+        }
+    }
+
+    qInfo().noquote() << QString("Signal to action: p50 %1 ms, p90 %2 ms, p99 %3 ms, max %4 ms")
+                             .arg(latencies.percentile(50) / 1000.0)
+                             .arg(latencies.percentile(90) / 1000.0)
+                             .arg(latencies.percentile(99) / 1000.0)
+                             .arg(latencies.max() / 1000.0);
+    qInfo().noquote() << QString("Within the engine: %1 actions, p50 %2 ms, p99 %3 ms")
+                             .arg(engineStats.actionCount())
+                             .arg(engineStats.actionP50())
+                             .arg(engineStats.actionP99());
+
+    QCOMPARE(latencies.count(), static_cast<quint64>(latencySamples));
+    // The engine measures from receiving the limit, without the time on the bus
+    QVERIFY(engineStats.actionCount() > 0);
+    QVERIFY2(latencies.percentile(99) < maximumLatency * 1000,
+        qPrintable(QString("p99 latency %1 ms").arg(latencies.percentile(99) / 1000.0)));
+}
+
+void TestLimitPath::signalStorm_data()
+{
+    QTest::addColumn<double>("rate");
+    QTest::addColumn<quint64>("count");
+
+    QTest::newRow("100/s") << 100.0 << static_cast<quint64>(200);
+    QTest::newRow("1000/s") << 1000.0 << static_cast<quint64>(2000);
+    QTest::newRow("unthrottled") << 0.0 << static_cast<quint64>(20000);
+}
+
+// The stub alternates between the two limits at the given rate. Every signal changes the effective
+// limit, so none of them can be dropped as a resend. The engine has to receive all of them, stay
+// responsive, and end up with the current of the last limit.
+void TestLimitPath::signalStorm()
+{
+    QFETCH(double, rate);
+    QFETCH(quint64, count);
+
+    const LimitSourceStub::Source source = ControlLatencyTracker::SourceIec61850Path1;
+    quint64 received = m_received;
+    quint64 actions = m_actions;
+    int expectedCurrent = count % 2 ? lowCurrent : highCurrent;
+
+    qint64 maxLateness = 0;
+    QElapsedTimer probeClock;
+    QTimer probeTimer;
+    probeTimer.setTimerType(Qt::PreciseTimer);
+    probeTimer.setInterval(probeInterval);
+    connect(&probeTimer, &QTimer::timeout, this, [&]() {
+        maxLateness = qMax(maxLateness, probeClock.restart() - probeInterval);
+    });
+
+    StormSender sender(m_stub, source, count, rate, &m_clock);
+    qint64 startedAt = m_clock.nsecsElapsed();
+
+    probeClock.start();
+    probeTimer.start();
+    sender.start();
+
+    QVERIFY(waitFor([&]() { return sender.isFinished(); }, timeout));
+    QCOMPARE(sender.sent(), count);
+    QVERIFY2(waitFor([&]() { return m_received - received == count; }, timeout),
+        qPrintable(QString("Received %1 of %2 limits").arg(m_received - received).arg(count)));
+    QVERIFY(waitFor([&]() {
+        return !m_engine->isEvaluationPending() && chargingCurrent() == expectedCurrent;
+    }, timeout));
+    probeTimer.stop();
+
+    qint64 finishedAt = sender.finishedAt();
+    double sendSeconds = (finishedAt - startedAt) / 1e9;
+    double receiveSeconds = (m_receivedAt - startedAt) / 1e9;
+    // How long the engine was still busy with the storm after the last signal had been sent
+    double backlogMs = qMax<qint64>(0, m_receivedAt - finishedAt) / 1e6;
+    qInfo().noquote() << QString("Sent %1 limits at %2 per second, received at %3 per second, "
+                                 "%4 actions, backlog %5 ms, main loop late by at most %6 ms")
+                             .arg(count)
+                             .arg(count / sendSeconds, 0, 'f', 0)
+                             .arg(count / receiveSeconds, 0, 'f', 0)
+                             .arg(m_actions - actions)
+                             .arg(backlogMs, 0, 'f', 1)
+                             .arg(maxLateness);
+
+    QVERIFY(m_actions > actions);
+    // Up to a thousand limits per second the engine keeps up with the bus
+    if (rate > 0) {
+        QVERIFY2(backlogMs < maximumLatency,
+            qPrintable(QString("Backlog of %1 ms after the storm").arg(backlogMs)));
+    }
+}
+
+// A limit in effect while the engine is down gets read with Properties.Get at startup. It has to
+// take effect without any signal and end up in the capture, so a replay starts with it as well.
+void TestLimitPath::limitActiveAtStartup()
+{
+    const LimitSourceStub::Source source = ControlLatencyTracker::SourceOpcUa;
+    QString captureFile = m_settingsDir.path() + "/startup.capture";
+
+    delete m_engine;
+    m_engine = nullptr;
+    {
+        SettingsStore settings(m_settingsDir.path() + "/consolinno.conf");
+        settings.setValue("Settings/captureFile", captureFile);
+        settings.flush();
+    }
+
+    m_stub->setInitialLimit(source, lowLimit);
+    m_evCharger->setStateValue("maxChargingCurrent", highCurrent);
+
+    quint64 received = m_received;
+    startEngine();
+    if (QTest::currentTestFailed())
+        return;
+
+    QVERIFY(waitFor([this]() { return chargingCurrent() == lowCurrent; }, timeout));
+    QCOMPARE(m_received, received);
+
+    // The capture gets closed with the engine
+    delete m_engine;
+    m_engine = nullptr;
+
+    EngineCaptureReader reader;
+    QVERIFY(reader.open(captureFile));
+    bool recorded = false;
+    EngineCaptureEvent event;
+    while (reader.next(event)) {
+        recorded |= event.type == EngineCaptureEvent::TypeLimitSignal && event.source == source
+            && event.consumptionLimit == lowLimit;
+    }
+    QVERIFY(recorded);
+
+    startEngine();
+}
+
+void TestLimitPath::startEngine()
+{
+    m_engine = new EnergyEngine(m_thingManager, m_energyManager, this);
+    LimitSourceManager* limitSources = m_engine->findChild<LimitSourceManager*>();
+    QVERIFY(limitSources);
+    connect(limitSources, &LimitSourceManager::consumptionLimitChanged, this, [this]() {
+        m_received++;
+        m_receivedAt = m_clock.nsecsElapsed();
+    });
+}
+
+int TestLimitPath::chargingCurrent() const
+{
+    return m_evCharger->stateValue("maxChargingCurrent").toInt();
+}
+
+bool TestLimitPath::waitFor(const std::function<bool()>& condition, int timeout)
+{
+    // Wakes the event loop up regularly, the condition might not depend on any event
+    QTimer heartbeat;
+    heartbeat.start(probeInterval);
+
+    QElapsedTimer timer;
+    timer.start();
+    while (!condition()) {
+        if (timer.elapsed() > timeout)
+            return false;
+
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+    }
+    return true;
+}
+
+QTEST_GUILESS_MAIN(TestLimitPath)
+
+#include "testlimitpath.moc"
@@ -0,0 +1,24 @@
+include(../../tests.pri)
+
+QT += testlib
+CONFIG += testcase link_pkgconfig
+PKGCONFIG += nymea
+
+TARGET = testoptimizerworker
+
+HEADERS += \
+    $$ENGINE_DIR/clspowerallocator.h \
+    $$ENGINE_DIR/decisiontrace.h \
+    $$ENGINE_DIR/heatpumpswitching.h \
+    $$ENGINE_DIR/optimizerworker.h \
+    $$ENGINE_DIR/pidautotuner.h \
+    $$ENGINE_DIR/pidcontroller.h
+
+SOURCES += \
+    $$ENGINE_DIR/clspowerallocator.cpp \
+    $$ENGINE_DIR/decisiontrace.cpp \
+    $$ENGINE_DIR/heatpumpswitching.cpp \
+    $$ENGINE_DIR/optimizerworker.cpp \
+    $$ENGINE_DIR/pidautotuner.cpp \
+    $$ENGINE_DIR/pidcontroller.cpp \
+    testoptimizerworker.cpp
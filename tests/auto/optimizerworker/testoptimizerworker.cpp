@@ -0,0 +1,175 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include <QElapsedTimer>
+#include <QLoggingCategory>
+#include <QSignalSpy>
+#include <QThread>
+#include <QTimer>
+#include <QtTest>
+
+#include "optimizerworker.h"
+
+Q_LOGGING_CATEGORY(dcConsolinnoEnergy, "ConsolinnoEnergy")
+
+namespace {
+
+// Snapshots get published at the rate of a busy control loop
+const int publishInterval = 50;
+const int probeInterval = 10;
+const int loadDuration = 3000;
+
+// Every computation blocks the worker thread this long, the snapshot itself is small. A main loop
+// waiting for a computation would be late by about that much, in milliseconds
+const int computeDelay = 200;
+const int snapshotChargerCount = 100;
+
+// A §14a limit with every unit competing for the power: one PID per charger plus the allocation
+EngineSnapshot createSnapshot(int chargerCount)
+{
+    EngineSnapshot snapshot;
+    snapshot.limitActive = true;
+    snapshot.consumptionLimit = 4200.0f * chargerCount / 2;
+
+    snapshot.evChargers.reserve(chargerCount);
+    for (int i = 0; i < chargerCount; i++) {
+        EngineSnapshot::EvCharger evCharger;
+        evCharger.thingId = ThingId::createThingId();
+        evCharger.maxChargingCurrent = 16;
+        evCharger.maxChargingCurrentMinValue = 6;
+        evCharger.maxChargingCurrentMaxValue = 32;
+        evCharger.controllableLocalSystem = true;
+        evCharger.clsPriority = i % 10;
+        evCharger.p = 0.001f;
+        evCharger.i = 0.0002f;
+        evCharger.setpoint = 100;
+        snapshot.evChargers.append(evCharger);
+    }
+
+    snapshot.heatPumps.reserve(chargerCount / 4);
+    for (int i = 0; i < chargerCount / 4; i++) {
+        EngineSnapshot::HeatPump heatPump;
+        heatPump.thingId = ThingId::createThingId();
+        heatPump.sgReadyMode = QStringLiteral("Standard");
+        heatPump.maxElectricalPower = 3000;
+        heatPump.clsPriority = i % 10;
+        snapshot.heatPumps.append(heatPump);
+    }
+
+    return snapshot;
+}
+
+// The units are shared with the base snapshot, publishing one does not copy them
+EngineSnapshotPointer publish(const EngineSnapshot& base, quint64 revision)
+{
+    QSharedPointer<EngineSnapshot> snapshot(new EngineSnapshot(base));
+    snapshot->revision = revision;
+    snapshot->gridPower = -2000 + (revision % 10) * 400;
+    snapshot->monotonicTime = revision * publishInterval;
+    snapshot->decision.timestamp = 1000 + revision * publishInterval;
+    return snapshot;
+}
+
+}
+
+class TestOptimizerWorker : public QObject {
+    Q_OBJECT
+
+private slots:
+    void outdatedSnapshotsAreSkipped();
+    void mainLoopStaysResponsive();
+};
+
+void TestOptimizerWorker::outdatedSnapshotsAreSkipped()
+{
+    OptimizerWorker worker;
+    QSignalSpy computedSpy(&worker, &OptimizerWorker::computed);
+
+    EngineSnapshot base = createSnapshot(10);
+    worker.setLatestRevision(5);
+    worker.compute(publish(base, 4));
+    QCOMPARE(computedSpy.count(), 0);
+
+    worker.compute(publish(base, 5));
+    QCOMPARE(computedSpy.count(), 1);
+    QCOMPARE(computedSpy.at(0).at(0).value<OptimizerResult>().revision, 5ull);
+}
+
+// The worker thread is kept busy with snapshots that each take computeDelay to compute, meanwhile
+// a probe timer on the main thread measures its lateness
+void TestOptimizerWorker::mainLoopStaysResponsive()
+{
+    EngineSnapshot base = createSnapshot(snapshotChargerCount);
+
+    const quint64 snapshotCount = loadDuration / publishInterval;
+    QThread* mainThread = QThread::currentThread();
+    QThread thread;
+    OptimizerWorker* worker = new OptimizerWorker();
+    worker->setComputeDelay(computeDelay);
+    worker->moveToThread(&thread);
+    connect(&thread, &QThread::finished, worker, &QObject::deleteLater);
+    thread.start();
+
+    quint64 results = 0;
+    quint64 lastRevision = 0;
+    bool resultsOnMainThread = true;
+    connect(worker, &OptimizerWorker::computed, this, [&](const OptimizerResult& result) {
+        results++;
+        lastRevision = result.revision;
+        resultsOnMainThread &= QThread::currentThread() == mainThread;
+    });
+
+    quint64 published = 0;
+    QTimer publishTimer;
+    publishTimer.setInterval(publishInterval);
+    connect(&publishTimer, &QTimer::timeout, this, [&]() {
+        if (published == snapshotCount) {
+            publishTimer.stop();
+            return;
+        }
+
+        // Exactly like the engine does it
+        EngineSnapshotPointer snapshot = publish(base, ++published);
+        worker->setLatestRevision(snapshot->revision);
+        QMetaObject::invokeMethod(worker, "compute", Qt::QueuedConnection,
+            Q_ARG(EngineSnapshotPointer, snapshot));
+    });
+
+    qint64 maxLateness = 0;
+    QElapsedTimer probeClock;
+    QTimer probeTimer;
+    probeTimer.setTimerType(Qt::PreciseTimer);
+    probeTimer.setInterval(probeInterval);
+    connect(&probeTimer, &QTimer::timeout, this, [&]() {
+        maxLateness = qMax(maxLateness, probeClock.restart() - probeInterval);
+    });
+
+    probeClock.start();
+    probeTimer.start();
+    publishTimer.start();
+
+    QTRY_VERIFY_WITH_TIMEOUT(
+        published == snapshotCount && lastRevision == published, loadDuration * 10);
+    probeTimer.stop();
+
+    thread.quit();
+    thread.wait();
+
+    qInfo() << "Published" << published << "snapshots, got" << results
+            << "results, main loop was late by at most" << maxLateness << "ms";
+
+    QVERIFY(resultsOnMainThread);
+    QVERIFY(results > 0);
+    // The worker could not keep up and skipped the outdated snapshots instead of queueing them up
+    QVERIFY(results < published);
+    // The probe timer must never have waited for a computation. Half the delay leaves room for a
+    // loaded machine, waiting for a computation costs the whole delay.
+    QVERIFY2(maxLateness < computeDelay / 2,
+        qPrintable(QString("Main loop blocked for %1 ms").arg(maxLateness)));
+}
+
+QTEST_GUILESS_MAIN(TestOptimizerWorker)
+
+#include "testoptimizerworker.moc"
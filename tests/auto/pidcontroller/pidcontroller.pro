@@ -0,0 +1,13 @@
+include(../../tests.pri)
+
+QT += testlib
+CONFIG += testcase
+
+TARGET = testpidcontroller
+
+HEADERS += \
+    $$ENGINE_DIR/pidcontroller.h
+
+SOURCES += \
+    $$ENGINE_DIR/pidcontroller.cpp \
+    testpidcontroller.cpp
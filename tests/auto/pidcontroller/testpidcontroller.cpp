@@ -0,0 +1,265 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include <QRandomGenerator>
+#include <QVector>
+#include <QtMath>
+#include <QtTest>
+
+#include <functional>
+
+#include "pidcontroller.h"
+
+namespace {
+
+// Three phases at 230 V
+const double wattsPerAmpere = 690;
+const double minimumCurrent = 6;
+const double maximumCurrent = 16;
+const double houseLoad = 500;
+
+// Gains as they would be stored in the charging optimization configuration, A/W, A/(W s), A s/W
+const double kp = 0.001;
+const double ki = 0.0002;
+const double kd = 0;
+
+// One ampere, the wallbox cannot be set any finer
+const double settlingBand = wattsPerAmpere;
+
+/*!
+ * \brief The Wallbox class simulates a wallbox charging a car as first order system.
+ * \details The car applies a new current only with the next sample (dead time), the charging
+ * power then approaches the current with the time constant of the car.
+ */
+class Wallbox {
+public:
+    Wallbox(double initialCurrent, double timeConstant)
+        : m_timeConstant(timeConstant)
+        , m_appliedCurrent(initialCurrent)
+        , m_pendingCurrent(initialCurrent)
+        , m_power(initialCurrent * wattsPerAmpere)
+    {
+    }
+
+    void setCurrent(double current) { m_pendingCurrent = current; }
+
+    // Advances by dt seconds, returns the charging power in W
+    double step(double dt)
+    {
+        double target = m_appliedCurrent * wattsPerAmpere;
+        m_power += (target - m_power) * (1 - qExp(-dt / m_timeConstant));
+        m_appliedCurrent = m_pendingCurrent;
+        return m_power;
+    }
+
+private:
+    double m_timeConstant;
+    double m_appliedCurrent;
+    double m_pendingCurrent;
+    double m_power;
+};
+
+struct Sample {
+    double gridPower = 0;
+    double current = 0;
+};
+
+// Returns the current to command for a grid power sample at time in milliseconds
+typedef std::function<double(double gridPower, qint64 time)> ChargingControl;
+
+// The grid point power is regulated to 0 W, the surplus is the pv power per sample
+QVector<Sample> simulate(const ChargingControl& control, const QVector<double>& surplus,
+    bool jitter)
+{
+    QRandomGenerator random(42);
+    Wallbox wallbox(minimumCurrent, 8);
+    QVector<Sample> samples;
+    samples.reserve(surplus.size());
+
+    qint64 time = 0;
+    foreach (double pvPower, surplus) {
+        // The meter of a real setup does not deliver at an exact rate
+        double dt = jitter ? 0.5 + random.bounded(1.5) : 1;
+        time += qRound64(dt * 1000);
+
+        Sample sample;
+        sample.gridPower = houseLoad - pvPower + wallbox.step(dt);
+        sample.current = control(sample.gridPower, time);
+        wallbox.setCurrent(sample.current);
+        samples.append(sample);
+    }
+    return samples;
+}
+
+// Whole amperes within the limits of the wallbox, as the optimizer commands them
+ChargingControl pidControl(PidController& controller)
+{
+    controller.setGains(kp, ki, kd);
+    controller.setOutputLimits(minimumCurrent, maximumCurrent);
+    controller.reset(minimumCurrent);
+    return [&controller](double gridPower, qint64 time) {
+        return qBound(minimumCurrent, qFloor(controller.update(0, gridPower, time)) * 1.0,
+            maximumCurrent);
+    };
+}
+
+// The previous behavior: everything while there is surplus, the minimum otherwise
+double bangBangControl(double gridPower, qint64 time)
+{
+    Q_UNUSED(time)
+    return gridPower > 0 ? minimumCurrent : maximumCurrent;
+}
+
+// Index of the first sample from which on the grid power stays within the band, -1 if never
+int settlingIndex(const QVector<Sample>& samples, int from = 0)
+{
+    int index = -1;
+    for (int i = from; i < samples.size(); i++) {
+        if (qAbs(samples.at(i).gridPower) > settlingBand) {
+            index = -1;
+        } else if (index < 0) {
+            index = i;
+        }
+    }
+    return index < 0 ? -1 : index - from;
+}
+
+double maxCurrentChange(const QVector<Sample>& samples)
+{
+    double previous = minimumCurrent;
+    double change = 0;
+    foreach (const Sample& sample, samples) {
+        change = qMax(change, qAbs(sample.current - previous));
+        previous = sample.current;
+    }
+    return change;
+}
+
+}
+
+class TestPidController : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initialOutputIsBumpless();
+    void outputIsClamped();
+    void stepResponse_data();
+    void stepResponse();
+    void recoversFromSaturation();
+    void setpointChangeCausesNoDerivativeKick();
+    void sampleGapRestartsDerivative();
+};
+
+void TestPidController::initialOutputIsBumpless()
+{
+    PidController controller;
+    controller.setGains(kp, ki, kd);
+    controller.setOutputLimits(minimumCurrent, maximumCurrent);
+    QVERIFY(!controller.isInitialized());
+
+    controller.reset(10);
+    QVERIFY(controller.isInitialized());
+    QCOMPARE(controller.update(0, 0, 1000), 10.0);
+    QCOMPARE(controller.update(0, 0, 2000), 10.0);
+}
+
+void TestPidController::outputIsClamped()
+{
+    PidController controller;
+    controller.setGains(kp, ki, kd);
+    controller.setOutputLimits(minimumCurrent, maximumCurrent);
+    controller.reset(10);
+
+    QCOMPARE(controller.update(0, -100000, 1000), maximumCurrent);
+    QCOMPARE(controller.update(0, 100000, 2000), minimumCurrent);
+
+    // An initial output outside of the limits gets clamped as well
+    controller.reset(32);
+    QCOMPARE(controller.output(), maximumCurrent);
+}
+
+void TestPidController::stepResponse_data()
+{
+    QTest::addColumn<bool>("jitter");
+
+    QTest::newRow("regular samples") << false;
+    QTest::newRow("irregular samples") << true;
+}
+
+// The surplus jumps from nothing to 8 kW, the charger has to take over about 11 A
+void TestPidController::stepResponse()
+{
+    QFETCH(bool, jitter);
+
+    QVector<double> surplus(300, 8000);
+
+    PidController controller;
+    QVector<Sample> pid = simulate(pidControl(controller), surplus, jitter);
+    QVector<Sample> bangBang = simulate(bangBangControl, surplus, jitter);
+
+    int pidSettling = settlingIndex(pid);
+    int bangBangSettling = settlingIndex(bangBang);
+    qInfo() << "Settled after" << pidSettling << "samples, bang-bang after" << bangBangSettling;
+
+    QVERIFY(pidSettling >= 0);
+    QVERIFY(pidSettling <= 30);
+    QVERIFY(bangBangSettling < 0 || pidSettling < bangBangSettling);
+
+    // Smooth: no jumps between the limits like the bang-bang control does
+    QVERIFY(maxCurrentChange(pid) <= 3);
+    QCOMPARE(maxCurrentChange(bangBang), maximumCurrent - minimumCurrent);
+    foreach (const Sample& sample, pid) {
+        QVERIFY(sample.current >= minimumCurrent && sample.current <= maximumCurrent);
+    }
+}
+
+// A surplus beyond the maximum current keeps the output saturated for two minutes, the integral
+// must not wind up meanwhile, or the charger would keep drawing from the grid after a cloud
+void TestPidController::recoversFromSaturation()
+{
+    QVector<double> surplus(120, 15000);
+    surplus += QVector<double>(120, 6000);
+
+    PidController controller;
+    QVector<Sample> samples = simulate(pidControl(controller), surplus, false);
+
+    QVERIFY(samples.at(119).current >= maximumCurrent - 1);
+    QVERIFY(samples.at(121).current < maximumCurrent - 1);
+
+    int settling = settlingIndex(samples, 120);
+    QVERIFY(settling >= 0);
+    QVERIFY(settling <= 30);
+}
+
+void TestPidController::setpointChangeCausesNoDerivativeKick()
+{
+    PidController controller;
+    controller.setGains(0, 0, 1);
+    controller.setOutputLimits(-100, 100);
+    controller.reset(0);
+
+    controller.update(0, 50, 1000);
+    controller.update(0, 50, 2000);
+    QCOMPARE(controller.update(5000, 50, 3000), 0.0);
+}
+
+void TestPidController::sampleGapRestartsDerivative()
+{
+    PidController controller;
+    controller.setGains(0, 0, 1);
+    controller.setOutputLimits(-1000, 1000);
+    controller.setMaxSampleTime(30);
+    controller.reset(0);
+
+    controller.update(0, 0, 1000);
+    QVERIFY(controller.update(0, 100, 2000) < 0);
+
+    // The meter was gone for a minute, the jump must not be taken as a slope
+    QCOMPARE(controller.update(0, 5000, 62000), 0.0);
+}
+
+QTEST_APPLESS_MAIN(TestPidController)
+
+#include "testpidcontroller.moc"
@@ -0,0 +1,80 @@
+# The engine sources of the plugin, without the plugin entry point. Keep in sync with
+# nymea-energy-plugin-consolinno.pro.
+include(tests.pri)
+
+QT += network dbus concurrent
+CONFIG += link_pkgconfig
+PKGCONFIG += nymea nymea-energy
+
+gcc {
+    COMPILER_VERSION = $$system($$QMAKE_CXX " -dumpversion")
+    COMPILER_MAJOR_VERSION = $$str_member($$COMPILER_VERSION)
+    greaterThan(COMPILER_MAJOR_VERSION, 7): QMAKE_CXXFLAGS += -Wno-deprecated-copy
+}
+
+HEADERS += \
+    $$ENGINE_DIR/configurations/batteryconfiguration.h \
+    $$ENGINE_DIR/configurations/chargingconfiguration.h \
+    $$ENGINE_DIR/configurations/chargingoptimizationconfiguration.h \
+    $$ENGINE_DIR/configurations/chargingsessionconfiguration.h \
+    $$ENGINE_DIR/configurations/conemsstate.h \
+    $$ENGINE_DIR/configurations/heatingconfiguration.h \
+    $$ENGINE_DIR/configurations/pvconfiguration.h \
+    $$ENGINE_DIR/configurations/userconfiguration.h \
+    $$ENGINE_DIR/configurations/heatingrodconfiguration.h \
+    $$ENGINE_DIR/configurations/dynamicelectricpricingconfiguration.h \
+    $$ENGINE_DIR/configurations/washingmachineconfiguration.h \
+    $$ENGINE_DIR/chargingsessionhistory.h \
+    $$ENGINE_DIR/clspowerallocator.h \
+    $$ENGINE_DIR/configurationchangelog.h \
+    $$ENGINE_DIR/configurationstore.h \
+    $$ENGINE_DIR/consolinnojsonhandler.h \
+    $$ENGINE_DIR/consumptionlimitarbiter.h \
+    $$ENGINE_DIR/controllatency.h \
+    $$ENGINE_DIR/controlloopscheduler.h \
+    $$ENGINE_DIR/decisiontrace.h \
+    $$ENGINE_DIR/energyengine.h \
+    $$ENGINE_DIR/enginecapture.h \
+    $$ENGINE_DIR/engineclock.h \
+    $$ENGINE_DIR/heatpumpswitching.h \
+    $$ENGINE_DIR/limitsourcemanager.h \
+    $$ENGINE_DIR/optimizerworker.h \
+    $$ENGINE_DIR/pidautotuner.h \
+    $$ENGINE_DIR/pidcontroller.h \
+    $$ENGINE_DIR/sessionjournal.h \
+    $$ENGINE_DIR/setpointactuator.h \
+    $$ENGINE_DIR/stateaccessorcache.h \
+    $$ENGINE_DIR/settingsstore.h
+
+SOURCES += \
+    $$ENGINE_DIR/configurations/batteryconfiguration.cpp \
+    $$ENGINE_DIR/configurations/chargingconfiguration.cpp \
+    $$ENGINE_DIR/configurations/chargingoptimizationconfiguration.cpp \
+    $$ENGINE_DIR/configurations/chargingsessionconfiguration.cpp \
+    $$ENGINE_DIR/configurations/conemsstate.cpp \
+    $$ENGINE_DIR/configurations/heatingconfiguration.cpp \
+    $$ENGINE_DIR/configurations/pvconfiguration.cpp \
+    $$ENGINE_DIR/configurations/userconfiguration.cpp \
+    $$ENGINE_DIR/configurations/heatingrodconfiguration.cpp \
+    $$ENGINE_DIR/configurations/dynamicelectricpricingconfiguration.cpp \
+    $$ENGINE_DIR/configurations/washingmachineconfiguration.cpp \
+    $$ENGINE_DIR/chargingsessionhistory.cpp \
+    $$ENGINE_DIR/clspowerallocator.cpp \
+    $$ENGINE_DIR/configurationchangelog.cpp \
+    $$ENGINE_DIR/consolinnojsonhandler.cpp \
+    $$ENGINE_DIR/consumptionlimitarbiter.cpp \
+    $$ENGINE_DIR/controllatency.cpp \
+    $$ENGINE_DIR/controlloopscheduler.cpp \
+    $$ENGINE_DIR/decisiontrace.cpp \
+    $$ENGINE_DIR/energyengine.cpp \
+    $$ENGINE_DIR/enginecapture.cpp \
+    $$ENGINE_DIR/engineclock.cpp \
+    $$ENGINE_DIR/heatpumpswitching.cpp \
+    $$ENGINE_DIR/limitsourcemanager.cpp \
+    $$ENGINE_DIR/optimizerworker.cpp \
+    $$ENGINE_DIR/pidautotuner.cpp \
+    $$ENGINE_DIR/pidcontroller.cpp \
+    $$ENGINE_DIR/sessionjournal.cpp \
+    $$ENGINE_DIR/setpointactuator.cpp \
+    $$ENGINE_DIR/stateaccessorcache.cpp \
+    $$ENGINE_DIR/settingsstore.cpp
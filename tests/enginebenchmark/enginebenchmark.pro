@@ -0,0 +1,9 @@
+include(../engine.pri)
+include(../mocks/mocks.pri)
+
+TARGET = enginebenchmark
+CONFIG += console
+CONFIG -= app_bundle
+
+SOURCES += \
+    main.cpp
@@ -0,0 +1,522 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLoggingCategory>
+#include <QTemporaryDir>
+#include <QThread>
+
+#include <functional>
+
+#include "consolinnojsonhandler.h"
+#include "energyengine.h"
+#include "jsonrpc/jsonreply.h"
+#include "settingsstore.h"
+#include "stateaccessorcache.h"
+
+#include "mockenergymanager.h"
+#include "mockthingmanager.h"
+#include "mockthings.h"
+
+Q_LOGGING_CATEGORY(dcConsolinnoEnergy, "ConsolinnoEnergy")
+
+namespace {
+
+// A §14a limit under which every unit has to give up some power
+const double powerPerUnit = 4000;
+
+struct Measurement {
+    quint64 calls = 0;
+    qint64 nsecs = 0;
+
+    QJsonObject toJson() const
+    {
+        QJsonObject object;
+        object.insert("calls", static_cast<qint64>(calls));
+        object.insert("usPerCall", calls > 0 ? nsecs / 1000.0 / calls : 0);
+        object.insert("perSecond", nsecs > 0 ? calls * 1e9 / nsecs : 0);
+        return object;
+    }
+};
+
+/*!
+ * \brief The Benchmark class runs the engine with N synthetic units of each kind.
+ * \details Every run gets its own settings directory, the engine starts from scratch. N ev
+ * chargers, heat pumps and batteries get configured as controllable local systems, so all of them
+ * are part of every snapshot while a consumption limit is active.
+ */
+class Benchmark {
+public:
+    explicit Benchmark(int duration)
+        : m_duration(duration)
+    {
+    }
+
+    QJsonObject run(int count);
+    // Only N ev chargers: the control tick and the charger state reads it does
+    QJsonObject runEvChargers(int count);
+    // N configured things in total: the first start, restarts and the first evaluation
+    QJsonObject runStartup(int count);
+
+private:
+    int m_duration;
+
+    MockThingManager* m_thingManager = nullptr;
+    MockEnergyManager* m_energyManager = nullptr;
+    Thing* m_rootMeter = nullptr;
+
+    // Repeats the function for the configured duration, only the time spent in it counts
+    Measurement measure(const std::function<void()>& function,
+        const std::function<void()>& prepare = std::function<void()>()) const;
+
+    static void prepareSettings(const QString& path);
+    void addRootMeter();
+    void addThings(int count);
+    void configure(EnergyEngine* engine) const;
+    void setGridPower(double power) const;
+    static void waitForEvaluation(EnergyEngine* engine);
+};
+
+Measurement Benchmark::measure(
+    const std::function<void()>& function, const std::function<void()>& prepare) const
+{
+    Measurement measurement;
+    QElapsedTimer total;
+    total.start();
+    QElapsedTimer timer;
+    while (measurement.calls == 0 || total.elapsed() < m_duration) {
+        if (prepare) {
+            prepare();
+        }
+        timer.start();
+        function();
+        measurement.nsecs += timer.nsecsElapsed();
+        measurement.calls++;
+    }
+    return measurement;
+}
+
+void Benchmark::prepareSettings(const QString& path)
+{
+    qputenv("SNAP", "1");
+    qputenv("SNAP_DATA", path.toUtf8());
+    SettingsStore settings(path + "/consolinno.conf");
+    // Only the evaluations triggered by the benchmark run, no limit source from the system bus
+    settings.setValue("Settings/controlLoopInterval", 24 * 60 * 60 * 1000);
+    settings.setValue("Settings/limitSourceBusAddress", "unix:path=" + path + "/no-bus");
+    settings.flush();
+}
+
+void Benchmark::addRootMeter()
+{
+    m_rootMeter = MockThings::create(MockThings::rootMeterClass(), "Root meter");
+    m_thingManager->addThing(m_rootMeter);
+    m_energyManager->setRootMeter(m_rootMeter);
+    m_thingManager->addThing(MockThings::create(MockThings::gridSupportClass(), "Grid support"));
+}
+
+void Benchmark::addThings(int count)
+{
+    addRootMeter();
+    m_thingManager->addThing(MockThings::create(MockThings::inverterClass(), "Inverter"));
+
+    for (int i = 0; i < count; i++) {
+        m_thingManager->addThing(
+            MockThings::create(MockThings::evChargerClass(), QString("Ev charger %1").arg(i)));
+        m_thingManager->addThing(
+            MockThings::create(MockThings::heatPumpClass(), QString("Heat pump %1").arg(i)));
+        m_thingManager->addThing(
+            MockThings::create(MockThings::batteryClass(), QString("Battery %1").arg(i)));
+    }
+}
+
+void Benchmark::configure(EnergyEngine* engine) const
+{
+    int priority = 0;
+    foreach (ChargingOptimizationConfiguration configuration,
+        engine->chargingOptimizationConfigurations()) {
+        configuration.setControllableLocalSystem(true);
+        configuration.setClsPriority(priority++ % 10);
+        configuration.setP_value(0.001f);
+        configuration.setI_value(0.0002f);
+        engine->setChargingOptimizationConfiguration(configuration);
+    }
+
+    foreach (HeatingConfiguration configuration, engine->heatingConfigurations()) {
+        configuration.setControllableLocalSystem(true);
+        configuration.setClsPriority(priority++ % 10);
+        configuration.setMaxElectricalPower(3);
+        engine->setHeatingConfiguration(configuration);
+    }
+
+    foreach (BatteryConfiguration configuration, engine->batteryConfigurations()) {
+        configuration.setControllableLocalSystem(true);
+        configuration.setClsPriority(priority++ % 10);
+        engine->setBatteryConfiguration(configuration);
+    }
+}
+
+void Benchmark::setGridPower(double power) const
+{
+    for (int phase = 0; phase < EnergyEngine::phaseCount; phase++) {
+        m_rootMeter->setStateValue(QString("currentPowerPhase%1").arg(QChar('A' + phase)),
+            power / EnergyEngine::phaseCount);
+    }
+    m_rootMeter->setStateValue("currentPower", power);
+}
+
+void Benchmark::waitForEvaluation(EnergyEngine* engine)
+{
+    QCoreApplication::processEvents();
+    while (engine->isEvaluationPending()) {
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+    }
+}
+
+QJsonObject Benchmark::run(int count)
+{
+    QTemporaryDir settingsDir;
+    prepareSettings(settingsDir.path());
+
+    m_thingManager = new MockThingManager();
+    m_energyManager = new MockEnergyManager(m_thingManager);
+    addThings(count);
+
+    QJsonObject result;
+    result.insert("count", count);
+    result.insert("things", m_thingManager->configuredThings().count());
+
+    QElapsedTimer timer;
+    timer.start();
+    EnergyEngine* engine = new EnergyEngine(m_thingManager, m_energyManager);
+    result.insert("constructionMs", timer.nsecsElapsed() / 1e6);
+
+    configure(engine);
+    waitForEvaluation(engine);
+
+    // A restart with all configurations in the settings
+    delete engine;
+    timer.start();
+    engine = new EnergyEngine(m_thingManager, m_energyManager);
+    result.insert("restartMs", timer.nsecsElapsed() / 1e6);
+    waitForEvaluation(engine);
+
+    result.insert("evaluateAvailableUseCases", measure([engine]() {
+        QMetaObject::invokeMethod(engine, "evaluateAvailableUseCases", Qt::DirectConnection);
+    }).toJson());
+
+    engine->onConsumptionLimitChanged(ControlLatencyTracker::SourceOpcUa,
+        static_cast<qlonglong>(powerPerUnit * count));
+    waitForEvaluation(engine);
+
+    // The grid power swings around the limit, the optimizer has to reallocate on every tick
+    quint64 tick = 0;
+    std::function<void()> nextSample = [this, &tick, count]() {
+        setGridPower(powerPerUnit * count * (tick++ % 2 ? 1.2 : 0.8));
+    };
+
+    // Only the part on the main thread: reading the states and publishing the snapshot
+    QJsonObject controlTicks;
+    controlTicks.insert("mainThread", measure([engine]() {
+        QMetaObject::invokeMethod(engine, "evaluateAndSetMaxChargingCurrent", Qt::DirectConnection);
+    }, nextSample).toJson());
+    waitForEvaluation(engine);
+
+    // Until the actions of the optimizer have been executed
+    quint64 actionsBefore = m_thingManager->executedActions();
+    Measurement roundTrip = measure([engine]() {
+        QMetaObject::invokeMethod(engine, "evaluateAndSetMaxChargingCurrent", Qt::DirectConnection);
+        waitForEvaluation(engine);
+    }, nextSample);
+    QJsonObject roundTripJson = roundTrip.toJson();
+    roundTripJson.insert("actionsPerTick",
+        (m_thingManager->executedActions() - actionsBefore) * 1.0 / roundTrip.calls);
+    controlTicks.insert("roundTrip", roundTripJson);
+    result.insert("controlTicks", controlTicks);
+
+    // Cold replies have to be packed again after a configuration changed, warm ones come from the
+    // cache of the handler
+    ConsolinnoJsonHandler* handler = new ConsolinnoJsonHandler(engine, HEMSVersionInfo());
+    typedef JsonReply* (ConsolinnoJsonHandler::*GetMethod)(const QVariantMap&);
+    QList<QPair<QString, GetMethod>> methods;
+    methods << qMakePair(QString("GetChargingConfigurations"),
+                   &ConsolinnoJsonHandler::GetChargingConfigurations)
+            << qMakePair(QString("GetChargingOptimizationConfigurations"),
+                   &ConsolinnoJsonHandler::GetChargingOptimizationConfigurations)
+            << qMakePair(QString("GetHeatingConfigurations"),
+                   &ConsolinnoJsonHandler::GetHeatingConfigurations)
+            << qMakePair(QString("GetBatteryConfigurations"),
+                   &ConsolinnoJsonHandler::GetBatteryConfigurations);
+
+    int priority = 0;
+    std::function<void()> changeConfiguration = [engine, &priority]() {
+        foreach (ChargingOptimizationConfiguration configuration,
+            engine->chargingOptimizationConfigurations()) {
+            configuration.setClsPriority(++priority % 10);
+            engine->setChargingOptimizationConfiguration(configuration);
+            break;
+        }
+        foreach (HeatingConfiguration configuration, engine->heatingConfigurations()) {
+            configuration.setClsPriority(priority % 10);
+            engine->setHeatingConfiguration(configuration);
+            break;
+        }
+        foreach (BatteryConfiguration configuration, engine->batteryConfigurations()) {
+            configuration.setClsPriority(priority % 10);
+            engine->setBatteryConfiguration(configuration);
+            break;
+        }
+    };
+
+    QJsonObject configurations;
+    for (int i = 0; i < methods.count(); i++) {
+        GetMethod method = methods.at(i).second;
+        std::function<void()> get = [handler, method]() {
+            delete (handler->*method)(QVariantMap());
+        };
+
+        // Replies per second a client can poll, with the JSON encoding the server adds to each
+        std::function<void()> getEncoded = [handler, method]() {
+            JsonReply* reply = (handler->*method)(QVariantMap());
+            QJsonDocument::fromVariant(reply->data()).toJson(QJsonDocument::Compact);
+            delete reply;
+        };
+
+        QJsonObject methodJson;
+        methodJson.insert("cold", measure(get, changeConfiguration).toJson());
+        methodJson.insert("warm", measure(get).toJson());
+        Measurement encoded = measure(getEncoded);
+        methodJson.insert("encoded", encoded.toJson());
+        methodJson.insert("repliesPerSecond", encoded.toJson().value("perSecond"));
+        configurations.insert(methods.at(i).first, methodJson);
+    }
+    result.insert("configurations", configurations);
+
+    delete handler;
+    delete engine;
+    delete m_energyManager;
+    delete m_thingManager;
+    return result;
+}
+
+QJsonObject Benchmark::runEvChargers(int count)
+{
+    QTemporaryDir settingsDir;
+    prepareSettings(settingsDir.path());
+
+    m_thingManager = new MockThingManager();
+    m_energyManager = new MockEnergyManager(m_thingManager);
+    addRootMeter();
+    QList<Thing*> evChargers;
+    for (int i = 0; i < count; i++) {
+        evChargers.append(
+            MockThings::create(MockThings::evChargerClass(), QString("Ev charger %1").arg(i)));
+        m_thingManager->addThing(evChargers.last());
+    }
+
+    EnergyEngine* engine = new EnergyEngine(m_thingManager, m_energyManager);
+    configure(engine);
+    engine->onConsumptionLimitChanged(ControlLatencyTracker::SourceOpcUa,
+        static_cast<qlonglong>(powerPerUnit * count));
+    waitForEvaluation(engine);
+
+    QJsonObject result;
+    result.insert("count", count);
+
+    quint64 tick = 0;
+    std::function<void()> nextSample = [this, &tick, count]() {
+        setGridPower(powerPerUnit * count * (tick++ % 2 ? 1.2 : 0.8));
+    };
+    result.insert("mainThread", measure([engine]() {
+        QMetaObject::invokeMethod(engine, "evaluateAndSetMaxChargingCurrent", Qt::DirectConnection);
+    }, nextSample).toJson());
+    waitForEvaluation(engine);
+
+    // The states a tick reads of every charger, through the cached accessors and by name
+    StateAccessorCache cache;
+    double sum = 0;
+    result.insert("cachedStateReads", measure([&cache, &evChargers, &sum]() {
+        foreach (Thing* thing, evChargers) {
+            ThingClassAccessorsPointer accessors = cache.accessors(thing);
+            sum += thing->stateValue(accessors->maxChargingCurrent).toFloat()
+                + accessors->maxChargingCurrentMinValue + accessors->maxChargingCurrentMaxValue
+                + thing->stateValue(accessors->phaseCount).toInt()
+                + thing->stateValue(accessors->pluggedIn).toBool();
+        }
+    }).toJson());
+    result.insert("stateReadsByName", measure([&evChargers, &sum]() {
+        foreach (Thing* thing, evChargers) {
+            StateType maxChargingCurrent
+                = thing->thingClass().stateTypes().findByName("maxChargingCurrent");
+            sum += thing->stateValue("maxChargingCurrent").toFloat()
+                + maxChargingCurrent.minValue().toFloat() + maxChargingCurrent.maxValue().toFloat()
+                + thing->stateValue("phaseCount").toInt() + thing->stateValue("pluggedIn").toBool();
+        }
+    }).toJson());
+    // Keeps the reads from being optimized away
+    result.insert("stateSum", sum);
+
+    delete engine;
+    delete m_energyManager;
+    delete m_thingManager;
+    return result;
+}
+
+QJsonObject Benchmark::runStartup(int count)
+{
+    QTemporaryDir settingsDir;
+    prepareSettings(settingsDir.path());
+
+    // The root meter, the grid support thing and an inverter, the others take turns
+    m_thingManager = new MockThingManager();
+    m_energyManager = new MockEnergyManager(m_thingManager);
+    addRootMeter();
+    m_thingManager->addThing(MockThings::create(MockThings::inverterClass(), "Inverter"));
+    QList<ThingClass> thingClasses;
+    thingClasses << MockThings::evChargerClass() << MockThings::heatPumpClass()
+                 << MockThings::batteryClass() << MockThings::heatingRodClass();
+    for (int i = m_thingManager->configuredThings().count(); i < count; i++) {
+        const ThingClass& thingClass = thingClasses.at(i % thingClasses.count());
+        m_thingManager->addThing(
+            MockThings::create(thingClass, QString("%1 %2").arg(thingClass.name()).arg(i)));
+    }
+
+    QJsonObject result;
+    result.insert("count", count);
+    result.insert("things", m_thingManager->configuredThings().count());
+
+    // Every thing gets its default configurations
+    QElapsedTimer timer;
+    timer.start();
+    EnergyEngine* engine = new EnergyEngine(m_thingManager, m_energyManager);
+    result.insert("firstStartMs", timer.nsecsElapsed() / 1e6);
+    configure(engine);
+    delete engine;
+
+    // A reboot: all configurations come from the settings
+    result.insert("restart", measure([this]() {
+        delete new EnergyEngine(m_thingManager, m_energyManager);
+    }).toJson());
+
+    // Until the first evaluation has been applied, what delays the control loop after a reboot
+    timer.start();
+    engine = new EnergyEngine(m_thingManager, m_energyManager);
+    QMetaObject::invokeMethod(engine, "evaluateAndSetMaxChargingCurrent", Qt::DirectConnection);
+    waitForEvaluation(engine);
+    result.insert("firstEvaluationMs", timer.nsecsElapsed() / 1e6);
+
+    delete engine;
+    delete m_energyManager;
+    delete m_thingManager;
+    return result;
+}
+
+bool parseCounts(const QString& value, QList<int>* counts)
+{
+    QStringList countList = value.split(',', QString::SkipEmptyParts);
+    foreach (const QString& count, countList) {
+        bool ok = false;
+        counts->append(count.toInt(&ok));
+        if (!ok || counts->last() < 1) {
+            qCritical() << "Invalid unit count" << count;
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication application(argc, argv);
+    application.setApplicationName("enginebenchmark");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Measures the energy engine with N synthetic ev chargers, "
+                                     "heat pumps and batteries each, and writes the results as "
+                                     "JSON.");
+    parser.addHelpOption();
+    QCommandLineOption countsOption("counts", "Comma separated unit counts.", "counts",
+        "1,10,100,1000");
+    QCommandLineOption evChargersOption("ev-chargers",
+        "Comma separated ev charger counts of the runs with ev chargers only.", "counts",
+        "1,10,50");
+    QCommandLineOption startupOption("startup-things",
+        "Comma separated thing counts of the startup runs.", "counts", "5,50,200");
+    QCommandLineOption durationOption(
+        "duration", "Duration of each measurement in milliseconds.", "ms", "500");
+    QCommandLineOption outputOption("output", "Write the results to this file instead of stdout.",
+        "file");
+    QCommandLineOption verboseOption("verbose", "Keep the debug output of the engine.");
+    parser.addOption(countsOption);
+    parser.addOption(evChargersOption);
+    parser.addOption(startupOption);
+    parser.addOption(durationOption);
+    parser.addOption(outputOption);
+    parser.addOption(verboseOption);
+    parser.process(application);
+
+    // The engine logs every evaluation, that would be measured as well
+    if (!parser.isSet(verboseOption)) {
+        QLoggingCategory::setFilterRules("*.debug=false\n*.info=false");
+    }
+
+    QList<int> counts;
+    QList<int> evChargerCounts;
+    QList<int> startupCounts;
+    if (!parseCounts(parser.value(countsOption), &counts)
+        || !parseCounts(parser.value(evChargersOption), &evChargerCounts)
+        || !parseCounts(parser.value(startupOption), &startupCounts)) {
+        return 1;
+    }
+
+    Benchmark benchmark(qMax(1, parser.value(durationOption).toInt()));
+    QJsonArray runs;
+    foreach (int count, counts) {
+        qWarning() << "Running the benchmark with" << count << "units of each kind";
+        runs.append(benchmark.run(count));
+    }
+    QJsonArray evChargerRuns;
+    foreach (int count, evChargerCounts) {
+        qWarning() << "Running the benchmark with" << count << "ev chargers only";
+        evChargerRuns.append(benchmark.runEvChargers(count));
+    }
+    QJsonArray startupRuns;
+    foreach (int count, startupCounts) {
+        qWarning() << "Running the startup benchmark with" << count << "configured things";
+        startupRuns.append(benchmark.runStartup(count));
+    }
+
+    QJsonObject results;
+    results.insert("timestamp", QDateTime::currentDateTimeUtc().toString(Qt::ISODate));
+    results.insert("qtVersion", QString(qVersion()));
+    results.insert("idealThreadCount", QThread::idealThreadCount());
+    results.insert("durationMs", parser.value(durationOption).toInt());
+    results.insert("runs", runs);
+    results.insert("evChargerRuns", evChargerRuns);
+    results.insert("startupRuns", startupRuns);
+    QByteArray json = QJsonDocument(results).toJson();
+
+    QFile output;
+    if (parser.isSet(outputOption)) {
+        output.setFileName(parser.value(outputOption));
+        if (!output.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            qCritical() << "Could not open" << output.fileName() << output.errorString();
+            return 1;
+        }
+    } else {
+        output.open(stdout, QIODevice::WriteOnly);
+    }
+    output.write(json);
+    return 0;
+}
@@ -0,0 +1,361 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLoggingCategory>
+#include <QMetaProperty>
+#include <QSet>
+#include <QTemporaryDir>
+
+#include "energyengine.h"
+#include "enginecapture.h"
+#include "engineclock.h"
+#include "settingsstore.h"
+
+#include "mockenergymanager.h"
+#include "mockthingmanager.h"
+#include "mockthings.h"
+
+Q_LOGGING_CATEGORY(dcConsolinnoEnergy, "ConsolinnoEnergy")
+
+namespace {
+
+// Properties of a configuration gadget as written by EngineCaptureWriter::recordConfiguration()
+template <typename T> T readConfiguration(const QVariantMap& properties)
+{
+    T configuration;
+    const QMetaObject& metaObject = T::staticMetaObject;
+    for (int i = metaObject.propertyOffset(); i < metaObject.propertyCount(); i++) {
+        QMetaProperty property = metaObject.property(i);
+        if (properties.contains(property.name())) {
+            property.writeOnGadget(&configuration, properties.value(property.name()));
+        }
+    }
+    return configuration;
+}
+
+template <typename T> QJsonObject toJson(const T& gadget)
+{
+    QJsonObject object;
+    const QMetaObject& metaObject = T::staticMetaObject;
+    for (int i = metaObject.propertyOffset(); i < metaObject.propertyCount(); i++) {
+        QMetaProperty property = metaObject.property(i);
+        object.insert(property.name(), QJsonValue::fromVariant(property.readOnGadget(&gadget)));
+    }
+    return object;
+}
+
+/*!
+ * \brief The Replay class feeds the events of a capture into an energy engine.
+ * \details The engine runs against mock things under a virtual EngineClock: before an event gets
+ * applied the clock is advanced to the time it has been recorded at, so due control loop ticks
+ * run first. After every event the replay waits until the optimizer actions have been executed.
+ * The output is one JSON object per line: every executed action, every control loop tick with
+ * the wall time the event that caused it took to process, and a summary at the end.
+ */
+class Replay {
+public:
+    Replay(const QString& captureFile, QFile* output);
+
+    bool run(const QString& settingsFile, int interval);
+
+private:
+    QString m_captureFile;
+    QFile* m_output = nullptr;
+    qint64 m_startTime = 0;
+
+    MockThingManager m_thingManager;
+    MockEnergyManager m_energyManager;
+    Thing* m_rootMeter = nullptr;
+    EnergyEngine* m_engine = nullptr;
+
+    uint m_lastTick = 0;
+    quint64 m_ticks = 0;
+    quint64 m_actions = 0;
+    qint64 m_maxStepNsecs = 0;
+
+    bool addThings();
+    void apply(const EngineCaptureEvent& event);
+    void waitForEvaluation();
+    void writeTicks(qint64 stepNsecs);
+    void write(const QJsonObject& object);
+};
+
+Replay::Replay(const QString& captureFile, QFile* output)
+    : m_captureFile(captureFile)
+    , m_output(output)
+    , m_energyManager(&m_thingManager)
+{
+    QObject::connect(&m_thingManager, &MockThingManager::actionRequested, &m_thingManager,
+        [this](Thing* thing, const Action& action) {
+            QJsonObject object;
+            object.insert("type", "action");
+            object.insert("time", EngineClock::currentMSecsSinceEpoch() - m_startTime);
+            object.insert("thingId", thing->id().toString());
+            object.insert("thing", thing->name());
+            object.insert(
+                "action", thing->thingClass().actionTypes().findById(action.actionTypeId()).name());
+            if (!action.params().isEmpty()) {
+                object.insert("value", QJsonValue::fromVariant(action.params().first().value()));
+            }
+            write(object);
+            m_actions++;
+        });
+}
+
+// The capture only knows the things by the ids in its events, so the things get created from them
+bool Replay::addThings()
+{
+    EngineCaptureReader reader;
+    if (!reader.open(m_captureFile))
+        return false;
+
+    QSet<ThingId> evChargers;
+    QSet<ThingId> cars;
+    QSet<ThingId> heatPumps;
+    EngineCaptureEvent event;
+    while (reader.next(event)) {
+        if (event.type == EngineCaptureEvent::TypePluggedIn) {
+            evChargers.insert(event.thingId);
+        } else if (event.type == EngineCaptureEvent::TypeConfiguration) {
+            const QVariantMap& configuration = event.configuration;
+            if (configuration.contains("evChargerThingId")) {
+                evChargers.insert(configuration.value("evChargerThingId").toUuid());
+            }
+            if (!configuration.value("carThingId").toUuid().isNull()) {
+                cars.insert(configuration.value("carThingId").toUuid());
+            }
+            if (configuration.contains("heatPumpThingId")) {
+                heatPumps.insert(configuration.value("heatPumpThingId").toUuid());
+            }
+        }
+    }
+    m_startTime = reader.startTime();
+
+    m_rootMeter = MockThings::create(MockThings::rootMeterClass(), "Root meter");
+    m_thingManager.addThing(m_rootMeter);
+    m_energyManager.setRootMeter(m_rootMeter);
+    m_thingManager.addThing(MockThings::create(MockThings::gridSupportClass(), "Grid support"));
+    m_thingManager.addThing(MockThings::create(MockThings::inverterClass(), "Inverter"));
+    foreach (const ThingId& thingId, evChargers) {
+        m_thingManager.addThing(MockThings::create(MockThings::evChargerClass(),
+            "Ev charger " + thingId.toString().mid(1, 8), thingId));
+    }
+    foreach (const ThingId& thingId, cars) {
+        m_thingManager.addThing(MockThings::create(
+            MockThings::carClass(), "Car " + thingId.toString().mid(1, 8), thingId));
+    }
+    foreach (const ThingId& thingId, heatPumps) {
+        m_thingManager.addThing(MockThings::create(
+            MockThings::heatPumpClass(), "Heat pump " + thingId.toString().mid(1, 8), thingId));
+    }
+    return true;
+}
+
+void Replay::apply(const EngineCaptureEvent& event)
+{
+    switch (event.type) {
+    case EngineCaptureEvent::TypeRootMeterSample:
+        // The engine evaluates on the total power, the phases have to be there before
+        for (int phase = 0; phase < EnergyEngine::phaseCount; phase++) {
+            m_rootMeter->setStateValue(QString("currentPowerPhase%1").arg(QChar('A' + phase)),
+                event.phasePower[phase]);
+        }
+        m_rootMeter->setStateValue("currentPower", event.currentPower);
+        break;
+    case EngineCaptureEvent::TypeLimitSignal:
+        if (event.source < ControlLatencyTracker::SourceCount) {
+            m_engine->onConsumptionLimitChanged(
+                static_cast<ControlLatencyTracker::Source>(event.source), event.consumptionLimit);
+        }
+        break;
+    case EngineCaptureEvent::TypePluggedIn:
+        if (Thing* thing = m_thingManager.findConfiguredThing(event.thingId)) {
+            thing->setStateValue("pluggedIn", event.pluggedIn);
+        }
+        break;
+    case EngineCaptureEvent::TypeConfiguration:
+        if (event.configurationType == "HousholdPhaseLimit") {
+            m_engine->setHousholdPhaseLimit(
+                event.configuration.value("housholdPhaseLimit").toUInt());
+        } else if (event.configurationType == "ChargingConfiguration") {
+            m_engine->setChargingConfiguration(
+                readConfiguration<ChargingConfiguration>(event.configuration));
+        } else if (event.configurationType == "ChargingOptimizationConfiguration") {
+            m_engine->setChargingOptimizationConfiguration(
+                readConfiguration<ChargingOptimizationConfiguration>(event.configuration));
+        } else if (event.configurationType == "HeatingConfiguration") {
+            // Heat meters are not part of the capture, the control loop does not use them
+            HeatingConfiguration configuration
+                = readConfiguration<HeatingConfiguration>(event.configuration);
+            configuration.setHeatMeterThingId(ThingId());
+            m_engine->setHeatingConfiguration(configuration);
+        } else {
+            qCWarning(dcConsolinnoEnergy())
+                << "Skipping unknown configuration" << event.configurationType;
+        }
+        break;
+    }
+}
+
+void Replay::waitForEvaluation()
+{
+    // Zero timers of the control loop run with this pass
+    QCoreApplication::processEvents();
+    while (m_engine->isEvaluationPending()) {
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+    }
+}
+
+void Replay::writeTicks(qint64 stepNsecs)
+{
+    foreach (const ControlDecision& decision, m_engine->decisionTrace(16)) {
+        if (decision.tick() <= m_lastTick)
+            continue;
+
+        QJsonObject object = toJson(decision);
+        object.insert("type", "tick");
+        object.insert("time", decision.timestamp() - m_startTime);
+        object.insert("stepUs", stepNsecs / 1000.0);
+        write(object);
+        m_lastTick = decision.tick();
+        m_ticks++;
+    }
+}
+
+void Replay::write(const QJsonObject& object)
+{
+    m_output->write(QJsonDocument(object).toJson(QJsonDocument::Compact));
+    m_output->write("\n");
+}
+
+bool Replay::run(const QString& settingsFile, int interval)
+{
+    if (!addThings()) {
+        qCritical() << "Could not read the capture" << m_captureFile;
+        return false;
+    }
+
+    QTemporaryDir settingsDir;
+    qputenv("SNAP", "1");
+    qputenv("SNAP_DATA", settingsDir.path().toUtf8());
+    if (!settingsFile.isEmpty()
+        && !QFile::copy(settingsFile, settingsDir.path() + "/consolinno.conf")) {
+        qCritical() << "Could not copy the settings" << settingsFile;
+        return false;
+    }
+    {
+        SettingsStore settings(settingsDir.path() + "/consolinno.conf");
+        if (interval > 0) {
+            settings.setValue("Settings/controlLoopInterval", interval);
+        }
+        interval = settings.value("Settings/controlLoopInterval", 1000).toInt();
+        // The limit signals come from the capture only, and the replay must not record itself
+        settings.setValue("Settings/limitSourceBusAddress", "unix:path=" + settingsDir.path()
+            + "/no-bus");
+        settings.setValue("Settings/captureFile", QString());
+        settings.flush();
+    }
+
+    EngineClock::setVirtualTime(m_startTime);
+    m_engine = new EnergyEngine(&m_thingManager, &m_energyManager);
+    waitForEvaluation();
+    writeTicks(0);
+
+    EngineCaptureReader reader;
+    reader.open(m_captureFile);
+    quint64 events = 0;
+    qint64 lastTime = 0;
+    QElapsedTimer wallClock;
+    wallClock.start();
+    QElapsedTimer step;
+    EngineCaptureEvent event;
+    while (reader.next(event)) {
+        step.start();
+        EngineClock::setVirtualTime(m_startTime + event.time);
+        apply(event);
+        waitForEvaluation();
+        qint64 stepNsecs = step.nsecsElapsed();
+        m_maxStepNsecs = qMax(m_maxStepNsecs, stepNsecs);
+        writeTicks(stepNsecs);
+        lastTime = event.time;
+        events++;
+    }
+
+    // A tick requested by the last events is still waiting for its interval
+    step.start();
+    EngineClock::setVirtualTime(m_startTime + lastTime + interval);
+    waitForEvaluation();
+    writeTicks(step.nsecsElapsed());
+    qint64 wallNsecs = wallClock.nsecsElapsed();
+
+    delete m_engine;
+    m_engine = nullptr;
+
+    QJsonObject summary;
+    summary.insert("type", "summary");
+    summary.insert("events", static_cast<qint64>(events));
+    summary.insert("ticks", static_cast<qint64>(m_ticks));
+    summary.insert("actions", static_cast<qint64>(m_actions));
+    summary.insert("captureMs", lastTime);
+    summary.insert("wallMs", wallNsecs / 1e6);
+    summary.insert("speedup", wallNsecs > 0 ? lastTime * 1e6 / wallNsecs : 0);
+    summary.insert("maxStepUs", m_maxStepNsecs / 1000.0);
+    write(summary);
+    return true;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication application(argc, argv);
+    application.setApplicationName("enginereplay");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Replays a capture of Settings/captureFile through the "
+                                     "energy engine as fast as possible, and writes the executed "
+                                     "actions and the control loop ticks as JSON lines.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("capture", "The capture file.");
+    QCommandLineOption settingsOption("settings",
+        "consolinno.conf of the captured system, for its Settings/* values.", "file");
+    QCommandLineOption intervalOption("interval",
+        "Control loop interval in milliseconds, instead of the one in the settings.", "ms");
+    QCommandLineOption outputOption("output", "Write to this file instead of stdout.", "file");
+    QCommandLineOption verboseOption("verbose", "Keep the debug output of the engine.");
+    parser.addOption(settingsOption);
+    parser.addOption(intervalOption);
+    parser.addOption(outputOption);
+    parser.addOption(verboseOption);
+    parser.process(application);
+
+    if (parser.positionalArguments().count() != 1) {
+        parser.showHelp(1);
+    }
+
+    if (!parser.isSet(verboseOption)) {
+        QLoggingCategory::setFilterRules("*.debug=false\n*.info=false");
+    }
+
+    QFile output;
+    if (parser.isSet(outputOption)) {
+        output.setFileName(parser.value(outputOption));
+        if (!output.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            qCritical() << "Could not open" << output.fileName() << output.errorString();
+            return 1;
+        }
+    } else {
+        output.open(stdout, QIODevice::WriteOnly);
+    }
+
+    Replay replay(parser.positionalArguments().first(), &output);
+    return replay.run(parser.value(settingsOption), parser.value(intervalOption).toInt()) ? 0 : 1;
+}
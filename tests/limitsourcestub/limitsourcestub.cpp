@@ -0,0 +1,197 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include "limitsourcestub.h"
+
+#include <QDBusMessage>
+#include <QDBusVariant>
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <QThread>
+
+namespace {
+
+struct StubSource {
+    const char* service;
+    const char* path;
+    const char* interface;
+};
+
+const char* const iecService = "de.consolinno.fnnstb.iec61850";
+const char* const iecInterface = "de.consolinno.fnnstb.iec61850.cls.actpow_ggio001";
+const char* const opcService = "de.consolinno.fnnstb.opcua";
+const char* const opcInterface = "de.consolinno.fnnstb.opcua.cls.actpow_ggio001";
+
+// Indexed by the source, like the table of the LimitSourceManager
+const StubSource stubSources[ControlLatencyTracker::SourceCount] = {
+    { iecService, "/de/consolinno/fnnstb/iec61850/cls/actpow_ggio001/1", iecInterface },
+    { iecService, "/de/consolinno/fnnstb/iec61850/cls/actpow_ggio001/2", iecInterface },
+    { iecService, "/de/consolinno/fnnstb/iec61850/cls/actpow_ggio001/3", iecInterface },
+    { iecService, "/de/consolinno/fnnstb/iec61850/cls/actpow_ggio001/4", iecInterface },
+    { opcService, "/de/consolinno/fnnstb/opcua/cls/actpow_ggio001/1", opcInterface },
+};
+
+const char* const limitMember = "AnOut_mxVal_f";
+const char* const propertiesInterface = "org.freedesktop.DBus.Properties";
+
+}
+
+LimitSourceStub::LimitSourceStub(const QDBusConnection& connection, QObject* parent)
+    : QDBusVirtualObject(parent)
+    , m_connection(connection)
+{
+    m_limits.fill(-1);
+}
+
+LimitSourceStub::~LimitSourceStub() { unregisterSources(); }
+
+bool LimitSourceStub::sourceFromName(const QString& name, Source* source)
+{
+    for (int i = 0; i < ControlLatencyTracker::SourceCount; i++) {
+        if (name == ControlLatencyTracker::sourceName(static_cast<Source>(i))) {
+            *source = static_cast<Source>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool LimitSourceStub::registerSources()
+{
+    bool success = true;
+    for (int source = 0; source < ControlLatencyTracker::SourceCount; source++) {
+        success &= m_connection.registerVirtualObject(stubSources[source].path, this);
+    }
+
+    // The objects have to be there when the LimitSourceManager sees the service and fetches
+    success &= m_connection.registerService(iecService);
+    success &= m_connection.registerService(opcService);
+    m_registered = true;
+    return success;
+}
+
+void LimitSourceStub::unregisterSources()
+{
+    if (!m_registered)
+        return;
+
+    m_connection.unregisterService(iecService);
+    m_connection.unregisterService(opcService);
+    for (int source = 0; source < ControlLatencyTracker::SourceCount; source++) {
+        m_connection.unregisterObject(stubSources[source].path);
+    }
+    m_registered = false;
+}
+
+qlonglong LimitSourceStub::limit(Source source) const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_limits.at(source);
+}
+
+bool LimitSourceStub::setLimit(Source source, qlonglong consumptionLimit)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_limits[source] = consumptionLimit;
+    }
+
+    // The property is a float, the signal carries the limit as integer like the gateways do
+    QDBusMessage signal = QDBusMessage::createSignal(
+        stubSources[source].path, stubSources[source].interface, limitMember);
+    signal << consumptionLimit;
+    return m_connection.send(signal);
+}
+
+void LimitSourceStub::setInitialLimit(Source source, qlonglong consumptionLimit)
+{
+    QMutexLocker locker(&m_mutex);
+    m_limits[source] = consumptionLimit;
+}
+
+quint64 LimitSourceStub::sendLimits(
+    Source source, const QList<qlonglong>& consumptionLimits, quint64 count, double rate)
+{
+    if (consumptionLimits.isEmpty())
+        return 0;
+
+    QElapsedTimer timer;
+    timer.start();
+    quint64 sent = 0;
+    for (quint64 i = 0; i < count; i++) {
+        if (rate > 0) {
+            qint64 due = static_cast<qint64>(i * 1e9 / rate);
+            qint64 remaining = due - timer.nsecsElapsed();
+            if (remaining > 0) {
+                QThread::usleep(static_cast<unsigned long>(remaining / 1000));
+            }
+        }
+
+        if (setLimit(source, consumptionLimits.at(i % consumptionLimits.count()))) {
+            sent++;
+        }
+    }
+    return sent;
+}
+
+QString LimitSourceStub::introspect(const QString& path) const
+{
+    int source = sourceAt(path);
+    if (source < 0)
+        return QString();
+
+    return QString("<interface name=\"%1\">"
+                   "<property name=\"%2\" type=\"d\" access=\"read\"/>"
+                   "<signal name=\"%2\"><arg name=\"value\" type=\"x\"/></signal>"
+                   "</interface>")
+        .arg(stubSources[source].interface, limitMember);
+}
+
+bool LimitSourceStub::handleMessage(const QDBusMessage& message, const QDBusConnection& connection)
+{
+    int source = sourceAt(message.path());
+    if (source < 0 || message.interface() != QLatin1String(propertiesInterface))
+        return false;
+
+    const QVariantList arguments = message.arguments();
+    QString interface = arguments.value(0).toString();
+    if (interface != QLatin1String(stubSources[source].interface)) {
+        connection.send(message.createErrorReply(
+            QDBusError::UnknownInterface, "Unknown interface " + interface));
+        return true;
+    }
+
+    double value = limit(static_cast<Source>(source));
+    if (message.member() == QLatin1String("Get")) {
+        QString name = arguments.value(1).toString();
+        if (name != QLatin1String(limitMember)) {
+            connection.send(
+                message.createErrorReply(QDBusError::UnknownProperty, "Unknown property " + name));
+            return true;
+        }
+        connection.send(message.createReply(QVariant::fromValue(QDBusVariant(value))));
+        return true;
+    }
+
+    if (message.member() == QLatin1String("GetAll")) {
+        QVariantMap properties;
+        properties.insert(limitMember, value);
+        connection.send(message.createReply(properties));
+        return true;
+    }
+
+    connection.send(message.createErrorReply(QDBusError::NotSupported,
+        "The consumption limit is read only"));
+    return true;
+}
+
+int LimitSourceStub::sourceAt(const QString& path)
+{
+    for (int source = 0; source < ControlLatencyTracker::SourceCount; source++) {
+        if (path == QLatin1String(stubSources[source].path))
+            return source;
+    }
+    return -1;
+}
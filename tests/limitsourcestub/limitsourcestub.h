@@ -0,0 +1,67 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#ifndef LIMITSOURCESTUB_H
+#define LIMITSOURCESTUB_H
+
+#include <QDBusConnection>
+#include <QDBusVirtualObject>
+#include <QMutex>
+
+#include <array>
+
+#include "controllatency.h"
+
+/*!
+ * \brief The LimitSourceStub class stands in for the IEC 61850 server and the OPC UA client.
+ * \details It owns de.consolinno.fnnstb.iec61850 and de.consolinno.fnnstb.opcua on the given
+ * connection, usually one to a private dbus-daemon, and serves the four actpow_ggio001 paths of
+ * the IEC 61850 server and the one of the OPC UA client. Every path answers Properties.Get for
+ * AnOut_mxVal_f with its current value and emits the AnOut_mxVal_f signal when a limit gets set,
+ * with the signatures the LimitSourceManager subscribes to.
+ *
+ * Setting limits is thread safe, a signal storm can be sent from another thread while the
+ * properties are served on the thread of the stub.
+ */
+class LimitSourceStub : public QDBusVirtualObject {
+    Q_OBJECT
+public:
+    typedef ControlLatencyTracker::Source Source;
+
+    explicit LimitSourceStub(const QDBusConnection& connection, QObject* parent = nullptr);
+    ~LimitSourceStub() override;
+
+    // Accepts the names of ControlLatencyTracker::sourceName(), returns false for an unknown one
+    static bool sourceFromName(const QString& name, Source* source);
+
+    // Registers the objects and owns the service names, returns false if the bus refused any
+    bool registerSources();
+    void unregisterSources();
+
+    // -1 while the source does not restrict the consumption
+    qlonglong limit(Source source) const;
+    // Sets the property and emits the signal
+    bool setLimit(Source source, qlonglong consumptionLimit);
+    // Sets the property only, like a limit that was in effect before the engine started
+    void setInitialLimit(Source source, qlonglong consumptionLimit);
+    // Sets count limits, cycling through the given ones, at rate signals per second or as fast as
+    // possible for a rate of 0. Blocks the calling thread, returns the number of signals sent.
+    quint64 sendLimits(
+        Source source, const QList<qlonglong>& consumptionLimits, quint64 count, double rate);
+
+    QString introspect(const QString& path) const override;
+    bool handleMessage(const QDBusMessage& message, const QDBusConnection& connection) override;
+
+private:
+    QDBusConnection m_connection;
+    bool m_registered = false;
+
+    mutable QMutex m_mutex;
+    std::array<qlonglong, ControlLatencyTracker::SourceCount> m_limits;
+
+    static int sourceAt(const QString& path);
+};
+
+#endif // LIMITSOURCESTUB_H
@@ -0,0 +1,10 @@
+# Stand-in for the IEC 61850 server and the OPC UA client, the including target has to compile
+# controllatency.cpp of the engine as well
+INCLUDEPATH += $$PWD
+QT += dbus
+
+HEADERS += \
+    $$PWD/limitsourcestub.h
+
+SOURCES += \
+    $$PWD/limitsourcestub.cpp
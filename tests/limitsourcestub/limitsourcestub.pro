@@ -0,0 +1,13 @@
+include(../tests.pri)
+include(limitsourcestub.pri)
+
+TARGET = limitsourcestub
+CONFIG += console
+CONFIG -= app_bundle
+
+HEADERS += \
+    $$ENGINE_DIR/controllatency.h
+
+SOURCES += \
+    $$ENGINE_DIR/controllatency.cpp \
+    main.cpp
@@ -0,0 +1,138 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDBusMessage>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QThread>
+
+#include "limitsourcestub.h"
+
+namespace {
+
+/*!
+ * \brief The Sender class sends the limits off the main thread, the stub keeps answering
+ * Properties.Get while a storm is running.
+ */
+class Sender : public QThread {
+public:
+    Sender(LimitSourceStub* stub, LimitSourceStub::Source source,
+        const QList<qlonglong>& consumptionLimits, quint64 count, double rate)
+        : m_stub(stub)
+        , m_source(source)
+        , m_consumptionLimits(consumptionLimits)
+        , m_count(count)
+        , m_rate(rate)
+    {
+    }
+
+protected:
+    void run() override
+    {
+        QElapsedTimer timer;
+        timer.start();
+        quint64 sent = m_stub->sendLimits(m_source, m_consumptionLimits, m_count, m_rate);
+        qint64 elapsed = timer.nsecsElapsed();
+        qInfo().noquote() << QString("Sent %1 of %2 limits to %3 in %4 ms, %5 per second")
+                                 .arg(sent)
+                                 .arg(m_count)
+                                 .arg(ControlLatencyTracker::sourceName(m_source))
+                                 .arg(elapsed / 1e6, 0, 'f', 1)
+                                 .arg(elapsed > 0 ? sent * 1e9 / elapsed : 0, 0, 'f', 0);
+    }
+
+private:
+    LimitSourceStub* m_stub;
+    LimitSourceStub::Source m_source;
+    QList<qlonglong> m_consumptionLimits;
+    quint64 m_count;
+    double m_rate;
+};
+
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication application(argc, argv);
+    application.setApplicationName("limitsourcestub");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Stands in for the IEC 61850 server and the OPC UA client: "
+                                     "serves the AnOut_mxVal_f consumption limits of all sources "
+                                     "and sends limit signals at a given rate.");
+    parser.addHelpOption();
+    QCommandLineOption addressOption("address",
+        "D-Bus address to serve on, e.g. the one printed by a private dbus-daemon. Without it "
+        "the session bus is used.", "address");
+    QCommandLineOption sourceOption("source",
+        "Source the signals are sent for: iec61850/1 to iec61850/4 or opcua.", "source",
+        "iec61850/1");
+    QCommandLineOption limitsOption("limits",
+        "Comma separated consumption limits in watts, sent in turn. -1 lifts the limit.",
+        "limits", "4200");
+    QCommandLineOption countOption("count", "Number of signals to send, 0 to only serve.",
+        "count", "0");
+    QCommandLineOption rateOption("rate",
+        "Signals per second, 0 for as fast as possible.", "rate", "1");
+    QCommandLineOption quitOption("quit", "Quit once all signals have been sent.");
+    parser.addOption(addressOption);
+    parser.addOption(sourceOption);
+    parser.addOption(limitsOption);
+    parser.addOption(countOption);
+    parser.addOption(rateOption);
+    parser.addOption(quitOption);
+    parser.process(application);
+
+    LimitSourceStub::Source source;
+    if (!LimitSourceStub::sourceFromName(parser.value(sourceOption), &source)) {
+        qCritical() << "Unknown source" << parser.value(sourceOption);
+        return 1;
+    }
+
+    QList<qlonglong> consumptionLimits;
+    QStringList values = parser.value(limitsOption).split(',', QString::SkipEmptyParts);
+    foreach (const QString& value, values) {
+        bool ok = false;
+        consumptionLimits.append(value.trimmed().toLongLong(&ok));
+        if (!ok) {
+            qCritical() << "Invalid consumption limit" << value;
+            return 1;
+        }
+    }
+
+    QDBusConnection connection = QDBusConnection::sessionBus();
+    if (parser.isSet(addressOption)) {
+        connection = QDBusConnection::connectToBus(parser.value(addressOption), "LimitSourceStub");
+    }
+    if (!connection.isConnected()) {
+        qCritical() << "Could not connect to the bus" << connection.lastError().message();
+        return 1;
+    }
+
+    LimitSourceStub stub(connection);
+    if (!stub.registerSources()) {
+        qCritical() << "Could not register the limit sources" << connection.lastError().message();
+        return 1;
+    }
+
+    quint64 count = parser.value(countOption).toULongLong();
+    if (count == 0)
+        return application.exec();
+
+    Sender sender(&stub, source, consumptionLimits, count, parser.value(rateOption).toDouble());
+    if (parser.isSet(quitOption)) {
+        QObject::connect(&sender, &QThread::finished, &application, &QCoreApplication::quit);
+    }
+    sender.start();
+    int result = application.exec();
+    sender.wait();
+
+    // Messages leave in order, once the bus answered the ping all signals have been written
+    connection.call(QDBusMessage::createMethodCall("org.freedesktop.DBus", "/org/freedesktop/DBus",
+        "org.freedesktop.DBus.Peer", "Ping"));
+    return result;
+}
@@ -0,0 +1,51 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include "mockenergymanager.h"
+
+MockEnergyManager::MockEnergyManager(ThingManager* thingManager, QObject* parent)
+    : EnergyManager(parent)
+    , m_thingManager(thingManager)
+{
+}
+
+void MockEnergyManager::setRootMeter(Thing* rootMeter)
+{
+    if (m_rootMeter == rootMeter)
+        return;
+
+    m_rootMeter = rootMeter;
+    emit rootMeterChanged();
+}
+
+EnergyManager::EnergyError MockEnergyManager::setRootMeter(const ThingId& rootMeterId)
+{
+    Thing* rootMeter = m_thingManager->findConfiguredThing(rootMeterId);
+    if (!rootMeter)
+        return EnergyErrorInvalidParameter;
+
+    setRootMeter(rootMeter);
+    return EnergyErrorNoError;
+}
+
+Thing* MockEnergyManager::rootMeter() const { return m_rootMeter; }
+
+double MockEnergyManager::currentPowerConsumption() const { return 0; }
+
+double MockEnergyManager::currentPowerProduction() const { return 0; }
+
+double MockEnergyManager::currentPowerAcquisition() const { return 0; }
+
+double MockEnergyManager::currentPowerStorage() const { return 0; }
+
+double MockEnergyManager::totalConsumption() const { return 0; }
+
+double MockEnergyManager::totalProduction() const { return 0; }
+
+double MockEnergyManager::totalAcquisition() const { return 0; }
+
+double MockEnergyManager::totalReturn() const { return 0; }
+
+EnergyLogs* MockEnergyManager::logs() const { return nullptr; }
@@ -0,0 +1,45 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#ifndef MOCKENERGYMANAGER_H
+#define MOCKENERGYMANAGER_H
+
+#include <QPointer>
+
+#include <energymanager.h>
+#include <integrations/thingmanager.h>
+
+/*!
+ * \brief The MockEnergyManager class only provides the root meter.
+ * \details The power balance and the logs are not computed, the engine reads the grid power from
+ * the root meter directly.
+ */
+class MockEnergyManager : public EnergyManager {
+    Q_OBJECT
+public:
+    explicit MockEnergyManager(ThingManager* thingManager, QObject* parent = nullptr);
+
+    void setRootMeter(Thing* rootMeter);
+
+    EnergyError setRootMeter(const ThingId& rootMeterId) override;
+    Thing* rootMeter() const override;
+
+    double currentPowerConsumption() const override;
+    double currentPowerProduction() const override;
+    double currentPowerAcquisition() const override;
+    double currentPowerStorage() const override;
+    double totalConsumption() const override;
+    double totalProduction() const override;
+    double totalAcquisition() const override;
+    double totalReturn() const override;
+
+    EnergyLogs* logs() const override;
+
+private:
+    ThingManager* m_thingManager = nullptr;
+    QPointer<Thing> m_rootMeter;
+};
+
+#endif // MOCKENERGYMANAGER_H
@@ -0,0 +1,12 @@
+# Stand-ins for the nymea core, so the engine runs outside of nymead
+INCLUDEPATH += $$PWD
+
+HEADERS += \
+    $$PWD/mockenergymanager.h \
+    $$PWD/mockthingmanager.h \
+    $$PWD/mockthings.h
+
+SOURCES += \
+    $$PWD/mockenergymanager.cpp \
+    $$PWD/mockthingmanager.cpp \
+    $$PWD/mockthings.cpp
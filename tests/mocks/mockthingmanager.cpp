@@ -0,0 +1,367 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include "mockthingmanager.h"
+
+#include <QLoggingCategory>
+
+#include <integrations/thingactioninfo.h>
+
+Q_DECLARE_LOGGING_CATEGORY(dcConsolinnoEnergy)
+
+MockThingManager::MockThingManager(QObject* parent)
+    : ThingManager(parent)
+{
+}
+
+void MockThingManager::addThing(Thing* thing)
+{
+    thing->setParent(this);
+    m_things.append(thing);
+    m_thingsById.insert(thing->id(), thing);
+    emit thingAdded(thing);
+}
+
+void MockThingManager::removeThing(const ThingId& thingId)
+{
+    Thing* thing = m_thingsById.take(thingId);
+    if (!thing)
+        return;
+
+    m_things.removeAll(thing);
+    emit thingRemoved(thingId);
+    thing->deleteLater();
+}
+
+quint64 MockThingManager::executedActions() const { return m_executedActions; }
+
+IntegrationPlugins MockThingManager::plugins() const { return IntegrationPlugins(); }
+
+IntegrationPlugin* MockThingManager::plugin(const PluginId& pluginId) const
+{
+    Q_UNUSED(pluginId)
+    return nullptr;
+}
+
+Thing::ThingError MockThingManager::setPluginConfig(
+    const PluginId& pluginId, const ParamList& pluginConfig)
+{
+    Q_UNUSED(pluginId)
+    Q_UNUSED(pluginConfig)
+    return Thing::ThingErrorPluginNotFound;
+}
+
+Vendors MockThingManager::supportedVendors() const { return Vendors(); }
+
+Interfaces MockThingManager::supportedInterfaces() const { return Interfaces(); }
+
+ThingClasses MockThingManager::supportedThings(const VendorId& vendorId) const
+{
+    Q_UNUSED(vendorId)
+    return ThingClasses();
+}
+
+Things MockThingManager::configuredThings() const { return m_things; }
+
+Thing* MockThingManager::findConfiguredThing(const ThingId& id) const
+{
+    return m_thingsById.value(id);
+}
+
+Things MockThingManager::findConfiguredThings(const ThingClassId& thingClassId) const
+{
+    Things things;
+    foreach (Thing* thing, m_things) {
+        if (thing->thingClassId() == thingClassId) {
+            things.append(thing);
+        }
+    }
+    return things;
+}
+
+Things MockThingManager::findConfiguredThings(const QString& interface) const
+{
+    Things things;
+    foreach (Thing* thing, m_things) {
+        if (thing->thingClass().interfaces().contains(interface)) {
+            things.append(thing);
+        }
+    }
+    return things;
+}
+
+Things MockThingManager::findChildThings(const ThingId& id) const
+{
+    Q_UNUSED(id)
+    return Things();
+}
+
+ThingClass MockThingManager::findThingClass(const ThingClassId& thingClassId) const
+{
+    foreach (Thing* thing, m_things) {
+        if (thing->thingClassId() == thingClassId) {
+            return thing->thingClass();
+        }
+    }
+    return ThingClass();
+}
+
+ThingDiscoveryInfo* MockThingManager::discoverThings(
+    const ThingClassId& thingClassId, const ParamList& params)
+{
+    Q_UNUSED(thingClassId)
+    Q_UNUSED(params)
+    return nullptr;
+}
+
+// The engine only sets up things on its own if the grid support thing is missing, the tools
+// always add one
+ThingSetupInfo* MockThingManager::addConfiguredThing(
+    const ThingClassId& thingClassId, const ParamList& params, const QString& name)
+{
+    Q_UNUSED(params)
+    qCCritical(dcConsolinnoEnergy()) << "The mock thing manager can not set up" << name
+                                     << thingClassId.toString() << ", add it with addThing()";
+    return nullptr;
+}
+
+ThingSetupInfo* MockThingManager::addConfiguredThing(
+    const ThingDescriptorId& thingDescriptorId, const ParamList& params, const QString& name)
+{
+    Q_UNUSED(thingDescriptorId)
+    Q_UNUSED(params)
+    Q_UNUSED(name)
+    return nullptr;
+}
+
+ThingSetupInfo* MockThingManager::reconfigureThing(
+    const ThingId& thingId, const ParamList& params, const QString& name)
+{
+    Q_UNUSED(thingId)
+    Q_UNUSED(params)
+    Q_UNUSED(name)
+    return nullptr;
+}
+
+ThingSetupInfo* MockThingManager::reconfigureThing(
+    const ThingDescriptorId& thingDescriptorId, const ParamList& params, const QString& name)
+{
+    Q_UNUSED(thingDescriptorId)
+    Q_UNUSED(params)
+    Q_UNUSED(name)
+    return nullptr;
+}
+
+Thing::ThingError MockThingManager::editThing(const ThingId& thingId, const QString& name)
+{
+    Thing* thing = m_thingsById.value(thingId);
+    if (!thing)
+        return Thing::ThingErrorThingNotFound;
+
+    thing->setName(name);
+    return Thing::ThingErrorNoError;
+}
+
+Thing::ThingError MockThingManager::setThingSettings(
+    const ThingId& thingId, const ParamList& settings)
+{
+    Q_UNUSED(thingId)
+    Q_UNUSED(settings)
+    return Thing::ThingErrorUnsupportedFeature;
+}
+
+ThingPairingInfo* MockThingManager::pairThing(
+    const ThingClassId& thingClassId, const ParamList& params, const QString& name)
+{
+    Q_UNUSED(thingClassId)
+    Q_UNUSED(params)
+    Q_UNUSED(name)
+    return nullptr;
+}
+
+ThingPairingInfo* MockThingManager::pairThing(
+    const ThingDescriptorId& thingDescriptorId, const ParamList& params, const QString& name)
+{
+    Q_UNUSED(thingDescriptorId)
+    Q_UNUSED(params)
+    Q_UNUSED(name)
+    return nullptr;
+}
+
+ThingPairingInfo* MockThingManager::pairThing(
+    const ThingId& thingId, const ParamList& params, const QString& name)
+{
+    Q_UNUSED(thingId)
+    Q_UNUSED(params)
+    Q_UNUSED(name)
+    return nullptr;
+}
+
+ThingPairingInfo* MockThingManager::confirmPairing(
+    const PairingTransactionId& pairingTransactionId, const QString& username,
+    const QString& secret)
+{
+    Q_UNUSED(pairingTransactionId)
+    Q_UNUSED(username)
+    Q_UNUSED(secret)
+    return nullptr;
+}
+
+Thing::ThingError MockThingManager::removeConfiguredThing(const ThingId& thingId)
+{
+    if (!m_thingsById.contains(thingId))
+        return Thing::ThingErrorThingNotFound;
+
+    removeThing(thingId);
+    return Thing::ThingErrorNoError;
+}
+
+ThingActionInfo* MockThingManager::executeAction(const Action& action)
+{
+    m_executedActions++;
+
+    Thing* thing = m_thingsById.value(action.thingId());
+    ThingActionInfo* info = new ThingActionInfo(thing, action, this);
+    if (!thing) {
+        info->finish(Thing::ThingErrorThingNotFound);
+        return info;
+    }
+
+    StateTypeId stateTypeId(action.actionTypeId().toString());
+    if (!action.params().isEmpty() && thing->thingClass().hasStateType(stateTypeId)) {
+        thing->setStateValue(stateTypeId, action.params().first().value());
+    }
+    emit actionRequested(thing, action);
+
+    // Finished gets emitted queued, after the caller connected to it
+    info->finish(Thing::ThingErrorNoError);
+    return info;
+}
+
+BrowseResult* MockThingManager::browseThing(
+    const ThingId& thingId, const QString& itemId, const QLocale& locale)
+{
+    Q_UNUSED(thingId)
+    Q_UNUSED(itemId)
+    Q_UNUSED(locale)
+    return nullptr;
+}
+
+BrowserItemResult* MockThingManager::browserItemDetails(
+    const ThingId& thingId, const QString& itemId, const QLocale& locale)
+{
+    Q_UNUSED(thingId)
+    Q_UNUSED(itemId)
+    Q_UNUSED(locale)
+    return nullptr;
+}
+
+BrowserActionInfo* MockThingManager::executeBrowserItem(const BrowserAction& browserAction)
+{
+    Q_UNUSED(browserAction)
+    return nullptr;
+}
+
+BrowserItemActionInfo* MockThingManager::executeBrowserItemAction(
+    const BrowserItemAction& browserItemAction)
+{
+    Q_UNUSED(browserItemAction)
+    return nullptr;
+}
+
+IOConnections MockThingManager::ioConnections(const ThingId& thingId) const
+{
+    Q_UNUSED(thingId)
+    return IOConnections();
+}
+
+IOConnectionResult MockThingManager::connectIO(const IOConnection& connection)
+{
+    Q_UNUSED(connection)
+    return IOConnectionResult();
+}
+
+IOConnectionResult MockThingManager::connectIO(const ThingId& inputThing,
+    const StateTypeId& inputState, const ThingId& outputThing, const StateTypeId& outputState,
+    bool inverted)
+{
+    Q_UNUSED(inputThing)
+    Q_UNUSED(inputState)
+    Q_UNUSED(outputThing)
+    Q_UNUSED(outputState)
+    Q_UNUSED(inverted)
+    return IOConnectionResult();
+}
+
+Thing::ThingError MockThingManager::disconnectIO(const IOConnectionId& ioConnectionId)
+{
+    Q_UNUSED(ioConnectionId)
+    return Thing::ThingErrorUnsupportedFeature;
+}
+
+QString MockThingManager::translate(
+    const PluginId& pluginId, const QString& string, const QLocale& locale)
+{
+    Q_UNUSED(pluginId)
+    Q_UNUSED(locale)
+    return string;
+}
+
+ParamType MockThingManager::translateParamType(
+    const PluginId& pluginId, const ParamType& paramType, const QLocale& locale)
+{
+    Q_UNUSED(pluginId)
+    Q_UNUSED(locale)
+    return paramType;
+}
+
+ThingClass MockThingManager::translateThingClass(
+    const ThingClass& thingClass, const QLocale& locale)
+{
+    Q_UNUSED(locale)
+    return thingClass;
+}
+
+Vendor MockThingManager::translateVendor(const Vendor& vendor, const QLocale& locale)
+{
+    Q_UNUSED(locale)
+    return vendor;
+}
+
+Thing::ThingError MockThingManager::setStateLogging(
+    const ThingId& thingId, const StateTypeId& stateTypeId, bool enabled)
+{
+    Q_UNUSED(thingId)
+    Q_UNUSED(stateTypeId)
+    Q_UNUSED(enabled)
+    return Thing::ThingErrorNoError;
+}
+
+Thing::ThingError MockThingManager::setEventLogging(
+    const ThingId& thingId, const EventTypeId& eventTypeId, bool enabled)
+{
+    Q_UNUSED(thingId)
+    Q_UNUSED(eventTypeId)
+    Q_UNUSED(enabled)
+    return Thing::ThingErrorNoError;
+}
+
+Thing::ThingError MockThingManager::setActionLogging(
+    const ThingId& thingId, const ActionTypeId& actionTypeId, bool enabled)
+{
+    Q_UNUSED(thingId)
+    Q_UNUSED(actionTypeId)
+    Q_UNUSED(enabled)
+    return Thing::ThingErrorNoError;
+}
+
+Thing::ThingError MockThingManager::setStateFilter(
+    const ThingId& thingId, const StateTypeId& stateTypeId, Types::StateValueFilter filter)
+{
+    Q_UNUSED(thingId)
+    Q_UNUSED(stateTypeId)
+    Q_UNUSED(filter)
+    return Thing::ThingErrorNoError;
+}
@@ -0,0 +1,115 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#ifndef MOCKTHINGMANAGER_H
+#define MOCKTHINGMANAGER_H
+
+#include <QHash>
+
+#include <integrations/thingmanager.h>
+
+/*!
+ * \brief The MockThingManager class holds the things of a benchmark or replay in memory.
+ * \details Things are added with addThing(), setting up things of integration plugins is not
+ * supported. Executed actions set the state with the id of the action type right away, like an
+ * integration confirming the new value with its next poll, and finish successfully.
+ */
+class MockThingManager : public ThingManager {
+    Q_OBJECT
+public:
+    explicit MockThingManager(QObject* parent = nullptr);
+
+    // Takes the ownership of the thing
+    void addThing(Thing* thing);
+    void removeThing(const ThingId& thingId);
+
+    quint64 executedActions() const;
+
+    IntegrationPlugins plugins() const override;
+    IntegrationPlugin* plugin(const PluginId& pluginId) const override;
+    Thing::ThingError setPluginConfig(
+        const PluginId& pluginId, const ParamList& pluginConfig) override;
+
+    Vendors supportedVendors() const override;
+    Interfaces supportedInterfaces() const override;
+    ThingClasses supportedThings(const VendorId& vendorId = VendorId()) const override;
+
+    Things configuredThings() const override;
+    Thing* findConfiguredThing(const ThingId& id) const override;
+    Things findConfiguredThings(const ThingClassId& thingClassId) const override;
+    Things findConfiguredThings(const QString& interface) const override;
+    Things findChildThings(const ThingId& id) const override;
+    ThingClass findThingClass(const ThingClassId& thingClassId) const override;
+
+    ThingDiscoveryInfo* discoverThings(
+        const ThingClassId& thingClassId, const ParamList& params) override;
+
+    ThingSetupInfo* addConfiguredThing(const ThingClassId& thingClassId, const ParamList& params,
+        const QString& name = QString()) override;
+    ThingSetupInfo* addConfiguredThing(const ThingDescriptorId& thingDescriptorId,
+        const ParamList& params = ParamList(), const QString& name = QString()) override;
+
+    ThingSetupInfo* reconfigureThing(
+        const ThingId& thingId, const ParamList& params, const QString& name = QString()) override;
+    ThingSetupInfo* reconfigureThing(const ThingDescriptorId& thingDescriptorId,
+        const ParamList& params = ParamList(), const QString& name = QString()) override;
+
+    Thing::ThingError editThing(const ThingId& thingId, const QString& name) override;
+    Thing::ThingError setThingSettings(const ThingId& thingId, const ParamList& settings) override;
+
+    ThingPairingInfo* pairThing(const ThingClassId& thingClassId, const ParamList& params,
+        const QString& name = QString()) override;
+    ThingPairingInfo* pairThing(const ThingDescriptorId& thingDescriptorId,
+        const ParamList& params = ParamList(), const QString& name = QString()) override;
+    ThingPairingInfo* pairThing(const ThingId& thingId, const ParamList& params = ParamList(),
+        const QString& name = QString()) override;
+    ThingPairingInfo* confirmPairing(const PairingTransactionId& pairingTransactionId,
+        const QString& username, const QString& secret) override;
+
+    Thing::ThingError removeConfiguredThing(const ThingId& thingId) override;
+
+    ThingActionInfo* executeAction(const Action& action) override;
+
+    BrowseResult* browseThing(
+        const ThingId& thingId, const QString& itemId, const QLocale& locale) override;
+    BrowserItemResult* browserItemDetails(
+        const ThingId& thingId, const QString& itemId, const QLocale& locale) override;
+    BrowserActionInfo* executeBrowserItem(const BrowserAction& browserAction) override;
+    BrowserItemActionInfo* executeBrowserItemAction(
+        const BrowserItemAction& browserItemAction) override;
+
+    IOConnections ioConnections(const ThingId& thingId = ThingId()) const override;
+    IOConnectionResult connectIO(const IOConnection& connection) override;
+    IOConnectionResult connectIO(const ThingId& inputThing, const StateTypeId& inputState,
+        const ThingId& outputThing, const StateTypeId& outputState, bool inverted = false) override;
+    Thing::ThingError disconnectIO(const IOConnectionId& ioConnectionId) override;
+
+    QString translate(
+        const PluginId& pluginId, const QString& string, const QLocale& locale) override;
+    ParamType translateParamType(
+        const PluginId& pluginId, const ParamType& paramType, const QLocale& locale) override;
+    ThingClass translateThingClass(const ThingClass& thingClass, const QLocale& locale) override;
+    Vendor translateVendor(const Vendor& vendor, const QLocale& locale) override;
+
+    Thing::ThingError setStateLogging(
+        const ThingId& thingId, const StateTypeId& stateTypeId, bool enabled) override;
+    Thing::ThingError setEventLogging(
+        const ThingId& thingId, const EventTypeId& eventTypeId, bool enabled) override;
+    Thing::ThingError setActionLogging(
+        const ThingId& thingId, const ActionTypeId& actionTypeId, bool enabled) override;
+    Thing::ThingError setStateFilter(const ThingId& thingId, const StateTypeId& stateTypeId,
+        Types::StateValueFilter filter) override;
+
+signals:
+    // Emitted for every executed action, after the state has been set
+    void actionRequested(Thing* thing, const Action& action);
+
+private:
+    Things m_things;
+    QHash<ThingId, Thing*> m_thingsById;
+    quint64 m_executedActions = 0;
+};
+
+#endif // MOCKTHINGMANAGER_H
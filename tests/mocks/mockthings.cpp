@@ -0,0 +1,195 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include <QtCore>
+
+// Things get constructed and their states initialized by the thing manager of nymead only. Qt is
+// included above, so only the nymea types get their private members opened up here.
+#define private public
+#include <integrations/thing.h>
+#undef private
+
+#include "mockthings.h"
+
+namespace {
+
+const PluginId mockPluginId("364ab64c-d93e-4723-b64a-e32241ceca75");
+const VendorId mockVendorId("4aed5f55-8ba6-4c06-a335-770ddbe35044");
+
+struct MockStateType {
+    MockStateType(const QString& name, QVariant::Type type, const QVariant& defaultValue,
+        bool writable = false, const QVariant& minValue = QVariant(),
+        const QVariant& maxValue = QVariant())
+        : name(name)
+        , type(type)
+        , defaultValue(defaultValue)
+        , writable(writable)
+        , minValue(minValue)
+        , maxValue(maxValue)
+    {
+    }
+
+    QString name;
+    QVariant::Type type;
+    QVariant defaultValue;
+    bool writable;
+    QVariant minValue;
+    QVariant maxValue;
+};
+
+// State type ids are derived from the thing class id and the name of the state
+StateTypeId stateTypeId(const ThingClassId& thingClassId, const QString& name)
+{
+    return StateTypeId(QUuid::createUuidV5(thingClassId, name).toString());
+}
+
+ThingClass createThingClass(const ThingClassId& thingClassId, const QString& name,
+    const QStringList& interfaces, const QList<MockStateType>& mockStateTypes)
+{
+    ThingClass thingClass(mockPluginId, mockVendorId, thingClassId);
+    thingClass.setName(name);
+    thingClass.setDisplayName(name);
+    thingClass.setInterfaces(interfaces);
+
+    StateTypes stateTypes;
+    ActionTypes actionTypes;
+    foreach (const MockStateType& mockStateType, mockStateTypes) {
+        StateTypeId id = stateTypeId(thingClassId, mockStateType.name);
+        StateType stateType(id);
+        stateType.setName(mockStateType.name);
+        stateType.setDisplayName(mockStateType.name);
+        stateType.setType(mockStateType.type);
+        stateType.setDefaultValue(mockStateType.defaultValue);
+        stateType.setMinValue(mockStateType.minValue);
+        stateType.setMaxValue(mockStateType.maxValue);
+        stateTypes.append(stateType);
+
+        if (!mockStateType.writable)
+            continue;
+
+        // Like in the plugin json files, the action and its param share the id of the state
+        ActionType actionType(ActionTypeId(id.toString()));
+        actionType.setName(mockStateType.name);
+        actionType.setDisplayName(mockStateType.name);
+        ParamTypes paramTypes;
+        ParamType paramType(ParamTypeId(id.toString()), mockStateType.name, mockStateType.type,
+            mockStateType.defaultValue);
+        paramType.setMinValue(mockStateType.minValue);
+        paramType.setMaxValue(mockStateType.maxValue);
+        paramTypes.append(paramType);
+        actionType.setParamTypes(paramTypes);
+        actionTypes.append(actionType);
+    }
+    thingClass.setStateTypes(stateTypes);
+    thingClass.setActionTypes(actionTypes);
+    return thingClass;
+}
+
+}
+
+ThingClass MockThings::rootMeterClass()
+{
+    static const ThingClass thingClass = createThingClass(
+        ThingClassId("3bde5184-6feb-4f20-b667-d33294dff4db"), "mockMeter",
+        QStringList() << "energymeter",
+        QList<MockStateType>() << MockStateType { "currentPower", QVariant::Double, 0.0 }
+                               << MockStateType { "currentPowerPhaseA", QVariant::Double, 0.0 }
+                               << MockStateType { "currentPowerPhaseB", QVariant::Double, 0.0 }
+                               << MockStateType { "currentPowerPhaseC", QVariant::Double, 0.0 });
+    return thingClass;
+}
+
+ThingClass MockThings::evChargerClass()
+{
+    static const ThingClass thingClass = createThingClass(
+        ThingClassId("a7b4286c-8cd7-4d8d-88c3-177eb0a44eb6"), "mockEvCharger",
+        QStringList() << "evcharger" << "smartmeterconsumer",
+        QList<MockStateType>()
+            << MockStateType { "power", QVariant::Bool, true, true }
+            << MockStateType { "maxChargingCurrent", QVariant::UInt, 6, true, 6, 32 }
+            << MockStateType { "pluggedIn", QVariant::Bool, true }
+            << MockStateType { "phaseCount", QVariant::UInt, 3, false, 1, 3 }
+            << MockStateType { "currentPower", QVariant::Double, 0.0 });
+    return thingClass;
+}
+
+ThingClass MockThings::heatPumpClass()
+{
+    static const ThingClass thingClass = createThingClass(
+        ThingClassId("8db9a581-6e2f-4627-b840-b72e9d4efd62"), "mockHeatPump",
+        QStringList() << "heatpump" << "smartgridheatpump",
+        QList<MockStateType>()
+            << MockStateType { "sgReadyMode", QVariant::String, "Standard", true }
+            << MockStateType { "currentPower", QVariant::Double, 0.0 });
+    return thingClass;
+}
+
+ThingClass MockThings::heatingRodClass()
+{
+    static const ThingClass thingClass = createThingClass(
+        ThingClassId("1d1a94d8-5c90-4d97-949a-1947862bde30"), "mockHeatingRod",
+        QStringList() << "smartheatingrod",
+        QList<MockStateType>() << MockStateType { "power", QVariant::Bool, true, true }
+                               << MockStateType { "currentPower", QVariant::Double, 0.0 });
+    return thingClass;
+}
+
+ThingClass MockThings::batteryClass()
+{
+    static const ThingClass thingClass = createThingClass(
+        ThingClassId("3e142fe2-e468-43d8-80eb-5c81fdd427cc"), "mockBattery",
+        QStringList() << "energystorage",
+        QList<MockStateType>() << MockStateType { "currentPower", QVariant::Double, 0.0 }
+                               << MockStateType { "batteryLevel", QVariant::Int, 50, false, 0, 100 }
+                               << MockStateType { "batteryCritical", QVariant::Bool, false });
+    return thingClass;
+}
+
+ThingClass MockThings::inverterClass()
+{
+    static const ThingClass thingClass
+        = createThingClass(ThingClassId("a3d5c122-90d9-4406-91ed-1f6dc53d778e"), "mockInverter",
+            QStringList() << "solarinverter",
+            QList<MockStateType>() << MockStateType { "currentPower", QVariant::Double, 0.0 });
+    return thingClass;
+}
+
+ThingClass MockThings::carClass()
+{
+    static const ThingClass thingClass = createThingClass(
+        ThingClassId("e2675cf5-4f0a-4973-9980-15ff03e4650a"), "mockCar",
+        QStringList() << "electricvehicle",
+        QList<MockStateType>() << MockStateType { "batteryLevel", QVariant::Int, 50, false, 0, 100 }
+                               << MockStateType { "capacity", QVariant::Double, 50.0 });
+    return thingClass;
+}
+
+ThingClass MockThings::gridSupportClass()
+{
+    static const ThingClass thingClass = createThingClass(
+        ThingClassId("d6821b26-ddb2-4115-84dd-92db0e961bc3"), "mockGridSupport",
+        QStringList() << "gridsupport",
+        QList<MockStateType>() << MockStateType { "plim", QVariant::Double, -1.0 }
+                               << MockStateType { "plimStatus", QVariant::String, "unrestricted" }
+                               << MockStateType { "plimActionLatency", QVariant::Int, -1 }
+                               << MockStateType { "plimMeterLatency", QVariant::Int, -1 });
+    return thingClass;
+}
+
+Thing* MockThings::create(
+    const ThingClass& thingClass, const QString& name, const ThingId& thingId, QObject* parent)
+{
+    Thing* thing = new Thing(mockPluginId, thingClass, thingId, parent);
+    thing->setName(name);
+
+    States states;
+    foreach (const StateType& stateType, thingClass.stateTypes()) {
+        State state(stateType.id(), thingId);
+        state.setValue(stateType.defaultValue());
+        states.append(state);
+    }
+    thing->setStates(states);
+    return thing;
+}
@@ -0,0 +1,35 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#ifndef MOCKTHINGS_H
+#define MOCKTHINGS_H
+
+#include <integrations/thing.h>
+#include <types/thingclass.h>
+
+/*!
+ * \brief The MockThings class creates things of minimal thing classes for the engine.
+ * \details Every thing class only has the interfaces and the states the engine looks up by name,
+ * writable states have an action type with the id of the state. The ids are fixed, a capture
+ * replayed twice addresses the same states.
+ */
+class MockThings {
+public:
+    static ThingClass rootMeterClass();
+    static ThingClass evChargerClass();
+    static ThingClass heatPumpClass();
+    static ThingClass heatingRodClass();
+    static ThingClass batteryClass();
+    static ThingClass inverterClass();
+    static ThingClass carClass();
+    // Has the thing class id the engine uses when it adds the grid support thing itself
+    static ThingClass gridSupportClass();
+
+    // All states start with the default value of their state type
+    static Thing* create(const ThingClass& thingClass, const QString& name,
+        const ThingId& thingId = ThingId::createThingId(), QObject* parent = nullptr);
+};
+
+#endif // MOCKTHINGS_H
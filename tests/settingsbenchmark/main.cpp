@@ -0,0 +1,231 @@
+/* Copyright (C) Consolinno Energy GmbH - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLoggingCategory>
+#include <QTemporaryDir>
+
+#include <functional>
+
+#include "configurations/batteryconfiguration.h"
+#include "configurations/chargingconfiguration.h"
+#include "configurations/chargingoptimizationconfiguration.h"
+#include "configurations/chargingsessionconfiguration.h"
+#include "configurations/heatingconfiguration.h"
+#include "configurations/pvconfiguration.h"
+#include "configurationstore.h"
+#include "settingsstore.h"
+
+Q_LOGGING_CATEGORY(dcConsolinnoEnergy, "ConsolinnoEnergy")
+
+namespace {
+
+struct Measurement {
+    quint64 calls = 0;
+    qint64 nsecs = 0;
+
+    QJsonObject toJson() const
+    {
+        QJsonObject object;
+        object.insert("calls", static_cast<qint64>(calls));
+        object.insert("usPerCall", calls > 0 ? nsecs / 1000.0 / calls : 0);
+        object.insert("perSecond", nsecs > 0 ? calls * 1e9 / nsecs : 0);
+        return object;
+    }
+};
+
+// Repeats the function for the given duration
+Measurement measure(int duration, const std::function<void()>& function)
+{
+    Measurement measurement;
+    QElapsedTimer total;
+    total.start();
+    QElapsedTimer timer;
+    while (measurement.calls == 0 || total.elapsed() < duration) {
+        timer.start();
+        function();
+        measurement.nsecs += timer.nsecsElapsed();
+        measurement.calls++;
+    }
+    return measurement;
+}
+
+// Stores count configurations with default values, like the engine does for new things
+template <typename T>
+void addConfigurations(
+    SettingsStore* settings, const QString& group, const char* idProperty, int count)
+{
+    ConfigurationStore<T> store(settings, group, idProperty);
+    const QMetaObject& metaObject = T::staticMetaObject;
+    QMetaProperty id = metaObject.property(metaObject.indexOfProperty(idProperty));
+    for (int i = 0; i < count; i++) {
+        T configuration;
+        id.writeOnGadget(&configuration, QUuid::createUuid());
+        store.setValue(configuration);
+    }
+}
+
+/*!
+ * \brief The Benchmark class measures the snapshots of the SettingsStore.
+ * \details The configuration set is the one of a system with N ev chargers, heat pumps, batteries
+ * and pv inverters: every kind of configuration the engine persists for them plus the global
+ * settings. Writing includes the fsync and the renames, loading reads and validates the current
+ * generation.
+ */
+class Benchmark {
+public:
+    explicit Benchmark(int duration)
+        : m_duration(duration)
+    {
+    }
+
+    QJsonObject run(int count) const;
+
+private:
+    int m_duration;
+};
+
+QJsonObject Benchmark::run(int count) const
+{
+    QTemporaryDir settingsDir;
+    QString fileName = settingsDir.path() + "/consolinno.conf";
+
+    SettingsStore* settings = new SettingsStore(fileName);
+    settings->setValue("Settings/controlLoopInterval", 1000);
+    settings->setValue("Settings/flushInterval", 5000);
+    settings->setValue("BlackoutProtection/housholdPhaseLimit", 25);
+    addConfigurations<HeatingConfiguration>(
+        settings, "HeatingConfigurations", "heatPumpThingId", count);
+    addConfigurations<ChargingConfiguration>(
+        settings, "ChargingConfigurations", "evChargerThingId", count);
+    addConfigurations<ChargingOptimizationConfiguration>(
+        settings, "ChargingOptimizationConfigurations", "evChargerThingId", count);
+    addConfigurations<ChargingSessionConfiguration>(
+        settings, "ChargingSessionConfigurations", "evChargerThingId", count);
+    addConfigurations<BatteryConfiguration>(
+        settings, "BatteryConfigurations", "batteryThingId", count);
+    addConfigurations<PvConfiguration>(settings, "PvConfigurations", "pvThingId", count);
+    settings->flush();
+
+    QJsonObject result;
+    result.insert("count", count);
+    result.insert("snapshotBytes", QFileInfo(settings->snapshotFileName()).size());
+
+    // One changed value per flush, the whole snapshot gets written every time
+    int revision = 0;
+    result.insert("write", measure(m_duration, [settings, &revision]() {
+        settings->setValue("Settings/benchmarkRevision", ++revision);
+        settings->flush();
+    }).toJson());
+    result.insert("generations", static_cast<qint64>(settings->generation()));
+    delete settings;
+
+    result.insert("load", measure(m_duration, [fileName]() {
+        SettingsStore store(fileName);
+    }).toJson());
+
+    // The current generation is damaged, the last known good one gets loaded and written back
+    Measurement recovery;
+    QElapsedTimer total;
+    total.start();
+    QElapsedTimer timer;
+    while (recovery.calls == 0 || total.elapsed() < m_duration) {
+        QFile snapshot(fileName + ".snapshot");
+        if (!snapshot.open(QIODevice::ReadWrite)) {
+            qCritical() << "Could not open" << snapshot.fileName() << snapshot.errorString();
+            break;
+        }
+        snapshot.seek(snapshot.size() - 1);
+        snapshot.write("x");
+        snapshot.close();
+
+        timer.start();
+        SettingsStore store(fileName);
+        store.flush();
+        recovery.nsecs += timer.nsecsElapsed();
+        recovery.calls++;
+    }
+    result.insert("recovery", recovery.toJson());
+    return result;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication application(argc, argv);
+    application.setApplicationName("settingsbenchmark");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Measures writing, loading and recovering the settings "
+                                     "snapshot with the configurations of N ev chargers, heat "
+                                     "pumps, batteries and pv inverters each, and writes the "
+                                     "results as JSON.");
+    parser.addHelpOption();
+    QCommandLineOption countsOption("counts", "Comma separated unit counts.", "counts",
+        "1,10,100");
+    QCommandLineOption durationOption(
+        "duration", "Duration of each measurement in milliseconds.", "ms", "500");
+    QCommandLineOption outputOption("output", "Write the results to this file instead of stdout.",
+        "file");
+    QCommandLineOption verboseOption("verbose", "Keep the debug output of the settings store.");
+    parser.addOption(countsOption);
+    parser.addOption(durationOption);
+    parser.addOption(outputOption);
+    parser.addOption(verboseOption);
+    parser.process(application);
+
+    // The store logs every flush and every recovery, that would be measured as well
+    if (!parser.isSet(verboseOption)) {
+        QLoggingCategory::setFilterRules(
+            "*.debug=false\n*.info=false\nConsolinnoEnergy.warning=false");
+    }
+
+    QList<int> counts;
+    QStringList countList = parser.value(countsOption).split(',', QString::SkipEmptyParts);
+    foreach (const QString& count, countList) {
+        bool ok = false;
+        counts.append(count.toInt(&ok));
+        if (!ok || counts.last() < 1) {
+            qCritical() << "Invalid unit count" << count;
+            return 1;
+        }
+    }
+
+    Benchmark benchmark(qMax(1, parser.value(durationOption).toInt()));
+    QJsonArray runs;
+    foreach (int count, counts) {
+        qWarning() << "Running the benchmark with" << count << "units of each kind";
+        runs.append(benchmark.run(count));
+    }
+
+    QJsonObject results;
+    results.insert("timestamp", QDateTime::currentDateTimeUtc().toString(Qt::ISODate));
+    results.insert("qtVersion", QString(qVersion()));
+    results.insert("durationMs", parser.value(durationOption).toInt());
+    results.insert("runs", runs);
+    QByteArray json = QJsonDocument(results).toJson();
+
+    QFile output;
+    if (parser.isSet(outputOption)) {
+        output.setFileName(parser.value(outputOption));
+        if (!output.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            qCritical() << "Could not open" << output.fileName() << output.errorString();
+            return 1;
+        }
+    } else {
+        output.open(stdout, QIODevice::WriteOnly);
+    }
+    output.write(json);
+    return 0;
+}
@@ -0,0 +1,8 @@
+include(../engine.pri)
+
+TARGET = settingsbenchmark
+CONFIG += console
+CONFIG -= app_bundle
+
+SOURCES += \
+    main.cpp
@@ -0,0 +1,6 @@
+# Shared by all test and tool targets, the engine sources get compiled into each of them
+QT -= gui
+CONFIG += c++11
+
+ENGINE_DIR = $$PWD/..
+INCLUDEPATH += $$ENGINE_DIR
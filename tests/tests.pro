@@ -0,0 +1,8 @@
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    auto \
+    enginebenchmark \
+    enginereplay \
+    limitsourcestub \
+    settingsbenchmark